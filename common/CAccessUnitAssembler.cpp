@@ -0,0 +1,260 @@
+/*************************************************************************
+    > File Name: CAccessUnitAssembler.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 18时12分40秒
+ ************************************************************************/
+
+#include <math.h>
+#include "CAccessUnitAssembler.h"
+
+CAccessUnitAssembler::CAccessUnitAssembler() : m_pScanner(NULL),m_bHasPending(false),m_pLastBase(NULL),m_nLastBaseOffset(0),
+	m_fDefaultFrameRate(25),m_nSpsId(-1),m_fNextDts(0),m_fPocBaseDts(0),m_nPocBase(0),m_bHasPocBase(false),m_nReorderDelay(0),
+	m_bInjectedOut(false)
+{
+
+}
+
+CAccessUnitAssembler::~CAccessUnitAssembler()
+{
+
+}
+
+void CAccessUnitAssembler::Attach(CAnnexbScanner* scanner)
+{
+	m_pScanner = scanner;
+	m_Parser.Reset();
+	m_bHasPending = false;
+	m_pLastBase = NULL;
+	m_nLastBaseOffset = 0;
+	m_nSpsId = -1;
+	m_fNextDts = 0;
+	m_fPocBaseDts = 0;
+	m_nPocBase = 0;
+	m_bHasPocBase = false;
+	m_nReorderDelay = 0;
+	m_Injected.clear();
+	m_InjectData.clear();
+	m_bInjectedOut = false;
+}
+
+void CAccessUnitAssembler::SetDefaultFrameRate(double fps)
+{
+	if(fps > 0)
+		m_fDefaultFrameRate = fps;
+}
+
+void CAccessUnitAssembler::Resync(int64_t dts)
+{
+	m_bHasPending = false;
+	m_pLastBase = NULL;
+	m_fNextDts = (double)dts;
+	m_bHasPocBase = false;
+}
+
+void CAccessUnitAssembler::InjectParameterSet(const NaluView& n)
+{
+	if(m_bInjectedOut)
+	{
+		m_Injected.clear();
+		m_InjectData.clear();
+		m_bInjectedOut = false;
+	}
+	if(n.nal_unit_type == 7)
+		m_Parser.ParseSps(n.data,n.len);
+	else if(n.nal_unit_type == 8)
+		m_Parser.ParsePps(n.data,n.len);
+	else
+		return;
+	m_InjectData.push_back(std::vector<unsigned char>(n.data,n.data + n.len));
+	m_Injected.push_back(n);
+}
+
+double CAccessUnitAssembler::FrameDuration(const H264Sps* sps) const
+{
+	if(sps != NULL && sps->timing_info_present_flag)
+		return (double)AU_TIME_BASE * 2 * sps->num_units_in_tick / sps->time_scale;
+	return AU_TIME_BASE / m_fDefaultFrameRate;
+}
+
+double CAccessUnitAssembler::FrameRate() const
+{
+	return AU_TIME_BASE / FrameDuration(m_Parser.GetSps(m_nSpsId));
+}
+
+void CAccessUnitAssembler::Rebase(AccessUnit& au)
+{
+	if(m_pScanner->Base() == m_pLastBase && m_pScanner->BaseOffset() == m_nLastBaseOffset)
+		return;
+	m_pLastBase = m_pScanner->Base();
+	m_nLastBaseOffset = m_pScanner->BaseOffset();
+	for(size_t i = 0; i < au.nalus.size(); i++)
+		au.nalus[i].data = m_pScanner->Resolve(au.nalus[i].offset + au.nalus[i].startcodeprefix_len);
+}
+
+void CAccessUnitAssembler::Stamp(AccessUnit& au,const H264SliceHeader& sh,bool parsed)
+{
+	const H264Sps* sps = parsed ? m_Parser.GetSliceSps(sh) : NULL;
+	if(sps != NULL)
+		m_nSpsId = sps->sps_id;
+	double frame_dur = FrameDuration(m_Parser.GetSps(m_nSpsId));
+	double dts = m_fNextDts;
+
+	au.dts = au.pts = (int64_t)(dts + 0.5);
+	if(!au.has_picture)
+		return;
+
+	au.field = parsed && sh.field_pic_flag;
+	double dur = au.field ? frame_dur / 2 : frame_dur;
+	au.duration = (int64_t)(dur + 0.5);
+	m_fNextDts += dur;
+	if(!parsed)
+		return;
+
+	au.poc = m_Parser.ComputePoc(sh);
+	if(au.idr || !m_bHasPocBase)
+	{
+		m_nPocBase = au.poc;
+		m_fPocBaseDts = dts;
+		m_bHasPocBase = true;
+		if(sps != NULL && sps->max_num_reorder_frames > m_nReorderDelay)
+			m_nReorderDelay = sps->max_num_reorder_frames;
+	}
+
+	//POC每帧增加2(每场增加1)。SPS没有给出重排序帧数时，遇到PTS小于DTS的图像再加大延迟
+	double pts = m_fPocBaseDts + (au.poc - m_nPocBase) * frame_dur / 2 + m_nReorderDelay * frame_dur;
+	if(pts < dts)
+	{
+		int more = (int)ceil((dts - pts) / frame_dur);
+		m_nReorderDelay += more;
+		pts += more * frame_dur;
+	}
+	au.pts = (int64_t)(pts + 0.5);
+}
+
+int CAccessUnitAssembler::Next(AccessUnit& au)
+{
+	NaluView n;
+	H264SliceHeader sh,first_sh,prev_sh;
+	bool parsed = false,first_parsed = false;
+	int has_b = 0,has_p = 0;
+
+	au.nalus.clear();
+	au.offset = 0;
+	au.size = 0;
+	au.has_picture = 0;
+	au.idr = 0;
+	au.reference = 0;
+	au.slice_type = H264_SLICE_I;
+	au.field = 0;
+	au.poc = 0;
+	au.dts = au.pts = au.duration = 0;
+	memset(&first_sh,0,sizeof(first_sh));
+	memset(&prev_sh,0,sizeof(prev_sh));
+
+	if(m_bInjectedOut)
+	{
+		m_Injected.clear();
+		m_InjectData.clear();
+		m_bInjectedOut = false;
+	}
+	if(m_pScanner == NULL)
+		return 0;
+
+	while(1)
+	{
+		if(m_bHasPending)
+		{
+			n = m_Pending;
+			m_bHasPending = false;
+		}
+		else
+		{
+			//回调方式下，已经加入访问单元的NALU在扫描器补充数据时要保留
+			m_pScanner->SetKeep(au.nalus.empty() ? SCAN_KEEP_NONE : au.offset);
+			if(!m_pScanner->Next(n))
+				break;
+			Rebase(au);
+			if(n.len == 0)
+				continue;
+		}
+
+		int type = n.nal_unit_type;
+		bool vcl = (type == 1 || type == 5);
+		bool boundary = false;
+		if(type == 9)
+		{
+			//AUD总是访问单元的第一个NALU
+			boundary = !au.nalus.empty();
+		}
+		else if(type == 6 || type == 7 || type == 8 || (type >= 14 && type <= 18))
+		{
+			//SEI、参数集等出现在片之后，说明上一个图像已经结束
+			boundary = au.has_picture;
+		}
+		else if(vcl)
+		{
+			parsed = m_Parser.ParseSliceHeader(n.data,n.len,sh);
+			//片头无法解析(如缺少参数集)时无法判断，每个片单独作为一个访问单元
+			if(au.has_picture)
+				boundary = !parsed || !first_parsed || m_Parser.IsNewPicture(prev_sh,sh);
+		}
+		if(boundary)
+		{
+			m_Pending = n;
+			m_bHasPending = true;
+			break;
+		}
+
+		if(au.nalus.empty())
+			au.offset = n.offset;
+		if(type == 7)
+		{
+			m_Parser.ParseSps(n.data,n.len);
+		}
+		else if(type == 8)
+		{
+			m_Parser.ParsePps(n.data,n.len);
+		}
+		else if(vcl)
+		{
+			if(!au.has_picture)
+			{
+				au.has_picture = 1;
+				au.idr = (type == 5);
+				first_sh = sh;
+				first_parsed = parsed;
+			}
+			if(n.nal_reference_idc)
+				au.reference = 1;
+			if(parsed)
+			{
+				if(sh.slice_type == H264_SLICE_B)
+					has_b = 1;
+				else if(sh.slice_type == H264_SLICE_P || sh.slice_type == H264_SLICE_SP)
+					has_p = 1;
+			}
+			prev_sh = sh;
+		}
+		au.nalus.push_back(n);
+		au.size += n.len;
+	}
+
+	if(au.nalus.empty())
+		return 0;
+	if(!m_Injected.empty() && !m_bInjectedOut)
+	{
+		//拷贝的参数集放在访问单元最前面，视图指向拷贝的数据
+		for(size_t i = 0; i < m_Injected.size(); i++)
+		{
+			m_Injected[i].data = &m_InjectData[i][0];
+			au.size += m_Injected[i].len;
+		}
+		au.nalus.insert(au.nalus.begin(),m_Injected.begin(),m_Injected.end());
+		m_bInjectedOut = true;
+	}
+	au.slice_type = has_b ? H264_SLICE_B : (has_p ? H264_SLICE_P : H264_SLICE_I);
+	Stamp(au,first_sh,first_parsed);
+	return 1;
+}
+
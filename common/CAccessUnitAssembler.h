@@ -0,0 +1,123 @@
+/*************************************************************************
+    > File Name: CAccessUnitAssembler.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 18时12分40秒
+ ************************************************************************/
+
+#ifndef CACCESS_UNIT_ASSEMBLER_H
+#define CACCESS_UNIT_ASSEMBLER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "CAnnexbScanner.h"
+#include "CH264Parser.h"
+
+//时间戳的时钟频率，与RTP的H.264时钟一致
+#define AU_TIME_BASE  90000
+
+/**
+ * _AccessUnit
+ * 一个访问单元(一帧或一场图像)及其前面的AUD/SPS/PPS/SEI等NALU
+ */
+typedef struct _AccessUnit
+{
+	std::vector<NaluView> nalus;  //按码流顺序的NALU视图，数据在下一次调用Next之前有效
+	uint64_t offset;              //第一个NALU起始码在码流中的偏移
+	unsigned int size;            //所有NALU数据的总长度，不包括起始码
+	int has_picture;              //是否包含片。码流末尾只有SEI等NALU时为0
+	int idr;                      //IDR图像
+	int reference;                //是否被参考(片的nal_ref_idc不为0)
+	int slice_type;               //H264_SLICE_I/P/B，包含B片为B，包含P片为P，否则为I
+	int field;                    //场图像
+	int poc;                      //图像顺序号
+	int64_t dts;                  //解码时间戳，单位1/AU_TIME_BASE秒
+	int64_t pts;                  //显示时间戳，单位1/AU_TIME_BASE秒
+	int64_t duration;             //持续时间，单位1/AU_TIME_BASE秒
+}AccessUnit;
+
+/**
+ * 访问单元组装器。从CAnnexbScanner依次取得NALU，按7.4.1.2.3节的规则(AUD、片之后出现的SPS/PPS/SEI、
+ * first_mb_in_slice以及frame_num/pps_id/nal_ref_idc/POC等片头字段的变化)把属于同一图像的NALU组成一个访问单元。
+ * DTS按帧间隔递增，帧间隔由SPS的VUI计时信息得到，没有时使用SetDefaultFrameRate的帧率；
+ * PTS由POC相对最近一个IDR的差值换算，并加上重排序延迟保证PTS不小于DTS
+ */
+class CAccessUnitAssembler
+{
+private:
+	CAnnexbScanner* m_pScanner;
+	CH264Parser m_Parser;
+	NaluView m_Pending;                //已经读出但属于下一个访问单元的NALU
+	bool m_bHasPending;
+	const unsigned char* m_pLastBase;  //扫描器缓冲区上次的地址，变化时重新计算视图地址
+	uint64_t m_nLastBaseOffset;
+
+	double m_fDefaultFrameRate;
+	int m_nSpsId;                      //最近一个图像引用的SPS
+	double m_fNextDts;                 //下一个访问单元的DTS，用浮点累加避免帧间隔取整造成漂移
+	double m_fPocBaseDts;              //最近一个IDR的DTS
+	int m_nPocBase;                    //最近一个IDR的POC
+	bool m_bHasPocBase;
+	int m_nReorderDelay;               //PTS相对POC推算值的延迟，单位帧
+
+	std::vector<NaluView> m_Injected;                 //InjectParameterSet交来的参数集，加在下一个访问单元前面
+	std::vector<std::vector<unsigned char> > m_InjectData;  //参数集数据的拷贝
+	bool m_bInjectedOut;               //参数集已经随访问单元输出，下一次调用Next时释放
+
+	//扫描器缓冲区移动后重新计算视图地址
+	void Rebase(AccessUnit& au);
+	//帧间隔，单位1/AU_TIME_BASE秒
+	double FrameDuration(const H264Sps* sps) const;
+	//计算访问单元的时间戳，sh为第一个片的片头，parsed表示片头是否解析成功
+	void Stamp(AccessUnit& au,const H264SliceHeader& sh,bool parsed);
+
+public:
+	CAccessUnitAssembler();
+	~CAccessUnitAssembler();
+
+	/**
+	 * 关联NALU扫描器，扫描器已经打开
+	 * @param scanner NALU扫描器
+	 */
+	void Attach(CAnnexbScanner* scanner);
+
+	/**
+	 * 码流中没有VUI计时信息时使用的帧率，默认25
+	 */
+	void SetDefaultFrameRate(double fps);
+
+	/**
+	 * 扫描器跳转(Seek)到一个访问单元的起始位置之后调用，丢弃已读出的NALU并从dts重新计算时间戳
+	 * @param dts 下一个访问单元的DTS，单位1/AU_TIME_BASE秒
+	 */
+	void Resync(int64_t dts);
+
+	/**
+	 * 解析一个不在当前读取位置的SPS/PPS(跳转时跳过的参数集)，拷贝后加在下一个访问单元的最前面输出
+	 * @param n SPS或PPS的视图，调用返回后不再使用
+	 */
+	void InjectParameterSet(const NaluView& n);
+
+	/**
+	 * 取得下一个访问单元
+	 * @param au 存储访问单元
+	 * @成功则返回 1 , 码流结束则返回 0
+	 */
+	int Next(AccessUnit& au);
+
+	/**
+	 * 当前使用的帧率，SPS中有计时信息时由SPS得到
+	 */
+	double FrameRate() const;
+
+	/**
+	 * 最近一个图像引用的SPS，还没有图像时返回NULL
+	 */
+	const H264Sps* ActiveSps() const { return m_Parser.GetSps(m_nSpsId); }
+
+	const CH264Parser& Parser() const { return m_Parser; }
+};
+
+#endif
+
@@ -0,0 +1,262 @@
+/*************************************************************************
+    > File Name: CAnnexbScanner.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 09时32分18秒
+ ************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "CAnnexbScanner.h"
+
+//不能mmap的文件(如管道)按块读入时每次读取的大小
+#define SCAN_READ_BLOCK_SIZE (4*1024*1024)
+
+CAnnexbScanner::CAnnexbScanner() : m_nFd(-1),m_pMap(NULL),m_bMapped(false),m_pBase(NULL),m_nSize(0),m_nPos(0),m_nBaseOffset(0),
+	m_pReadFunc(NULL),m_pStream(NULL),m_nCapacity(0),m_nBlockSize(0),m_bEof(false),m_nKeepOffset(SCAN_KEEP_NONE)
+{
+
+}
+
+CAnnexbScanner::~CAnnexbScanner()
+{
+	Close();
+}
+
+int CAnnexbScanner::Open(const char* fn)
+{
+	struct stat st;
+
+	Close();
+	if((m_nFd = open(fn,O_RDONLY)) < 0)
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,fn);
+		return 0;
+	}
+
+	if(fstat(m_nFd,&st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void* addr = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,m_nFd,0);
+		if(addr != MAP_FAILED)
+		{
+			//码流是顺序扫描的，提示内核加大预读
+			madvise(addr,st.st_size,MADV_SEQUENTIAL);
+			m_pMap = (unsigned char*)addr;
+			m_bMapped = true;
+			m_nSize = st.st_size;
+		}
+	}
+
+	//无法映射时退化为按大块读入内存
+	if(!m_bMapped)
+	{
+		uint64_t cap = 0;
+		ssize_t n;
+		while(1)
+		{
+			if(m_nSize + SCAN_READ_BLOCK_SIZE > cap)
+			{
+				cap = cap ? cap * 2 : SCAN_READ_BLOCK_SIZE * 2;
+				unsigned char* tmp = (unsigned char*)realloc(m_pMap,cap);
+				if(tmp == NULL)
+				{
+					printf("%s: ====haoge====realloc %llu bytes failed\n",__FUNCTION__,(unsigned long long)cap);
+					Close();
+					return 0;
+				}
+				m_pMap = tmp;
+			}
+			if((n = read(m_nFd,m_pMap + m_nSize,SCAN_READ_BLOCK_SIZE)) <= 0)
+				break;
+			m_nSize += n;
+		}
+	}
+
+	m_pBase = m_pMap;
+	m_nPos = 0;
+	return 1;
+}
+
+void CAnnexbScanner::Attach(const unsigned char* buf,uint64_t size)
+{
+	Close();
+	m_pBase = buf;
+	m_nSize = size;
+	m_nPos = 0;
+}
+
+int CAnnexbScanner::OpenStream(ReadBufferFunc read_buffer,unsigned int block_size)
+{
+	Close();
+	if(read_buffer == NULL || block_size == 0)
+		return 0;
+
+	//初始容量为两个读取块，之后只有当单个NALU放不下时才扩容
+	m_nCapacity = (uint64_t)block_size * 2;
+	if((m_pStream = (unsigned char*)malloc(m_nCapacity)) == NULL)
+	{
+		printf("%s: ====haoge====malloc %llu bytes failed\n",__FUNCTION__,(unsigned long long)m_nCapacity);
+		m_nCapacity = 0;
+		return 0;
+	}
+	m_pReadFunc = read_buffer;
+	m_nBlockSize = block_size;
+	m_bEof = false;
+	m_pBase = m_pStream;
+	return 1;
+}
+
+int CAnnexbScanner::Refill()
+{
+	int n;
+	uint64_t drop;
+
+	if(m_pReadFunc == NULL || m_bEof)
+		return 0;
+
+	//尾部空间不够读取一块时，先把m_nPos之前已经取走的数据丢弃(调用者要求保留的除外)，剩余数据移到缓冲区开头
+	drop = m_nPos;
+	if(m_nKeepOffset < m_nBaseOffset + drop)
+		drop = (m_nKeepOffset > m_nBaseOffset) ? m_nKeepOffset - m_nBaseOffset : 0;
+	if(m_nCapacity - m_nSize < m_nBlockSize && drop > 0)
+	{
+		memmove(m_pStream,m_pStream + drop,m_nSize - drop);
+		m_nBaseOffset += drop;
+		m_nSize -= drop;
+		m_nPos -= drop;
+	}
+
+	//剩下的数据(一个还没有找到结尾的NALU)已经占满缓冲区,按倍数扩容
+	if(m_nCapacity - m_nSize < m_nBlockSize)
+	{
+		uint64_t cap = m_nCapacity * 2;
+		if(cap < m_nSize + m_nBlockSize)
+			cap = m_nSize + m_nBlockSize;
+		unsigned char* tmp = (unsigned char*)realloc(m_pStream,cap);
+		if(tmp == NULL)
+		{
+			printf("%s: ====haoge====realloc %llu bytes failed\n",__FUNCTION__,(unsigned long long)cap);
+			m_bEof = true;
+			return 0;
+		}
+		m_pStream = tmp;
+		m_nCapacity = cap;
+	}
+	m_pBase = m_pStream;
+
+	if((n = m_pReadFunc(m_pStream + m_nSize,m_nBlockSize)) <= 0)
+	{
+		m_bEof = true;
+		return 0;
+	}
+	m_nSize += n;
+	return 1;
+}
+
+void CAnnexbScanner::Close()
+{
+	if(m_pMap)
+	{
+		if(m_bMapped)
+			munmap(m_pMap,m_nSize);
+		else
+			free(m_pMap);
+	}
+	if(m_nFd >= 0)
+		close(m_nFd);
+	m_nFd = -1;
+	m_pMap = NULL;
+	m_bMapped = false;
+	if(m_pStream)
+		free(m_pStream);
+	m_pStream = NULL;
+	m_pReadFunc = NULL;
+	m_nCapacity = 0;
+	m_nBlockSize = 0;
+	m_bEof = false;
+	m_pBase = NULL;
+	m_nSize = 0;
+	m_nPos = 0;
+	m_nBaseOffset = 0;
+	m_nKeepOffset = SCAN_KEEP_NONE;
+}
+
+int CAnnexbScanner::Seek(uint64_t offset)
+{
+	if(offset < m_nBaseOffset || offset - m_nBaseOffset > m_nSize)
+		return 0;
+	m_nPos = offset - m_nBaseOffset;
+	return 1;
+}
+
+//这个函数主要功能为得到一个完整NALU的视图，获取他的长度，填充F,IDC,TYPE位
+int CAnnexbScanner::Next(NaluView& nalu)
+{
+	const unsigned char* sc;
+	const unsigned char* next;
+	uint64_t resume;
+	uint64_t data_pos;
+	uint64_t end_pos;
+
+	//查找当前NALU的起始码
+	while((sc = CStartCodeFinder::Find(m_pBase + m_nPos,m_pBase + m_nSize)) == m_pBase + m_nSize)
+	{
+		//没有找到，只保留末尾3个字节(可能是被块边界截断的起始码)，补充数据后继续查找
+		if(m_nSize - m_nPos > 3)
+			m_nPos = m_nSize - 3;
+		if(!Refill())
+		{
+			m_nPos = m_nSize;
+			return 0;
+		}
+	}
+
+	//起始码之前若还有一个0x00则为4字节起始码0x00000001
+	nalu.startcodeprefix_len = 3;
+	if(sc > m_pBase + m_nPos && sc[-1] == 0)
+	{
+		sc--;
+		nalu.startcodeprefix_len = 4;
+	}
+	m_nPos = sc - m_pBase;
+	data_pos = m_nPos + nalu.startcodeprefix_len;
+
+	//查找相邻的下一个起始码，它的开始位置即为当前NALU的结束位置。回调方式下m_nPos之后的数据在补充时都会保留，
+	//只记录相对m_nPos已经查找过的长度，补充数据后从上次的末尾(回退2个字节以防起始码跨块)继续查找
+	resume = data_pos - m_nPos;
+	while((next = CStartCodeFinder::Find(m_pBase + m_nPos + resume,m_pBase + m_nSize)) == m_pBase + m_nSize)
+	{
+		if(m_nSize - m_nPos > resume + 2)
+			resume = m_nSize - m_nPos - 2;
+		if(!Refill())
+		{
+			//没有更多数据，当前NALU一直到码流末尾
+			next = m_pBase + m_nSize;
+			break;
+		}
+	}
+	data_pos = m_nPos + nalu.startcodeprefix_len;
+	end_pos = next - m_pBase;
+	if(next != m_pBase + m_nSize && end_pos > data_pos && next[-1] == 0)
+		end_pos--;
+
+	nalu.offset = m_nBaseOffset + m_nPos;
+	nalu.data = m_pBase + data_pos;
+	nalu.len = end_pos - data_pos;
+	m_nPos = end_pos;
+
+	if(nalu.len == 0)
+	{
+		nalu.forbidden_bit = 0;
+		nalu.nal_reference_idc = 0;
+		nalu.nal_unit_type = 0;
+		return 1;
+	}
+	nalu.forbidden_bit      = nalu.data[0] & 0x80; 	// 1  bit  提取NALU头中的forbidden_bit (禁止位)
+	nalu.nal_reference_idc  = nalu.data[0] & 0x60;  // 2  bit  提取NALU头中的nal_reference_bit (优先级)
+	nalu.nal_unit_type      = nalu.data[0] & 0x1f;  // 5  bit  提取NALU头中的nal_unit_type (NAL类型)
+	return 1;
+}
+
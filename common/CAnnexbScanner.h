@@ -0,0 +1,139 @@
+/*************************************************************************
+    > File Name: CAnnexbScanner.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 09时32分18秒
+ ************************************************************************/
+
+#ifndef CANNEXB_SCANNER_H
+#define CANNEXB_SCANNER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "CStartCodeFinder.h"
+
+/**
+ * _NaluView
+ * 指向扫描缓冲区中一个NALU的视图。只记录位置、长度和NALU头字段，不持有也不拷贝NALU数据，
+ * 数据在扫描器关闭(或流式读取下一次补充数据)之前有效
+ */
+typedef struct _NaluView
+{
+	const unsigned char* data;    //! 指向NALU的第一个字节(NALU头)，不包括起始码
+	unsigned int len;             //! Length of the NAL unit (Excluding the start code, which does not belong to the NALU)
+	int startcodeprefix_len;      //! 4 for parameter sets and first slice in picture, 3 for everything else (suggested)
+	uint64_t offset;              //! 起始码在码流中的字节偏移
+	int forbidden_bit;            //! should be always FALSE
+	int nal_reference_idc;        //! NALU_PRIORITY_xxxx,与NALU_t一致保留在第6，7位,使用时需右移5位
+	int nal_unit_type;            //! NALU_TYPE_xxxx
+}NaluView;
+
+/**
+ * 读取码流数据的回调函数
+ * uint8_t *buf：外部数据送至该地址
+ * int buf_size：外部数据大小
+ * 返回值：成功读取的内存大小,没有数据时返回0或-1
+ */
+typedef int (*ReadBufferFunc)(unsigned char* buf,int buf_size);
+
+//SetKeep参数，不保留已取走的数据
+#define SCAN_KEEP_NONE  UINT64_MAX
+
+/**
+ * H.264 Annex-B码流扫描器，依次返回每个NALU的视图，不做逐个NALU的内存分配与拷贝。
+ * 码流有两种来源：
+ * 1 文件：整个文件映射到内存
+ * 2 回调：通过ReadBufferFunc按块读入内部缓冲区。缓冲区尾部空间不足时把尚未取走的数据(当前NALU)一次性移到缓冲区开头，
+ *   只有单个NALU超过缓冲区容量时才按倍数扩容，因此不需要清零缓冲区，内存峰值只取决于最大的NALU
+ */
+class CAnnexbScanner
+{
+private:
+	int m_nFd;                        //映射文件的描述符
+	unsigned char* m_pMap;            //mmap的基址,mmap失败时为读入数据的堆内存
+	bool m_bMapped;                   //m_pMap是否由mmap得到
+	const unsigned char* m_pBase;     //被扫描数据的起始地址
+	uint64_t m_nSize;                 //被扫描数据的大小
+	uint64_t m_nPos;                  //下一次查找起始码的开始位置,相对于m_pBase
+	uint64_t m_nBaseOffset;           //m_pBase[0]在码流中的偏移，回调方式下随着丢弃已取走的数据而增大
+
+	ReadBufferFunc m_pReadFunc;       //回调方式的数据来源
+	unsigned char* m_pStream;         //回调方式的内部缓冲区
+	uint64_t m_nCapacity;             //内部缓冲区的容量
+	unsigned int m_nBlockSize;        //每次调用回调读取的大小
+	bool m_bEof;                      //回调已经没有更多数据
+	uint64_t m_nKeepOffset;           //回调方式下从该偏移开始的数据在补充时不会被丢弃
+
+	/**
+	 * 回调方式下补充数据，必要时丢弃m_nPos之前已取走的数据或扩容
+	 * @成功读到数据则返回 1 , 没有更多数据则返回 0
+	 */
+	int Refill();
+
+public:
+	CAnnexbScanner();
+	~CAnnexbScanner();
+
+	/**
+	 * 打开H264码流文件并映射到内存
+	 * @param fn 文件名
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Open(const char* fn);
+
+	/**
+	 * 扫描调用者提供的一段内存，扫描器不持有该内存
+	 * @param buf 码流数据
+	 * @param size 码流数据大小
+	 */
+	void Attach(const unsigned char* buf,uint64_t size);
+
+	/**
+	 * 通过回调函数按块读取码流
+	 * @param read_buffer 回调函数，当数据不足的时候，扫描器会自动调用该函数获取输入数据
+	 * @param block_size 每次读取的大小
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int OpenStream(ReadBufferFunc read_buffer,unsigned int block_size);
+
+	/**
+	 * 释放映射的文件或解除对外部内存的引用
+	 */
+	void Close();
+
+	/**
+	 * 取得下一个NALU。回调方式下，返回的视图在下一次调用Next之前有效
+	 * @param nalu 存储NALU视图
+	 * @成功则返回 1 , 码流结束则返回 0
+	 */
+	int Next(NaluView& nalu);
+
+	/**
+	 * 将扫描位置移动到指定偏移，该偏移应为某个NALU起始码的位置。回调方式下只能在已读入的数据范围内移动
+	 * @param offset 码流中的字节偏移
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Seek(uint64_t offset);
+
+	/**
+	 * 回调方式下，要求补充数据时保留从offset开始的数据，使调用者可以同时持有多个NALU。
+	 * 保留的数据在缓冲区中可能被移动，调用Next之后要用Resolve重新取得地址
+	 * @param offset 码流中的字节偏移，SCAN_KEEP_NONE表示不保留
+	 */
+	void SetKeep(uint64_t offset) { m_nKeepOffset = offset; }
+
+	/**
+	 * 码流偏移在当前缓冲区中的地址，偏移必须在已读入且未丢弃的范围内
+	 */
+	const unsigned char* Resolve(uint64_t offset) const { return m_pBase + (offset - m_nBaseOffset); }
+
+	uint64_t Tell() const { return m_nBaseOffset + m_nPos; }
+	uint64_t BaseOffset() const { return m_nBaseOffset; }
+	uint64_t Size() const { return m_nSize; }
+	const unsigned char* Base() const { return m_pBase; }
+};
+
+#endif
+
@@ -0,0 +1,43 @@
+/*************************************************************************
+    > File Name: CBitReader.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 14时21分09秒
+ ************************************************************************/
+
+#include "CBitReader.h"
+
+CBitReader::CBitReader(const uint8_t* buf,unsigned int len) : m_pStart(buf),m_pBuf(buf),m_pEnd(buf + len),m_nCache(0),m_nBits(0),m_nPadBits(0)
+{
+
+}
+
+void CBitReader::RefillTail()
+{
+	while(m_nBits <= 56)
+	{
+		if(m_pBuf < m_pEnd)
+		{
+			m_nCache |= (uint64_t)(*m_pBuf++) << (56 - m_nBits);
+		}
+		else
+		{
+			//数据已经读完，补0
+			m_nPadBits += 8;
+		}
+		m_nBits += 8;
+	}
+}
+
+uint32_t CBitReader::UeSlow()
+{
+	//前缀0多于15个，逐位计数。合法的ue(v)前缀0不超过31个
+	int nZeroNum = 0;
+	while(u1() == 0)
+	{
+		if(++nZeroNum >= 32 || Overrun())
+			return 0xffffffff;
+	}
+	return (uint32_t)((1ULL << nZeroNum) - 1 + u(nZeroNum));
+}
+
@@ -0,0 +1,140 @@
+/*************************************************************************
+    > File Name: CBitReader.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 14时21分09秒
+ ************************************************************************/
+
+#ifndef CBIT_READER_H
+#define CBIT_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * 按位读取RBSP数据的读取器。
+ * 维护一个左对齐的64位缓存，缓存不足时用一次非对齐的8字节大端加载补满，u(n)只需要移位取值；
+ * ue(v)/se(v)用前导零计数指令(clz)一次求出前缀0的个数，不再逐位循环。
+ * 读到数据末尾之后按0补齐，并通过Overrun()报告越界
+ */
+class CBitReader
+{
+private:
+	const uint8_t* m_pStart;    //数据起始地址
+	const uint8_t* m_pBuf;      //下一次装入缓存的位置
+	const uint8_t* m_pEnd;      //数据结束地址
+	uint64_t m_nCache;          //左对齐的缓存位，最高位为下一个要读取的位
+	int m_nBits;                //缓存中有效的位数
+	unsigned int m_nPadBits;    //读到数据末尾后补入的0的位数
+
+	//剩余数据不足8字节时逐字节装入缓存
+	void RefillTail();
+	//前缀0超过15个的ue(v)
+	uint32_t UeSlow();
+
+	//补充缓存，使有效位数不少于56位
+	inline void Refill()
+	{
+		if(m_pEnd - m_pBuf >= 8)
+		{
+			uint64_t v;
+			memcpy(&v,m_pBuf,8);
+			v = __builtin_bswap64(v);
+			m_nCache |= v >> m_nBits;
+			int bytes = (63 - m_nBits) >> 3;
+			m_pBuf += bytes;
+			m_nBits += bytes << 3;
+		}
+		else
+			RefillTail();
+	}
+
+public:
+	CBitReader(const uint8_t* buf,unsigned int len);
+
+	/**
+	 * 读取n位无符号数 u(n)
+	 * @param n 位数，0~32
+	 */
+	inline uint32_t u(int n)
+	{
+		if(n == 0)
+			return 0;
+		if(m_nBits < n)
+			Refill();
+		uint32_t v = (uint32_t)(m_nCache >> (64 - n));
+		m_nCache <<= n;
+		m_nBits -= n;
+		return v;
+	}
+
+	//读取1位
+	inline uint32_t u1()
+	{
+		return u(1);
+	}
+
+	//跳过n位
+	inline void Skip(unsigned int n)
+	{
+		while(n > 32)
+		{
+			u(32);
+			n -= 32;
+		}
+		u(n);
+	}
+
+	/**
+	 * 读取无符号指数哥伦布编码 ue(v)
+	 */
+	inline uint32_t Ue()
+	{
+		if(m_nBits < 32)
+			Refill();
+		//缓存最高16位中有1，则前缀0不超过15个，整个码字(最多31位)都在缓存中
+		if(m_nCache >= (1ULL << 48))
+		{
+			int n = 2 * __builtin_clzll(m_nCache) + 1;
+			uint32_t v = (uint32_t)(m_nCache >> (64 - n)) - 1;
+			m_nCache <<= n;
+			m_nBits -= n;
+			return v;
+		}
+		return UeSlow();
+	}
+
+	/**
+	 * 读取有符号指数哥伦布编码 se(v)
+	 */
+	inline int32_t Se()
+	{
+		uint32_t k = Ue();
+		//k为奇数对应正数(k+1)/2，偶数对应负数-k/2
+		return (k & 1) ? (int32_t)((k + 1) >> 1) : -(int32_t)(k >> 1);
+	}
+
+	//已读取的位数
+	unsigned int BitPos() const
+	{
+		return (unsigned int)(m_pBuf - m_pStart) * 8 + m_nPadBits - m_nBits;
+	}
+
+	//剩余未读取的位数，越界时为0
+	unsigned int BitsLeft() const
+	{
+		unsigned int total = (unsigned int)(m_pEnd - m_pStart) * 8;
+		unsigned int pos = BitPos();
+		return pos < total ? total - pos : 0;
+	}
+
+	//是否已经读到了数据末尾之后
+	bool Overrun() const
+	{
+		return BitPos() > (unsigned int)(m_pEnd - m_pStart) * 8;
+	}
+};
+
+#endif
+
@@ -0,0 +1,294 @@
+/*************************************************************************
+    > File Name: CChunkScanner.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 21时32分08秒
+ ************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "CChunkScanner.h"
+#include "CAnnexbScanner.h"
+#include "CStartCodeFinder.h"
+
+//每个线程最多领先拼接位置的分块数，限制尚未输出的结果占用的内存
+#define CHUNK_AHEAD_PER_THREAD  4
+
+CChunkScanner::CChunkScanner() : m_nFd(-1),m_pMap(NULL),m_pData(NULL),m_nSize(0),m_nThreads(1),m_nChunkSize(CHUNK_DEFAULT_SIZE)
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	if(n > 0)
+		m_nThreads = n;
+}
+
+CChunkScanner::~CChunkScanner()
+{
+	Close();
+}
+
+int CChunkScanner::Open(const char* fn)
+{
+	struct stat st;
+
+	Close();
+	if((m_nFd = open(fn,O_RDONLY)) < 0)
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,fn);
+		return 0;
+	}
+	if(fstat(m_nFd,&st) != 0 || !S_ISREG(st.st_mode))
+	{
+		Close();
+		return 0;
+	}
+	if(st.st_size > 0)
+	{
+		void* addr = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,m_nFd,0);
+		if(addr == MAP_FAILED)
+		{
+			Close();
+			return 0;
+		}
+		m_pMap = (unsigned char*)addr;
+	}
+	m_pData = m_pMap;
+	m_nSize = st.st_size;
+	return 1;
+}
+
+void CChunkScanner::Attach(const unsigned char* buf,uint64_t size)
+{
+	Close();
+	m_pData = buf;
+	m_nSize = size;
+}
+
+void CChunkScanner::Close()
+{
+	if(m_pMap)
+		munmap(m_pMap,m_nSize);
+	if(m_nFd >= 0)
+		close(m_nFd);
+	m_nFd = -1;
+	m_pMap = NULL;
+	m_pData = NULL;
+	m_nSize = 0;
+}
+
+void CChunkScanner::SetThreads(int threads)
+{
+	m_nThreads = threads > 0 ? threads : 1;
+}
+
+void CChunkScanner::SetChunkSize(uint64_t size)
+{
+	if(size > 0)
+		m_nChunkSize = size;
+}
+
+void CChunkScanner::ScanChunk(ChunkNextFunc next,uint64_t begin,uint64_t end,std::vector<ChunkUnit>& units) const
+{
+	ChunkUnit unit;
+	uint64_t pos = begin;
+	int resync = 1;
+
+	units.clear();
+	while(pos < end && next(m_pData,m_nSize,pos,end,resync,&unit))
+	{
+		units.push_back(unit);
+		pos = unit.end;
+		resync = 0;
+	}
+}
+
+static bool UnitOffsetLess(const ChunkUnit& unit,uint64_t offset)
+{
+	return unit.offset < offset;
+}
+
+uint64_t CChunkScanner::Stitch(ChunkNextFunc next,const std::vector<ChunkUnit>& units,uint64_t pos,const ChunkEmitFunc& emit,uint64_t& count) const
+{
+	ChunkUnit unit;
+	std::vector<ChunkUnit>::const_iterator it = std::lower_bound(units.begin(),units.end(),pos,UnitOffsetLess);
+
+	while(it != units.end())
+	{
+		//从真实位置顺序查找一次，结果与本块的单元相同时之后的单元都相同
+		if(!next(m_pData,m_nSize,pos,m_nSize,0,&unit))
+			return m_nSize;
+		if(unit.offset == it->offset && unit.end == it->end)
+		{
+			count += units.end() - it;
+			for(; it != units.end(); ++it)
+				emit(m_pData,*it);
+			return units.back().end;
+		}
+		emit(m_pData,unit);
+		count++;
+		pos = unit.end;
+		it = std::lower_bound(it,units.end(),pos,UnitOffsetLess);
+	}
+	return pos;
+}
+
+uint64_t CChunkScanner::Run(ChunkNextFunc next,const ChunkEmitFunc& emit)
+{
+	ChunkUnit unit;
+	uint64_t pos = 0,count = 0;
+	uint64_t chunks = (m_nSize + m_nChunkSize - 1) / m_nChunkSize;
+
+	if(m_pData == NULL || m_nSize == 0)
+		return 0;
+
+	if(m_nThreads > 1 && chunks > 1)
+	{
+		//线程池：各线程依次领取分块，最多领先拼接位置window块；调用线程按顺序等待每块的结果并拼接
+		uint64_t window = (uint64_t)m_nThreads * CHUNK_AHEAD_PER_THREAD;
+		std::vector<std::vector<ChunkUnit> > slots(window);
+		std::vector<bool> done(window,false);
+		std::mutex lock;
+		std::condition_variable cv_done,cv_space;
+		uint64_t next_chunk = 0,stitched = 0;
+		std::vector<std::thread> threads;
+
+		for(int i = 0; i < m_nThreads && i < (int)chunks; i++)
+		{
+			threads.push_back(std::thread([&]() {
+				std::vector<ChunkUnit> units;
+				std::unique_lock<std::mutex> guard(lock);
+				while(1)
+				{
+					cv_space.wait(guard,[&] {
+						return next_chunk >= chunks || next_chunk < stitched + window;
+					});
+					if(next_chunk >= chunks)
+						break;
+					uint64_t k = next_chunk++;
+					guard.unlock();
+
+					uint64_t begin = k * m_nChunkSize;
+					ScanChunk(next,begin,std::min(begin + m_nChunkSize,m_nSize),units);
+
+					guard.lock();
+					slots[k % window].swap(units);
+					done[k % window] = true;
+					cv_done.notify_all();
+				}
+			}));
+		}
+
+		std::vector<ChunkUnit> units;
+		for(uint64_t k = 0; k < chunks; k++)
+		{
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				cv_done.wait(guard,[&] {
+					return (bool)done[k % window];
+				});
+				units.swap(slots[k % window]);
+				done[k % window] = false;
+				stitched++;
+				cv_space.notify_all();
+			}
+			if(pos < m_nSize)
+				pos = Stitch(next,units,pos,emit,count);
+		}
+
+		for(size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
+
+	//单线程时从头顺序解析；多线程时接着最后一块的结尾继续(最后一个单元可能超出最后一块)
+	while(pos < m_nSize && next(m_pData,m_nSize,pos,m_nSize,0,&unit))
+	{
+		emit(m_pData,unit);
+		count++;
+		pos = unit.end;
+	}
+	return count;
+}
+
+int CChunkScanner::AnnexbNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit)
+{
+	CAnnexbScanner scanner;
+	NaluView nalu;
+
+	//重新同步时先确认limit之前有起始码，避免在没有起始码的分块中一直查找到文件末尾；
+	//接着上一个NALU查找时pos就是下一个起始码(或文件末尾)，不需要再确认
+	if(resync)
+	{
+		const unsigned char* end = data + std::min(limit + 2,size);
+		if(CStartCodeFinder::Find(data + pos,end) == end)
+			return 0;
+	}
+
+	scanner.Attach(data,size);
+	if(!scanner.Seek(pos) || !scanner.Next(nalu))
+		return 0;
+	unit->offset = nalu.offset;
+	unit->len = nalu.len;
+	unit->prefix_len = nalu.startcodeprefix_len;
+	unit->end = scanner.Tell();
+	return 1;
+}
+
+int CChunkScanner::AdtsNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit)
+{
+	//与getADTSframe一致：剩余数据少于ADTS头(7字节)时结束，找到同步字后剩余数据不足一帧时也结束
+	for(uint64_t q = pos; q < limit && q + 7 <= size; q++)
+	{
+		const unsigned char* p = (const unsigned char*)memchr(data + q,0xff,std::min(limit,size - 6) - q);
+		if(p == NULL)
+			return 0;
+		q = p - data;
+		if((p[1] & 0xf0) != 0xf0)
+			continue;
+
+		unsigned int len = ((p[3] & 0x03) << 11) | (p[4] << 3) | ((p[5] & 0xe0) >> 5);
+		if(len == 0)
+			continue;
+		if(q + len > size)
+			return 0;
+		//分块的开始处可能是帧数据中碰巧出现的0xFFF，要求下一帧也以同步字开始
+		if(resync && (len < 7 || (q + len + 1 < size && (data[q + len] != 0xff || (data[q + len + 1] & 0xf0) != 0xf0))))
+			continue;
+
+		unit->offset = q;
+		unit->len = len;
+		unit->prefix_len = 0;
+		unit->end = q + len;
+		return 1;
+	}
+	return 0;
+}
+
+int CChunkScanner::TsNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit)
+{
+	for(uint64_t q = pos; q < limit && q + TS_PACKET_SIZE <= size; q++)
+	{
+		const unsigned char* p = (const unsigned char*)memchr(data + q,0x47,std::min(limit,size - TS_PACKET_SIZE + 1) - q);
+		if(p == NULL)
+			return 0;
+		q = p - data;
+		//188字节之后还是同步字节才认为是TS包；重新同步时再多检查一个包
+		if(q + TS_PACKET_SIZE < size && data[q + TS_PACKET_SIZE] != 0x47)
+			continue;
+		if(resync && q + 2 * TS_PACKET_SIZE < size && data[q + 2 * TS_PACKET_SIZE] != 0x47)
+			continue;
+
+		unit->offset = q;
+		unit->len = TS_PACKET_SIZE;
+		unit->prefix_len = 0;
+		unit->end = q + TS_PACKET_SIZE;
+		return 1;
+	}
+	return 0;
+}
+
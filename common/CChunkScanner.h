@@ -0,0 +1,113 @@
+/*************************************************************************
+    > File Name: CChunkScanner.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 21时32分08秒
+ ************************************************************************/
+
+#ifndef CCHUNK_SCANNER_H
+#define CCHUNK_SCANNER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+//每个分块的默认大小
+#define CHUNK_DEFAULT_SIZE   (32*1024*1024)
+//MPEG-TS包长度
+#define TS_PACKET_SIZE       188
+
+/**
+ * _ChunkUnit
+ * 码流中的一个单元(NALU、ADTS帧或TS包)
+ */
+typedef struct _ChunkUnit
+{
+	uint64_t offset;              //单元在文件中的起始位置(起始码、同步字)
+	uint64_t end;                 //下一次查找的起始位置
+	unsigned int len;             //单元长度，不包括起始码
+	unsigned int prefix_len;      //起始码长度，ADTS帧和TS包为0
+}ChunkUnit;
+
+/**
+ * 查找单元的函数。从pos开始查找第一个起始位置小于limit的单元，单元的结尾可以超过limit。
+ * 结果只能由pos决定，顺序解析就是从0开始不断以上一个单元的end再次查找。
+ * resync不为0时表示pos是分块的开始，不一定在单元边界上，可以用更严格的条件减少误判
+ * @成功则返回 1 , 没有单元则返回 0
+ */
+typedef int (*ChunkNextFunc)(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit);
+
+//按文件顺序依次回调每个单元
+typedef std::function<void(const unsigned char* data,const ChunkUnit& unit)> ChunkEmitFunc;
+
+/**
+ * 可以从任意位置重新同步的码流(H.264 Annex-B起始码、ADTS的0xFFF同步字、每188字节一个0x47的MPEG-TS)的并行扫描。
+ * 文件映射到内存后分成若干块，线程池中的每个线程从块的开始独立重新同步并找出块内的单元；
+ * 调用线程按顺序拼接：从上一块最后一个单元的end顺序查找一次，与本块的第一个单元相同时本块的结果即可直接使用，
+ * 不同时(重新同步误判或单元跨越了整个块)顺序解析直到两者重合。输出与从头顺序解析完全相同
+ */
+class CChunkScanner
+{
+private:
+	int m_nFd;
+	unsigned char* m_pMap;          //Open映射的文件
+	const unsigned char* m_pData;
+	uint64_t m_nSize;
+	int m_nThreads;
+	uint64_t m_nChunkSize;
+
+	//找出起始位置在[begin,end)中的单元
+	void ScanChunk(ChunkNextFunc next,uint64_t begin,uint64_t end,std::vector<ChunkUnit>& units) const;
+	//从pos开始拼接一个分块的结果，返回拼接后的位置
+	uint64_t Stitch(ChunkNextFunc next,const std::vector<ChunkUnit>& units,uint64_t pos,const ChunkEmitFunc& emit,uint64_t& count) const;
+
+public:
+	CChunkScanner();
+	~CChunkScanner();
+
+	/**
+	 * 把文件映射到内存
+	 * @param fn 文件名
+	 * @成功则返回 1 , 失败(文件不存在或不能映射，如管道)则返回 0
+	 */
+	int Open(const char* fn);
+
+	/**
+	 * 扫描调用者提供的一段内存，扫描器不持有该内存
+	 */
+	void Attach(const unsigned char* buf,uint64_t size);
+
+	void Close();
+
+	/**
+	 * 线程数，默认为CPU核数。为1时不创建线程，直接顺序解析
+	 */
+	void SetThreads(int threads);
+
+	/**
+	 * 每个分块的大小，默认CHUNK_DEFAULT_SIZE
+	 */
+	void SetChunkSize(uint64_t size);
+
+	/**
+	 * 扫描整个文件，在调用线程中按文件顺序回调每个单元
+	 * @param next 查找单元的函数，如AnnexbNext、AdtsNext、TsNext
+	 * @param emit 单元回调
+	 * @返回单元个数
+	 */
+	uint64_t Run(ChunkNextFunc next,const ChunkEmitFunc& emit);
+
+	const unsigned char* Data() const { return m_pData; }
+	uint64_t Size() const { return m_nSize; }
+
+	//H.264 Annex-B：以起始码分隔的NALU，与CAnnexbScanner的结果相同
+	static int AnnexbNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit);
+	//ADTS：同步字0xFFF开始，长度由frame_length给出的AAC帧
+	static int AdtsNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit);
+	//MPEG-TS：0x47开始且188字节之后还是0x47(或文件结束)的TS包
+	static int TsNext(const unsigned char* data,uint64_t size,uint64_t pos,uint64_t limit,int resync,ChunkUnit* unit);
+};
+
+#endif
+
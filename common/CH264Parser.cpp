@@ -0,0 +1,463 @@
+/*************************************************************************
+    > File Name: CH264Parser.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 17时03分25秒
+ ************************************************************************/
+
+#include "CH264Parser.h"
+
+//参数集转换为RBSP时的缓冲区大小，带缩放矩阵的SPS也远小于该值
+#define PARAM_SET_RBSP_SIZE  4096
+//片头转换为RBSP的字节数，足以覆盖first_mb_in_slice到delta_pic_order_cnt的所有字段
+#define SLICE_HEADER_RBSP_SIZE  64
+
+CH264Parser::CH264Parser()
+{
+	m_pSps = (H264Sps*)malloc(sizeof(H264Sps) * H264_MAX_SPS_COUNT);
+	m_pPps = (H264Pps*)malloc(sizeof(H264Pps) * H264_MAX_PPS_COUNT);
+	Reset();
+}
+
+CH264Parser::~CH264Parser()
+{
+	free(m_pSps);
+	free(m_pPps);
+}
+
+void CH264Parser::Reset()
+{
+	memset(m_pSps,0,sizeof(H264Sps) * H264_MAX_SPS_COUNT);
+	memset(m_pPps,0,sizeof(H264Pps) * H264_MAX_PPS_COUNT);
+	m_nPrevPocMsb = 0;
+	m_nPrevPocLsb = 0;
+	m_nPrevFrameNumOffset = 0;
+	m_nPrevFrameNum = 0;
+}
+
+//跳过scaling_list()，只需要读出delta_scale
+static void SkipScalingList(CBitReader& br,int size)
+{
+	int lastScale = 8;
+	int nextScale = 8;
+	for(int j = 0; j < size; j++)
+	{
+		if(nextScale != 0)
+		{
+			int delta_scale = br.Se();
+			nextScale = (lastScale + delta_scale + 256) % 256;
+		}
+		lastScale = (nextScale == 0) ? lastScale : nextScale;
+	}
+}
+
+//跳过hrd_parameters()
+static void SkipHrdParameters(CBitReader& br)
+{
+	uint32_t cpb_cnt_minus1 = br.Ue();
+	br.u(4);    //bit_rate_scale
+	br.u(4);    //cpb_size_scale
+	for(uint32_t i = 0; i <= cpb_cnt_minus1 && i < 32; i++)
+	{
+		br.Ue();    //bit_rate_value_minus1
+		br.Ue();    //cpb_size_value_minus1
+		br.u1();    //cbr_flag
+	}
+	br.u(5);    //initial_cpb_removal_delay_length_minus1
+	br.u(5);    //cpb_removal_delay_length_minus1
+	br.u(5);    //dpb_output_delay_length_minus1
+	br.u(5);    //time_offset_length
+}
+
+int CH264Parser::ParseSps(const unsigned char* data,unsigned int len)
+{
+	unsigned char rbsp[PARAM_SET_RBSP_SIZE];
+	H264Sps sps;
+
+	if(len < 4 || (data[0] & 0x1f) != 7)
+		return -1;
+	len = CRbsp::NalToRbsp(data + 1,len - 1,rbsp,sizeof(rbsp));
+	CBitReader br(rbsp,len);
+
+	memset(&sps,0,sizeof(sps));
+	sps.profile_idc = br.u(8);
+	br.u(8);    //constraint_set0_flag ~ constraint_set5_flag, reserved_zero_2bits
+	sps.level_idc = br.u(8);
+	//Ue()在码流错误时返回0xffffffff，先按无符号数检查范围，再存入int
+	uint32_t sps_id = br.Ue();
+	if(sps_id >= H264_MAX_SPS_COUNT)
+		return -1;
+	sps.sps_id = sps_id;
+
+	sps.chroma_format_idc = 1;
+	if(sps.profile_idc == 100 || sps.profile_idc == 110 || sps.profile_idc == 122 || sps.profile_idc == 244 ||
+	   sps.profile_idc == 44 || sps.profile_idc == 83 || sps.profile_idc == 86 || sps.profile_idc == 118 ||
+	   sps.profile_idc == 128 || sps.profile_idc == 138 || sps.profile_idc == 139 || sps.profile_idc == 134 ||
+	   sps.profile_idc == 135)
+	{
+		sps.chroma_format_idc = br.Ue();
+		if(sps.chroma_format_idc == 3)
+			sps.separate_colour_plane_flag = br.u1();
+		br.Ue();    //bit_depth_luma_minus8
+		br.Ue();    //bit_depth_chroma_minus8
+		br.u1();    //qpprime_y_zero_transform_bypass_flag
+		if(br.u1()) //seq_scaling_matrix_present_flag
+		{
+			int count = (sps.chroma_format_idc != 3) ? 8 : 12;
+			for(int i = 0; i < count; i++)
+			{
+				if(br.u1())    //seq_scaling_list_present_flag[i]
+					SkipScalingList(br,i < 6 ? 16 : 64);
+			}
+		}
+	}
+
+	uint32_t log2_max_frame_num_minus4 = br.Ue();
+	uint32_t pic_order_cnt_type = br.Ue();
+	if(log2_max_frame_num_minus4 > 12 || pic_order_cnt_type > 2)
+		return -1;
+	sps.log2_max_frame_num = log2_max_frame_num_minus4 + 4;
+	sps.pic_order_cnt_type = pic_order_cnt_type;
+	if(sps.pic_order_cnt_type == 0)
+	{
+		uint32_t log2_max_pic_order_cnt_lsb_minus4 = br.Ue();
+		if(log2_max_pic_order_cnt_lsb_minus4 > 12)
+			return -1;
+		sps.log2_max_pic_order_cnt_lsb = log2_max_pic_order_cnt_lsb_minus4 + 4;
+	}
+	else if(sps.pic_order_cnt_type == 1)
+	{
+		sps.delta_pic_order_always_zero_flag = br.u1();
+		sps.offset_for_non_ref_pic = br.Se();
+		sps.offset_for_top_to_bottom_field = br.Se();
+		uint32_t num_ref_frames_in_pic_order_cnt_cycle = br.Ue();
+		if(num_ref_frames_in_pic_order_cnt_cycle > 255)
+			return -1;
+		sps.num_ref_frames_in_pic_order_cnt_cycle = num_ref_frames_in_pic_order_cnt_cycle;
+		for(int i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle; i++)
+			sps.offset_for_ref_frame[i] = br.Se();
+	}
+	sps.max_num_ref_frames = br.Ue();
+	br.u1();    //gaps_in_frame_num_value_allowed_flag
+	int pic_width_in_mbs_minus1 = br.Ue();
+	int pic_height_in_map_units_minus1 = br.Ue();
+	sps.frame_mbs_only_flag = br.u1();
+	if(!sps.frame_mbs_only_flag)
+		br.u1();    //mb_adaptive_frame_field_flag
+	br.u1();    //direct_8x8_inference_flag
+
+	sps.width = (pic_width_in_mbs_minus1 + 1) * 16;
+	sps.height = (2 - sps.frame_mbs_only_flag) * (pic_height_in_map_units_minus1 + 1) * 16;
+	if(br.u1()) //frame_cropping_flag
+	{
+		int crop_left = br.Ue();
+		int crop_right = br.Ue();
+		int crop_top = br.Ue();
+		int crop_bottom = br.Ue();
+		//裁剪的单位取决于色度格式(7.4.2.1.1节)
+		int chroma_array_type = sps.separate_colour_plane_flag ? 0 : sps.chroma_format_idc;
+		int crop_unit_x = 1;
+		int crop_unit_y = 2 - sps.frame_mbs_only_flag;
+		if(chroma_array_type != 0)
+		{
+			crop_unit_x = (chroma_array_type == 3) ? 1 : 2;
+			crop_unit_y *= (chroma_array_type == 1) ? 2 : 1;
+		}
+		sps.width -= crop_unit_x * (crop_left + crop_right);
+		sps.height -= crop_unit_y * (crop_top + crop_bottom);
+	}
+
+	sps.max_num_reorder_frames = -1;
+	if(br.u1()) //vui_parameters_present_flag
+	{
+		if(br.u1()) //aspect_ratio_info_present_flag
+		{
+			if(br.u(8) == 255)    //aspect_ratio_idc == Extended_SAR
+			{
+				br.u(16);    //sar_width
+				br.u(16);    //sar_height
+			}
+		}
+		if(br.u1()) //overscan_info_present_flag
+			br.u1();    //overscan_appropriate_flag
+		if(br.u1()) //video_signal_type_present_flag
+		{
+			br.u(3);    //video_format
+			br.u1();    //video_full_range_flag
+			if(br.u1()) //colour_description_present_flag
+			{
+				br.u(8);    //colour_primaries
+				br.u(8);    //transfer_characteristics
+				br.u(8);    //matrix_coefficients
+			}
+		}
+		if(br.u1()) //chroma_loc_info_present_flag
+		{
+			br.Ue();    //chroma_sample_loc_type_top_field
+			br.Ue();    //chroma_sample_loc_type_bottom_field
+		}
+		/*
+		 * 帧率为 time_scale / (2 * num_units_in_tick)，num_units_in_tick是时钟的一个"场"周期
+		 */
+		sps.timing_info_present_flag = br.u1();
+		if(sps.timing_info_present_flag)
+		{
+			sps.num_units_in_tick = br.u(32);
+			sps.time_scale = br.u(32);
+			sps.fixed_frame_rate_flag = br.u1();
+			if(sps.num_units_in_tick == 0 || sps.time_scale == 0)
+				sps.timing_info_present_flag = 0;
+		}
+		int nal_hrd = br.u1();
+		if(nal_hrd)
+			SkipHrdParameters(br);
+		int vcl_hrd = br.u1();
+		if(vcl_hrd)
+			SkipHrdParameters(br);
+		if(nal_hrd || vcl_hrd)
+			br.u1();    //low_delay_hrd_flag
+		br.u1();    //pic_struct_present_flag
+		if(br.u1()) //bitstream_restriction_flag
+		{
+			br.u1();    //motion_vectors_over_pic_boundaries_flag
+			br.Ue();    //max_bytes_per_pic_denom
+			br.Ue();    //max_bits_per_mb_denom
+			br.Ue();    //log2_max_mv_length_horizontal
+			br.Ue();    //log2_max_mv_length_vertical
+			sps.max_num_reorder_frames = br.Ue();
+			br.Ue();    //max_dec_frame_buffering
+		}
+		//VUI不完整时只丢弃VUI中的信息，SPS本身仍然可用
+		if(br.Overrun())
+		{
+			sps.timing_info_present_flag = 0;
+			sps.max_num_reorder_frames = -1;
+		}
+	}
+	else if(br.Overrun())
+		return -1;
+
+	sps.valid = 1;
+	m_pSps[sps.sps_id] = sps;
+	return sps.sps_id;
+}
+
+int CH264Parser::ParsePps(const unsigned char* data,unsigned int len)
+{
+	unsigned char rbsp[SLICE_HEADER_RBSP_SIZE];
+	H264Pps pps;
+
+	if(len < 2 || (data[0] & 0x1f) != 8)
+		return -1;
+	//只需要PPS开头的几个字段
+	len = CRbsp::NalToRbsp(data + 1,len - 1,rbsp,sizeof(rbsp));
+	CBitReader br(rbsp,len);
+
+	memset(&pps,0,sizeof(pps));
+	uint32_t pps_id = br.Ue();
+	uint32_t sps_id = br.Ue();
+	br.u1();    //entropy_coding_mode_flag
+	pps.bottom_field_pic_order_in_frame_present_flag = br.u1();
+	if(br.Overrun() || pps_id >= H264_MAX_PPS_COUNT || sps_id >= H264_MAX_SPS_COUNT)
+		return -1;
+	pps.pps_id = pps_id;
+	pps.sps_id = sps_id;
+
+	pps.valid = 1;
+	m_pPps[pps.pps_id] = pps;
+	return pps.pps_id;
+}
+
+int CH264Parser::ParseSliceHeader(const unsigned char* data,unsigned int len,H264SliceHeader& sh)
+{
+	unsigned char rbsp[SLICE_HEADER_RBSP_SIZE];
+
+	if(len < 2)
+		return 0;
+	memset(&sh,0,sizeof(sh));
+	sh.nal_unit_type = data[0] & 0x1f;
+	sh.nal_ref_idc = (data[0] >> 5) & 0x03;
+	if(sh.nal_unit_type != 1 && sh.nal_unit_type != 5)
+		return 0;
+
+	len = CRbsp::NalToRbsp(data + 1,len - 1,rbsp,sizeof(rbsp));
+	CBitReader br(rbsp,len);
+
+	sh.first_mb_in_slice = br.Ue();
+	sh.slice_type = br.Ue() % 5;
+	sh.pps_id = br.Ue();
+	const H264Pps* pps = GetPps(sh.pps_id);
+	if(pps == NULL)
+		return 0;
+	const H264Sps* sps = GetSps(pps->sps_id);
+	if(sps == NULL)
+		return 0;
+
+	if(sps->separate_colour_plane_flag)
+		br.u(2);    //colour_plane_id
+	sh.frame_num = br.u(sps->log2_max_frame_num);
+	if(!sps->frame_mbs_only_flag)
+	{
+		sh.field_pic_flag = br.u1();
+		if(sh.field_pic_flag)
+			sh.bottom_field_flag = br.u1();
+	}
+	if(sh.nal_unit_type == 5)
+		sh.idr_pic_id = br.Ue();
+	if(sps->pic_order_cnt_type == 0)
+	{
+		sh.pic_order_cnt_lsb = br.u(sps->log2_max_pic_order_cnt_lsb);
+		if(pps->bottom_field_pic_order_in_frame_present_flag && !sh.field_pic_flag)
+			sh.delta_pic_order_cnt_bottom = br.Se();
+	}
+	else if(sps->pic_order_cnt_type == 1 && !sps->delta_pic_order_always_zero_flag)
+	{
+		sh.delta_pic_order_cnt[0] = br.Se();
+		if(pps->bottom_field_pic_order_in_frame_present_flag && !sh.field_pic_flag)
+			sh.delta_pic_order_cnt[1] = br.Se();
+	}
+	return br.Overrun() ? 0 : 1;
+}
+
+int CH264Parser::ComputePoc(const H264SliceHeader& sh)
+{
+	const H264Sps* sps = GetSliceSps(sh);
+	if(sps == NULL)
+		return 0;
+
+	int idr = (sh.nal_unit_type == 5);
+	int top = 0,bottom = 0;
+
+	if(sps->pic_order_cnt_type == 0)
+	{
+		//8.2.1.1 由pic_order_cnt_lsb的回绕推出PicOrderCntMsb
+		int max_lsb = 1 << sps->log2_max_pic_order_cnt_lsb;
+		int lsb = sh.pic_order_cnt_lsb;
+		int msb;
+		if(idr)
+		{
+			m_nPrevPocMsb = 0;
+			m_nPrevPocLsb = 0;
+		}
+		if(lsb < m_nPrevPocLsb && m_nPrevPocLsb - lsb >= max_lsb / 2)
+			msb = m_nPrevPocMsb + max_lsb;
+		else if(lsb > m_nPrevPocLsb && lsb - m_nPrevPocLsb > max_lsb / 2)
+			msb = m_nPrevPocMsb - max_lsb;
+		else
+			msb = m_nPrevPocMsb;
+		top = msb + lsb;
+		bottom = sh.field_pic_flag ? top : top + sh.delta_pic_order_cnt_bottom;
+		if(sh.nal_ref_idc)
+		{
+			m_nPrevPocMsb = msb;
+			m_nPrevPocLsb = lsb;
+		}
+	}
+	else
+	{
+		//8.2.1.2 / 8.2.1.3 由frame_num推出
+		int max_frame_num = 1 << sps->log2_max_frame_num;
+		int frame_num_offset;
+		if(idr)
+			frame_num_offset = 0;
+		else if(m_nPrevFrameNum > sh.frame_num)
+			frame_num_offset = m_nPrevFrameNumOffset + max_frame_num;
+		else
+			frame_num_offset = m_nPrevFrameNumOffset;
+
+		if(sps->pic_order_cnt_type == 1)
+		{
+			int n = sps->num_ref_frames_in_pic_order_cnt_cycle;
+			int abs_frame_num = (n != 0) ? frame_num_offset + sh.frame_num : 0;
+			if(sh.nal_ref_idc == 0 && abs_frame_num > 0)
+				abs_frame_num--;
+			int expected = 0;
+			if(abs_frame_num > 0)
+			{
+				int delta_in_cycle = 0;
+				for(int i = 0; i < n; i++)
+					delta_in_cycle += sps->offset_for_ref_frame[i];
+				int cycle_cnt = (abs_frame_num - 1) / n;
+				int in_cycle = (abs_frame_num - 1) % n;
+				expected = cycle_cnt * delta_in_cycle;
+				for(int i = 0; i <= in_cycle; i++)
+					expected += sps->offset_for_ref_frame[i];
+			}
+			if(sh.nal_ref_idc == 0)
+				expected += sps->offset_for_non_ref_pic;
+			if(!sh.field_pic_flag)
+			{
+				top = expected + sh.delta_pic_order_cnt[0];
+				bottom = top + sps->offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[1];
+			}
+			else if(!sh.bottom_field_flag)
+				top = bottom = expected + sh.delta_pic_order_cnt[0];
+			else
+				top = bottom = expected + sps->offset_for_top_to_bottom_field + sh.delta_pic_order_cnt[0];
+		}
+		else
+		{
+			int temp = 0;
+			if(!idr)
+				temp = 2 * (frame_num_offset + sh.frame_num) - (sh.nal_ref_idc == 0 ? 1 : 0);
+			top = bottom = temp;
+		}
+		m_nPrevFrameNumOffset = frame_num_offset;
+		m_nPrevFrameNum = sh.frame_num;
+	}
+
+	if(sh.field_pic_flag)
+		return sh.bottom_field_flag ? bottom : top;
+	return top < bottom ? top : bottom;
+}
+
+bool CH264Parser::IsNewPicture(const H264SliceHeader& prev,const H264SliceHeader& cur) const
+{
+	//同一图像的片first_mb_in_slice递增，回到0即为新图像(不考虑任意片顺序ASO)
+	if(cur.first_mb_in_slice == 0)
+		return true;
+	if(cur.frame_num != prev.frame_num || cur.pps_id != prev.pps_id)
+		return true;
+	if(cur.field_pic_flag != prev.field_pic_flag || cur.bottom_field_flag != prev.bottom_field_flag)
+		return true;
+	if((cur.nal_ref_idc == 0) != (prev.nal_ref_idc == 0))
+		return true;
+	if((cur.nal_unit_type == 5) != (prev.nal_unit_type == 5))
+		return true;
+	if(cur.nal_unit_type == 5 && cur.idr_pic_id != prev.idr_pic_id)
+		return true;
+
+	const H264Sps* sps = GetSliceSps(cur);
+	if(sps != NULL && sps->pic_order_cnt_type == 0)
+	{
+		if(cur.pic_order_cnt_lsb != prev.pic_order_cnt_lsb || cur.delta_pic_order_cnt_bottom != prev.delta_pic_order_cnt_bottom)
+			return true;
+	}
+	else if(sps != NULL && sps->pic_order_cnt_type == 1)
+	{
+		if(cur.delta_pic_order_cnt[0] != prev.delta_pic_order_cnt[0] || cur.delta_pic_order_cnt[1] != prev.delta_pic_order_cnt[1])
+			return true;
+	}
+	return false;
+}
+
+const H264Sps* CH264Parser::GetSps(int id) const
+{
+	if(id < 0 || id >= H264_MAX_SPS_COUNT || !m_pSps[id].valid)
+		return NULL;
+	return &m_pSps[id];
+}
+
+const H264Pps* CH264Parser::GetPps(int id) const
+{
+	if(id < 0 || id >= H264_MAX_PPS_COUNT || !m_pPps[id].valid)
+		return NULL;
+	return &m_pPps[id];
+}
+
+const H264Sps* CH264Parser::GetSliceSps(const H264SliceHeader& sh) const
+{
+	const H264Pps* pps = GetPps(sh.pps_id);
+	return pps ? GetSps(pps->sps_id) : NULL;
+}
+
@@ -0,0 +1,168 @@
+/*************************************************************************
+    > File Name: CH264Parser.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 17时03分25秒
+ ************************************************************************/
+
+#ifndef CH264_PARSER_H
+#define CH264_PARSER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "CBitReader.h"
+#include "CRbsp.h"
+
+#define H264_MAX_SPS_COUNT   32
+#define H264_MAX_PPS_COUNT   256
+
+//slice_type % 5
+enum
+{
+	H264_SLICE_P  = 0,
+	H264_SLICE_B  = 1,
+	H264_SLICE_I  = 2,
+	H264_SLICE_SP = 3,
+	H264_SLICE_SI = 4,
+};
+
+/**
+ * _H264Sps
+ * 序列参数集中解析片头、计算POC和时间戳需要的字段
+ */
+typedef struct _H264Sps
+{
+	int valid;
+	int profile_idc;
+	int level_idc;
+	int sps_id;
+	int chroma_format_idc;
+	int separate_colour_plane_flag;
+	int log2_max_frame_num;                //log2_max_frame_num_minus4 + 4
+	int pic_order_cnt_type;
+	int log2_max_pic_order_cnt_lsb;        //log2_max_pic_order_cnt_lsb_minus4 + 4
+	int delta_pic_order_always_zero_flag;
+	int offset_for_non_ref_pic;
+	int offset_for_top_to_bottom_field;
+	int num_ref_frames_in_pic_order_cnt_cycle;
+	int offset_for_ref_frame[256];
+	int max_num_ref_frames;
+	int frame_mbs_only_flag;
+	int width;                             //去掉裁剪区域后的图像宽度
+	int height;                            //去掉裁剪区域后的图像高度
+
+	//VUI
+	int timing_info_present_flag;
+	uint32_t num_units_in_tick;
+	uint32_t time_scale;
+	int fixed_frame_rate_flag;
+	int max_num_reorder_frames;            //bitstream_restriction中的值，没有时为-1
+}H264Sps;
+
+/**
+ * _H264Pps
+ * 图像参数集中解析片头需要的字段
+ */
+typedef struct _H264Pps
+{
+	int valid;
+	int pps_id;
+	int sps_id;
+	int bottom_field_pic_order_in_frame_present_flag;
+}H264Pps;
+
+/**
+ * _H264SliceHeader
+ * 片头中从first_mb_in_slice到delta_pic_order_cnt为止的字段，足以判断图像边界和计算POC
+ */
+typedef struct _H264SliceHeader
+{
+	int nal_unit_type;
+	int nal_ref_idc;
+	int first_mb_in_slice;
+	int slice_type;                        //已对5取余
+	int pps_id;
+	int frame_num;
+	int field_pic_flag;
+	int bottom_field_flag;
+	int idr_pic_id;
+	int pic_order_cnt_lsb;
+	int delta_pic_order_cnt_bottom;
+	int delta_pic_order_cnt[2];
+}H264SliceHeader;
+
+/**
+ * H.264参数集与片头解析器。按id保存收到的SPS/PPS，片头解析时据此确定各字段的位数；
+ * 并按解码顺序计算每个图像的POC(8.2.1节，三种pic_order_cnt_type)。
+ * 所有解析都先把NALU转换到RBSP，片头只转换开头的一小段，大的I片也不需要整片拷贝
+ */
+class CH264Parser
+{
+private:
+	H264Sps* m_pSps;                       //H264_MAX_SPS_COUNT个SPS
+	H264Pps* m_pPps;                       //H264_MAX_PPS_COUNT个PPS
+
+	//计算POC需要的前一个图像的状态
+	int m_nPrevPocMsb;
+	int m_nPrevPocLsb;
+	int m_nPrevFrameNumOffset;
+	int m_nPrevFrameNum;
+
+public:
+	CH264Parser();
+	~CH264Parser();
+
+	/**
+	 * 清除保存的参数集和POC状态
+	 */
+	void Reset();
+
+	/**
+	 * 解析SPS并按sps_id保存
+	 * @param data NALU数据(包括NALU头，不包括起始码)
+	 * @param len NALU长度
+	 * @成功则返回sps_id , 失败则返回 -1
+	 */
+	int ParseSps(const unsigned char* data,unsigned int len);
+
+	/**
+	 * 解析PPS并按pps_id保存，引用的SPS必须已经解析过
+	 * @param data NALU数据(包括NALU头，不包括起始码)
+	 * @param len NALU长度
+	 * @成功则返回pps_id , 失败则返回 -1
+	 */
+	int ParsePps(const unsigned char* data,unsigned int len);
+
+	/**
+	 * 解析片头(nal_unit_type为1或5)
+	 * @param data NALU数据(包括NALU头，不包括起始码)
+	 * @param len NALU长度
+	 * @param sh 存储片头字段
+	 * @成功则返回 1 , 失败(参数集不存在或数据不完整)则返回 0
+	 */
+	int ParseSliceHeader(const unsigned char* data,unsigned int len,H264SliceHeader& sh);
+
+	/**
+	 * 计算图像的POC，必须按解码顺序对每个图像的第一个片调用一次
+	 * @param sh 图像第一个片的片头
+	 * @返回帧的POC(TopFieldOrderCnt与BottomFieldOrderCnt中较小的一个)，场图像返回该场的POC
+	 */
+	int ComputePoc(const H264SliceHeader& sh);
+
+	/**
+	 * 判断片是否属于一个新的图像(7.4.1.2.4节)
+	 * @param prev 前一个片的片头
+	 * @param cur 当前片的片头
+	 */
+	bool IsNewPicture(const H264SliceHeader& prev,const H264SliceHeader& cur) const;
+
+	const H264Sps* GetSps(int id) const;
+	const H264Pps* GetPps(int id) const;
+	//片引用的SPS
+	const H264Sps* GetSliceSps(const H264SliceHeader& sh) const;
+};
+
+#endif
+
@@ -0,0 +1,203 @@
+/*************************************************************************
+    > File Name: CH264Stats.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 22时48分55秒
+ ************************************************************************/
+
+#include <string.h>
+#include "CH264Stats.h"
+
+static const char* s_TypeName[H264_STATS_TYPES] = { "I", "P", "B" };
+
+CH264Stats::CH264Stats() : m_nWindow(AU_TIME_BASE)
+{
+	Reset();
+}
+
+CH264Stats::~CH264Stats()
+{
+
+}
+
+void CH264Stats::Reset()
+{
+	m_Window.clear();
+	m_nWindowBytes = 0;
+	m_nFrames = 0;
+	m_nTotalBytes = 0;
+	m_nIdrFrames = 0;
+	for(int i = 0; i < H264_STATS_TYPES; i++)
+	{
+		m_nTypeFrames[i] = 0;
+		m_nTypeBytes[i] = 0;
+		m_nTypeMin[i] = 0;
+		m_nTypeMax[i] = 0;
+	}
+	m_nFirstDts = 0;
+	m_nEndDts = 0;
+	m_fPeakBitrate = 0;
+	m_nPeakDts = 0;
+	m_nGopFrames = 0;
+	m_GopHist.clear();
+}
+
+void CH264Stats::SetWindow(double sec)
+{
+	if(sec > 0)
+		m_nWindow = (int64_t)(sec * AU_TIME_BASE + 0.5);
+}
+
+int CH264Stats::Add(const AccessUnit& au,H264FrameStat* frame)
+{
+	uint64_t bytes = 0;
+	for(size_t i = 0; i < au.nalus.size(); i++)
+		bytes += au.nalus[i].len + au.nalus[i].startcodeprefix_len;
+	m_nTotalBytes += bytes;
+	if(!au.has_picture)
+		return 0;
+
+	int type = (au.slice_type == H264_SLICE_B) ? H264_STATS_B : ((au.slice_type == H264_SLICE_P) ? H264_STATS_P : H264_STATS_I);
+	if(m_nTypeFrames[type] == 0 || bytes < m_nTypeMin[type])
+		m_nTypeMin[type] = bytes;
+	if(bytes > m_nTypeMax[type])
+		m_nTypeMax[type] = bytes;
+	m_nTypeFrames[type]++;
+	m_nTypeBytes[type] += bytes;
+
+	//GOP以IDR划分，第一个IDR之前的帧不计入
+	if(au.idr)
+	{
+		if(m_nGopFrames > 0)
+			m_GopHist[m_nGopFrames]++;
+		m_nGopFrames = 0;
+		m_nIdrFrames++;
+	}
+	if(au.idr || m_nGopFrames > 0)
+		m_nGopFrames++;
+
+	if(m_nFrames == 0)
+		m_nFirstDts = au.dts;
+	m_nEndDts = au.dts + au.duration;
+
+	//窗口为(dts-window,dts]，码率按整个窗口长度计算，开头不足一个窗口时偏小，不会产生虚高的峰值
+	m_Window.push_back(std::make_pair(au.dts,bytes));
+	m_nWindowBytes += bytes;
+	while(m_Window.front().first <= au.dts - m_nWindow)
+	{
+		m_nWindowBytes -= m_Window.front().second;
+		m_Window.pop_front();
+	}
+	double bitrate = (double)m_nWindowBytes * 8 * AU_TIME_BASE / m_nWindow;
+	if(bitrate > m_fPeakBitrate)
+	{
+		m_fPeakBitrate = bitrate;
+		m_nPeakDts = au.dts;
+	}
+
+	if(frame != NULL)
+	{
+		frame->index = m_nFrames;
+		frame->dts = au.dts;
+		frame->pts = au.pts;
+		frame->type = type;
+		frame->idr = au.idr;
+		frame->bytes = bytes;
+		frame->window_bitrate = bitrate;
+	}
+	m_nFrames++;
+	return 1;
+}
+
+void CH264Stats::Finish()
+{
+	if(m_nGopFrames > 0)
+		m_GopHist[m_nGopFrames]++;
+	m_nGopFrames = 0;
+}
+
+double CH264Stats::Duration() const
+{
+	return (double)(m_nEndDts - m_nFirstDts) / AU_TIME_BASE;
+}
+
+double CH264Stats::AverageBitrate() const
+{
+	double duration = Duration();
+	if(duration <= 0)
+		return 0;
+	uint64_t bytes = m_nTypeBytes[H264_STATS_I] + m_nTypeBytes[H264_STATS_P] + m_nTypeBytes[H264_STATS_B];
+	return bytes * 8 / duration;
+}
+
+void CH264Stats::WriteJson(FILE* fp,const char* url,const H264Sps* sps,double fps) const
+{
+	uint64_t gops = 0,gop_frames = 0,gop_min = 0,gop_max = 0;
+	for(std::map<uint64_t,uint64_t>::const_iterator it = m_GopHist.begin(); it != m_GopHist.end(); ++it)
+	{
+		if(gops == 0)
+			gop_min = it->first;
+		gop_max = it->first;
+		gops += it->second;
+		gop_frames += it->first * it->second;
+	}
+	double average = AverageBitrate();
+
+	fprintf(fp,"{\n");
+	fprintf(fp,"  \"file\": \"");
+	//文件名中的引号和反斜杠需要转义
+	for(const char* p = url; *p; p++)
+	{
+		if(*p == '"' || *p == '\\')
+			fputc('\\',fp);
+		fputc(*p,fp);
+	}
+	fprintf(fp,"\",\n");
+	fprintf(fp,"  \"width\": %d,\n",sps ? sps->width : 0);
+	fprintf(fp,"  \"height\": %d,\n",sps ? sps->height : 0);
+	fprintf(fp,"  \"frame_rate\": %.3f,\n",fps);
+	fprintf(fp,"  \"frames\": %llu,\n",(unsigned long long)m_nFrames);
+	fprintf(fp,"  \"idr_frames\": %llu,\n",(unsigned long long)m_nIdrFrames);
+	fprintf(fp,"  \"duration\": %.3f,\n",Duration());
+	fprintf(fp,"  \"total_bytes\": %llu,\n",(unsigned long long)m_nTotalBytes);
+	fprintf(fp,"  \"average_bitrate\": %.0f,\n",average);
+	fprintf(fp,"  \"window\": %.3f,\n",(double)m_nWindow / AU_TIME_BASE);
+	fprintf(fp,"  \"peak_bitrate\": %.0f,\n",m_fPeakBitrate);
+	fprintf(fp,"  \"peak_time\": %.3f,\n",(double)(m_nPeakDts - m_nFirstDts) / AU_TIME_BASE);
+	fprintf(fp,"  \"peak_to_average\": %.3f,\n",average > 0 ? m_fPeakBitrate / average : 0);
+
+	fprintf(fp,"  \"frame_types\": {\n");
+	for(int i = 0; i < H264_STATS_TYPES; i++)
+	{
+		uint64_t n = m_nTypeFrames[i];
+		fprintf(fp,"    \"%s\": { \"count\": %llu, \"ratio\": %.4f, \"bytes\": %llu, \"min_size\": %llu, \"max_size\": %llu, \"avg_size\": %.1f }%s\n",
+			s_TypeName[i],(unsigned long long)n,m_nFrames ? (double)n / m_nFrames : 0,(unsigned long long)m_nTypeBytes[i],
+			(unsigned long long)m_nTypeMin[i],(unsigned long long)m_nTypeMax[i],n ? (double)m_nTypeBytes[i] / n : 0,
+			i + 1 < H264_STATS_TYPES ? "," : "");
+	}
+	fprintf(fp,"  },\n");
+
+	fprintf(fp,"  \"gop\": {\n");
+	fprintf(fp,"    \"count\": %llu,\n",(unsigned long long)gops);
+	fprintf(fp,"    \"min\": %llu,\n",(unsigned long long)gop_min);
+	fprintf(fp,"    \"max\": %llu,\n",(unsigned long long)gop_max);
+	fprintf(fp,"    \"avg\": %.2f,\n",gops ? (double)gop_frames / gops : 0);
+	fprintf(fp,"    \"histogram\": {");
+	for(std::map<uint64_t,uint64_t>::const_iterator it = m_GopHist.begin(); it != m_GopHist.end(); ++it)
+		fprintf(fp,"%s \"%llu\": %llu",it == m_GopHist.begin() ? "" : ",",(unsigned long long)it->first,(unsigned long long)it->second);
+	fprintf(fp," }\n");
+	fprintf(fp,"  }\n");
+	fprintf(fp,"}\n");
+}
+
+void CH264Stats::WriteCsvHeader(FILE* fp)
+{
+	fprintf(fp,"frame,dts,pts,type,idr,bytes,window_bitrate\n");
+}
+
+void CH264Stats::WriteCsvRow(FILE* fp,const H264FrameStat& frame)
+{
+	fprintf(fp,"%llu,%.6f,%.6f,%s,%d,%llu,%.0f\n",(unsigned long long)frame.index,(double)frame.dts / AU_TIME_BASE,(double)frame.pts / AU_TIME_BASE,
+		s_TypeName[frame.type],frame.idr,(unsigned long long)frame.bytes,frame.window_bitrate);
+}
+
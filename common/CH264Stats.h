@@ -0,0 +1,112 @@
+/*************************************************************************
+    > File Name: CH264Stats.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 22时48分55秒
+ ************************************************************************/
+
+#ifndef CH264_STATS_H
+#define CH264_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include "CAccessUnitAssembler.h"
+
+//统计中的图像类型
+enum
+{
+	H264_STATS_I = 0,
+	H264_STATS_P = 1,
+	H264_STATS_B = 2,
+	H264_STATS_TYPES = 3,
+};
+
+/**
+ * _H264FrameStat
+ * 一帧(访问单元)的统计结果
+ */
+typedef struct _H264FrameStat
+{
+	uint64_t index;               //帧序号
+	int64_t dts;                  //单位1/AU_TIME_BASE秒
+	int64_t pts;
+	int type;                     //H264_STATS_I/P/B
+	int idr;
+	uint64_t bytes;               //帧的字节数，包括起始码以及同一访问单元中的SPS/PPS/SEI
+	double window_bitrate;        //以该帧结束的滑动窗口内的码率，单位bit/s
+}H264FrameStat;
+
+/**
+ * H.264码流统计。按解码顺序逐个加入访问单元，一遍得到帧大小、I/P/B帧比例、GOP长度分布、
+ * 滑动窗口码率以及峰值码率与平均码率之比(用于估算缓冲区大小)，结果可以输出为JSON
+ */
+class CH264Stats
+{
+private:
+	int64_t m_nWindow;                              //滑动窗口长度，单位1/AU_TIME_BASE秒
+	std::deque<std::pair<int64_t,uint64_t> > m_Window;  //窗口内各帧的DTS和字节数
+	uint64_t m_nWindowBytes;
+
+	uint64_t m_nFrames;
+	uint64_t m_nTotalBytes;                         //所有访问单元的字节数，包括没有图像的访问单元
+	uint64_t m_nIdrFrames;
+	uint64_t m_nTypeFrames[H264_STATS_TYPES];
+	uint64_t m_nTypeBytes[H264_STATS_TYPES];
+	uint64_t m_nTypeMin[H264_STATS_TYPES];
+	uint64_t m_nTypeMax[H264_STATS_TYPES];
+
+	int64_t m_nFirstDts;
+	int64_t m_nEndDts;                              //最后一帧的DTS加上持续时间
+	double m_fPeakBitrate;
+	int64_t m_nPeakDts;                             //峰值码率窗口结束的DTS
+
+	uint64_t m_nGopFrames;                          //当前GOP已有的帧数，0表示还没有遇到IDR
+	std::map<uint64_t,uint64_t> m_GopHist;          //GOP长度(帧数) -> 个数
+
+public:
+	CH264Stats();
+	~CH264Stats();
+
+	void Reset();
+
+	/**
+	 * 滑动窗口长度，默认1秒，Reset之前设置
+	 */
+	void SetWindow(double sec);
+
+	/**
+	 * 加入一个访问单元
+	 * @param au 访问单元，按解码顺序
+	 * @param frame 不为NULL时存储该帧的统计结果
+	 * @访问单元包含图像则返回 1 , 否则返回 0(只计入总字节数)
+	 */
+	int Add(const AccessUnit& au,H264FrameStat* frame);
+
+	/**
+	 * 结束最后一个GOP，输出结果之前调用
+	 */
+	void Finish();
+
+	/**
+	 * 以JSON输出统计结果
+	 * @param fp 输出文件
+	 * @param url 码流文件名
+	 * @param sps 码流的SPS，用于输出分辨率，可以为NULL
+	 * @param fps 帧率
+	 */
+	void WriteJson(FILE* fp,const char* url,const H264Sps* sps,double fps) const;
+
+	//以CSV输出每帧的统计结果
+	static void WriteCsvHeader(FILE* fp);
+	static void WriteCsvRow(FILE* fp,const H264FrameStat& frame);
+
+	uint64_t Frames() const { return m_nFrames; }
+	double Duration() const;
+	double AverageBitrate() const;
+	double PeakBitrate() const { return m_fPeakBitrate; }
+};
+
+#endif
+
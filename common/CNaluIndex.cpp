@@ -0,0 +1,306 @@
+/*************************************************************************
+    > File Name: CNaluIndex.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 20时05分17秒
+ ************************************************************************/
+
+#include <sys/stat.h>
+#include "CNaluIndex.h"
+
+#define INDEX_HEADER_SIZE    40
+#define INDEX_NALU_SIZE      12
+#define INDEX_KEY_SIZE       24
+
+static void PutLe32(unsigned char* p,uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static void PutLe64(unsigned char* p,uint64_t v)
+{
+	PutLe32(p,(uint32_t)v);
+	PutLe32(p + 4,(uint32_t)(v >> 32));
+}
+
+static uint32_t GetLe32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetLe64(const unsigned char* p)
+{
+	return GetLe32(p) | ((uint64_t)GetLe32(p + 4) << 32);
+}
+
+CNaluIndex::CNaluIndex() : m_nAuCount(0),m_nFileSize(0),m_nMtimeSec(0),m_nMtimeNsec(0)
+{
+
+}
+
+CNaluIndex::~CNaluIndex()
+{
+
+}
+
+std::string CNaluIndex::SidecarName(const char* fn)
+{
+	return std::string(fn) + NALU_INDEX_SUFFIX;
+}
+
+int CNaluIndex::StatFile(const char* fn,uint64_t& size,int64_t& sec,uint32_t& nsec)
+{
+	struct stat st;
+	if(stat(fn,&st) != 0)
+		return 0;
+	size = st.st_size;
+	sec = st.st_mtim.tv_sec;
+	nsec = st.st_mtim.tv_nsec;
+	return 1;
+}
+
+int CNaluIndex::Build(const char* fn)
+{
+	CAnnexbScanner scanner;
+	CAccessUnitAssembler assembler;
+	AccessUnit au;
+
+	m_Packed.clear();
+	m_Len.clear();
+	m_Keys.clear();
+	m_nAuCount = 0;
+	if(!StatFile(fn,m_nFileSize,m_nMtimeSec,m_nMtimeNsec) || !scanner.Open(fn))
+		return 0;
+
+	assembler.Attach(&scanner);
+	while(assembler.Next(au))
+	{
+		if(au.idr)
+		{
+			KeyframeEntry key;
+			key.offset = au.offset;
+			key.dts = au.dts;
+			key.au_index = m_nAuCount;
+			key.nalu_index = (uint32_t)m_Packed.size();
+			m_Keys.push_back(key);
+		}
+		for(size_t i = 0; i < au.nalus.size(); i++)
+		{
+			const NaluView& n = au.nalus[i];
+			uint64_t packed = (n.offset << 16) | ((n.startcodeprefix_len == 4) << 8) | ((i == 0) << 7) |
+				(n.nal_reference_idc & 0x60) | (n.nal_unit_type & 0x1f);
+			m_Packed.push_back(packed);
+			m_Len.push_back(n.len);
+		}
+		m_nAuCount++;
+	}
+	scanner.Close();
+	return 1;
+}
+
+int CNaluIndex::Load(const char* fn)
+{
+	uint64_t size;
+	int64_t sec;
+	uint32_t nsec;
+	unsigned char hdr[INDEX_HEADER_SIZE];
+
+	if(!StatFile(fn,size,sec,nsec))
+		return 0;
+	FILE* fp = fopen(SidecarName(fn).c_str(),"rb");
+	if(fp == NULL)
+		return 0;
+
+	int ret = 0;
+	if(fread(hdr,1,sizeof(hdr),fp) == sizeof(hdr) && GetLe32(hdr) == NALU_INDEX_MAGIC && GetLe32(hdr + 4) == NALU_INDEX_VERSION &&
+	   GetLe64(hdr + 8) == size && (int64_t)GetLe64(hdr + 16) == sec && GetLe32(hdr + 24) == nsec)
+	{
+		uint32_t nalu_count = GetLe32(hdr + 28);
+		uint32_t key_count = GetLe32(hdr + 32);
+		uint64_t body_size = (uint64_t)nalu_count * INDEX_NALU_SIZE + (uint64_t)key_count * INDEX_KEY_SIZE;
+		//分配之前先与索引文件的实际大小核对，损坏或截断的索引按过期处理
+		struct stat st;
+		if(fstat(fileno(fp),&st) != 0 || (uint64_t)st.st_size != INDEX_HEADER_SIZE + body_size)
+		{
+			fclose(fp);
+			return 0;
+		}
+		std::vector<unsigned char> body(body_size);
+		if(body.empty() || fread(&body[0],1,body.size(),fp) == body.size())
+		{
+			const unsigned char* p = body.empty() ? NULL : &body[0];
+			m_Packed.resize(nalu_count);
+			m_Len.resize(nalu_count);
+			m_Keys.resize(key_count);
+			for(uint32_t i = 0; i < nalu_count; i++,p += INDEX_NALU_SIZE)
+			{
+				m_Packed[i] = GetLe64(p);
+				m_Len[i] = GetLe32(p + 8);
+			}
+			for(uint32_t i = 0; i < key_count; i++,p += INDEX_KEY_SIZE)
+			{
+				m_Keys[i].offset = GetLe64(p);
+				m_Keys[i].dts = (int64_t)GetLe64(p + 8);
+				m_Keys[i].au_index = GetLe32(p + 16);
+				m_Keys[i].nalu_index = GetLe32(p + 20);
+			}
+			m_nAuCount = GetLe32(hdr + 36);
+			m_nFileSize = size;
+			m_nMtimeSec = sec;
+			m_nMtimeNsec = nsec;
+			ret = 1;
+		}
+	}
+	fclose(fp);
+	return ret;
+}
+
+int CNaluIndex::Save(const char* fn) const
+{
+	std::string name = SidecarName(fn);
+	std::string tmp = name + ".tmp";
+	std::vector<unsigned char> buf(INDEX_HEADER_SIZE + m_Packed.size() * INDEX_NALU_SIZE + m_Keys.size() * INDEX_KEY_SIZE);
+	unsigned char* p = &buf[0];
+
+	PutLe32(p,NALU_INDEX_MAGIC);
+	PutLe32(p + 4,NALU_INDEX_VERSION);
+	PutLe64(p + 8,m_nFileSize);
+	PutLe64(p + 16,(uint64_t)m_nMtimeSec);
+	PutLe32(p + 24,m_nMtimeNsec);
+	PutLe32(p + 28,(uint32_t)m_Packed.size());
+	PutLe32(p + 32,(uint32_t)m_Keys.size());
+	PutLe32(p + 36,m_nAuCount);
+	p += INDEX_HEADER_SIZE;
+	for(size_t i = 0; i < m_Packed.size(); i++,p += INDEX_NALU_SIZE)
+	{
+		PutLe64(p,m_Packed[i]);
+		PutLe32(p + 8,m_Len[i]);
+	}
+	for(size_t i = 0; i < m_Keys.size(); i++,p += INDEX_KEY_SIZE)
+	{
+		PutLe64(p,m_Keys[i].offset);
+		PutLe64(p + 8,(uint64_t)m_Keys[i].dts);
+		PutLe32(p + 16,m_Keys[i].au_index);
+		PutLe32(p + 20,m_Keys[i].nalu_index);
+	}
+
+	//先写临时文件再改名，其他进程不会读到写了一半的索引
+	FILE* fp = fopen(tmp.c_str(),"wb");
+	if(fp == NULL)
+		return 0;
+	size_t n = fwrite(&buf[0],1,buf.size(),fp);
+	if(fclose(fp) != 0 || n != buf.size() || rename(tmp.c_str(),name.c_str()) != 0)
+	{
+		remove(tmp.c_str());
+		return 0;
+	}
+	return 1;
+}
+
+int CNaluIndex::LoadOrBuild(const char* fn)
+{
+	if(Load(fn))
+		return 1;
+	if(!Build(fn))
+		return 0;
+	if(!Save(fn))
+		printf("%s: ====haoge====write index %s failed\n",__FUNCTION__,SidecarName(fn).c_str());
+	return 1;
+}
+
+NaluIndexEntry CNaluIndex::Nalu(uint32_t i) const
+{
+	NaluIndexEntry e;
+	uint64_t packed = m_Packed[i];
+	e.offset = packed >> 16;
+	e.len = m_Len[i];
+	e.startcodeprefix_len = (packed & 0x100) ? 4 : 3;
+	e.au_start = (packed >> 7) & 1;
+	e.nal_reference_idc = (packed >> 5) & 3;
+	e.nal_unit_type = packed & 0x1f;
+	return e;
+}
+
+int CNaluIndex::FindKeyframe(int64_t dts) const
+{
+	//关键帧按DTS递增，二分查找
+	int lo = 0,hi = (int)m_Keys.size() - 1,ret = m_Keys.empty() ? -1 : 0;
+	while(lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(m_Keys[mid].dts <= dts)
+		{
+			ret = mid;
+			lo = mid + 1;
+		}
+		else
+			hi = mid - 1;
+	}
+	return ret;
+}
+
+int CNaluIndex::FindKeyframeByOffset(uint64_t offset) const
+{
+	int lo = 0,hi = (int)m_Keys.size() - 1,ret = m_Keys.empty() ? -1 : 0;
+	while(lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(m_Keys[mid].offset <= offset)
+		{
+			ret = mid;
+			lo = mid + 1;
+		}
+		else
+			hi = mid - 1;
+	}
+	return ret;
+}
+
+int CNaluIndex::SeekToKeyframe(int key,CAnnexbScanner& scanner,CAccessUnitAssembler& assembler) const
+{
+	if(key < 0 || key >= (int)m_Keys.size())
+		return 0;
+	const KeyframeEntry& k = m_Keys[key];
+
+	//访问单元本身是否带有SPS和PPS
+	bool has_sps = false,has_pps = false;
+	for(uint32_t i = k.nalu_index; i < m_Packed.size(); i++)
+	{
+		NaluIndexEntry e = Nalu(i);
+		if(i != k.nalu_index && e.au_start)
+			break;
+		has_sps |= (e.nal_unit_type == 7);
+		has_pps |= (e.nal_unit_type == 8);
+	}
+
+	//向前查找最近的SPS和PPS，先交给组装器，保证从关键帧开始解码
+	uint64_t param[2];
+	int count = 0;
+	for(int64_t i = (int64_t)k.nalu_index - 1; i >= 0 && (!has_sps || !has_pps); i--)
+	{
+		NaluIndexEntry e = Nalu((uint32_t)i);
+		if((e.nal_unit_type == 7 && !has_sps) || (e.nal_unit_type == 8 && !has_pps))
+		{
+			param[count++] = e.offset;
+			has_sps |= (e.nal_unit_type == 7);
+			has_pps |= (e.nal_unit_type == 8);
+		}
+	}
+	//SPS必须先于PPS解析
+	for(int i = count - 1; i >= 0; i--)
+	{
+		NaluView n;
+		if(!scanner.Seek(param[i]) || !scanner.Next(n))
+			return 0;
+		assembler.InjectParameterSet(n);
+	}
+
+	if(!scanner.Seek(k.offset))
+		return 0;
+	assembler.Resync(k.dts);
+	return 1;
+}
+
@@ -0,0 +1,138 @@
+/*************************************************************************
+    > File Name: CNaluIndex.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 20时05分17秒
+ ************************************************************************/
+
+#ifndef CNALU_INDEX_H
+#define CNALU_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "CAnnexbScanner.h"
+#include "CAccessUnitAssembler.h"
+
+#define NALU_INDEX_MAGIC    0x5844494e      //"NIDX"
+#define NALU_INDEX_VERSION  1
+//索引文件名为码流文件名加上该后缀
+#define NALU_INDEX_SUFFIX   ".idx"
+
+/**
+ * _NaluIndexEntry
+ * 索引中的一个NALU
+ */
+typedef struct _NaluIndexEntry
+{
+	uint64_t offset;              //起始码在文件中的偏移
+	unsigned int len;             //NALU长度，不包括起始码
+	int startcodeprefix_len;      //3或4
+	int nal_unit_type;
+	int nal_reference_idc;        //已右移5位，0~3
+	int au_start;                 //是否为访问单元的第一个NALU
+}NaluIndexEntry;
+
+/**
+ * _KeyframeEntry
+ * 索引中的一个IDR访问单元
+ */
+typedef struct _KeyframeEntry
+{
+	uint64_t offset;              //访问单元第一个NALU起始码的偏移(包括IDR之前的AUD/SPS/PPS/SEI)
+	int64_t dts;                  //解码时间戳，单位1/AU_TIME_BASE秒
+	uint32_t au_index;            //访问单元序号
+	uint32_t nalu_index;          //访问单元第一个NALU在索引中的序号
+}KeyframeEntry;
+
+/**
+ * H.264码流文件的NALU/关键帧索引，保存在码流文件旁边的索引文件(xxx.h264.idx)中。
+ * 索引文件记录码流文件的大小和修改时间，两者任一变化即认为索引已过期，需要重新建立。
+ * 文件格式(小端)：
+ *   文件头 40字节：magic, version, file_size(8), mtime_sec(8), mtime_nsec, nalu_count, keyframe_count, au_count
+ *   NALU记录 每个12字节：offset<<16 | sc4<<8 | au_start<<7 | nal_reference_idc<<5 | nal_unit_type (8字节), len (4字节)
+ *   关键帧记录 每个24字节：offset(8), dts(8), au_index, nalu_index
+ */
+class CNaluIndex
+{
+private:
+	std::vector<uint64_t> m_Packed;       //NALU记录的前8字节
+	std::vector<uint32_t> m_Len;          //NALU长度
+	std::vector<KeyframeEntry> m_Keys;
+	uint32_t m_nAuCount;
+	uint64_t m_nFileSize;
+	int64_t m_nMtimeSec;
+	uint32_t m_nMtimeNsec;
+
+	//取得文件大小和修改时间
+	static int StatFile(const char* fn,uint64_t& size,int64_t& sec,uint32_t& nsec);
+
+public:
+	CNaluIndex();
+	~CNaluIndex();
+
+	/**
+	 * 扫描码流文件建立索引
+	 * @param fn 码流文件名
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Build(const char* fn);
+
+	/**
+	 * 读取码流文件对应的索引文件
+	 * @param fn 码流文件名(不是索引文件名)
+	 * @索引文件存在且未过期则返回 1 , 否则返回 0
+	 */
+	int Load(const char* fn);
+
+	/**
+	 * 把索引写入码流文件对应的索引文件
+	 * @param fn 码流文件名(不是索引文件名)
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Save(const char* fn) const;
+
+	/**
+	 * 读取索引，索引文件不存在或已过期时重新建立并保存。保存失败(如目录不可写)不影响使用
+	 * @param fn 码流文件名
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int LoadOrBuild(const char* fn);
+
+	/**
+	 * 查找DTS不晚于dts的最后一个关键帧
+	 * @param dts 单位1/AU_TIME_BASE秒
+	 * @返回关键帧序号，没有关键帧时返回 -1
+	 */
+	int FindKeyframe(int64_t dts) const;
+
+	/**
+	 * 查找起始位置不晚于offset的最后一个关键帧
+	 * @param offset 文件中的字节偏移
+	 * @返回关键帧序号，没有关键帧时返回 -1
+	 */
+	int FindKeyframeByOffset(uint64_t offset) const;
+
+	/**
+	 * 把扫描器和组装器定位到第key个关键帧。若该访问单元中没有SPS或PPS，
+	 * 把之前最近的SPS/PPS交给组装器，随第一个访问单元一起输出。扫描器必须以文件方式打开
+	 * @param key 关键帧序号
+	 * @param scanner 已打开同一码流文件的扫描器
+	 * @param assembler 已关联该扫描器的组装器
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int SeekToKeyframe(int key,CAnnexbScanner& scanner,CAccessUnitAssembler& assembler) const;
+
+	uint32_t NaluCount() const { return (uint32_t)m_Packed.size(); }
+	uint32_t KeyframeCount() const { return (uint32_t)m_Keys.size(); }
+	uint32_t AuCount() const { return m_nAuCount; }
+	NaluIndexEntry Nalu(uint32_t i) const;
+	const KeyframeEntry& Keyframe(uint32_t i) const { return m_Keys[i]; }
+
+	//码流文件对应的索引文件名
+	static std::string SidecarName(const char* fn);
+};
+
+#endif
+
@@ -0,0 +1,435 @@
+/*************************************************************************
+    > File Name: CPcapReader.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 09时37分52秒
+ ************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "CPcapReader.h"
+
+//pcap文件头的magic，微秒和纳秒时间戳
+#define PCAP_MAGIC_US        0xa1b2c3d4
+#define PCAP_MAGIC_NS        0xa1b23c4d
+#define PCAP_HEADER_SIZE     24
+#define PCAP_RECORD_SIZE     16
+
+//pcapng的块类型
+#define PCAPNG_SHB           0x0A0D0D0A
+#define PCAPNG_IDB           0x00000001
+#define PCAPNG_SPB           0x00000003
+#define PCAPNG_EPB           0x00000006
+#define PCAPNG_BYTE_ORDER    0x1A2B3C4D
+#define PCAPNG_OPT_TSRESOL   9
+
+//链路层类型(LINKTYPE_*)
+#define LINK_NULL            0
+#define LINK_ETHERNET        1
+#define LINK_RAW_OLD         12
+#define LINK_RAW             101
+#define LINK_LOOP            108
+#define LINK_LINUX_SLL       113
+#define LINK_IPV4            228
+#define LINK_IPV6            229
+#define LINK_LINUX_SLL2      276
+
+#define ETHER_IPV4           0x0800
+#define ETHER_IPV6           0x86DD
+#define ETHER_VLAN           0x8100
+#define ETHER_QINQ           0x88A8
+
+//协议头中的字段都是网络字节序，与文件的字节序无关
+static inline uint16_t be16(const unsigned char* p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline int64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+CPcapReader::CPcapReader() : m_nFd(-1),m_pMap(NULL),m_nSize(0),m_bNg(false),m_bSwap(false),m_nLinkType(LINK_ETHERNET),m_nTsScale(1000),m_nIfCount(0),
+	m_nPort(0),m_nLoops(1),m_fSpeed(1),m_nMode(PCAP_REPLAY_FAST),m_nFirstTs(-1),m_nLastTs(0),m_nStartNs(0)
+{
+	memset(&m_Stats,0,sizeof(m_Stats));
+}
+
+CPcapReader::~CPcapReader()
+{
+	Close();
+}
+
+uint32_t CPcapReader::Read32(const unsigned char* p) const
+{
+	uint32_t v;
+	memcpy(&v,p,sizeof(v));
+	return m_bSwap ? __builtin_bswap32(v) : v;
+}
+
+uint16_t CPcapReader::Read16(const unsigned char* p) const
+{
+	uint16_t v;
+	memcpy(&v,p,sizeof(v));
+	return m_bSwap ? __builtin_bswap16(v) : v;
+}
+
+int CPcapReader::Open(const char* fn)
+{
+	struct stat st;
+
+	Close();
+	if((m_nFd = open(fn,O_RDONLY)) < 0)
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,fn);
+		return 0;
+	}
+	if(fstat(m_nFd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size < PCAP_HEADER_SIZE)
+	{
+		printf("%s: ====haoge====%s is not a capture file\n",__FUNCTION__,fn);
+		Close();
+		return 0;
+	}
+	void* addr = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,m_nFd,0);
+	if(addr == MAP_FAILED)
+	{
+		Close();
+		return 0;
+	}
+	m_pMap = (const unsigned char*)addr;
+	m_nSize = st.st_size;
+	//顺序读取整个文件
+	madvise(addr,m_nSize,MADV_SEQUENTIAL);
+
+	uint32_t magic;
+	memcpy(&magic,m_pMap,sizeof(magic));
+	m_bNg = false;
+	m_bSwap = false;
+	if(magic == PCAP_MAGIC_US || magic == __builtin_bswap32(PCAP_MAGIC_US))
+	{
+		m_bSwap = magic != PCAP_MAGIC_US;
+		m_nTsScale = 1000;
+	}
+	else if(magic == PCAP_MAGIC_NS || magic == __builtin_bswap32(PCAP_MAGIC_NS))
+	{
+		m_bSwap = magic != PCAP_MAGIC_NS;
+		m_nTsScale = 1;
+	}
+	else if(magic == PCAPNG_SHB)
+	{
+		//字节序在每个SHB中给出，Run时逐段确定
+		m_bNg = true;
+	}
+	else
+	{
+		printf("%s: ====haoge====unknown capture format, magic 0x%08x\n",__FUNCTION__,magic);
+		Close();
+		return 0;
+	}
+	if(!m_bNg)
+		m_nLinkType = (int)(Read32(m_pMap + 20) & 0xffff);
+	return 1;
+}
+
+void CPcapReader::Close()
+{
+	if(m_pMap != NULL)
+	{
+		munmap((void*)m_pMap,m_nSize);
+		m_pMap = NULL;
+	}
+	if(m_nFd >= 0)
+	{
+		close(m_nFd);
+		m_nFd = -1;
+	}
+	m_nSize = 0;
+}
+
+void CPcapReader::ParseIdb(const unsigned char* body,uint32_t len)
+{
+	if(m_nIfCount >= PCAP_MAX_INTERFACES || len < 8)
+		return;
+	int index = m_nIfCount++;
+	m_IfLinkType[index] = Read16(body);
+	m_IfTsUnits[index] = 1000000;
+
+	//选项：code(2) + length(2) + value(补齐到4字节)，code为0结束
+	uint32_t pos = 8;
+	while(pos + 4 <= len)
+	{
+		uint16_t code = Read16(body + pos);
+		uint16_t olen = Read16(body + pos + 2);
+		if(code == 0 || pos + 4 + olen > len)
+			break;
+		if(code == PCAPNG_OPT_TSRESOL && olen >= 1)
+		{
+			//最高位为0表示10的负n次方秒，为1表示2的负n次方秒
+			unsigned char v = body[pos + 4];
+			int n = v & 0x7f;
+			int64_t units = 1;
+			if(v & 0x80)
+				units = n < 62 ? (1LL << n) : (1LL << 62);
+			else
+				for(int i = 0; i < n && i < 18; i++)
+					units *= 10;
+			m_IfTsUnits[index] = units;
+		}
+		pos += 4 + ((olen + 3) & ~3);
+	}
+}
+
+void CPcapReader::OnFrame(const unsigned char* frame,uint32_t caplen,int linktype,int64_t ts,int64_t offset,const UdpPacketFunc& cb)
+{
+	const unsigned char* p = frame;
+	const unsigned char* end = frame + caplen;
+	int ether = 0;
+
+	switch(linktype)
+	{
+	case LINK_ETHERNET:
+		if(caplen < 14)
+			break;
+		ether = be16(p + 12);
+		p += 14;
+		while((ether == ETHER_VLAN || ether == ETHER_QINQ) && end - p >= 4)
+		{
+			ether = be16(p + 2);
+			p += 4;
+		}
+		break;
+	case LINK_LINUX_SLL:
+		if(caplen < 16)
+			break;
+		ether = be16(p + 14);
+		p += 16;
+		break;
+	case LINK_LINUX_SLL2:
+		if(caplen < 20)
+			break;
+		ether = be16(p);
+		p += 20;
+		break;
+	case LINK_NULL:
+	case LINK_LOOP:
+	{
+		//协议族：NULL是抓包机器的字节序，LOOP是网络字节序，AF_INET都是2，AF_INET6因系统不同为10/24/28/30
+		if(caplen < 4)
+			break;
+		uint32_t family = linktype == LINK_LOOP ? ((uint32_t)be16(p) << 16 | be16(p + 2)) : Read32(p);
+		if(family == 2)
+			ether = ETHER_IPV4;
+		else if(family == 10 || family == 24 || family == 28 || family == 30)
+			ether = ETHER_IPV6;
+		p += 4;
+		break;
+	}
+	case LINK_RAW_OLD:
+	case LINK_RAW:
+	case LINK_IPV4:
+	case LINK_IPV6:
+		if(caplen < 1)
+			break;
+		ether = (p[0] >> 4) == 4 ? ETHER_IPV4 : ((p[0] >> 4) == 6 ? ETHER_IPV6 : 0);
+		break;
+	default:
+		break;
+	}
+
+	UdpPacket pkt;
+	memset(&pkt.from,0,sizeof(pkt.from));
+	pkt.from.sin_family = AF_INET;
+	const unsigned char* udp = NULL;
+	if(ether == ETHER_IPV4 && end - p >= 20)
+	{
+		int ihl = (p[0] & 0x0f) * 4;
+		//只处理完整的UDP包，分片(MF或者片偏移不为0)跳过
+		if(ihl >= 20 && p[9] == 17 && (be16(p + 6) & 0x3fff) == 0 && end - p >= ihl + 8)
+		{
+			memcpy(&pkt.from.sin_addr,p + 12,4);
+			udp = p + ihl;
+		}
+	}
+	else if(ether == ETHER_IPV6 && end - p >= 48)
+	{
+		//不处理扩展头，源地址放不进sockaddr_in，只给出端口
+		if(p[6] == 17)
+			udp = p + 40;
+	}
+	if(udp == NULL)
+	{
+		m_Stats.skipped++;
+		return;
+	}
+
+	int ulen = be16(udp + 4);
+	if(ulen < 8)
+	{
+		m_Stats.skipped++;
+		return;
+	}
+	if(m_nPort != 0 && be16(udp + 2) != m_nPort)
+	{
+		m_Stats.filtered++;
+		return;
+	}
+
+	pkt.data = udp + 8;
+	pkt.len = ulen - 8;
+	pkt.truncated = 0;
+	if(end - pkt.data < pkt.len)
+	{
+		pkt.len = (int)(end - pkt.data);
+		pkt.truncated = 1;
+		m_Stats.truncated++;
+	}
+	pkt.worker = 0;
+	pkt.from.sin_port = htons(be16(udp));
+	pkt.arrival = ts + offset;
+
+	if(m_nFirstTs < 0)
+	{
+		m_nFirstTs = pkt.arrival;
+		m_nStartNs = monotonic_ns();
+	}
+	else if(m_nMode == PCAP_REPLAY_REALTIME && pkt.arrival > m_nFirstTs)
+	{
+		//按抓包时的间隔等到该包的时刻，用绝对时刻避免误差累积
+		int64_t due = m_nStartNs + (int64_t)((pkt.arrival - m_nFirstTs) / m_fSpeed);
+		struct timespec t;
+		t.tv_sec = due / 1000000000LL;
+		t.tv_nsec = due % 1000000000LL;
+		while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&t,NULL) == EINTR)
+			;
+	}
+
+	m_Stats.packets++;
+	m_Stats.bytes += pkt.len;
+	cb(pkt);
+}
+
+int CPcapReader::Run(const UdpPacketFunc& cb,int mode)
+{
+	if(m_pMap == NULL)
+		return 0;
+
+	memset(&m_Stats,0,sizeof(m_Stats));
+	m_nMode = mode;
+	m_nFirstTs = -1;
+	m_nLastTs = 0;
+	int64_t offset = 0;
+	int ret = 1;
+
+	for(int loop = 0; loop < m_nLoops && ret; loop++)
+	{
+		int64_t first = -1,last = 0;
+		if(!m_bNg)
+		{
+			uint64_t pos = PCAP_HEADER_SIZE;
+			while(pos + PCAP_RECORD_SIZE <= m_nSize)
+			{
+				const unsigned char* rec = m_pMap + pos;
+				uint32_t caplen = Read32(rec + 8);
+				if(pos + PCAP_RECORD_SIZE + caplen > m_nSize)
+				{
+					printf("%s: ====haoge====truncated record at offset %llu\n",__FUNCTION__,(unsigned long long)pos);
+					break;
+				}
+				int64_t ts = (int64_t)Read32(rec) * 1000000000LL + (int64_t)Read32(rec + 4) * m_nTsScale;
+				if(first < 0)
+					first = ts;
+				last = ts;
+				m_Stats.records++;
+				OnFrame(rec + PCAP_RECORD_SIZE,caplen,m_nLinkType,ts,offset,cb);
+				pos += PCAP_RECORD_SIZE + caplen;
+			}
+		}
+		else
+		{
+			uint64_t pos = 0;
+			int64_t ts = 0;
+			while(pos + 12 <= m_nSize)
+			{
+				const unsigned char* blk = m_pMap + pos;
+				uint32_t type;
+				memcpy(&type,blk,sizeof(type));
+				if(type == PCAPNG_SHB)
+				{
+					//新的一段：重新确定字节序，接口编号从0开始
+					uint32_t order;
+					memcpy(&order,blk + 8,sizeof(order));
+					if(order != PCAPNG_BYTE_ORDER && order != __builtin_bswap32(PCAPNG_BYTE_ORDER))
+					{
+						printf("%s: ====haoge====bad section header at offset %llu\n",__FUNCTION__,(unsigned long long)pos);
+						ret = 0;
+						break;
+					}
+					m_bSwap = order != PCAPNG_BYTE_ORDER;
+					m_nIfCount = 0;
+				}
+				type = Read32(blk);
+				uint32_t blen = Read32(blk + 4);
+				if(blen < 12 || (blen & 3) != 0 || pos + blen > m_nSize)
+				{
+					printf("%s: ====haoge====bad block at offset %llu\n",__FUNCTION__,(unsigned long long)pos);
+					ret = blen >= 12;
+					break;
+				}
+				const unsigned char* body = blk + 8;
+				uint32_t len = blen - 12;
+				if(type == PCAPNG_IDB)
+				{
+					ParseIdb(body,len);
+				}
+				else if(type == PCAPNG_EPB && len >= 20)
+				{
+					uint32_t ifid = Read32(body);
+					uint32_t caplen = Read32(body + 12);
+					if(ifid < (uint32_t)m_nIfCount && caplen <= len - 20)
+					{
+						uint64_t t = ((uint64_t)Read32(body + 4) << 32) | Read32(body + 8);
+						int64_t units = m_IfTsUnits[ifid];
+						ts = units == 1000000000LL ? (int64_t)t : (int64_t)(t / units) * 1000000000LL + (int64_t)((t % units) * 1000000000ULL / units);
+						if(first < 0)
+							first = ts;
+						last = ts;
+						m_Stats.records++;
+						OnFrame(body + 20,caplen,m_IfLinkType[ifid],ts,offset,cb);
+					}
+				}
+				else if(type == PCAPNG_SPB && len >= 4 && m_nIfCount > 0)
+				{
+					//SPB没有时间戳，沿用前一个包的时刻
+					uint32_t caplen = Read32(body);
+					if(caplen > len - 4)
+						caplen = len - 4;
+					m_Stats.records++;
+					OnFrame(body + 4,caplen,m_IfLinkType[0],ts,offset,cb);
+				}
+				pos += blen;
+			}
+		}
+		if(first < 0)
+			break;
+		m_nLastTs = last + offset;
+		//下一遍接在这一遍之后，留出1ms的间隔
+		offset += last - first + 1000000;
+	}
+
+	if(m_nFirstTs >= 0)
+	{
+		m_Stats.duration = (m_nLastTs - m_nFirstTs) / 1e9;
+		m_Stats.elapsed = (monotonic_ns() - m_nStartNs) / 1e9;
+	}
+	return ret;
+}
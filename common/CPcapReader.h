@@ -0,0 +1,112 @@
+/*************************************************************************
+    > File Name: CPcapReader.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 09时37分52秒
+ ************************************************************************/
+
+#ifndef CPCAP_READER_H
+#define CPCAP_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CUdpIngest.h"
+
+//pcapng文件最多的接口数(Interface Description Block)
+#define PCAP_MAX_INTERFACES  16
+
+//回放方式
+enum
+{
+	PCAP_REPLAY_FAST     = 0,   //不等待，尽快回放，用于测吞吐量
+	PCAP_REPLAY_REALTIME = 1,   //按抓包时的时间间隔回放
+};
+
+/**
+ * _PcapStats
+ * 回放统计
+ */
+typedef struct _PcapStats
+{
+	uint64_t records;             //文件中的包记录数
+	uint64_t packets;             //回调的UDP包数
+	uint64_t bytes;               //回调的UDP负载字节数
+	uint64_t filtered;            //端口或地址不匹配的UDP包
+	uint64_t skipped;             //不是IPv4/IPv6上的UDP、IP分片或者链路层类型不支持的包
+	uint64_t truncated;           //抓包长度小于UDP包长度的包(snaplen太小)
+	double duration;              //抓包的时间跨度，秒
+	double elapsed;               //回放用的时间，秒
+}PcapStats;
+
+/**
+ * 读取pcap(微秒、纳秒时间戳，大小端)和pcapng(SHB/IDB/EPB/SPB)抓包文件，取出其中的UDP负载，
+ * 以CUdpIngest相同的UdpPacket回调，到达时刻为抓包的时间戳，解析代码不需要区分实时接收和回放。
+ * 链路层支持以太网(含VLAN)、Linux cooked(SLL/SLL2)、BSD loopback和raw IP，网络层支持IPv4和IPv6(不处理分片和扩展头)。
+ * 文件映射到内存，UDP负载直接指向映射的数据，不复制
+ */
+class CPcapReader
+{
+private:
+	int m_nFd;
+	const unsigned char* m_pMap;
+	uint64_t m_nSize;
+
+	bool m_bNg;                   //pcapng格式
+	bool m_bSwap;                 //文件的字节序与本机不同
+	int m_nLinkType;              //pcap的链路层类型
+	int64_t m_nTsScale;           //pcap时间戳小数部分到纳秒的倍数(微秒1000，纳秒1)
+	int m_nIfCount;               //pcapng的接口数
+	int m_IfLinkType[PCAP_MAX_INTERFACES];
+	int64_t m_IfTsUnits[PCAP_MAX_INTERFACES];  //pcapng每秒的时间戳单位数(if_tsresol)，默认1000000
+
+	int m_nPort;                  //只回调目的端口为该值的包，0表示全部
+	int m_nLoops;
+	double m_fSpeed;              //按原始时间回放时的速度倍数
+	int m_nMode;
+	int64_t m_nFirstTs;           //第一个回调的包的时间戳，纳秒，-1表示还没有
+	int64_t m_nLastTs;            //最近一个包记录的时间戳(加上循环的偏移)
+	int64_t m_nStartNs;           //开始回放的时刻，CLOCK_MONOTONIC
+	PcapStats m_Stats;
+
+	uint32_t Read32(const unsigned char* p) const;
+	uint16_t Read16(const unsigned char* p) const;
+	//从链路层帧中取出UDP包并回调
+	void OnFrame(const unsigned char* frame,uint32_t caplen,int linktype,int64_t ts,int64_t offset,const UdpPacketFunc& cb);
+	//解析pcapng的接口描述块
+	void ParseIdb(const unsigned char* body,uint32_t len);
+
+public:
+	CPcapReader();
+	~CPcapReader();
+
+	/**
+	 * 打开并映射抓包文件，识别格式
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Open(const char* fn);
+	void Close();
+
+	/**
+	 * 只回放目的端口为port的UDP包，0表示全部
+	 */
+	void SetPort(int port) { m_nPort = port; }
+	/**
+	 * 回放次数(用于吞吐量测试)，之后的每一遍到达时刻接着上一遍增加
+	 */
+	void SetLoops(int loops) { m_nLoops = loops > 0 ? loops : 1; }
+	/**
+	 * 按原始时间回放时的速度倍数，2表示两倍速
+	 */
+	void SetSpeed(double speed) { m_fSpeed = speed > 0 ? speed : 1; }
+
+	/**
+	 * 回放整个文件，逐个UDP包回调(在调用线程中)
+	 * @param mode PCAP_REPLAY_FAST或PCAP_REPLAY_REALTIME
+	 * @成功则返回 1 , 文件格式错误则返回 0
+	 */
+	int Run(const UdpPacketFunc& cb,int mode = PCAP_REPLAY_FAST);
+
+	void GetStats(PcapStats* stats) const { *stats = m_Stats; }
+};
+
+#endif
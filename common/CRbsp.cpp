@@ -0,0 +1,71 @@
+/*************************************************************************
+    > File Name: CRbsp.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 16时10分52秒
+ ************************************************************************/
+
+#include "CRbsp.h"
+
+unsigned int CRbsp::NalToRbsp(const unsigned char* src,unsigned int len,unsigned char* dst,unsigned int dst_size)
+{
+	const unsigned char* p = src;
+	const unsigned char* end = src + len;
+	unsigned char* d = dst;
+	unsigned int left = dst_size;
+
+	while(left > 0)
+	{
+		//从p开始查找，0x03之前的两个0不会与上一个0x03之前的0连成新的模式
+		const unsigned char* q = CStartCodeFinder::FindPrefix(p,end,0x03);
+		//保留 00 00，丢弃其后的0x03
+		unsigned int n = (q == end) ? (unsigned int)(end - p) : (unsigned int)(q + 2 - p);
+		if(n > left)
+			n = left;
+		memcpy(d,p,n);
+		d += n;
+		left -= n;
+		if(q == end)
+			break;
+		p = q + 3;
+	}
+	return (unsigned int)(d - dst);
+}
+
+unsigned int CRbsp::RbspToNal(const unsigned char* src,unsigned int len,unsigned char* dst)
+{
+	const unsigned char* p = src;
+	const unsigned char* end = src + len;
+	unsigned char* d = dst;
+
+	while(p < end)
+	{
+		//0x00很少，用memchr跳到下一个0，中间的数据整块拷贝
+		const unsigned char* z = (const unsigned char*)memchr(p,0,end - p);
+		if(z == NULL)
+		{
+			memcpy(d,p,end - p);
+			d += end - p;
+			break;
+		}
+		if(z + 2 < end && z[1] == 0 && z[2] <= 0x03)
+		{
+			//00 00 后面是00~03，插入0x03，从第三个字节重新开始计数
+			memcpy(d,p,z + 2 - p);
+			d += z + 2 - p;
+			*d++ = 0x03;
+			p = z + 2;
+		}
+		else
+		{
+			memcpy(d,p,z + 1 - p);
+			d += z + 1 - p;
+			p = z + 1;
+		}
+	}
+	//RBSP以 00 00 结尾(cabac_zero_word)时末尾要补一个0x03，否则会与下一个起始码连在一起
+	if(d - dst >= 2 && d[-1] == 0 && d[-2] == 0)
+		*d++ = 0x03;
+	return (unsigned int)(d - dst);
+}
+
@@ -0,0 +1,53 @@
+/*************************************************************************
+    > File Name: CRbsp.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 16时10分52秒
+ ************************************************************************/
+
+#ifndef CRBSP_H
+#define CRBSP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "CStartCodeFinder.h"
+
+/**
+ * NALU负载与RBSP之间的转换，即防竞争字节0x03的去除与插入。
+ * 在NALU中，00 00 之后出现00、01、02、03时编码器会插入一个0x03，解析语法元素之前需要先去掉。
+ * 两个方向都是单遍扫描、写入调用者提供的另一块内存，不修改源数据
+ */
+class CRbsp
+{
+public:
+	/**
+	 * 去除防竞争字节，NALU -> RBSP。用向量内核查找 00 00 03，两次命中之间的数据整块拷贝
+	 * @param src NALU数据(可以包括NALU头)
+	 * @param len NALU数据长度
+	 * @param dst 输出缓冲区，RBSP不会比源数据长
+	 * @param dst_size 输出缓冲区大小，写满即停止。只解析片头等开头部分时可以只转换前若干字节
+	 * @返回写入dst的字节数
+	 */
+	static unsigned int NalToRbsp(const unsigned char* src,unsigned int len,unsigned char* dst,unsigned int dst_size);
+
+	/**
+	 * 插入防竞争字节，RBSP -> NALU。改写SPS/SEI等之后重新封装时使用
+	 * @param src RBSP数据(可以包括NALU头)
+	 * @param len RBSP数据长度
+	 * @param dst 输出缓冲区，大小不小于MaxNalSize(len)
+	 * @返回写入dst的字节数
+	 */
+	static unsigned int RbspToNal(const unsigned char* src,unsigned int len,unsigned char* dst);
+
+	/**
+	 * 插入防竞争字节后的最大长度：最坏情况下每两个0x00之后插入一个0x03，末尾再补一个0x03
+	 */
+	static inline unsigned int MaxNalSize(unsigned int len)
+	{
+		return len + len / 2 + 1;
+	}
+};
+
+#endif
+
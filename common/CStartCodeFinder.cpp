@@ -0,0 +1,166 @@
+/*************************************************************************
+    > File Name: CStartCodeFinder.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 11时05分42秒
+ ************************************************************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+#include "CStartCodeFinder.h"
+
+//s_pFind初值为Resolve，第一次调用时才选择内核，不依赖全局对象的初始化顺序
+CStartCodeFinder::FindFunc CStartCodeFinder::s_pFind = CStartCodeFinder::Resolve;
+int CStartCodeFinder::s_nKernel = START_CODE_KERNEL_AUTO;
+
+const unsigned char* CStartCodeFinder::Resolve(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	SetKernel(START_CODE_KERNEL_AUTO);
+	return s_pFind(p,end,third);
+}
+
+int CStartCodeFinder::SetKernel(int kernel)
+{
+	int avx2 = 0,sse2 = 0;
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+	sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	if(kernel == START_CODE_KERNEL_AUTO)
+		kernel = avx2 ? START_CODE_KERNEL_AVX2 : START_CODE_KERNEL_SSE2;
+	if(kernel == START_CODE_KERNEL_AVX2 && !avx2)
+		kernel = START_CODE_KERNEL_SSE2;
+	if(kernel == START_CODE_KERNEL_SSE2 && !sse2)
+		kernel = START_CODE_KERNEL_SCALAR;
+
+	switch(kernel)
+	{
+		case START_CODE_KERNEL_AVX2:
+			s_pFind = FindAvx2;
+			break;
+		case START_CODE_KERNEL_SSE2:
+			s_pFind = FindSse2;
+			break;
+		default:
+			kernel = START_CODE_KERNEL_SCALAR;
+			s_pFind = FindScalar;
+			break;
+	}
+	s_nKernel = kernel;
+	return kernel;
+}
+
+const char* CStartCodeFinder::KernelName()
+{
+	if(s_nKernel == START_CODE_KERNEL_AUTO)
+		SetKernel(START_CODE_KERNEL_AUTO);
+	switch(s_nKernel)
+	{
+		case START_CODE_KERNEL_AVX2:
+			return "avx2";
+		case START_CODE_KERNEL_SSE2:
+			return "sse2";
+		default:
+			return "scalar";
+	}
+}
+
+const unsigned char* CStartCodeFinder::FindScalar(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	//先用memchr定位第三个字节，再回头检查前两个字节是否为0x0000
+	const unsigned char* q = p + 2;
+	while(q < end)
+	{
+		q = (const unsigned char*)memchr(q,third,end - q);
+		if(q == NULL)
+			return end;
+		if(q[-1] == 0 && q[-2] == 0)
+			return q - 2;
+		q++;
+	}
+	return end;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * 向量内核：压缩码流中连续两个0x00几乎只出现在起始码和防竞争字节处，所以先查找 00 00 对：
+ * 在p和p+1两次加载，按位或之后与0比较，结果中第j字节为0xFF表示j、j+1两个位置都是0x00。
+ * 每次处理64字节，整块都没有 00 00 对时(绝大多数情况)只用一次movemask判断后跳过；
+ * 有的时候再在p+2加载比较third，两个掩码相与，最低位即为第一个 00 00 third 模式的位置。
+ * 每块读到p+65，剩余不足66字节时交给标量实现，模式的开始位置都不小于p，不需要回退
+ */
+#define START_CODE_BLOCK      64
+#define START_CODE_BLOCK_READ (START_CODE_BLOCK + 2)
+
+__attribute__((target("sse2")))
+const unsigned char* CStartCodeFinder::FindSse2(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i x = _mm_set1_epi8((char)third);
+
+	while(end - p >= START_CODE_BLOCK_READ)
+	{
+		__m128i z0 = _mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)p),_mm_loadu_si128((const __m128i*)(p + 1))),zero);
+		__m128i z1 = _mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)(p + 16)),_mm_loadu_si128((const __m128i*)(p + 17))),zero);
+		__m128i z2 = _mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)(p + 32)),_mm_loadu_si128((const __m128i*)(p + 33))),zero);
+		__m128i z3 = _mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)(p + 48)),_mm_loadu_si128((const __m128i*)(p + 49))),zero);
+		if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(z0,z1),_mm_or_si128(z2,z3))))
+		{
+			uint64_t mz = (uint64_t)_mm_movemask_epi8(z0) | ((uint64_t)_mm_movemask_epi8(z1) << 16) |
+				((uint64_t)_mm_movemask_epi8(z2) << 32) | ((uint64_t)_mm_movemask_epi8(z3) << 48);
+			uint64_t mx = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)),x)) |
+				((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 18)),x)) << 16) |
+				((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 34)),x)) << 32) |
+				((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 50)),x)) << 48);
+			uint64_t m = mz & mx;
+			if(m)
+				return p + __builtin_ctzll(m);
+		}
+		p += START_CODE_BLOCK;
+	}
+	return FindScalar(p,end,third);
+}
+
+__attribute__((target("avx2")))
+const unsigned char* CStartCodeFinder::FindAvx2(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i x = _mm256_set1_epi8((char)third);
+
+	while(end - p >= START_CODE_BLOCK_READ)
+	{
+		__m256i z0 = _mm256_cmpeq_epi8(_mm256_or_si256(_mm256_loadu_si256((const __m256i*)p),_mm256_loadu_si256((const __m256i*)(p + 1))),zero);
+		__m256i z1 = _mm256_cmpeq_epi8(_mm256_or_si256(_mm256_loadu_si256((const __m256i*)(p + 32)),_mm256_loadu_si256((const __m256i*)(p + 33))),zero);
+		if(_mm256_movemask_epi8(_mm256_or_si256(z0,z1)))
+		{
+			uint64_t mz = (uint32_t)_mm256_movemask_epi8(z0) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(z1) << 32);
+			uint64_t mx = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 2)),x)) |
+				((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 34)),x)) << 32);
+			uint64_t m = mz & mx;
+			if(m)
+				return p + __builtin_ctzll(m);
+		}
+		p += START_CODE_BLOCK;
+	}
+	return FindScalar(p,end,third);
+}
+
+#else
+
+const unsigned char* CStartCodeFinder::FindSse2(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	return FindScalar(p,end,third);
+}
+
+const unsigned char* CStartCodeFinder::FindAvx2(const unsigned char* p,const unsigned char* end,unsigned char third)
+{
+	return FindScalar(p,end,third);
+}
+
+#endif
+
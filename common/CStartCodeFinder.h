@@ -0,0 +1,77 @@
+/*************************************************************************
+    > File Name: CStartCodeFinder.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 11时05分42秒
+ ************************************************************************/
+
+#ifndef CSTART_CODE_FINDER_H
+#define CSTART_CODE_FINDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+//查找内核的种类
+enum
+{
+	START_CODE_KERNEL_AUTO   = 0,   //运行时根据CPU自动选择
+	START_CODE_KERNEL_SCALAR = 1,   //逐字节比较(memchr辅助)
+	START_CODE_KERNEL_SSE2   = 2,   //一次检查64个位置(4个16字节向量)
+	START_CODE_KERNEL_AVX2   = 3,   //一次检查64个位置(2个32字节向量)
+};
+
+/**
+ * H.264起始码查找。在一段内存中查找 00 00 xx 三字节模式，xx为0x01时即为起始码0x000001，
+ * xx为0x03时即为防竞争字节0x000003。向量内核每次检查64个位置，先查找 00 00 对，没有时整块跳过，
+ * 比memchr辅助的标量实现快；第一次调用时根据CPU支持的指令集选择AVX2、SSE2或标量实现
+ */
+class CStartCodeFinder
+{
+public:
+	typedef const unsigned char* (*FindFunc)(const unsigned char* p,const unsigned char* end,unsigned char third);
+
+private:
+	static FindFunc s_pFind;     //当前使用的内核
+	static int s_nKernel;        //当前内核种类
+
+	static const unsigned char* Resolve(const unsigned char* p,const unsigned char* end,unsigned char third);
+
+public:
+	/**
+	 * 在[p,end)中查找3字节起始码0x000001
+	 * @返回指向0x000001第一个字节的指针，找不到则返回end
+	 */
+	static inline const unsigned char* Find(const unsigned char* p,const unsigned char* end)
+	{
+		return s_pFind(p,end,0x01);
+	}
+
+	/**
+	 * 在[p,end)中查找 00 00 third 三字节模式
+	 * @返回指向该模式第一个字节的指针，找不到则返回end
+	 */
+	static inline const unsigned char* FindPrefix(const unsigned char* p,const unsigned char* end,unsigned char third)
+	{
+		return s_pFind(p,end,third);
+	}
+
+	/**
+	 * 指定使用的内核，CPU不支持时退回到可用的内核
+	 * @param kernel START_CODE_KERNEL_xxx
+	 * @返回实际使用的内核
+	 */
+	static int SetKernel(int kernel);
+
+	/**
+	 * 当前使用的内核名称,"avx2","sse2"或"scalar"
+	 */
+	static const char* KernelName();
+
+	static const unsigned char* FindScalar(const unsigned char* p,const unsigned char* end,unsigned char third);
+	static const unsigned char* FindSse2(const unsigned char* p,const unsigned char* end,unsigned char third);
+	static const unsigned char* FindAvx2(const unsigned char* p,const unsigned char* end,unsigned char third);
+};
+
+#endif
+
@@ -0,0 +1,341 @@
+/*************************************************************************
+    > File Name: CTsAnalyzer.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 08时46分15秒
+ ************************************************************************/
+
+#include <string.h>
+#include <math.h>
+#include "CTsAnalyzer.h"
+
+#define TS_ANALYZER_BUCKET_NS   ((int64_t)TS_ANALYZER_BUCKET_MS * 1000000)
+//PTS/DTS为33位，PCR为33位的base乘以300再加上扩展
+#define PTS_WRAP                (1LL << 33)
+#define PCR_WRAP                ((1LL << 33) * 300)
+#define PCR_HZ                  27000000LL
+
+CTsAnalyzer::CTsAnalyzer() : m_nPesGap((int64_t)TS_ANALYZER_PES_GAP_MS * 90),m_nReportInterval(0)
+{
+	Reset();
+}
+
+CTsAnalyzer::~CTsAnalyzer()
+{
+
+}
+
+void CTsAnalyzer::Reset()
+{
+	memset(m_PidSlot,0xff,sizeof(m_PidSlot));
+	m_nSlots = 0;
+	memset(&m_Stats,0,sizeof(m_Stats));
+	memset(m_TotalBuckets,0,sizeof(m_TotalBuckets));
+	m_nClockPid = -1;
+	m_nClockPcr = -1;
+	m_nClockNs = -1;
+	m_nStart = -1;
+	m_nBucket = -1;
+	m_nNextReport = -1;
+}
+
+void CTsAnalyzer::SetReport(int ms,const TsReportFunc& report)
+{
+	m_nReportInterval = ms > 0 ? (int64_t)ms * 1000000 : 0;
+	m_nNextReport = -1;
+	m_Report = report;
+}
+
+CTsAnalyzer::PidState* CTsAnalyzer::Slot(int pid)
+{
+	int index = m_PidSlot[pid];
+	if(index >= 0)
+		return &m_Slots[index];
+	if(m_nSlots >= TS_ANALYZER_MAX_PIDS)
+		return NULL;
+
+	//第一次出现的PID占用一个槽位，之后一直保留
+	PidState& s = m_Slots[m_nSlots];
+	memset(&s,0,sizeof(s));
+	s.health.pid = pid;
+	s.health.stream_id = -1;
+	s.last_cc = 0xff;
+	s.last_pcr = -1;
+	s.last_dts = -1;
+	m_PidSlot[pid] = m_nSlots++;
+	m_Stats.pids = m_nSlots;
+	return &s;
+}
+
+int CTsAnalyzer::Input(const unsigned char* data,size_t len,int64_t arrival)
+{
+	int total = (int)(len / TS_PACKET_SIZE);
+	bool has_arrival = arrival >= 0;
+
+	for(int i = 0; i < total; i += TS_CHECK_BATCH)
+	{
+		int n = total - i < TS_CHECK_BATCH ? total - i : TS_CHECK_BATCH;
+		const unsigned char* batch = data + (size_t)i * TS_PACKET_SIZE;
+		CTsDemuxer::CheckPackets(batch,n,m_Pids);
+		for(int k = 0; k < n; k++)
+		{
+			const unsigned char* p = batch + k * TS_PACKET_SIZE;
+			int64_t now = has_arrival ? arrival : m_nClockNs;
+
+			if(now >= 0)
+			{
+				if(m_nStart < 0)
+					m_nStart = now;
+				Advance(now);
+				m_Stats.duration = (now - m_nStart) / 1e9;
+				//定期汇总
+				if(m_nReportInterval > 0)
+				{
+					if(m_nNextReport < 0 || now - m_nNextReport > m_nReportInterval)
+						m_nNextReport = now + m_nReportInterval;
+					else if(now >= m_nNextReport)
+					{
+						m_nNextReport += m_nReportInterval;
+						if(m_Report)
+							m_Report(*this);
+					}
+				}
+			}
+
+			m_Stats.packets++;
+			if(m_Pids[k] < 0)
+			{
+				if(p[0] != TS_SYNC_BYTE)
+					m_Stats.sync_errors++;
+				else
+					m_Stats.transport_errors++;
+				continue;
+			}
+			ProcessPacket(p,m_Pids[k],now,has_arrival);
+		}
+	}
+	return total;
+}
+
+void CTsAnalyzer::Advance(int64_t now)
+{
+	int64_t b = now / TS_ANALYZER_BUCKET_NS;
+	if(m_nBucket < 0 || b < m_nBucket - TS_ANALYZER_BUCKETS)
+	{
+		//第一个包，或者时间大幅回退(如循环回放)：重新开始计时
+		memset(m_TotalBuckets,0,sizeof(m_TotalBuckets));
+		for(int i = 0; i < m_nSlots; i++)
+			memset(m_Slots[i].buckets,0,sizeof(m_Slots[i].buckets));
+		m_nBucket = b;
+		return;
+	}
+
+	while(m_nBucket < b)
+	{
+		//当前桶结束：窗口中各桶的包数之和换算成码率；从开始到现在不满一个窗口时按实际的桶数
+		int64_t filled = m_nBucket - m_nStart / TS_ANALYZER_BUCKET_NS + 1;
+		if(filled > TS_ANALYZER_BUCKETS)
+			filled = TS_ANALYZER_BUCKETS;
+		double scale = TS_PACKET_SIZE * 8.0 / (filled * TS_ANALYZER_BUCKET_MS / 1000.0);
+		uint64_t sum = 0;
+		for(int k = 0; k < TS_ANALYZER_BUCKETS; k++)
+			sum += m_TotalBuckets[k];
+		m_Stats.bitrate = sum * scale;
+		if(filled == TS_ANALYZER_BUCKETS && m_Stats.bitrate > m_Stats.bitrate_peak)
+			m_Stats.bitrate_peak = m_Stats.bitrate;
+		for(int i = 0; i < m_nSlots; i++)
+		{
+			PidState& s = m_Slots[i];
+			sum = 0;
+			for(int k = 0; k < TS_ANALYZER_BUCKETS; k++)
+				sum += s.buckets[k];
+			s.health.bitrate = sum * scale;
+			if(filled == TS_ANALYZER_BUCKETS && s.health.bitrate > s.health.bitrate_peak)
+				s.health.bitrate_peak = s.health.bitrate;
+		}
+
+		//下一个桶清零。中间超过一个窗口没有包时所有桶都清零
+		m_nBucket++;
+		if(b - m_nBucket >= TS_ANALYZER_BUCKETS)
+		{
+			memset(m_TotalBuckets,0,sizeof(m_TotalBuckets));
+			for(int i = 0; i < m_nSlots; i++)
+				memset(m_Slots[i].buckets,0,sizeof(m_Slots[i].buckets));
+			m_nBucket = b;
+			break;
+		}
+		int index = m_nBucket % TS_ANALYZER_BUCKETS;
+		m_TotalBuckets[index] = 0;
+		for(int i = 0; i < m_nSlots; i++)
+			m_Slots[i].buckets[index] = 0;
+	}
+}
+
+void CTsAnalyzer::ProcessPacket(const unsigned char* p,int pid,int64_t now,bool has_arrival)
+{
+	PidState* s = Slot(pid);
+	if(s == NULL)
+	{
+		m_Stats.untracked++;
+		return;
+	}
+	TsPidHealth& h = s->health;
+	int index = m_nBucket >= 0 ? (int)(m_nBucket % TS_ANALYZER_BUCKETS) : 0;
+	h.packets++;
+	s->buckets[index]++;
+	m_TotalBuckets[index]++;
+
+	int afc = (p[3] >> 4) & 0x03;
+	int cc = p[3] & 0x0f;
+	int off = 4;
+	bool disc = false;
+	if(afc & 0x02)
+	{
+		int aflen = p[4];
+		if(aflen > (afc == 0x02 ? 183 : 182))
+			return;
+		if(aflen > 0)
+		{
+			int flags = p[5];
+			disc = (flags & 0x80) != 0;
+			if(disc)
+				h.discontinuities++;
+			if((flags & 0x10) && aflen >= 7)
+			{
+				int64_t base = ((int64_t)p[6] << 25) | (p[7] << 17) | (p[8] << 9) | (p[9] << 1) | (p[10] >> 7);
+				int ext = ((p[10] & 0x01) << 8) | p[11];
+				OnPcr(*s,base * 300 + ext,disc,now,has_arrival);
+			}
+		}
+		off = 5 + aflen;
+	}
+	if(!(afc & 0x01) || pid == TS_NULL_PID)
+		return;
+
+	if(s->last_cc != 0xff && !disc)
+	{
+		if(cc == s->last_cc)
+		{
+			h.duplicates++;
+			return;
+		}
+		if(cc != ((s->last_cc + 1) & 0x0f))
+			h.cc_errors++;
+	}
+	s->last_cc = cc;
+	if(p[3] >> 6)
+	{
+		h.scrambled++;
+		return;
+	}
+	//只看PES开始的TS包中的PES包头，不组装PES
+	if((p[1] & 0x40) && off + 9 <= TS_PACKET_SIZE && p[off] == 0x00 && p[off + 1] == 0x00 && p[off + 2] == 0x01)
+		OnPes(*s,p + off,TS_PACKET_SIZE - off);
+}
+
+void CTsAnalyzer::OnPcr(PidState& s,int64_t pcr,bool disc,int64_t now,bool has_arrival)
+{
+	TsPidHealth& h = s.health;
+	h.pcrs++;
+	if(s.last_pcr >= 0 && !disc)
+	{
+		int64_t d = (pcr - s.last_pcr + PCR_WRAP) % PCR_WRAP;
+		if(d > PCR_WRAP / 2)
+			d -= PCR_WRAP;
+		if(d < 0 || d > (int64_t)TS_ANALYZER_PCR_DISC_MS * (PCR_HZ / 1000))
+			h.pcr_discontinuities++;
+		else
+		{
+			double ms = d / (PCR_HZ / 1000.0);
+			if(d > (int64_t)TS_ANALYZER_PCR_MAX_MS * (PCR_HZ / 1000))
+				h.pcr_interval_errors++;
+			s.pcr_interval_sum += d;
+			s.pcr_intervals++;
+			h.pcr_interval_avg = s.pcr_interval_sum / (PCR_HZ / 1000.0) / s.pcr_intervals;
+			if(ms > h.pcr_interval_max)
+				h.pcr_interval_max = ms;
+			//PCR的间隔与到达间隔之差
+			if(has_arrival)
+			{
+				double dev = fabs(ms - (now - s.last_pcr_time) / 1e6);
+				h.pcr_jitter += (dev - h.pcr_jitter) / 16;
+				if(dev > h.pcr_jitter_max)
+					h.pcr_jitter_max = dev;
+			}
+		}
+	}
+	s.last_pcr = pcr;
+	s.last_pcr_time = now;
+
+	//没有到达时刻时，第一个带PCR的PID作为时钟，跳变时时钟不前进
+	if(m_nClockPid < 0)
+	{
+		m_nClockPid = h.pid;
+		m_nClockNs = 0;
+	}
+	else if(h.pid == m_nClockPid)
+	{
+		int64_t d = (pcr - m_nClockPcr + PCR_WRAP) % PCR_WRAP;
+		if(d < PCR_HZ)
+			m_nClockNs += d * 1000 / 27;
+	}
+	if(h.pid == m_nClockPid)
+		m_nClockPcr = pcr;
+}
+
+void CTsAnalyzer::OnPes(PidState& s,const unsigned char* p,int len)
+{
+	TsPidHealth& h = s.health;
+	int sid = p[3];
+	h.stream_id = sid;
+	//没有可选包头的stream_id，见CTsDemuxer::EmitPes
+	if(sid == 0xbc || sid == 0xbe || sid == 0xbf || sid == 0xf0 || sid == 0xf1 || sid == 0xff || sid == 0xf2 || sid == 0xf8)
+		return;
+	int flags = p[7] >> 6;
+	const unsigned char* t = NULL;
+	if(flags == 0x03 && len >= 19)
+		t = p + 14;
+	else if((flags & 0x02) && len >= 14)
+		t = p + 9;
+	if(t == NULL)
+		return;
+
+	int64_t dts = ((int64_t)((t[0] >> 1) & 0x07) << 30) | (t[1] << 22) | ((t[2] >> 1) << 15) | (t[3] << 7) | (t[4] >> 1);
+	h.pes++;
+	if(s.last_dts >= 0)
+	{
+		int64_t gap = (dts - s.last_dts + PTS_WRAP) % PTS_WRAP;
+		if(gap > PTS_WRAP / 2)
+			gap -= PTS_WRAP;
+		if(gap < 0)
+			h.pes_backwards++;
+		else
+		{
+			if(gap > m_nPesGap)
+				h.pes_gaps++;
+			if(gap / 90.0 > h.pes_gap_max)
+				h.pes_gap_max = gap / 90.0;
+		}
+	}
+	s.last_dts = dts;
+}
+
+void CTsAnalyzer::Print(FILE* out) const
+{
+	fprintf(out,"[TS Health] %.1fs, packets: %llu, bitrate: %.3f Mbps, peak: %.3f Mbps, sync errors: %llu, transport errors: %llu, pids: %d, untracked: %llu\n",
+		m_Stats.duration,(unsigned long long)m_Stats.packets,m_Stats.bitrate / 1e6,m_Stats.bitrate_peak / 1e6,(unsigned long long)m_Stats.sync_errors,
+		(unsigned long long)m_Stats.transport_errors,m_Stats.pids,(unsigned long long)m_Stats.untracked);
+	fprintf(out,"   PID | SID |  PACKETS |   Mbps |   PEAK | CC ERR |  DUP | DISC |  PCRS | PCR AVG/MAX(ms) | >40ms | JUMP | JITTER/MAX(ms) |   PES | GAPS | BACK | MAX GAP(ms)\n");
+	for(int i = 0; i < m_nSlots; i++)
+	{
+		const TsPidHealth& h = m_Slots[i].health;
+		char sid[8] = "  -";
+		if(h.stream_id >= 0)
+			snprintf(sid,sizeof(sid),"x%02x",(unsigned)h.stream_id & 0xff);
+		fprintf(out,"0x%04x| %s| %9llu| %7.3f| %7.3f| %7llu| %5llu| %5llu| %6llu| %7.2f/%7.2f| %6llu| %5llu| %6.3f/%7.3f| %6llu| %5llu| %5llu| %8.1f\n",
+			h.pid,sid,(unsigned long long)h.packets,h.bitrate / 1e6,h.bitrate_peak / 1e6,(unsigned long long)h.cc_errors,
+			(unsigned long long)h.duplicates,(unsigned long long)h.discontinuities,(unsigned long long)h.pcrs,h.pcr_interval_avg,h.pcr_interval_max,
+			(unsigned long long)h.pcr_interval_errors,(unsigned long long)h.pcr_discontinuities,h.pcr_jitter,h.pcr_jitter_max,
+			(unsigned long long)h.pes,(unsigned long long)h.pes_gaps,(unsigned long long)h.pes_backwards,h.pes_gap_max);
+	}
+}
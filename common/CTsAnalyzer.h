@@ -0,0 +1,159 @@
+/*************************************************************************
+    > File Name: CTsAnalyzer.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 08时46分15秒
+ ************************************************************************/
+
+#ifndef CTS_ANALYZER_H
+#define CTS_ANALYZER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+#include "CTsDemuxer.h"
+
+//最多跟踪的PID数，超过的PID只计入untracked
+#define TS_ANALYZER_MAX_PIDS         128
+//码率滑动窗口：10个100ms的桶，即最近1秒
+#define TS_ANALYZER_BUCKETS          10
+#define TS_ANALYZER_BUCKET_MS        100
+//ETR 290：PCR间隔超过40ms为PCR_repetition_error，超过100ms或者回退(没有discontinuity_indicator)为PCR不连续
+#define TS_ANALYZER_PCR_MAX_MS       40
+#define TS_ANALYZER_PCR_DISC_MS      100
+//相邻PES的DTS(没有时为PTS)间隔超过该值记为一次时间戳空缺，毫秒
+#define TS_ANALYZER_PES_GAP_MS       500
+
+/**
+ * _TsPidHealth
+ * 一个PID的健康统计，时间单位毫秒，码率单位bps
+ */
+typedef struct _TsPidHealth
+{
+	int pid;
+	int stream_id;                //PES的stream_id，-1表示没有见过PES包头(PSI等)
+	uint64_t packets;
+	uint64_t cc_errors;           //continuity_counter不连续
+	uint64_t duplicates;
+	uint64_t discontinuities;     //适配域中的discontinuity_indicator
+	uint64_t scrambled;
+
+	uint64_t pcrs;
+	uint64_t pcr_interval_errors; //PCR间隔超过40ms
+	uint64_t pcr_discontinuities; //PCR跳变超过100ms或回退
+	double pcr_interval_avg;
+	double pcr_interval_max;
+	double pcr_jitter;            //PCR相对到达时刻的抖动(RFC 3550的平滑公式)，只在输入带到达时刻时计算
+	double pcr_jitter_max;
+
+	uint64_t pes;                 //带PTS的PES包
+	uint64_t pes_gaps;            //DTS间隔超过门限
+	uint64_t pes_backwards;       //DTS回退
+	double pes_gap_max;           //最大的DTS间隔
+
+	double bitrate;               //最近一个窗口(1秒)的码率
+	double bitrate_peak;          //各窗口码率的最大值
+}TsPidHealth;
+
+/**
+ * _TsAnalyzerStats
+ * 整个流的统计
+ */
+typedef struct _TsAnalyzerStats
+{
+	uint64_t packets;
+	uint64_t sync_errors;
+	uint64_t transport_errors;
+	uint64_t untracked;           //超过TS_ANALYZER_MAX_PIDS的PID的包
+	int pids;                     //出现过的PID数
+	double bitrate;               //整个流最近一个窗口的码率
+	double bitrate_peak;
+	double duration;              //从第一个包开始的时间，秒
+}TsAnalyzerStats;
+
+class CTsAnalyzer;
+//定期汇总的回调，在Input中调用
+typedef std::function<void(const CTsAnalyzer& analyzer)> TsReportFunc;
+
+/**
+ * MPEG-TS流健康分析：按PID统计连续计数器错误、PCR间隔和抖动、滑动窗口码率以及PES时间戳的空缺，
+ * 按ETR 290第一、二优先级中的对应项目计数。逐包处理只更新按PID索引的平坦数组中的计数器，不组装PES，
+ * 包头先用CTsDemuxer的SIMD内核成批检查。所有状态在构造时分配，之后内存不再变化。
+ * 时间基准是调用者给出的到达时刻(纳秒)，没有时(如分析文件)用第一个带PCR的PID的PCR换算，此时不计算PCR抖动
+ */
+class CTsAnalyzer
+{
+private:
+	typedef struct _PidState
+	{
+		TsPidHealth health;
+		unsigned char last_cc;        //0xff表示还没有
+		int64_t last_pcr;             //27MHz，-1表示还没有
+		int64_t last_pcr_time;        //收到上一个PCR的时刻，纳秒
+		int64_t pcr_interval_sum;     //27MHz
+		uint64_t pcr_intervals;
+		int64_t last_dts;             //90kHz，-1表示还没有
+		uint32_t buckets[TS_ANALYZER_BUCKETS];  //各桶中的包数
+	}PidState;
+
+	signed short m_PidSlot[TS_MAX_PID];       //m_Slots中的下标，-1表示还没有出现
+	PidState m_Slots[TS_ANALYZER_MAX_PIDS];
+	int m_nSlots;
+
+	int m_Pids[TS_CHECK_BATCH];
+	TsAnalyzerStats m_Stats;
+	uint32_t m_TotalBuckets[TS_ANALYZER_BUCKETS];
+
+	int m_nClockPid;              //没有到达时刻时作为时钟的PCR PID
+	int64_t m_nClockPcr;          //该PID最近的PCR，27MHz
+	int64_t m_nClockNs;           //由PCR得到的时刻，纳秒
+	int64_t m_nStart;             //第一个包的时刻
+	int64_t m_nBucket;            //当前桶的编号(时刻 / 桶长)，-1表示还没有
+	int64_t m_nPesGap;            //90kHz
+
+	int64_t m_nReportInterval;    //纳秒，0表示不汇总
+	int64_t m_nNextReport;
+	TsReportFunc m_Report;
+
+	PidState* Slot(int pid);
+	void ProcessPacket(const unsigned char* p,int pid,int64_t now,bool has_arrival);
+	void OnPcr(PidState& s,int64_t pcr,bool disc,int64_t now,bool has_arrival);
+	void OnPes(PidState& s,const unsigned char* p,int len);
+	//时间前进到now所在的桶，结算经过的桶的码率
+	void Advance(int64_t now);
+
+public:
+	CTsAnalyzer();
+	~CTsAnalyzer();
+
+	void Reset();
+
+	/**
+	 * PES时间戳空缺的门限，毫秒
+	 */
+	void SetPesGap(int ms) { m_nPesGap = (int64_t)ms * 90; }
+
+	/**
+	 * 每隔ms毫秒(按输入的时间基准)在Input中调用一次report
+	 */
+	void SetReport(int ms,const TsReportFunc& report);
+
+	/**
+	 * 输入连续的TS包
+	 * @param arrival 这些包的到达时刻，纳秒，小于0表示没有(用PCR作为时间基准)
+	 * @返回处理的TS包数
+	 */
+	int Input(const unsigned char* data,size_t len,int64_t arrival = -1);
+
+	void GetStats(TsAnalyzerStats* stats) const { *stats = m_Stats; }
+	//出现过的PID数以及按出现顺序的第i个PID的统计
+	int PidCount() const { return m_nSlots; }
+	const TsPidHealth& PidHealth(int i) const { return m_Slots[i].health; }
+
+	/**
+	 * 打印汇总表：整个流一行，之后每个PID一行
+	 */
+	void Print(FILE* out) const;
+};
+
+#endif
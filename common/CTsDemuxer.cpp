@@ -0,0 +1,611 @@
+/*************************************************************************
+    > File Name: CTsDemuxer.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 06时10分27秒
+ ************************************************************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+#include <string.h>
+#include "CTsDemuxer.h"
+
+//PES_packet_length为0(视频常见)时，PES包一直到下一个PES开始
+#define PES_UNBOUNDED        0xffffffffu
+
+CTsDemuxer::CheckFunc CTsDemuxer::s_pCheck = CTsDemuxer::Resolve;
+int CTsDemuxer::s_nKernel = TS_KERNEL_AUTO;
+
+CTsDemuxer::CTsDemuxer() : m_bFilter(false),m_nProgram(0),m_nStreams(0),m_nVideoBuf(TS_VIDEO_BUF_SIZE),m_nAudioBuf(TS_AUDIO_BUF_SIZE)
+{
+	memset(m_PidWanted,0,sizeof(m_PidWanted));
+	Reset();
+}
+
+CTsDemuxer::~CTsDemuxer()
+{
+
+}
+
+void CTsDemuxer::Reset()
+{
+	ResetStreams();
+	memset(m_PidType,PID_NONE,sizeof(m_PidType));
+	memset(m_PidStream,-1,sizeof(m_PidStream));
+	memset(m_Cc,0xff,sizeof(m_Cc));
+	m_PidType[TS_PAT_PID] = PID_PAT;
+	m_Pat.started = false;
+	m_Pmt.started = false;
+	m_nPmtPid = -1;
+	m_nPcrPid = -1;
+	m_nPatVersion = -1;
+	m_nPmtVersion = -1;
+	m_nPcr = -1;
+	memset(&m_Stats,0,sizeof(m_Stats));
+}
+
+void CTsDemuxer::SetPidFilter(const std::vector<int>& pids)
+{
+	memset(m_PidWanted,0,sizeof(m_PidWanted));
+	for(size_t i = 0; i < pids.size(); i++)
+	{
+		if(pids[i] >= 0 && pids[i] < TS_MAX_PID)
+			m_PidWanted[pids[i]] = true;
+	}
+	m_bFilter = !pids.empty();
+}
+
+void CTsDemuxer::SetBufferSize(unsigned int video,unsigned int audio)
+{
+	if(video > 0)
+		m_nVideoBuf = video;
+	if(audio > 0)
+		m_nAudioBuf = audio;
+}
+
+int CTsDemuxer::Input(const unsigned char* data,size_t len)
+{
+	int total = (int)(len / TS_PACKET_SIZE);
+
+	//先成批检查包头，得到每个包的PID，再逐包处理
+	for(int i = 0; i < total; i += TS_CHECK_BATCH)
+	{
+		int n = total - i < TS_CHECK_BATCH ? total - i : TS_CHECK_BATCH;
+		const unsigned char* batch = data + (size_t)i * TS_PACKET_SIZE;
+		CheckPackets(batch,n,m_Pids);
+		for(int k = 0; k < n; k++)
+		{
+			const unsigned char* p = batch + k * TS_PACKET_SIZE;
+			m_Stats.packets++;
+			if(m_Pids[k] < 0)
+			{
+				if(p[0] != TS_SYNC_BYTE)
+					m_Stats.sync_errors++;
+				else
+					m_Stats.transport_errors++;
+				continue;
+			}
+			ProcessPacket(p,m_Pids[k]);
+		}
+	}
+	return total;
+}
+
+void CTsDemuxer::Flush()
+{
+	for(int i = 0; i < m_nStreams; i++)
+	{
+		if(m_Streams[i].started)
+			EmitPes(m_Streams[i]);
+	}
+}
+
+void CTsDemuxer::ProcessPacket(const unsigned char* p,int pid)
+{
+	int type = m_PidType[pid];
+	int afc = (p[3] >> 4) & 0x03;
+	int cc = p[3] & 0x0f;
+	int off = 4,rai = 0;
+	bool disc = false,lost = false;
+
+	if(type == PID_NONE && pid != m_nPcrPid)
+	{
+		if(pid != TS_NULL_PID)
+			m_Stats.filtered++;
+		return;
+	}
+
+	//适配域：只有适配域时长度为183，有负载时最多182
+	if(afc & 0x02)
+	{
+		int aflen = p[4];
+		if(aflen > (afc == 0x02 ? 183 : 182))
+		{
+			m_Stats.transport_errors++;
+			return;
+		}
+		if(aflen > 0)
+		{
+			int flags = p[5];
+			disc = (flags & 0x80) != 0;
+			rai = (flags & 0x40) ? 1 : 0;
+			//PCR：33位的program_clock_reference_base(90kHz)和9位的扩展(27MHz)
+			if((flags & 0x10) && aflen >= 7)
+			{
+				int64_t base = ((int64_t)p[6] << 25) | (p[7] << 17) | (p[8] << 9) | (p[9] << 1) | (p[10] >> 7);
+				int ext = ((p[10] & 0x01) << 8) | p[11];
+				m_Stats.pcrs++;
+				if(pid == m_nPcrPid)
+					m_nPcr = base * 300 + ext;
+			}
+		}
+		off = 5 + aflen;
+	}
+	if(type == PID_NONE || !(afc & 0x01))
+		return;
+
+	//只有带负载的包continuity_counter才递增；相同的计数为重复包，丢弃；discontinuity_indicator为1时不检查
+	if(m_Cc[pid] != 0xff && !disc)
+	{
+		if(cc == m_Cc[pid])
+		{
+			m_Stats.duplicates++;
+			return;
+		}
+		if(cc != ((m_Cc[pid] + 1) & 0x0f))
+		{
+			m_Stats.cc_errors++;
+			lost = true;
+		}
+	}
+	m_Cc[pid] = cc;
+	if(p[3] >> 6)
+	{
+		m_Stats.scrambled++;
+		return;
+	}
+
+	bool pusi = (p[1] & 0x40) != 0;
+	const unsigned char* payload = p + off;
+	int len = TS_PACKET_SIZE - off;
+	if(type == PID_PAT || type == PID_PMT)
+	{
+		Section& sec = type == PID_PAT ? m_Pat : m_Pmt;
+		//丢包时正在组装的段已经不完整
+		if(lost)
+			sec.started = false;
+		OnSection(sec,payload,len,pusi,type);
+		return;
+	}
+
+	Stream& s = m_Streams[(int)m_PidStream[pid]];
+	if(lost && s.started)
+		s.discontinuity = 1;
+	if(pusi)
+	{
+		if(s.started)
+			EmitPes(s);
+		s.started = true;
+		s.size = 0;
+		s.need = 0;
+		s.pcr = m_nPcr;
+		s.random_access = rai;
+		s.discontinuity = 0;
+		s.truncated = false;
+	}
+	else if(!s.started)
+		return;
+	AppendPes(s,payload,len);
+}
+
+void CTsDemuxer::OnSection(Section& sec,const unsigned char* p,int len,bool start,int type)
+{
+	if(start)
+	{
+		//pointer_field之前的字节属于上一个段
+		int pointer = p[0];
+		if(1 + pointer > len)
+		{
+			sec.started = false;
+			return;
+		}
+		if(sec.started && pointer > 0)
+			AppendSection(sec,p + 1,pointer,type);
+		sec.started = true;
+		sec.len = 0;
+		sec.need = 0;
+		p += 1 + pointer;
+		len -= 1 + pointer;
+	}
+	else if(!sec.started)
+		return;
+	AppendSection(sec,p,len,type);
+}
+
+void CTsDemuxer::AppendSection(Section& sec,const unsigned char* p,int len,int type)
+{
+	//一个包中可以有多个段，段之后为0xFF填充
+	while(len > 0 && sec.started)
+	{
+		if(sec.len == 0 && p[0] == 0xff)
+		{
+			sec.started = false;
+			return;
+		}
+		int want = sec.need > 0 ? sec.need : 3;
+		int take = want - sec.len < len ? want - sec.len : len;
+		memcpy(sec.data + sec.len,p,take);
+		sec.len += take;
+		p += take;
+		len -= take;
+		if(sec.len < want)
+			return;
+		if(sec.need == 0)
+		{
+			//段头3字节之后才知道段长：table_id、section_length(12位)
+			sec.need = 3 + (((sec.data[1] & 0x0f) << 8) | sec.data[2]);
+			if(sec.need > TS_MAX_SECTION || sec.need < 12)
+				sec.started = false;
+			continue;
+		}
+		ParseSection(sec.data,sec.len,type);
+		sec.len = 0;
+		sec.need = 0;
+	}
+}
+
+void CTsDemuxer::ParseSection(const unsigned char* sec,int len,int type)
+{
+	m_Stats.sections++;
+	if(Crc32(sec,len) != 0)
+	{
+		m_Stats.crc_errors++;
+		return;
+	}
+	//section_syntax_indicator为1，current_next_indicator为0的段还没有生效
+	if(!(sec[1] & 0x80) || !(sec[5] & 0x01))
+		return;
+	if(type == PID_PAT && sec[0] == 0x00)
+		ParsePat(sec,len);
+	else if(type == PID_PMT && sec[0] == 0x02)
+		ParsePmt(sec,len);
+}
+
+void CTsDemuxer::ParsePat(const unsigned char* sec,int len)
+{
+	int version = (sec[5] >> 1) & 0x1f;
+	if(version == m_nPatVersion)
+		return;
+	m_nPatVersion = version;
+
+	//段头8字节之后每4字节一个节目：program_number(16位)、program_map_PID(13位)，最后4字节为CRC
+	for(int i = 8; i + 4 <= len - 4; i += 4)
+	{
+		int program = (sec[i] << 8) | sec[i + 1];
+		int pid = ((sec[i + 2] & 0x1f) << 8) | sec[i + 3];
+		//节目号0为网络信息表
+		if(program == 0 || (m_nProgram != 0 && program != m_nProgram))
+			continue;
+		if(pid != m_nPmtPid)
+		{
+			Flush();
+			ResetStreams();
+			if(m_nPmtPid >= 0)
+				m_PidType[m_nPmtPid] = PID_NONE;
+			m_nPmtPid = pid;
+			m_nPmtVersion = -1;
+			m_nPcrPid = -1;
+			m_Pmt.started = false;
+			m_PidType[pid] = PID_PMT;
+		}
+		break;
+	}
+}
+
+void CTsDemuxer::ParsePmt(const unsigned char* sec,int len)
+{
+	int program = (sec[3] << 8) | sec[4];
+	int version = (sec[5] >> 1) & 0x1f;
+	if((m_nProgram != 0 && program != m_nProgram) || version == m_nPmtVersion)
+		return;
+	m_nPmtVersion = version;
+
+	//节目的组成变了，先输出旧的基本流中未结束的PES
+	Flush();
+	ResetStreams();
+	int pcr_pid = ((sec[8] & 0x1f) << 8) | sec[9];
+	m_nPcrPid = pcr_pid == TS_NULL_PID ? -1 : pcr_pid;
+	int info = ((sec[10] & 0x0f) << 8) | sec[11];
+	//每个基本流：stream_type、elementary_PID、ES_info_length以及描述符
+	for(int i = 12 + info; i + 5 <= len - 4; )
+	{
+		int type = sec[i];
+		int pid = ((sec[i + 1] & 0x1f) << 8) | sec[i + 2];
+		int es_info = ((sec[i + 3] & 0x0f) << 8) | sec[i + 4];
+		AddStream(pid,type);
+		i += 5 + es_info;
+	}
+}
+
+int CTsDemuxer::AddStream(int pid,int type)
+{
+	if(m_nStreams >= TS_MAX_STREAMS || m_PidType[pid] != PID_NONE || pid == TS_NULL_PID)
+		return -1;
+	if(m_bFilter && !m_PidWanted[pid])
+		return -1;
+
+	//音频流用小的缓冲区，其他(视频以及不认识的类型)用大的；槽位的缓冲区保留，PMT更新后重复使用
+	bool audio = type == TS_STREAM_MPEG1_AUDIO || type == TS_STREAM_MPEG2_AUDIO || type == TS_STREAM_AAC || type == 0x11 || type == 0x81;
+	unsigned int size = audio ? m_nAudioBuf : m_nVideoBuf;
+	Stream& s = m_Streams[m_nStreams];
+	if(s.buf.size() != size)
+		s.buf.resize(size);
+	s.pid = pid;
+	s.type = type;
+	s.size = 0;
+	s.need = 0;
+	s.started = false;
+	s.pcr = -1;
+	s.random_access = 0;
+	s.discontinuity = 0;
+	s.truncated = false;
+	m_PidType[pid] = PID_PES;
+	m_PidStream[pid] = m_nStreams;
+	return m_nStreams++;
+}
+
+void CTsDemuxer::ResetStreams()
+{
+	for(int i = 0; i < m_nStreams; i++)
+	{
+		m_PidType[m_Streams[i].pid] = PID_NONE;
+		m_PidStream[m_Streams[i].pid] = -1;
+		m_Streams[i].started = false;
+	}
+	m_nStreams = 0;
+}
+
+void CTsDemuxer::AppendPes(Stream& s,const unsigned char* p,int len)
+{
+	unsigned int room = s.buf.size() - s.size;
+	if((unsigned int)len > room)
+	{
+		s.truncated = true;
+		s.discontinuity = 1;
+		len = room;
+	}
+	memcpy(&s.buf[s.size],p,len);
+	s.size += len;
+
+	//PES包头的前6字节：packet_start_code_prefix、stream_id、PES_packet_length
+	if(s.need == 0 && s.size >= 6)
+	{
+		unsigned int plen = (s.buf[4] << 8) | s.buf[5];
+		s.need = plen > 0 ? 6 + plen : PES_UNBOUNDED;
+	}
+	//长度已知的PES包收齐后立即输出，不等下一个PES开始
+	if(s.need != 0 && s.need != PES_UNBOUNDED && s.size >= s.need)
+		EmitPes(s);
+}
+
+static int64_t ParseTimestamp(const unsigned char* p)
+{
+	//33位时间戳分成3、15、15位，各段之后是一个标志位
+	return ((int64_t)((p[0] >> 1) & 0x07) << 30) | (p[1] << 22) | ((p[2] >> 1) << 15) | (p[3] << 7) | (p[4] >> 1);
+}
+
+void CTsDemuxer::EmitPes(Stream& s)
+{
+	const unsigned char* b = &s.buf[0];
+	unsigned int size = s.size;
+
+	s.started = false;
+	if(s.need != 0 && s.need != PES_UNBOUNDED && size > s.need)
+		size = s.need;
+	if(size < 6 || b[0] != 0x00 || b[1] != 0x00 || b[2] != 0x01)
+		return;
+
+	TsAccessUnit au;
+	int sid = b[3];
+	unsigned int hdr = 6;
+	au.pts = -1;
+	au.dts = -1;
+	//program_stream_map、padding_stream、private_stream_2、ECM、EMM、directory、DSMCC、H.222.1 type E没有可选包头
+	if(sid == 0xbe)
+		return;
+	if(sid != 0xbc && sid != 0xbf && sid != 0xf0 && sid != 0xf1 && sid != 0xff && sid != 0xf2 && sid != 0xf8)
+	{
+		if(size < 9 || 9u + b[8] > size)
+			return;
+		int flags = b[7] >> 6;
+		hdr = 9 + b[8];
+		if((flags & 0x02) && b[8] >= 5)
+			au.pts = ParseTimestamp(b + 9);
+		if(flags == 0x03 && b[8] >= 10)
+			au.dts = ParseTimestamp(b + 14);
+	}
+	if(au.dts < 0)
+		au.dts = au.pts;
+
+	au.pid = s.pid;
+	au.stream_type = s.type;
+	au.stream_id = sid;
+	au.pcr = s.pcr;
+	au.data = b + hdr;
+	au.size = size - hdr;
+	au.random_access = s.random_access;
+	au.discontinuity = s.discontinuity;
+	m_Stats.units++;
+	if(s.truncated)
+		m_Stats.truncated++;
+	if(m_Callback)
+		m_Callback(au);
+}
+
+uint32_t CTsDemuxer::Crc32(const unsigned char* data,int len)
+{
+	//按字节查表，表在第一次调用时生成
+	static uint32_t table[256];
+	static bool init = false;
+	if(!init)
+	{
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i << 24;
+			for(int k = 0; k < 8; k++)
+				c = (c & 0x80000000u) ? (c << 1) ^ 0x04c11db7u : (c << 1);
+			table[i] = c;
+		}
+		init = true;
+	}
+	uint32_t crc = 0xffffffffu;
+	for(int i = 0; i < len; i++)
+		crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xff];
+	return crc;
+}
+
+int CTsDemuxer::Resolve(const unsigned char* data,int count,int* pids)
+{
+	SetKernel(TS_KERNEL_AUTO);
+	return s_pCheck(data,count,pids);
+}
+
+int CTsDemuxer::SetKernel(int kernel)
+{
+	int avx2 = 0,sse2 = 0;
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+	sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	if(kernel == TS_KERNEL_AUTO)
+		kernel = avx2 ? TS_KERNEL_AVX2 : TS_KERNEL_SSE2;
+	if(kernel == TS_KERNEL_AVX2 && !avx2)
+		kernel = TS_KERNEL_SSE2;
+	if(kernel == TS_KERNEL_SSE2 && !sse2)
+		kernel = TS_KERNEL_SCALAR;
+
+	switch(kernel)
+	{
+		case TS_KERNEL_AVX2:
+			s_pCheck = CheckAvx2;
+			break;
+		case TS_KERNEL_SSE2:
+			s_pCheck = CheckSse2;
+			break;
+		default:
+			kernel = TS_KERNEL_SCALAR;
+			s_pCheck = CheckScalar;
+			break;
+	}
+	s_nKernel = kernel;
+	return kernel;
+}
+
+const char* CTsDemuxer::KernelName()
+{
+	if(s_nKernel == TS_KERNEL_AUTO)
+		SetKernel(TS_KERNEL_AUTO);
+	switch(s_nKernel)
+	{
+		case TS_KERNEL_AVX2:
+			return "avx2";
+		case TS_KERNEL_SSE2:
+			return "sse2";
+		default:
+			return "scalar";
+	}
+}
+
+int CTsDemuxer::CheckScalar(const unsigned char* data,int count,int* pids)
+{
+	int bad = 0;
+	for(int i = 0; i < count; i++)
+	{
+		const unsigned char* p = data + i * TS_PACKET_SIZE;
+		if(p[0] != TS_SYNC_BYTE || (p[1] & 0x80))
+		{
+			pids[i] = -1;
+			bad++;
+		}
+		else
+			pids[i] = ((p[1] & 0x1f) << 8) | p[2];
+	}
+	return bad;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * 向量内核：每个包的前4字节作为一个小端32位整数h(字节0在最低位)，
+ * (h & 0x80FF) == 0x47 即同步字节正确且transport_error_indicator为0，
+ * PID = (h & 0x1F00) | ((h >> 16) & 0xFF)，无效的包与全1相或得到-1
+ */
+__attribute__((target("sse2")))
+int CTsDemuxer::CheckSse2(const unsigned char* data,int count,int* pids)
+{
+	const __m128i mask = _mm_set1_epi32(0x80ff);
+	const __m128i sync = _mm_set1_epi32(TS_SYNC_BYTE);
+	const __m128i hi = _mm_set1_epi32(0x1f00);
+	const __m128i lo = _mm_set1_epi32(0xff);
+	int bad = 0,i = 0;
+
+	for(; i + 4 <= count; i += 4)
+	{
+		//SSE2没有gather，4个包头分别加载后组成一个向量
+		int h0,h1,h2,h3;
+		const unsigned char* p = data + i * TS_PACKET_SIZE;
+		memcpy(&h0,p,4);
+		memcpy(&h1,p + TS_PACKET_SIZE,4);
+		memcpy(&h2,p + 2 * TS_PACKET_SIZE,4);
+		memcpy(&h3,p + 3 * TS_PACKET_SIZE,4);
+		__m128i h = _mm_setr_epi32(h0,h1,h2,h3);
+		__m128i ok = _mm_cmpeq_epi32(_mm_and_si128(h,mask),sync);
+		__m128i pid = _mm_or_si128(_mm_and_si128(h,hi),_mm_and_si128(_mm_srli_epi32(h,16),lo));
+		pid = _mm_or_si128(pid,_mm_andnot_si128(ok,_mm_set1_epi32(-1)));
+		_mm_storeu_si128((__m128i*)(pids + i),pid);
+		bad += __builtin_popcount(~_mm_movemask_ps(_mm_castsi128_ps(ok)) & 0x0f);
+	}
+	return bad + CheckScalar(data + i * TS_PACKET_SIZE,count - i,pids + i);
+}
+
+__attribute__((target("avx2")))
+int CTsDemuxer::CheckAvx2(const unsigned char* data,int count,int* pids)
+{
+	const __m256i index = _mm256_setr_epi32(0,TS_PACKET_SIZE,2 * TS_PACKET_SIZE,3 * TS_PACKET_SIZE,
+		4 * TS_PACKET_SIZE,5 * TS_PACKET_SIZE,6 * TS_PACKET_SIZE,7 * TS_PACKET_SIZE);
+	const __m256i mask = _mm256_set1_epi32(0x80ff);
+	const __m256i sync = _mm256_set1_epi32(TS_SYNC_BYTE);
+	const __m256i hi = _mm256_set1_epi32(0x1f00);
+	const __m256i lo = _mm256_set1_epi32(0xff);
+	int bad = 0,i = 0;
+
+	for(; i + 8 <= count; i += 8)
+	{
+		//一次gather取8个包的包头
+		__m256i h = _mm256_i32gather_epi32((const int*)(data + i * TS_PACKET_SIZE),index,1);
+		__m256i ok = _mm256_cmpeq_epi32(_mm256_and_si256(h,mask),sync);
+		__m256i pid = _mm256_or_si256(_mm256_and_si256(h,hi),_mm256_and_si256(_mm256_srli_epi32(h,16),lo));
+		pid = _mm256_or_si256(pid,_mm256_andnot_si256(ok,_mm256_set1_epi32(-1)));
+		_mm256_storeu_si256((__m256i*)(pids + i),pid);
+		bad += __builtin_popcount(~_mm256_movemask_ps(_mm256_castsi256_ps(ok)) & 0xff);
+	}
+	return bad + CheckScalar(data + i * TS_PACKET_SIZE,count - i,pids + i);
+}
+
+#else
+
+int CTsDemuxer::CheckSse2(const unsigned char* data,int count,int* pids)
+{
+	return CheckScalar(data,count,pids);
+}
+
+int CTsDemuxer::CheckAvx2(const unsigned char* data,int count,int* pids)
+{
+	return CheckScalar(data,count,pids);
+}
+
+#endif
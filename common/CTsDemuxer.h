@@ -0,0 +1,238 @@
+/*************************************************************************
+    > File Name: CTsDemuxer.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 06时10分27秒
+ ************************************************************************/
+
+#ifndef CTS_DEMUXER_H
+#define CTS_DEMUXER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+#ifndef TS_PACKET_SIZE
+#define TS_PACKET_SIZE       188
+#endif
+#define TS_SYNC_BYTE         0x47
+#define TS_MAX_PID           8192
+#define TS_PAT_PID           0x0000
+#define TS_NULL_PID          0x1fff
+//一个节目最多处理的基本流个数
+#define TS_MAX_STREAMS       16
+//每批检查的TS包数
+#define TS_CHECK_BATCH       64
+//PSI段最长1024字节(section_length最大1021)
+#define TS_MAX_SECTION       1024
+//每个基本流PES缓冲区的默认大小，一个PES包(一个访问单元)超过时截断
+#define TS_VIDEO_BUF_SIZE    (2*1024*1024)
+#define TS_AUDIO_BUF_SIZE    (64*1024)
+
+//PMT中的stream_type
+#define TS_STREAM_MPEG2      0x02
+#define TS_STREAM_MPEG1_AUDIO 0x03
+#define TS_STREAM_MPEG2_AUDIO 0x04
+#define TS_STREAM_AAC        0x0f
+#define TS_STREAM_H264       0x1b
+#define TS_STREAM_H265       0x24
+
+//包头批量检查的内核种类
+enum
+{
+	TS_KERNEL_AUTO   = 0,
+	TS_KERNEL_SCALAR = 1,
+	TS_KERNEL_SSE2   = 2,   //一次检查4个包
+	TS_KERNEL_AVX2   = 3,   //一次检查8个包
+};
+
+/**
+ * _TsAccessUnit
+ * 从PES包中取出的一个基本流访问单元，数据指向解复用器内部的缓冲区，只在回调期间有效
+ */
+typedef struct _TsAccessUnit
+{
+	int pid;
+	int stream_type;              //TS_STREAM_xxx
+	int stream_id;                //PES的stream_id，如视频0xE0、音频0xC0
+	int64_t pts;                  //90kHz，没有时为-1
+	int64_t dts;                  //没有DTS时等于pts
+	int64_t pcr;                  //该PES开始时节目最近的PCR，27MHz，还没有时为-1
+	const unsigned char* data;    //PES负载(ES数据，H.264为带起始码的Annex-B，AAC为ADTS帧)
+	unsigned int size;
+	int random_access;            //PES开始的TS包适配域中random_access_indicator为1
+	int discontinuity;            //PES中间有丢包(continuity_counter不连续)、被截断或包头不完整
+}TsAccessUnit;
+
+/**
+ * _TsDemuxStats
+ * 解复用统计
+ */
+typedef struct _TsDemuxStats
+{
+	uint64_t packets;             //输入的TS包数
+	uint64_t sync_errors;         //同步字节不是0x47的包
+	uint64_t transport_errors;    //transport_error_indicator为1的包
+	uint64_t cc_errors;           //continuity_counter不连续的次数
+	uint64_t duplicates;          //重复的包(continuity_counter相同)
+	uint64_t scrambled;           //加扰的包，不处理负载
+	uint64_t sections;            //解析的PSI段(PAT/PMT)
+	uint64_t crc_errors;          //CRC32错误的PSI段
+	uint64_t pcrs;
+	uint64_t units;               //输出的访问单元
+	uint64_t truncated;           //超过缓冲区被截断的访问单元
+	uint64_t filtered;            //被PID过滤掉或者不属于所选节目的包
+}TsDemuxStats;
+
+//访问单元回调
+typedef std::function<void(const TsAccessUnit& au)> TsUnitFunc;
+
+/**
+ * MPEG-TS解复用：解析PAT/PMT，按PID把TS包的负载组装成PES包，取出PTS/DTS，从适配域中取出PCR，
+ * 每个完整的PES包作为一个访问单元回调。输入可以是任意多个连续的188字节TS包(如UDP/RTP中的7个包)，
+ * 包头(同步字节、transport_error_indicator、PID)先用SIMD成批检查，之后逐包处理。
+ * 每个基本流的PES缓冲区在PMT中出现时按类型一次分配，之后解复用不再分配内存
+ */
+class CTsDemuxer
+{
+public:
+	typedef int (*CheckFunc)(const unsigned char* data,int count,int* pids);
+
+private:
+	//PID的类型
+	enum
+	{
+		PID_NONE = 0,
+		PID_PAT  = 1,
+		PID_PMT  = 2,
+		PID_PES  = 3,
+	};
+
+	typedef struct _Section
+	{
+		unsigned char data[TS_MAX_SECTION];
+		int len;                  //已收到的字节数
+		int need;                 //整个段的字节数，0表示还不知道(只收到了段头的一部分)
+		bool started;
+	}Section;
+
+	typedef struct _Stream
+	{
+		int pid;
+		int type;
+		std::vector<unsigned char> buf;
+		unsigned int size;        //buf中已有的字节数(包括PES包头)
+		unsigned int need;        //PES_packet_length给出的整个PES包的字节数，0表示直到下一个PES开始
+		bool started;             //收到了PES的开始
+		int64_t pcr;
+		int random_access;
+		int discontinuity;
+		bool truncated;
+	}Stream;
+
+	//按PID索引的平坦数组，逐包处理时不查找
+	unsigned char m_PidType[TS_MAX_PID];
+	signed char m_PidStream[TS_MAX_PID];  //m_Streams中的下标
+	unsigned char m_Cc[TS_MAX_PID];       //上一个带负载的包的continuity_counter，0xff表示还没有
+	bool m_PidWanted[TS_MAX_PID];
+	bool m_bFilter;                       //设置了PID过滤，只输出m_PidWanted中的基本流
+
+	Section m_Pat;
+	Section m_Pmt;
+	int m_nProgram;                       //选择的节目号，0表示PAT中的第一个节目
+	int m_nPmtPid;
+	int m_nPcrPid;
+	int m_nPatVersion;
+	int m_nPmtVersion;
+	int64_t m_nPcr;
+
+	Stream m_Streams[TS_MAX_STREAMS];
+	int m_nStreams;
+	unsigned int m_nVideoBuf;
+	unsigned int m_nAudioBuf;
+
+	int m_Pids[TS_CHECK_BATCH];           //一批包检查后的PID，-1表示包头无效
+	TsDemuxStats m_Stats;
+	TsUnitFunc m_Callback;
+
+	static CheckFunc s_pCheck;
+	static int s_nKernel;
+
+	static int Resolve(const unsigned char* data,int count,int* pids);
+
+	void ProcessPacket(const unsigned char* p,int pid);
+	void OnSection(Section& sec,const unsigned char* p,int len,bool start,int type);
+	void AppendSection(Section& sec,const unsigned char* p,int len,int type);
+	void ParseSection(const unsigned char* sec,int len,int type);
+	void ParsePat(const unsigned char* sec,int len);
+	void ParsePmt(const unsigned char* sec,int len);
+	int AddStream(int pid,int type);
+	void ResetStreams();
+	void AppendPes(Stream& s,const unsigned char* p,int len);
+	void EmitPes(Stream& s);
+
+public:
+	CTsDemuxer();
+	~CTsDemuxer();
+
+	void Reset();
+
+	void SetCallback(const TsUnitFunc& cb) { m_Callback = cb; }
+
+	/**
+	 * 选择节目号，0(默认)表示PAT中的第一个节目，Reset之后生效
+	 */
+	void SetProgram(int program) { m_nProgram = program; }
+
+	/**
+	 * PID过滤：只输出这些PID的基本流；为空时输出所选节目的所有基本流
+	 */
+	void SetPidFilter(const std::vector<int>& pids);
+
+	/**
+	 * 视频、音频(以及其他)基本流PES缓冲区的大小，Reset之后生效
+	 */
+	void SetBufferSize(unsigned int video,unsigned int audio);
+
+	/**
+	 * 输入连续的TS包，不足188字节的尾部被忽略
+	 * @返回处理的TS包数
+	 */
+	int Input(const unsigned char* data,size_t len);
+
+	/**
+	 * 输出各基本流中还没有结束的PES包(输入结束时调用)
+	 */
+	void Flush();
+
+	void GetStats(TsDemuxStats* stats) const { *stats = m_Stats; }
+	int64_t Pcr() const { return m_nPcr; }
+	int PmtPid() const { return m_nPmtPid; }
+	int PcrPid() const { return m_nPcrPid; }
+
+	/**
+	 * 成批检查count个连续TS包的包头：同步字节为0x47且transport_error_indicator为0时pids[i]为PID，否则为-1
+	 * @返回无效的包数
+	 */
+	static inline int CheckPackets(const unsigned char* data,int count,int* pids)
+	{
+		return s_pCheck(data,count,pids);
+	}
+
+	/**
+	 * 指定包头检查的内核，CPU不支持时退回到可用的内核
+	 * @返回实际使用的内核
+	 */
+	static int SetKernel(int kernel);
+	static const char* KernelName();
+
+	static int CheckScalar(const unsigned char* data,int count,int* pids);
+	static int CheckSse2(const unsigned char* data,int count,int* pids);
+	static int CheckAvx2(const unsigned char* data,int count,int* pids);
+
+	//MPEG-2 CRC32(多项式0x04C11DB7)，PSI段包括CRC在内的结果为0
+	static uint32_t Crc32(const unsigned char* data,int len);
+};
+
+#endif
@@ -0,0 +1,415 @@
+/*************************************************************************
+    > File Name: CTsMuxer.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 07时02分41秒
+ ************************************************************************/
+
+#include <string.h>
+#include "CTsMuxer.h"
+
+//PTS/DTS/PCR的base都是33位
+#define TS_MUX_TIME_MASK     0x1ffffffffLL
+
+static const unsigned char s_StartCode[4] = { 0x00,0x00,0x00,0x01 };
+//H.264在TS中要求每个访问单元以AUD开始，primary_pic_type为7(任意片类型)
+static const unsigned char s_Aud[6] = { 0x00,0x00,0x00,0x01,0x09,0xf0 };
+
+CTsMuxer::CTsMuxer() : m_nLastPsi(-1),m_nPatCc(0),m_nPmtCc(0),m_nVideoCc(0),m_nAudioCc(0),m_bRtp(false),m_nSsrc(0),m_nSeq(0),
+	m_nRtpTs(0),m_nTime(0),m_nPerDatagram(TS_MUX_PACKETS_PER_DATAGRAM),m_nPackets(0),m_nSegments(0)
+{
+	memset(&m_Stats,0,sizeof(m_Stats));
+	SetPsiInterval(TS_MUX_PSI_INTERVAL);
+	SetDelay(TS_MUX_DELAY);
+	SetPids(1,TS_MUX_PMT_PID,TS_MUX_VIDEO_PID,TS_MUX_AUDIO_PID);
+}
+
+CTsMuxer::~CTsMuxer()
+{
+
+}
+
+void CTsMuxer::SetPids(int program,int pmt,int video,int audio)
+{
+	m_nProgram = program;
+	m_nPmtPid = pmt & 0x1fff;
+	m_nVideoPid = video & 0x1fff;
+	m_nAudioPid = audio < 0 ? -1 : (audio & 0x1fff);
+	BuildPsi();
+	m_nLastPsi = -1;
+}
+
+void CTsMuxer::SetPsiInterval(int ms)
+{
+	m_nPsiInterval = (int64_t)ms * 90;
+}
+
+void CTsMuxer::SetDelay(int ms)
+{
+	m_nDelay = (int64_t)ms * 90;
+}
+
+void CTsMuxer::SetPacketsPerDatagram(int n)
+{
+	if(n < 1)
+		n = 1;
+	if(n > TS_MUX_PACKETS_PER_DATAGRAM)
+		n = TS_MUX_PACKETS_PER_DATAGRAM;
+	Flush();
+	m_nPerDatagram = n;
+}
+
+void CTsMuxer::SetRtp(bool enable,uint32_t ssrc)
+{
+	Flush();
+	m_bRtp = enable;
+	m_nSsrc = ssrc;
+}
+
+//TS包头，带负载
+static void WriteTsHeader(unsigned char* p,int pid,bool pusi,bool af,unsigned char cc)
+{
+	p[0] = TS_SYNC_BYTE;
+	p[1] = (pusi ? 0x40 : 0x00) | ((pid >> 8) & 0x1f);
+	p[2] = pid & 0xff;
+	p[3] = (af ? 0x30 : 0x10) | (cc & 0x0f);
+}
+
+//一个段放在一个TS包中：pointer_field为0，段之后用0xFF填满
+static void WriteSectionPacket(unsigned char* p,int pid,const unsigned char* sec,int len)
+{
+	WriteTsHeader(p,pid,true,false,0);
+	p[4] = 0x00;
+	memcpy(p + 5,sec,len);
+	memset(p + 5 + len,0xff,TS_PACKET_SIZE - 5 - len);
+}
+
+void CTsMuxer::BuildPsi()
+{
+	unsigned char sec[TS_PACKET_SIZE];
+	int len;
+	uint32_t crc;
+
+	//PAT：一个节目
+	len = 0;
+	sec[len++] = 0x00;                             //table_id
+	sec[len++] = 0xb0;                             //section_syntax_indicator，section_length在后面填
+	sec[len++] = 0x00;
+	sec[len++] = 0x00;                             //transport_stream_id
+	sec[len++] = 0x01;
+	sec[len++] = 0xc1;                             //version 0，current_next_indicator 1
+	sec[len++] = 0x00;                             //section_number
+	sec[len++] = 0x00;                             //last_section_number
+	sec[len++] = (m_nProgram >> 8) & 0xff;
+	sec[len++] = m_nProgram & 0xff;
+	sec[len++] = 0xe0 | (m_nPmtPid >> 8);
+	sec[len++] = m_nPmtPid & 0xff;
+	sec[2] = len + 4 - 3;
+	crc = CTsDemuxer::Crc32(sec,len);
+	sec[len++] = crc >> 24;
+	sec[len++] = crc >> 16;
+	sec[len++] = crc >> 8;
+	sec[len++] = crc;
+	WriteSectionPacket(m_Pat,TS_PAT_PID,sec,len);
+
+	//PMT：PCR在视频PID上，没有节目描述符和基本流描述符
+	len = 0;
+	sec[len++] = 0x02;
+	sec[len++] = 0xb0;
+	sec[len++] = 0x00;
+	sec[len++] = (m_nProgram >> 8) & 0xff;
+	sec[len++] = m_nProgram & 0xff;
+	sec[len++] = 0xc1;
+	sec[len++] = 0x00;
+	sec[len++] = 0x00;
+	sec[len++] = 0xe0 | (m_nVideoPid >> 8);        //PCR_PID
+	sec[len++] = m_nVideoPid & 0xff;
+	sec[len++] = 0xf0;                             //program_info_length为0
+	sec[len++] = 0x00;
+	sec[len++] = TS_STREAM_H264;
+	sec[len++] = 0xe0 | (m_nVideoPid >> 8);
+	sec[len++] = m_nVideoPid & 0xff;
+	sec[len++] = 0xf0;
+	sec[len++] = 0x00;
+	if(m_nAudioPid >= 0)
+	{
+		sec[len++] = TS_STREAM_AAC;
+		sec[len++] = 0xe0 | (m_nAudioPid >> 8);
+		sec[len++] = m_nAudioPid & 0xff;
+		sec[len++] = 0xf0;
+		sec[len++] = 0x00;
+	}
+	sec[2] = len + 4 - 3;
+	crc = CTsDemuxer::Crc32(sec,len);
+	sec[len++] = crc >> 24;
+	sec[len++] = crc >> 16;
+	sec[len++] = crc >> 8;
+	sec[len++] = crc;
+	WriteSectionPacket(m_Pmt,m_nPmtPid,sec,len);
+}
+
+unsigned char* CTsMuxer::NextPacket()
+{
+	if(m_nPackets == 0)
+		m_nRtpTs = (uint32_t)(m_nTime + m_nDelay);
+	return m_Datagram + TS_MUX_RTP_HEADER + m_nPackets * TS_PACKET_SIZE;
+}
+
+void CTsMuxer::PacketDone()
+{
+	m_Stats.packets++;
+	if(++m_nPackets >= m_nPerDatagram)
+		Flush();
+}
+
+void CTsMuxer::Flush()
+{
+	if(m_nPackets == 0)
+		return;
+
+	unsigned char* p = m_Datagram + TS_MUX_RTP_HEADER;
+	int len = m_nPackets * TS_PACKET_SIZE;
+	if(m_bRtp)
+	{
+		//RFC 2250：负载类型33，marker为0，时间戳为90kHz
+		p -= TS_MUX_RTP_HEADER;
+		len += TS_MUX_RTP_HEADER;
+		p[0] = 0x80;
+		p[1] = TS_MUX_RTP_PT;
+		p[2] = m_nSeq >> 8;
+		p[3] = m_nSeq & 0xff;
+		p[4] = m_nRtpTs >> 24;
+		p[5] = m_nRtpTs >> 16;
+		p[6] = m_nRtpTs >> 8;
+		p[7] = m_nRtpTs;
+		p[8] = m_nSsrc >> 24;
+		p[9] = m_nSsrc >> 16;
+		p[10] = m_nSsrc >> 8;
+		p[11] = m_nSsrc;
+		m_nSeq++;
+	}
+	m_nPackets = 0;
+	m_Stats.datagrams++;
+	if(m_Output)
+		m_Output(p,len);
+}
+
+void CTsMuxer::WritePsi(int64_t time,bool force)
+{
+	//音频与视频交错时时间戳会略微回退，回退超过1秒(如循环发送)时重新计时
+	if(!force && m_nLastPsi >= 0 && time - m_nLastPsi < m_nPsiInterval && m_nLastPsi - time < 90000)
+		return;
+	m_nLastPsi = time;
+
+	//预先生成的包只改写连续计数器
+	unsigned char* p = NextPacket();
+	memcpy(p,m_Pat,TS_PACKET_SIZE);
+	p[3] = (p[3] & 0xf0) | m_nPatCc;
+	m_nPatCc = (m_nPatCc + 1) & 0x0f;
+	PacketDone();
+
+	p = NextPacket();
+	memcpy(p,m_Pmt,TS_PACKET_SIZE);
+	p[3] = (p[3] & 0xf0) | m_nPmtCc;
+	m_nPmtCc = (m_nPmtCc + 1) & 0x0f;
+	PacketDone();
+	m_Stats.psi++;
+}
+
+//PTS/DTS的5字节编码，prefix为'0010'(只有PTS)、'0011'(PTS)或'0001'(DTS)
+static void WriteTimestamp(unsigned char* p,int prefix,int64_t ts)
+{
+	ts &= TS_MUX_TIME_MASK;
+	p[0] = (prefix << 4) | (((ts >> 30) & 0x07) << 1) | 0x01;
+	p[1] = (ts >> 22) & 0xff;
+	p[2] = (((ts >> 15) & 0x7f) << 1) | 0x01;
+	p[3] = (ts >> 7) & 0xff;
+	p[4] = ((ts & 0x7f) << 1) | 0x01;
+}
+
+int CTsMuxer::BuildPesHeader(int stream_id,uint64_t payload,int64_t pts,int64_t dts,const unsigned char* prefix,int prefix_len)
+{
+	unsigned char* p = m_PesHeader;
+	bool has_dts = dts != pts;
+	int hdr_len = has_dts ? 10 : 5;
+
+	p[0] = 0x00;
+	p[1] = 0x00;
+	p[2] = 0x01;
+	p[3] = stream_id;
+	//PES_packet_length超过16位时为0，只有视频允许
+	uint64_t plen = 3 + hdr_len + prefix_len + payload;
+	if(plen > 0xffff)
+		plen = 0;
+	p[4] = (plen >> 8) & 0xff;
+	p[5] = plen & 0xff;
+	p[6] = 0x80;                                   //'10'，data_alignment_indicator等为0
+	p[7] = has_dts ? 0xc0 : 0x80;
+	p[8] = hdr_len;
+	WriteTimestamp(p + 9,has_dts ? 0x03 : 0x02,pts + m_nDelay);
+	if(has_dts)
+		WriteTimestamp(p + 14,0x01,dts + m_nDelay);
+	if(prefix_len > 0)
+		memcpy(p + 9 + hdr_len,prefix,prefix_len);
+	return 9 + hdr_len + prefix_len;
+}
+
+void CTsMuxer::WritePes(int pid,unsigned char& cc,int64_t pcr,bool rai)
+{
+	uint64_t left = 0;
+	for(int i = 0; i < m_nSegments; i++)
+		left += m_Segments[i].len;
+
+	int seg = 0;
+	unsigned int seg_off = 0;
+	bool first = true;
+	while(left > 0)
+	{
+		unsigned char* p = NextPacket();
+		unsigned char af[8];
+		int af_len = -1;                           //适配域长度字段的值，-1表示没有适配域
+		int af_flags_len = 0;
+
+		//第一个包的适配域：random_access_indicator和PCR
+		if(first && (pcr >= 0 || rai))
+		{
+			af[0] = (rai ? 0x40 : 0x00) | (pcr >= 0 ? 0x10 : 0x00);
+			af_flags_len = 1;
+			if(pcr >= 0)
+			{
+				int64_t base = (pcr / 300) & TS_MUX_TIME_MASK;
+				int ext = pcr % 300;
+				af[1] = (base >> 25) & 0xff;
+				af[2] = (base >> 17) & 0xff;
+				af[3] = (base >> 9) & 0xff;
+				af[4] = (base >> 1) & 0xff;
+				af[5] = ((base & 0x01) << 7) | 0x7e | ((ext >> 8) & 0x01);
+				af[6] = ext & 0xff;
+				af_flags_len = 7;
+				m_Stats.pcrs++;
+			}
+			af_len = af_flags_len;
+		}
+
+		int room = TS_PACKET_SIZE - 4 - (af_len >= 0 ? 1 + af_len : 0);
+		//最后一个包的负载不满时用适配域填充
+		if(left < (uint64_t)room)
+		{
+			int stuff = room - (int)left;
+			if(af_len < 0)
+			{
+				af_len = stuff - 1;
+				if(af_len > 0)
+				{
+					af[0] = 0x00;
+					af_flags_len = 1;
+				}
+			}
+			else
+				af_len += stuff;
+			room = (int)left;
+			m_Stats.stuffing += stuff;
+		}
+
+		WriteTsHeader(p,pid,first,af_len >= 0,cc);
+		cc = (cc + 1) & 0x0f;
+		unsigned char* q = p + 4;
+		if(af_len >= 0)
+		{
+			*q++ = af_len;
+			memcpy(q,af,af_flags_len);
+			memset(q + af_flags_len,0xff,af_len - af_flags_len);
+			q += af_len;
+		}
+
+		//按段拷贝负载
+		int n = room;
+		while(n > 0)
+		{
+			const Segment& s = m_Segments[seg];
+			unsigned int take = s.len - seg_off < (unsigned int)n ? s.len - seg_off : (unsigned int)n;
+			memcpy(q,s.data + seg_off,take);
+			q += take;
+			n -= take;
+			seg_off += take;
+			if(seg_off == s.len)
+			{
+				seg++;
+				seg_off = 0;
+			}
+		}
+		left -= room;
+		first = false;
+		PacketDone();
+	}
+}
+
+//Annex-B数据的第一个NALU是否为AUD
+static bool StartsWithAud(const unsigned char* data,unsigned int size)
+{
+	unsigned int i = 0;
+	while(i < size && i < 4 && data[i] == 0x00)
+		i++;
+	return i >= 2 && i + 1 < size && data[i] == 0x01 && (data[i + 1] & 0x1f) == 9;
+}
+
+int CTsMuxer::WriteVideo(const unsigned char* data,unsigned int size,int64_t pts,int64_t dts,bool key)
+{
+	if(data == NULL || size == 0)
+		return 0;
+
+	bool aud = StartsWithAud(data,size);
+	m_nTime = dts;
+	WritePsi(dts,key);
+	m_Segments[0].data = m_PesHeader;
+	m_Segments[0].len = BuildPesHeader(0xe0,size,pts,dts,s_Aud,aud ? 0 : sizeof(s_Aud));
+	m_Segments[1].data = data;
+	m_Segments[1].len = size;
+	m_nSegments = 2;
+	WritePes(m_nVideoPid,m_nVideoCc,dts * 300,key);
+	m_Stats.video_units++;
+	return 1;
+}
+
+int CTsMuxer::WriteVideo(const NaluView* nalus,int count,int64_t pts,int64_t dts,bool key)
+{
+	if(count <= 0 || 1 + 2 * count > TS_MUX_MAX_SEGMENTS)
+		return 0;
+
+	bool aud = nalus[0].nal_unit_type == 9;
+	uint64_t size = 0;
+	m_nSegments = 1;
+	for(int i = 0; i < count; i++)
+	{
+		m_Segments[m_nSegments].data = s_StartCode;
+		m_Segments[m_nSegments++].len = sizeof(s_StartCode);
+		m_Segments[m_nSegments].data = nalus[i].data;
+		m_Segments[m_nSegments++].len = nalus[i].len;
+		size += sizeof(s_StartCode) + nalus[i].len;
+	}
+	m_nTime = dts;
+	WritePsi(dts,key);
+	m_Segments[0].data = m_PesHeader;
+	m_Segments[0].len = BuildPesHeader(0xe0,size,pts,dts,s_Aud,aud ? 0 : sizeof(s_Aud));
+	WritePes(m_nVideoPid,m_nVideoCc,dts * 300,key);
+	m_Stats.video_units++;
+	return 1;
+}
+
+int CTsMuxer::WriteAudio(const unsigned char* data,unsigned int size,int64_t pts)
+{
+	//音频的PES包必须给出PES_packet_length
+	if(m_nAudioPid < 0 || data == NULL || size == 0 || size > 0xffff - 8)
+		return 0;
+
+	m_nTime = pts;
+	WritePsi(pts,false);
+	m_Segments[0].data = m_PesHeader;
+	m_Segments[0].len = BuildPesHeader(0xc0,size,pts,pts,NULL,0);
+	m_Segments[1].data = data;
+	m_Segments[1].len = size;
+	m_nSegments = 2;
+	WritePes(m_nAudioPid,m_nAudioCc,-1,false);
+	m_Stats.audio_units++;
+	return 1;
+}
@@ -0,0 +1,165 @@
+/*************************************************************************
+    > File Name: CTsMuxer.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 07时02分41秒
+ ************************************************************************/
+
+#ifndef CTS_MUXER_H
+#define CTS_MUXER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+#include "CAnnexbScanner.h"
+#include "CTsDemuxer.h"
+
+//默认的PID，与ffmpeg的mpegts封装一致
+#define TS_MUX_PMT_PID           0x1000
+#define TS_MUX_VIDEO_PID         0x0100
+#define TS_MUX_AUDIO_PID         0x0101
+//默认每个UDP包7个TS包(7*188=1316字节，加上RTP包头不超过以太网MTU)
+#define TS_MUX_PACKETS_PER_DATAGRAM 7
+//默认PAT/PMT的间隔，毫秒。关键帧之前总是插入PAT/PMT
+#define TS_MUX_PSI_INTERVAL      100
+//默认PTS/DTS相对PCR的延迟，毫秒，留给接收端的解码缓冲
+#define TS_MUX_DELAY             700
+//一个PES包最多的数据段数(PES包头以及每个NALU的起始码和数据)
+#define TS_MUX_MAX_SEGMENTS      512
+//RTP封装(RFC 2250)的包头长度和负载类型
+#define TS_MUX_RTP_HEADER        12
+#define TS_MUX_RTP_PT            33
+
+/**
+ * _TsMuxStats
+ * 封装统计
+ */
+typedef struct _TsMuxStats
+{
+	uint64_t packets;             //输出的TS包数
+	uint64_t datagrams;           //输出的UDP(RTP)包数
+	uint64_t psi;                 //插入PAT/PMT的次数
+	uint64_t pcrs;
+	uint64_t video_units;
+	uint64_t audio_units;
+	uint64_t stuffing;            //适配域中的填充字节数
+}TsMuxStats;
+
+//输出一个UDP包的负载(可能带RTP包头)，数据只在回调期间有效
+typedef std::function<void(const unsigned char* data,int len)> TsOutputFunc;
+
+/**
+ * MPEG-TS封装：把H.264(Annex-B)访问单元和AAC(ADTS)帧封装成PES包，再切分成188字节的TS包。
+ * 按间隔以及在每个关键帧之前插入PAT/PMT，视频PID的每个PES包的第一个TS包带PCR，
+ * H.264访问单元前面没有AUD时补上。TS包直接写入一个UDP包的缓冲区，每满7个(可设置)输出一次，
+ * 可以加上负载类型33的RTP包头。PAT/PMT在设置PID时生成，之后只改写连续计数器；
+ * PES包头写在固定的缓冲区中，访问单元数据按段从调用者的内存中直接拷入TS包，封装过程不分配内存
+ */
+class CTsMuxer
+{
+private:
+	typedef struct _Segment
+	{
+		const unsigned char* data;
+		unsigned int len;
+	}Segment;
+
+	int m_nProgram;
+	int m_nPmtPid;
+	int m_nVideoPid;
+	int m_nAudioPid;              //小于0表示没有音频
+	int64_t m_nPsiInterval;       //单位1/90000秒
+	int64_t m_nLastPsi;           //上次插入PAT/PMT时的时间戳，-1表示还没有
+	int64_t m_nDelay;             //单位1/90000秒
+
+	unsigned char m_Pat[TS_PACKET_SIZE];
+	unsigned char m_Pmt[TS_PACKET_SIZE];
+	unsigned char m_nPatCc;
+	unsigned char m_nPmtCc;
+	unsigned char m_nVideoCc;
+	unsigned char m_nAudioCc;
+
+	bool m_bRtp;
+	uint32_t m_nSsrc;
+	uint16_t m_nSeq;
+	uint32_t m_nRtpTs;            //当前UDP包的RTP时间戳：第一个TS包写入时正在封装的单元的DTS
+	int64_t m_nTime;              //正在封装的单元的DTS
+
+	unsigned char m_Datagram[TS_MUX_RTP_HEADER + TS_MUX_PACKETS_PER_DATAGRAM * TS_PACKET_SIZE];
+	int m_nPerDatagram;
+	int m_nPackets;               //m_Datagram中已有的TS包数
+
+	unsigned char m_PesHeader[32];  //PES包头以及补上的AUD
+	Segment m_Segments[TS_MUX_MAX_SEGMENTS];
+	int m_nSegments;
+
+	TsOutputFunc m_Output;
+	TsMuxStats m_Stats;
+
+	//生成PAT/PMT所在的TS包
+	void BuildPsi();
+	//UDP包缓冲区中下一个TS包的位置
+	unsigned char* NextPacket();
+	//一个TS包写完，UDP包满时输出
+	void PacketDone();
+	void WritePsi(int64_t time,bool force);
+	//写PES包头(以及prefix)，返回包头长度
+	int BuildPesHeader(int stream_id,uint64_t payload,int64_t pts,int64_t dts,const unsigned char* prefix,int prefix_len);
+	//把m_Segments中的PES包切分成TS包
+	void WritePes(int pid,unsigned char& cc,int64_t pcr,bool rai);
+
+public:
+	CTsMuxer();
+	~CTsMuxer();
+
+	/**
+	 * 设置节目号和PID，audio小于0表示只有视频
+	 */
+	void SetPids(int program,int pmt,int video,int audio);
+	/**
+	 * PAT/PMT的插入间隔，毫秒
+	 */
+	void SetPsiInterval(int ms);
+	/**
+	 * PTS/DTS相对PCR的延迟，毫秒
+	 */
+	void SetDelay(int ms);
+	/**
+	 * 每个UDP包中的TS包数，1~7
+	 */
+	void SetPacketsPerDatagram(int n);
+	/**
+	 * 是否加上RTP包头(负载类型33)
+	 */
+	void SetRtp(bool enable,uint32_t ssrc);
+	void SetOutput(const TsOutputFunc& output) { m_Output = output; }
+
+	/**
+	 * 封装一个H.264访问单元
+	 * @param data 带起始码的Annex-B数据
+	 * @param pts/dts 单位1/90000秒
+	 * @param key 关键帧，之前插入PAT/PMT，并设置random_access_indicator
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int WriteVideo(const unsigned char* data,unsigned int size,int64_t pts,int64_t dts,bool key);
+	/**
+	 * 封装一个H.264访问单元，NALU数据不连续时使用(如CAccessUnitAssembler输出的访问单元)，每个NALU前写4字节起始码
+	 */
+	int WriteVideo(const NaluView* nalus,int count,int64_t pts,int64_t dts,bool key);
+	/**
+	 * 封装AAC帧(一个或多个带ADTS头的帧)
+	 * @param pts 单位1/90000秒
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int WriteAudio(const unsigned char* data,unsigned int size,int64_t pts);
+
+	/**
+	 * 输出不满的UDP包。每满SetPacketsPerDatagram个TS包才自动输出一个UDP包，按帧定时发送时应在每帧之后调用，
+	 * 否则一帧最后的几个TS包要等到下一帧才发出；不调用时UDP包少而满，但到达时刻晚一个帧间隔。结束时也要调用
+	 */
+	void Flush();
+
+	void GetStats(TsMuxStats* stats) const { *stats = m_Stats; }
+};
+
+#endif
@@ -0,0 +1,250 @@
+/*************************************************************************
+    > File Name: CUdpIngest.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 07时58分36秒
+ ************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <vector>
+#include "CUdpIngest.h"
+
+CUdpIngest::CUdpIngest() : m_nThreads(1),m_bPin(false),m_nRcvBuf(UDP_INGEST_SOCK_BUF),m_nActualRcvBuf(0),m_pWorkers(NULL),m_nOpened(0),m_bRunning(false)
+{
+
+}
+
+CUdpIngest::~CUdpIngest()
+{
+	Close();
+}
+
+void CUdpIngest::SetThreads(int threads)
+{
+	if(threads < 1)
+		threads = 1;
+	if(threads > UDP_INGEST_MAX_THREADS)
+		threads = UDP_INGEST_MAX_THREADS;
+	m_nThreads = threads;
+}
+
+int CUdpIngest::Open(const char* ip,int port)
+{
+	struct sockaddr_in addr;
+
+	Close();
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET,ip,&addr.sin_addr) != 1)
+	{
+		printf("%s: ====haoge====invalid address %s\n",__FUNCTION__,ip);
+		return 0;
+	}
+
+	m_pWorkers = new Worker[m_nThreads];
+	for(m_nOpened = 0; m_nOpened < m_nThreads; m_nOpened++)
+	{
+		Worker& w = m_pWorkers[m_nOpened];
+		int on = 1;
+		w.fd = socket(AF_INET,SOCK_DGRAM,0);
+		if(w.fd < 0)
+		{
+			printf("%s: ====haoge====socket error: %s\n",__FUNCTION__,strerror(errno));
+			CloseSockets();
+			return 0;
+		}
+		//SO_RCVBUFFORCE不受net.core.rmem_max限制，没有权限时退回SO_RCVBUF
+		if(setsockopt(w.fd,SOL_SOCKET,SO_RCVBUFFORCE,&m_nRcvBuf,sizeof(m_nRcvBuf)) != 0)
+			setsockopt(w.fd,SOL_SOCKET,SO_RCVBUF,&m_nRcvBuf,sizeof(m_nRcvBuf));
+		//每个包带上套接字累计的丢包数以及内核的到达时刻
+		setsockopt(w.fd,SOL_SOCKET,SO_RXQ_OVFL,&on,sizeof(on));
+		setsockopt(w.fd,SOL_SOCKET,SO_TIMESTAMPNS,&on,sizeof(on));
+		if(m_nThreads > 1 && setsockopt(w.fd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on)) != 0)
+		{
+			printf("%s: ====haoge====SO_REUSEPORT error: %s\n",__FUNCTION__,strerror(errno));
+			close(w.fd);
+			CloseSockets();
+			return 0;
+		}
+		//接收超时，让接收线程定期检查是否停止
+		struct timeval tv = { 0,UDP_INGEST_POLL_MS * 1000 };
+		setsockopt(w.fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+		if(bind(w.fd,(struct sockaddr*)&addr,sizeof(addr)) != 0)
+		{
+			printf("%s: ====haoge====bind %s:%d error: %s\n",__FUNCTION__,ip,port,strerror(errno));
+			close(w.fd);
+			CloseSockets();
+			return 0;
+		}
+		w.packets = 0;
+		w.bytes = 0;
+		w.batches = 0;
+		w.truncated = 0;
+		w.drops = 0;
+		w.last_drops = 0;
+	}
+
+	socklen_t len = sizeof(m_nActualRcvBuf);
+	getsockopt(m_pWorkers[0].fd,SOL_SOCKET,SO_RCVBUF,&m_nActualRcvBuf,&len);
+	return 1;
+}
+
+int CUdpIngest::Start()
+{
+	if(m_pWorkers == NULL || m_nOpened != m_nThreads || m_bRunning)
+		return 0;
+	m_bRunning = true;
+	for(int i = 0; i < m_nThreads; i++)
+		m_pWorkers[i].thread = std::thread(&CUdpIngest::Loop,this,i);
+	return 1;
+}
+
+void CUdpIngest::Stop()
+{
+	if(!m_bRunning)
+		return;
+	m_bRunning = false;
+	for(int i = 0; i < m_nThreads; i++)
+	{
+		if(m_pWorkers[i].thread.joinable())
+			m_pWorkers[i].thread.join();
+	}
+}
+
+void CUdpIngest::CloseSockets()
+{
+	for(int i = 0; i < m_nOpened; i++)
+		close(m_pWorkers[i].fd);
+	m_nOpened = 0;
+	delete[] m_pWorkers;
+	m_pWorkers = NULL;
+}
+
+void CUdpIngest::Close()
+{
+	Stop();
+	CloseSockets();
+}
+
+void CUdpIngest::GetStats(UdpIngestStats* stats) const
+{
+	memset(stats,0,sizeof(UdpIngestStats));
+	for(int i = 0; i < m_nOpened; i++)
+	{
+		const Worker& w = m_pWorkers[i];
+		stats->packets += w.packets.load(std::memory_order_relaxed);
+		stats->bytes += w.bytes.load(std::memory_order_relaxed);
+		stats->batches += w.batches.load(std::memory_order_relaxed);
+		stats->truncated += w.truncated.load(std::memory_order_relaxed);
+		stats->drops += w.drops.load(std::memory_order_relaxed);
+	}
+}
+
+void CUdpIngest::Loop(int index)
+{
+	Worker& w = m_pWorkers[index];
+
+	if(m_bPin)
+	{
+		cpu_set_t set;
+		int cores = (int)std::thread::hardware_concurrency();
+		CPU_ZERO(&set);
+		CPU_SET(index % (cores > 0 ? cores : 1),&set);
+		pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+	}
+
+	//一批包的缓冲区在线程开始时分配，接收时只重置长度
+	size_t ctrl = CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec));
+	std::vector<unsigned char> bufs(UDP_INGEST_BATCH * UDP_INGEST_PKT_SIZE);
+	std::vector<unsigned char> ctrls(UDP_INGEST_BATCH * ctrl);
+	std::vector<struct mmsghdr> msgs(UDP_INGEST_BATCH);
+	std::vector<struct iovec> iovs(UDP_INGEST_BATCH);
+	std::vector<struct sockaddr_in> addrs(UDP_INGEST_BATCH);
+	for(int i = 0; i < UDP_INGEST_BATCH; i++)
+	{
+		iovs[i].iov_base = &bufs[i * UDP_INGEST_PKT_SIZE];
+		iovs[i].iov_len = UDP_INGEST_PKT_SIZE;
+	}
+
+	UdpPacket pkt;
+	pkt.worker = index;
+	while(m_bRunning)
+	{
+		for(int i = 0; i < UDP_INGEST_BATCH; i++)
+		{
+			memset(&msgs[i],0,sizeof(struct mmsghdr));
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			msgs[i].msg_hdr.msg_control = &ctrls[i * ctrl];
+			msgs[i].msg_hdr.msg_controllen = ctrl;
+		}
+		//MSG_WAITFORONE：等到第一个包之后不再阻塞，取走已经到达的包就返回
+		int n = recvmmsg(w.fd,&msgs[0],UDP_INGEST_BATCH,MSG_WAITFORONE,NULL);
+		if(n <= 0)
+		{
+			if(m_Idle)
+				m_Idle(index);
+			continue;
+		}
+
+		uint64_t bytes = 0,truncated = 0;
+		for(int i = 0; i < n; i++)
+		{
+			struct msghdr& hdr = msgs[i].msg_hdr;
+			pkt.data = (const unsigned char*)iovs[i].iov_base;
+			pkt.len = msgs[i].msg_len;
+			pkt.truncated = (hdr.msg_flags & MSG_TRUNC) ? 1 : 0;
+			pkt.from = addrs[i];
+			pkt.arrival = -1;
+			for(struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm != NULL; cm = CMSG_NXTHDR(&hdr,cm))
+			{
+				if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS)
+				{
+					struct timespec ts;
+					memcpy(&ts,CMSG_DATA(cm),sizeof(ts));
+					pkt.arrival = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+				}
+			}
+			//内核没有给出时间戳时用当前时刻
+			if(pkt.arrival < 0)
+			{
+				struct timespec ts;
+				clock_gettime(CLOCK_REALTIME,&ts);
+				pkt.arrival = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+			}
+			bytes += pkt.len;
+			truncated += pkt.truncated;
+			if(m_Callback)
+				m_Callback(pkt);
+		}
+
+		//SO_RXQ_OVFL是累计值，只需要看一批中的最后一个包
+		for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msgs[n - 1].msg_hdr); cm != NULL; cm = CMSG_NXTHDR(&msgs[n - 1].msg_hdr,cm))
+		{
+			if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL)
+			{
+				uint32_t drops;
+				memcpy(&drops,CMSG_DATA(cm),sizeof(drops));
+				w.drops.fetch_add((uint32_t)(drops - w.last_drops),std::memory_order_relaxed);
+				w.last_drops = drops;
+			}
+		}
+		w.packets.fetch_add(n,std::memory_order_relaxed);
+		w.bytes.fetch_add(bytes,std::memory_order_relaxed);
+		w.batches.fetch_add(1,std::memory_order_relaxed);
+		w.truncated.fetch_add(truncated,std::memory_order_relaxed);
+	}
+}
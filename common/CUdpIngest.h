@@ -0,0 +1,145 @@
+/*************************************************************************
+    > File Name: CUdpIngest.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 07时58分36秒
+ ************************************************************************/
+
+#ifndef CUDP_INGEST_H
+#define CUDP_INGEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+//一次recvmmsg最多接收的包数
+#define UDP_INGEST_BATCH         64
+//每个包缓冲区的大小，超过时包被截断
+#define UDP_INGEST_PKT_SIZE      2048
+//默认的套接字接收缓冲区大小
+#define UDP_INGEST_SOCK_BUF      (16*1024*1024)
+//最多的接收线程数
+#define UDP_INGEST_MAX_THREADS   64
+//接收超时，Stop之后接收线程最多这么久退出，毫秒
+#define UDP_INGEST_POLL_MS       100
+
+/**
+ * _UdpPacket
+ * 收到的一个UDP包，数据指向接收线程的包缓冲区，只在回调期间有效
+ */
+typedef struct _UdpPacket
+{
+	const unsigned char* data;
+	int len;
+	int truncated;                //包超过UDP_INGEST_PKT_SIZE被截断
+	int worker;                   //接收线程的编号，0 ~ 线程数-1
+	int64_t arrival;              //内核记录的到达时刻(SO_TIMESTAMPNS，CLOCK_REALTIME)，纳秒
+	struct sockaddr_in from;
+}UdpPacket;
+
+/**
+ * _UdpIngestStats
+ * 接收统计，多个线程时为各线程之和
+ */
+typedef struct _UdpIngestStats
+{
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t batches;             //recvmmsg返回包的次数，packets / batches为平均每次接收的包数
+	uint64_t truncated;
+	uint64_t drops;               //内核因接收缓冲区满丢弃的包(SO_RXQ_OVFL)
+}UdpIngestStats;
+
+//包回调，多个接收线程时在各线程中并发调用，同一线程内按接收顺序调用
+typedef std::function<void(const UdpPacket& pkt)> UdpPacketFunc;
+//空闲回调，接收线程UDP_INGEST_POLL_MS内没有收到包时在该线程中调用，参数为接收线程的编号
+typedef std::function<void(int worker)> UdpIdleFunc;
+
+/**
+ * UDP接收引擎：每个接收线程一个套接字，用recvmmsg一次接收一批包到预先分配的缓冲区，逐包回调，
+ * 接收路径上不打印日志、不分配内存，统计用各线程自己的原子计数器，由其他线程定期读取后输出。
+ * 多个线程时各套接字设置SO_REUSEPORT绑定同一个地址和端口，内核按源地址和端口把每个流固定分给其中一个套接字，
+ * 同一个流的包总在同一个线程中按顺序处理，线程可以各自绑定到一个CPU核
+ */
+class CUdpIngest
+{
+private:
+	typedef struct _Worker
+	{
+		int fd;
+		std::thread thread;
+		std::atomic<uint64_t> packets;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> batches;
+		std::atomic<uint64_t> truncated;
+		std::atomic<uint64_t> drops;
+		uint32_t last_drops;      //SO_RXQ_OVFL给出的是套接字累计的丢包数
+	}Worker;
+
+	int m_nThreads;
+	bool m_bPin;
+	int m_nRcvBuf;
+	int m_nActualRcvBuf;          //内核实际分配的接收缓冲区
+	Worker* m_pWorkers;
+	int m_nOpened;
+	std::atomic<bool> m_bRunning;
+	UdpPacketFunc m_Callback;
+	UdpIdleFunc m_Idle;
+
+	//接收线程
+	void Loop(int index);
+	void CloseSockets();
+
+public:
+	CUdpIngest();
+	~CUdpIngest();
+
+	/**
+	 * 接收线程数，大于1时使用SO_REUSEPORT，Open之前设置
+	 */
+	void SetThreads(int threads);
+	/**
+	 * 接收线程是否绑定CPU核，第i个线程绑定到第i个核(超过核数时取余)
+	 */
+	void SetPinCores(bool pin) { m_bPin = pin; }
+	/**
+	 * 套接字接收缓冲区大小，有CAP_NET_ADMIN权限时不受net.core.rmem_max限制
+	 */
+	void SetRcvBuf(int bytes) { m_nRcvBuf = bytes; }
+	void SetCallback(const UdpPacketFunc& cb) { m_Callback = cb; }
+	/**
+	 * 接收超时时的回调，用于在流量停止或很低时输出积攒的状态，Start之前设置
+	 */
+	void SetIdleCallback(const UdpIdleFunc& cb) { m_Idle = cb; }
+
+	/**
+	 * 创建并绑定套接字
+	 * @param ip 绑定的地址，如"0.0.0.0"、"127.0.0.1"
+	 * @param port 端口
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Open(const char* ip,int port);
+
+	/**
+	 * 启动接收线程
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Start();
+
+	/**
+	 * 停止接收线程并等待退出，之后可以再次Start
+	 */
+	void Stop();
+
+	void Close();
+
+	bool IsRunning() const { return m_bRunning; }
+	int Threads() const { return m_nThreads; }
+	int RcvBuf() const { return m_nActualRcvBuf; }
+	void GetStats(UdpIngestStats* stats) const;
+};
+
+#endif
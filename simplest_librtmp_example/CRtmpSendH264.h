@@ -12,29 +12,16 @@
 #include "libRTMP/librtmp/log.h"
 #include "libRTMP/librtmp/rtmp.h"
 #include "CNetByteOper.h"
+#include "../common/CAnnexbScanner.h"
+#include "../common/CAccessUnitAssembler.h"
+#include "../common/CNaluIndex.h"
 
 //定义包头长度，RTMP_MAX_HEADER_SIZE=18
 #define RTMP_HEAD_SIZE   (sizeof(RTMPPacket) + RTMP_MAX_HEADER_SIZE)
 
-//存储Nal单元数据的buffer大小
+//每次通过回调函数读取的数据大小
 #define BUFFER_SIZE 32768
 
-//搜寻Nal单元时的一些标志
-#define GOT_A_NAL_CROSS_BUFFER         BUFFER_SIZE+1
-#define GOT_A_NAL_INCLUDE_A_BUFFER     BUFFER_SIZE+2
-#define NO_MORE_BUFFER_TO_READ         BUFFER_SIZE+3
-
-
-/**
- * _NaluUnit
- * 内部结构体。该结构体主要用于存储和传递Nal单元的类型、大小和数据
- */ 
-typedef struct _NaluUnit  
-{
-	int type;
-	int size;
-	unsigned char *data;
-}NaluUnit;
 
 /**
  * _RTMPMetadata
@@ -74,31 +61,23 @@ enum
 class CRtmpSendH264
 {
 private:
-	unsigned int m_nFileBufSize;     //从文件读取数据存放到内存的缓冲大小
-	unsigned int nalhead_pos;        //记录每次寻找NALU起始码的开始位置
 	RTMP* m_pRtmp;                   //RTMP协议对象
 	RTMPMetadata metaData;           //h264视频数据封装
-	unsigned char* m_pFileBuf;       //从文件读取数据存放的缓冲
-	unsigned char* m_pFileBuf_tmp;   //存放寻找到的NALU
-	unsigned char* m_pFileBuf_tmp_old; //used for realloc
+	CAnnexbScanner m_Scanner;        //通过回调函数按块读取或映射整个文件，查找NALU
+	CAccessUnitAssembler m_Assembler;//把NALU组成访问单元(帧)，并给出时间戳
 
 private:
 	/**
-	 * H264的NAL起始码防竞争机制
-	 * @param buf SPS数据内容
-	 * @无返回值
-	*/
-	void de_emulation_prevention(BYTE* buf,unsigned int* buf_size);
+	 * 保存访问单元中的SPS和PPS，SPS变化时更新图像宽、高和帧率
+	 * @param au 访问单元
+	 */
+	void UpdateSpsPps(const AccessUnit& au);
 
 	/**
-	 * 解码SPS,获取视频图像宽、高信息
-	 * @param buf SPS数据内容
-	 * @param nLen SPS数据的长度
-	 * @param width 图像宽度
-	 * @param height 图像高度
+	 * 依次取得访问单元并按DTS发送，扫描器和组装器已经准备好
 	 * @成功则返回 1 , 失败则返回 0
 	 */
-	int h264_decode_sps(BYTE* buf,unsigned int nLen,int& width,int& height,int& fps);
+	int SendAccessUnits();
 
 	/**
 	 * 发送RTMP数据包
@@ -112,13 +91,12 @@ private:
 
 	/**
 	 * 发送H264数据帧
-	 * @param data 存储数据帧内容
-	 * @param size 数据帧的大小
-	 * @param bIsKeyFrame 记录该帧是否为关键帧
-	 * @param nTimeStamp 当前帧的时间戳
+	 * @param au 访问单元，一帧的所有片放入同一个RTMP消息
+	 * @param nTimeStamp 当前帧的时间戳(DTS)
+	 * @param nCompositionTime PTS与DTS的差，单位毫秒
 	 * @成功则返回 1 , 失败则返回 0
 	*/
-	int SendH264Packet(unsigned char* data,unsigned int size,int bIsKeyFrame,unsigned int nTimeStamp);
+	int SendH264Packet(const AccessUnit& au,unsigned int nTimeStamp,int nCompositionTime);
 
 	/**
 	 * 发送视频的sps和pps信息
@@ -130,31 +108,6 @@ private:
 	*/
 	int SendVideoSpsPps(unsigned char* pps,int pps_len,unsigned char* sps,int sps_len);
 
-    /**
-	 * 从内存中读取出第一个Nal单元
-	 * @param nalu 存储nalu数据
-	 *
-	 * @param read_buffer 回调函数，当数据不足的时候，系统会自动调用该函数获取输入数据.
-	 * 2个参数功能：
-	 * uint8_t *buf：外部数据送至该地址
-	 * int buf_size：外部数据大小
-	 * 返回值：成功读取的内存大小
-	 * @成功则返回 1 , 失败则返回 0
-	*/
-	int ReadFirstNaluFromBuf(NaluUnit& nalu,int (*read_buffer)(uint8_t *buf, int buf_size));
-
-	/**
-	 * 从内存中读取出一个Nal单元
-	 * @param nalu 存储nalu数据
-	 * @param read_buffer 回调函数，当数据不足的时候，系统会自动调用该函数获取输入数据.
-	 * 2个参数功能：
-	 * uint8_t* buf：外部数据送至该地址
-	 * int buf_size：外部数据大小
-	 * 返回值：成功读取的内存大小
-	 * @成功则返回 1 , 失败则返回 0
-	*/
-	int ReadOneNaluFromBuf(NaluUnit& nalu,int (*read_buffer)(uint8_t* buf, int buf_size));
-
 public:
 	CRtmpSendH264();
 	~CRtmpSendH264();
@@ -179,6 +132,14 @@ public:
 	 */
 	int RTMPH264_Send(int (*read_buffer)(unsigned char* buf, int buf_size));
 
+	/**
+	 * 将H.264码流文件利用RTMP协议发送到服务器，可以借助索引文件(xxx.h264.idx)从指定时间开始发送
+	 * @param fn 码流文件名
+	 * @param start_sec 起始时间(秒)，从该时间之前最近的IDR开始发送，为0时从头发送
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int RTMPH264_SendFile(const char* fn,double start_sec);
+
 	/**
 	 * 断开连接，释放相关的资源
 	*/
@@ -0,0 +1,176 @@
+/*************************************************************************
+    > File Name: simplest_bitreader_bench.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 15时02分36秒
+ ************************************************************************/
+
+#include <time.h>
+#include <vector>
+#include "CNetByteOper.h"
+#include "../common/CBitReader.h"
+
+//码流中字段组的个数，每组字段的组成与片头/SPS中常见的字段类似
+#define BENCH_GROUPS  200000
+//重复解析的次数
+#define BENCH_ROUNDS  20
+
+enum FieldType
+{
+	FIELD_U1 = 0,
+	FIELD_U4,
+	FIELD_U8,
+	FIELD_U32,
+	FIELD_UE,
+	FIELD_SE
+};
+
+//一组字段依次为：first_mb(ue) slice_type(ue) pps_id(ue) frame_num(u4) flag(u1) qp_delta(se) level(u8) tick(u32) ref_idx(ue)
+static const int s_Group[] = {FIELD_UE,FIELD_UE,FIELD_UE,FIELD_U4,FIELD_U1,FIELD_SE,FIELD_U8,FIELD_U32,FIELD_UE};
+#define GROUP_FIELDS (int)(sizeof(s_Group) / sizeof(s_Group[0]))
+
+//生成测试码流的简单写位器
+class CBitWriter
+{
+public:
+	std::vector<uint8_t> m_Buf;
+	uint64_t m_nBits;
+
+	CBitWriter() : m_nBits(0) {}
+
+	void Put(uint32_t val,int n)
+	{
+		for(int i = n - 1; i >= 0; i--)
+		{
+			if((m_nBits & 7) == 0)
+				m_Buf.push_back(0);
+			if((val >> i) & 1)
+				m_Buf.back() |= 0x80 >> (m_nBits & 7);
+			m_nBits++;
+		}
+	}
+
+	void PutUe(uint32_t val)
+	{
+		uint64_t v = (uint64_t)val + 1;
+		int len = 64 - __builtin_clzll(v);
+		Put(0,len - 1);
+		Put((uint32_t)v,len);
+	}
+
+	void PutSe(int32_t val)
+	{
+		PutUe(val > 0 ? 2 * val - 1 : -2 * val);
+	}
+};
+
+static uint32_t s_nSeed = 12345;
+static uint32_t Rand()
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return s_nSeed >> 8;
+}
+
+//大部分ue值很小，偶尔出现较大的值
+static uint32_t RandUe()
+{
+	uint32_t r = Rand();
+	if((r & 15) == 0)
+		return Rand() & 0xfffff;
+	return r % 40;
+}
+
+static double NowSec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t ParseOld(BYTE* buf,UINT len)
+{
+	uint64_t sum = 0;
+	UINT StartBit = 0;
+	for(int g = 0; g < BENCH_GROUPS; g++)
+	{
+		for(int f = 0; f < GROUP_FIELDS; f++)
+		{
+			switch(s_Group[f])
+			{
+				case FIELD_U1:  sum += CNetByteOper::u(1,buf,StartBit); break;
+				case FIELD_U4:  sum += CNetByteOper::u(4,buf,StartBit); break;
+				case FIELD_U8:  sum += CNetByteOper::u(8,buf,StartBit); break;
+				case FIELD_U32: sum += (uint32_t)CNetByteOper::u(32,buf,StartBit); break;
+				case FIELD_UE:  sum += CNetByteOper::Ue(buf,len,StartBit); break;
+				case FIELD_SE:  sum += CNetByteOper::Se(buf,len,StartBit); break;
+			}
+		}
+	}
+	return sum;
+}
+
+static uint64_t ParseNew(const uint8_t* buf,unsigned int len)
+{
+	uint64_t sum = 0;
+	CBitReader br(buf,len);
+	for(int g = 0; g < BENCH_GROUPS; g++)
+	{
+		for(int f = 0; f < GROUP_FIELDS; f++)
+		{
+			switch(s_Group[f])
+			{
+				case FIELD_U1:  sum += br.u1(); break;
+				case FIELD_U4:  sum += br.u(4); break;
+				case FIELD_U8:  sum += br.u(8); break;
+				case FIELD_U32: sum += br.u(32); break;
+				case FIELD_UE:  sum += br.Ue(); break;
+				case FIELD_SE:  sum += br.Se(); break;
+			}
+		}
+	}
+	return sum;
+}
+
+int main()
+{
+	CBitWriter bw;
+	uint64_t expect = 0;
+	for(int g = 0; g < BENCH_GROUPS; g++)
+	{
+		for(int f = 0; f < GROUP_FIELDS; f++)
+		{
+			uint32_t v;
+			int32_t s;
+			switch(s_Group[f])
+			{
+				case FIELD_U1:  v = Rand() & 1;    bw.Put(v,1);  expect += v; break;
+				case FIELD_U4:  v = Rand() & 15;   bw.Put(v,4);  expect += v; break;
+				case FIELD_U8:  v = Rand() & 255;  bw.Put(v,8);  expect += v; break;
+				case FIELD_U32: v = Rand() * 977;  bw.Put(v,32); expect += v; break;
+				case FIELD_UE:  v = RandUe();      bw.PutUe(v);  expect += v; break;
+				case FIELD_SE:  s = (int32_t)(Rand() % 53) - 26; bw.PutSe(s); expect += s; break;
+			}
+		}
+	}
+
+	UINT len = bw.m_Buf.size();
+	double bits = (double)bw.m_nBits * BENCH_ROUNDS;
+	double fields = (double)BENCH_GROUPS * GROUP_FIELDS * BENCH_ROUNDS;
+	printf("bitstream: %u bytes, %d fields x %d rounds\n",len,BENCH_GROUPS * GROUP_FIELDS,BENCH_ROUNDS);
+
+	uint64_t sum = 0;
+	double t = NowSec();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		sum = ParseOld(&bw.m_Buf[0],len);
+	t = NowSec() - t;
+	printf("  %-12s %s  %8.1f Mbit/s  %8.1f Mfield/s\n","CNetByteOper",sum == expect ? "ok  " : "FAIL",bits / t / 1e6,fields / t / 1e6);
+
+	t = NowSec();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		sum = ParseNew(&bw.m_Buf[0],len);
+	t = NowSec() - t;
+	printf("  %-12s %s  %8.1f Mbit/s  %8.1f Mfield/s\n","CBitReader",sum == expect ? "ok  " : "FAIL",bits / t / 1e6,fields / t / 1e6);
+
+	return 0;
+}
+
@@ -24,7 +24,7 @@ static int read_buffer1(unsigned char *buf, int buf_size )
 		return -1;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	//发布本地H264视频到RTMP服务器的URL
 	const char* publicUrl = "rtmp://10.0.142.118:1935/zhongjihao/myh264";
@@ -36,8 +36,11 @@ int main()
 	pRtmpH264->RTMPH264_Connect(RTMP_LOGALL,publicUrl,logfile);
 
 	printf("======haoge=====RTMPDump send h264 nalu start...\n");
-	//向RTMP服务器推流
-	pRtmpH264->RTMPH264_Send(read_buffer1);
+	//向RTMP服务器推流。用法: ./rtmppushh264 [码流文件 [起始时间(秒)]]，指定文件时借助索引文件跳转到起始时间之前最近的IDR
+	if(argc > 1)
+		pRtmpH264->RTMPH264_SendFile(argv[1],argc > 2 ? atof(argv[2]) : 0);
+	else
+		pRtmpH264->RTMPH264_Send(read_buffer1);
 
 	printf("======haoge=====RTMPDump send h264 nalu done...\n");
     //断开RTMP连接并释放相关资源
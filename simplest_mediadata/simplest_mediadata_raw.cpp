@@ -470,6 +470,15 @@ int main()
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <math.h>
+#include <mutex>
+#include "../common/CAnnexbScanner.h"
+#include "../common/CNaluIndex.h"
+#include "../common/CChunkScanner.h"
+#include "../common/CH264Stats.h"
+#include "../common/CTsDemuxer.h"
+#include "../common/CUdpIngest.h"
+#include "../common/CTsAnalyzer.h"
+#include "../common/CPcapReader.h"
 
 /////////////////////////////RGB、YUV像素数据处理///////////////////////////////////////
 
@@ -1526,252 +1535,192 @@ typedef enum{
 	NALU_PRIORITY_HIGHEST    = 3
 }NaluPriority;
 
-typedef struct{
-	int startcodeprefix_len;          //! 4 for parameter sets and first slice in picture, 3 for everything else (suggested)
-	unsigned int len;                 //! Length of the NAL unit (Excluding the start code, which does not belong to the NALU)
-	unsigned int max_size;            //! Nal Unit Buffer size
-	int forbidden_bit;                //! should be always FALSE
-	int nal_reference_idc;            //! NALU_PRIORITY_xxxx
-	int nal_unit_type;                //! NALU_TYPE_xxxx
-	char *buf;                        //! contains the first byte followed by the EBSP
-}NALU_t;
-
-static FILE* h264bitstream = NULL;    //the bit stream file
-static int info2 = 0, info3 = 0;
-
-static int FindStartCode2(unsigned char *Buf)
-{
-	if(Buf[0]!=0 || Buf[1]!=0 || Buf[2] !=1)
-		return 0; //0x000001?
-	else
-		return 1;
-}
-
-static int FindStartCode3(unsigned char *Buf)
+//打印NALU表中的一行
+static void print_nalu_row(FILE* myout,int nal_num,const NaluView* n)
 {
-	if(Buf[0]!=0 || Buf[1]!=0 || Buf[2] !=0 || Buf[3] !=1)
-		return 0;//0x00000001?
-	else
-		return 1;
-}
-
-static int GetAnnexbNALU(NALU_t *nalu)
-{
-	int pos = 0;
-	int StartCodeFound,rewind;
-	unsigned char *Buf;
-
-	if((Buf = (unsigned char*)calloc(nalu->max_size,sizeof(char))) == NULL)
-		printf("%s: Could not allocate Buf memory\n",__FUNCTION__);
-
-	nalu->startcodeprefix_len = 3;
-	if(3 != fread(Buf,1,3,h264bitstream))
-	{
-		free(Buf);
-		return 0;
-	}
+	char type_str[20] = {0};
 
-//先找3字节的startCode
-	info2 = FindStartCode2(Buf);
-	if(info2 != 1)    //不是3字节的StartCode
-	{
-		if(1 != fread(Buf+3,1,1,h264bitstream))
-		{
-			free(Buf);
-			return 0;
-		}
-        //再找4字节的StartCode
-		info3 = FindStartCode3(Buf);
-		if(info3 != 1)
-		{
-            //未找到4字节的StartCode
-			free(Buf);
-			return -1;
-		}
-		else
-		{
-            //找到4字节的StartCode
-			pos = 4;
-			nalu->startcodeprefix_len = 4;
-		}
-	}
-	else //找到3字节的StartCode
+	switch(n->nal_unit_type)
 	{
-		nalu->startcodeprefix_len = 3;
-		pos = 3;
+		case NALU_TYPE_SLICE:
+			sprintf(type_str,"SLICE");
+			break;
+		case NALU_TYPE_DPA:
+			sprintf(type_str,"DPA");
+			break;
+		case NALU_TYPE_DPB:
+			sprintf(type_str,"DPB");
+			break;
+		case NALU_TYPE_DPC:
+			sprintf(type_str,"DPC");
+			break;
+		case NALU_TYPE_IDR:
+			sprintf(type_str,"IDR");
+			break;
+		case NALU_TYPE_SEI:
+			sprintf(type_str,"SEI");
+			break;
+		case NALU_TYPE_SPS:
+			sprintf(type_str,"SPS");
+			break;
+		case NALU_TYPE_PPS:
+			sprintf(type_str,"PPS");
+			break;
+		case NALU_TYPE_AUD:
+			sprintf(type_str,"AUD");
+			break;
+		case NALU_TYPE_EOSEQ:
+			sprintf(type_str,"EOSEQ");
+			break;
+		case NALU_TYPE_EOSTREAM:
+			sprintf(type_str,"EOSTREAM");
+			break;
+		case NALU_TYPE_FILL:
+			sprintf(type_str,"FILL");
+			break;
 	}
 
-    //printf("==========haoge=====info2: %d   info3: %d   pos: %d  startcodeprefix_len: %d\n",info2,info3,pos,nalu->startcodeprefix_len);
-
-	StartCodeFound = 0;
-	info2 = 0;
-	info3 = 0;
-
-    //找到StartCode后，查找相邻的下一个StartCode的位置
-	while(!StartCodeFound)
+	char idc_str[20] = {0};
+	switch(n->nal_reference_idc >>5)
 	{
-		if(feof(h264bitstream))
-		{
-			nalu->len = (pos-1)-nalu->startcodeprefix_len;
-			memcpy(nalu->buf,&Buf[nalu->startcodeprefix_len],nalu->len);
-			nalu->forbidden_bit = nalu->buf[0] & 0x80; //1 bit
-			nalu->nal_reference_idc = nalu->buf[0] & 0x60; // 2 bit
-			nalu->nal_unit_type = (nalu->buf[0]) & 0x1f;// 5 bit
-			free(Buf);
-			return pos-1;
-		}
-
-		Buf[pos++] = fgetc(h264bitstream);
-		info3 = FindStartCode3(&Buf[pos-4]);
-		if(info3 != 1)
-			info2 = FindStartCode2(&Buf[pos-3]);
-		StartCodeFound = (info2 == 1 || info3 == 1);
-	}
-
-	// Here, we have found another start code and read length of startcode bytes more than we should
-    // have.  Hence, go back in the file
-    rewind = (info3 == 1)? -4 : -3;
-
-    //将文件指针重新定位到刚找到的StartCode的位置上
-    if(0 != fseek(h264bitstream,rewind,SEEK_CUR))
-    {
-		free(Buf);
-		printf("%s: Cannot fseek in the bit stream file",__FUNCTION__);
+		case NALU_PRIORITY_DISPOSABLE:
+			sprintf(idc_str,"DISPOS");
+			break;
+		case NALU_PRIRITY_LOW:
+			sprintf(idc_str,"LOW");
+			break;
+		case NALU_PRIORITY_HIGH:
+			sprintf(idc_str,"HIGH");
+			break;
+		case NALU_PRIORITY_HIGHEST:
+			sprintf(idc_str,"HIGHEST");
+			break;
 	}
 
-	// Here the Start code, the complete NALU, and the next start code is in the Buf.
-    // The size of Buf is pos, pos+rewind are the number of bytes excluding the next
-    // start code, and (pos+rewind)-startcodeprefix_len is the size of the NALU excluding the start code
-
-	nalu->len = (pos+rewind)-nalu->startcodeprefix_len;//NALU的大小，包括一个字节NALU头和EBSP数据
-	memcpy(nalu->buf,&Buf[nalu->startcodeprefix_len], nalu->len);//从StartCode之后开始拷贝NALU字节流数据
-	nalu->forbidden_bit = nalu->buf[0] & 0x80; //1 bit,提取NALU头中的forbidden_bit (禁止位)
-	nalu->nal_reference_idc = nalu->buf[0] & 0x60; // 2 bit，提取NALU头中的nal_reference_bit (优先级)
-	nalu->nal_unit_type = (nalu->buf[0]) & 0x1f;// 5 bit,提取NALU头中的nal_unit_type (NAL类型)
-	free(Buf);
-
-	return (pos+rewind);
+	fprintf(myout,"%5d| %8d| %7s| %6s| %8d|\n",nal_num,(int)n->offset,idc_str,type_str,n->len);
 }
 
 /**
 * Analysis H.264 Bitstream
 * @param url Location of input H.264 bitstream file.
+* @param threads 大于1时文件分块在多个线程中查找起始码，再按顺序拼接，结果与顺序查找相同
 */
-static int simplest_h264_parser(const char *url)
+static int simplest_h264_parser(const char *url,int threads = 1)
 {
-	NALU_t *n;
-	int buffersize = 100000;
+	CAnnexbScanner scanner;
+	CChunkScanner chunk_scanner;
+	CNaluIndex index;
+	NaluView nalu;
+	NaluView* n = &nalu;
 
 	//FILE *myout=fopen("output_log.txt","w+");
 	FILE *myout = stdout;
-	h264bitstream = fopen(url, "r+");
-	if(h264bitstream == NULL)
+	int nal_num = 0;
+
+	//码流文件旁边有未过期的索引文件(由h264index建立)时直接从索引输出NALU表，不需要扫描码流；
+	//否则码流文件映射到内存,逐个取得NALU视图,不再逐字节读文件和拷贝NALU
+	bool from_index = index.Load(url);
+	bool chunked = !from_index && threads > 1 && chunk_scanner.Open(url);
+	if(!from_index && !chunked && !scanner.Open(url))
 	{
 		printf("%s: Open file error\n",__FUNCTION__);
 		return 0;
 	}
 
-	n = (NALU_t*)calloc(1,sizeof(NALU_t));
-	if(n == NULL)
+	printf("-----+-------- NALU Table ------+---------+\n");
+	printf(" NUM |    POS  |    IDC |  TYPE |   LEN   |\n");
+	printf("-----+---------+--------+-------+---------+\n");
+
+	if(from_index)
 	{
-		printf("%s: Alloc NALU Error\n",__FUNCTION__);
+		memset(&nalu,0,sizeof(nalu));
+		for(uint32_t i = 0; i < index.NaluCount(); i++)
+		{
+			NaluIndexEntry e = index.Nalu(i);
+			nalu.offset = e.offset;
+			nalu.len = e.len;
+			nalu.startcodeprefix_len = e.startcodeprefix_len;
+			nalu.nal_reference_idc = e.nal_reference_idc << 5;
+			nalu.nal_unit_type = e.nal_unit_type;
+			print_nalu_row(myout,nal_num++,n);
+		}
 		return 0;
 	}
 
-	n->max_size = buffersize;
-	n->buf = (char*)calloc(buffersize,sizeof(char));
-	if(n->buf == NULL)
+	if(chunked)
 	{
-		free(n);
-		printf("%s: AllocNALU: n->buf",__FUNCTION__);
+		chunk_scanner.SetThreads(threads);
+		chunk_scanner.Run(CChunkScanner::AnnexbNext,[&](const unsigned char* data,const ChunkUnit& unit) {
+			const unsigned char* header = data + unit.offset + unit.prefix_len;
+			nalu.data = header;
+			nalu.offset = unit.offset;
+			nalu.len = unit.len;
+			nalu.startcodeprefix_len = unit.prefix_len;
+			nalu.nal_reference_idc = unit.len ? (header[0] & 0x60) : 0;
+			nalu.nal_unit_type = unit.len ? (header[0] & 0x1f) : 0;
+			print_nalu_row(myout,nal_num++,n);
+		});
 		return 0;
 	}
 
-	int data_offset = 0;
-	int nal_num = 0;
-	printf("-----+-------- NALU Table ------+---------+\n");
-	printf(" NUM |    POS  |    IDC |  TYPE |   LEN   |\n");
-	printf("-----+---------+--------+-------+---------+\n");
-
-	while(!feof(h264bitstream))
+	while(scanner.Next(nalu))
 	{
-		int data_lenth;
-		data_lenth = GetAnnexbNALU(n);
-		char type_str[20] = {0};
+		print_nalu_row(myout,nal_num,n);
+		nal_num++;
+	}
 
-		switch(n->nal_unit_type)
-		{
-			case NALU_TYPE_SLICE:
-				sprintf(type_str,"SLICE");
-				break;
-			case NALU_TYPE_DPA:
-				sprintf(type_str,"DPA");
-				break;
-			case NALU_TYPE_DPB:
-				sprintf(type_str,"DPB");
-				break;
-			case NALU_TYPE_DPC:
-				sprintf(type_str,"DPC");
-				break;
-			case NALU_TYPE_IDR:
-				sprintf(type_str,"IDR");
-				break;
-			case NALU_TYPE_SEI:
-				sprintf(type_str,"SEI");
-				break;
-			case NALU_TYPE_SPS:
-				sprintf(type_str,"SPS");
-				break;
-			case NALU_TYPE_PPS:
-				sprintf(type_str,"PPS");
-				break;
-			case NALU_TYPE_AUD:
-				sprintf(type_str,"AUD");
-				break;
-			case NALU_TYPE_EOSEQ:
-				sprintf(type_str,"EOSEQ");
-				break;
-			case NALU_TYPE_EOSTREAM:
-				sprintf(type_str,"EOSTREAM");
-				break;
-			case NALU_TYPE_FILL:
-				sprintf(type_str,"FILL");
-				break;
-		}
+	scanner.Close();
 
-		char idc_str[20] = {0};
-		switch(n->nal_reference_idc >>5)
-		{
-			case NALU_PRIORITY_DISPOSABLE:
-				sprintf(idc_str,"DISPOS");
-				break;
-			case NALU_PRIRITY_LOW:
-				sprintf(idc_str,"LOW");
-				break;
-			case NALU_PRIORITY_HIGH:
-				sprintf(idc_str,"HIGH");
-				break;
-			case NALU_PRIORITY_HIGHEST:
-				sprintf(idc_str,"HIGHEST");
-				break;
-		}
+	return 0;
+}
 
-		fprintf(myout,"%5d| %8d| %7s| %6s| %8d|\n",nal_num,data_offset,idc_str,type_str,n->len);
-		data_offset = data_offset + data_lenth;
-		nal_num++;
+//码流统计的输出格式
+enum
+{
+	H264_STATS_JSON = 0,    //汇总结果
+	H264_STATS_CSV  = 1,    //每帧一行
+};
+
+/**
+ * H.264码流统计分析
+ * 在Annex-B解析之上把NALU组成访问单元(帧)，一遍扫描得到GOP长度分布、每帧大小、I/P/B帧比例、
+ * 滑动窗口码率以及峰值码率与平均码率之比，以JSON(汇总)或CSV(每帧的大小和窗口码率)输出，便于程序处理
+ * @param url Location of input H.264 bitstream file.
+ * @param format H264_STATS_JSON或H264_STATS_CSV
+ * @param window 滑动窗口长度(秒)
+ */
+static int simplest_h264_stats(const char *url,int format,double window = 1.0)
+{
+	CAnnexbScanner scanner;
+	CAccessUnitAssembler assembler;
+	CH264Stats stats;
+	AccessUnit au;
+	H264FrameStat frame;
+
+	//FILE *myout=fopen("output_stats.json","w+");
+	FILE *myout = stdout;
+
+	if(!scanner.Open(url))
+	{
+		printf("%s: Open file error\n",__FUNCTION__);
+		return -1;
 	}
+	assembler.Attach(&scanner);
+	stats.SetWindow(window);
+	stats.Reset();
 
-	//Free
-	if(n)
+	if(format == H264_STATS_CSV)
+		CH264Stats::WriteCsvHeader(myout);
+	while(assembler.Next(au))
 	{
-		if(n->buf)
-		{
-			free(n->buf);
-			n->buf = NULL;
-		}
-		free(n);
+		if(stats.Add(au,&frame) && format == H264_STATS_CSV)
+			CH264Stats::WriteCsvRow(myout,frame);
 	}
+	stats.Finish();
+	if(format == H264_STATS_JSON)
+		stats.WriteJson(myout,url,assembler.ActiveSps(),assembler.FrameRate());
 
+	scanner.Close();
 	return 0;
 }
 
@@ -1815,209 +1764,144 @@ static int simplest_h264_parser(const char *url)
  *   15	Number of AAC Frames	         2	                   number of AAC frames (RDBs) in ADTS frame minus 1, for maximum compatibility always use 1 AAC frame per ADTS frame
  *
 */
-static int getADTSframe(unsigned char* buffer, int buf_size, unsigned char* data ,int* data_size)
+//打印ADTS帧表中的一行，frame指向一帧ADTS
+static void print_adts_row(FILE* myout,int cnt,const unsigned char* frame,int size)
 {
-	int size = 0;
+	char profile_str[10] = {0};
+	char frequence_str[10] = {0};
+	char channel_config_str[100] = {0};
 
-	if(!buffer || !data || !data_size)
-	{
-		return -1;
-	}
+	//frame指向一帧ADTS
+	unsigned char profile = frame[2] & 0xC0;
+	profile = profile >> 6;
 
-	while(1)
+	switch(profile)
 	{
-		if(buf_size < 7) //读取的acc原始碼流字节数不能小于ADTS头
-		{
-			return -1;
-		}
-
-		//Sync words
-		if((buffer[0] == 0xff) && ((buffer[1] & 0xf0) == 0xf0))
-		{
-			//找到ADTS帧后，根据ADTS帧头部结构提取Frame Length字段
-			size |= ((buffer[3] & 0x03) <<11);     //high 2 bit
-			size |= buffer[4]<<3;                  //middle 8 bit
-			size |= ((buffer[5] & 0xe0)>>5);       //low 3bit
+		case 0:
+			sprintf(profile_str,"Main");
+			break;
+		case 1:
+			sprintf(profile_str,"LC");
+			break;
+		case 2:
+			sprintf(profile_str,"SSR");
+			break;
+		default:
+			sprintf(profile_str,"unknown");
 			break;
-		}
-
-		--buf_size;
-		++buffer;
 	}
 
-	//读取的AAC碼流字节数如果小于一帧ADTS长度，则需要接着继续读取后面的数据，保证解析AAC碼流至少包含一个ADTS帧
-	if(buf_size < size)
+	unsigned char sampling_frequency_index = frame[2] & 0x3C;
+	sampling_frequency_index = sampling_frequency_index >> 2;
+
+	switch(sampling_frequency_index)
 	{
-		return 1;
+		case 0:
+			sprintf(frequence_str,"96000Hz");
+			break;
+		case 1:
+			sprintf(frequence_str,"88200Hz");
+			break;
+		case 2:
+			sprintf(frequence_str,"64000Hz");
+			break;
+		case 3:
+			sprintf(frequence_str,"48000Hz");
+			break;
+		case 4:
+			sprintf(frequence_str,"44100Hz");
+			break;
+		case 5:
+			sprintf(frequence_str,"32000Hz");
+			break;
+		case 6:
+			sprintf(frequence_str,"24000Hz");
+			break;
+		case 7:
+			sprintf(frequence_str,"22050Hz");
+			break;
+		case 8:
+			sprintf(frequence_str,"16000Hz");
+			break;
+		case 9:
+			sprintf(frequence_str,"12000Hz");
+			break;
+		case 10:
+			sprintf(frequence_str,"11025Hz");
+			break;
+		case 11:
+			sprintf(frequence_str,"8000Hz");
+			break;
+		case 12:
+			sprintf(frequence_str,"7350Hz");
+			break;
+		default:
+			sprintf(frequence_str,"unknown");
+			break;
 	}
 
-	memcpy(data,buffer,size);
-	*data_size = size;
-
-	return 0;
+	unsigned char channel_config_index = frame[2] & 0x01 << 2;
+	channel_config_index = channel_config_index | ((frame[3] & 0xC0) >> 6);
+	switch(channel_config_index)
+	{
+		case 0:
+			sprintf(channel_config_str,"Defined in AOT Specifc Config");
+			break;
+		case 1:
+			 sprintf(channel_config_str,"1 channel");
+			 break;
+		case 2:
+			  sprintf(channel_config_str,"2 channels");
+			  break;
+		case 3:
+			  sprintf(channel_config_str,"3 channels");
+			  break;
+		case 4:
+			  sprintf(channel_config_str,"4 channels");
+			  break;
+		case 5:
+			  sprintf(channel_config_str,"5 channels");
+			  break;
+		case 6:
+			  sprintf(channel_config_str,"6 channels");
+			  break;
+		case 7:
+			  sprintf(channel_config_str,"8 channels");
+			  break;
+	}
+
+	fprintf(myout,"%5d| %8s|  %8s|  %8s| %5d|\n",cnt,profile_str ,frequence_str,channel_config_str,size);
 }
 
 /*
  * AAC码流解析的步骤就是首先从码流中搜索0x0FFF，分离出ADTS frame；然后再分析ADTS frame的首部各个字段
  * 本文的程序即实现了上述的两个步骤
+ * 文件映射到内存后由CChunkScanner分块在threads个线程中各自查找同步字，再按顺序拼接，结果与从头顺序查找相同
  */
-static int simplest_aac_parser(const char *url)
+static int simplest_aac_parser(const char *url,int threads = 1)
 {
-	int data_size = 0;
-	int size = 0;
+	CChunkScanner scanner;
 	int cnt = 0;
-	int offset = 0;
 
 	//FILE *myout = fopen("output_log.txt","w+");
 	FILE *myout = stdout;
 
-	unsigned char *aacframe = (unsigned char *)malloc(1024*5);
-	unsigned char *aacbuffer = (unsigned char *)malloc(1024*1024);
-
-	FILE *ifile = fopen(url, "r");
-	if(!ifile)
+	if(!scanner.Open(url))
 	{
 		printf("%s: Open file error",__FUNCTION__);
 		return -1;
 	}
+	scanner.SetThreads(threads);
 
 	printf("-----+----------- ADTS Frame Table ----------+-------------+\n");
 	printf(" NUM | Profile | Frequency | Channel Configurations | Size |\n");
 	printf("-----+---------+-----------+------------------------+------+\n");
 
-	while(!feof(ifile))
-	{
-		data_size = fread(aacbuffer+offset,1,1024*1024-offset,ifile);
-		unsigned char* input_data = aacbuffer;
-
-		while(1)
-		{
-			int ret = getADTSframe(input_data,data_size,aacframe,&size);
-
-			if(ret == -1)
-			{
-				break;
-			}
-			else if(ret == 1)
-			{
-				memcpy(aacbuffer,input_data,data_size);
-				offset = data_size;
-				break;
-			}
-
-			char profile_str[10] = {0};
-			char frequence_str[10] = {0};
-			char channel_config_str[100] = {0};
-
-			//aacframe保存了一帧ADTS
-			unsigned char profile = aacframe[2] & 0xC0;
-			profile = profile >> 6;
-
-			switch(profile)
-			{
-				case 0:
-					sprintf(profile_str,"Main");
-					break;
-				case 1:
-					sprintf(profile_str,"LC");
-					break;
-				case 2:
-					sprintf(profile_str,"SSR");
-					break;
-				default:
-					sprintf(profile_str,"unknown");
-					break;
-			}
-
-			unsigned char sampling_frequency_index = aacframe[2] & 0x3C;
-			sampling_frequency_index = sampling_frequency_index >> 2;
-
-			switch(sampling_frequency_index)
-			{
-				case 0:
-					sprintf(frequence_str,"96000Hz");
-					break;
-				case 1:
-					sprintf(frequence_str,"88200Hz");
-					break;
-				case 2:
-					sprintf(frequence_str,"64000Hz");
-					break;
-				case 3:
-					sprintf(frequence_str,"48000Hz");
-					break;
-				case 4:
-					sprintf(frequence_str,"44100Hz");
-					break;
-				case 5:
-					sprintf(frequence_str,"32000Hz");
-					break;
-				case 6:
-					sprintf(frequence_str,"24000Hz");
-					break;
-				case 7:
-					sprintf(frequence_str,"22050Hz");
-					break;
-				case 8:
-					sprintf(frequence_str,"16000Hz");
-					break;
-				case 9:
-					sprintf(frequence_str,"12000Hz");
-					break;
-				case 10:
-					sprintf(frequence_str,"11025Hz");
-					break;
-				case 11:
-					sprintf(frequence_str,"8000Hz");
-					break;
-				case 12:
-					sprintf(frequence_str,"7350Hz");
-					break;
-				default:
-					sprintf(frequence_str,"unknown");
-					break;
-			}
-
-			unsigned char channel_config_index = aacframe[2] & 0x01 << 2;
-			channel_config_index = channel_config_index | ((aacframe[3] & 0xC0) >> 6);
-            switch(channel_config_index)
-			{
-				case 0:
-					sprintf(channel_config_str,"Defined in AOT Specifc Config");
-					break;
-				case 1:
-					 sprintf(channel_config_str,"1 channel");
-					 break;
-				case 2:
-					  sprintf(channel_config_str,"2 channels");
-					  break;
-				case 3:
-					  sprintf(channel_config_str,"3 channels");
-					  break;
-				case 4:
-					  sprintf(channel_config_str,"4 channels");
-					  break;
-				case 5:
-					  sprintf(channel_config_str,"5 channels");
-					  break;
-				case 6:
-					  sprintf(channel_config_str,"6 channels");
-					  break;
-				case 7:
-					  sprintf(channel_config_str,"8 channels");
-					  break;
-			}
-
-			fprintf(myout,"%5d| %8s|  %8s|  %8s| %5d|\n",cnt,profile_str ,frequence_str,channel_config_str,size);
-			data_size -= size;
-			input_data += size;
-			cnt++;
-		}
-	}
+	scanner.Run(CChunkScanner::AdtsNext,[&](const unsigned char* data,const ChunkUnit& unit) {
+		print_adts_row(myout,cnt++,data + unit.offset,unit.len);
+	});
 
-	fclose(ifile);
-	free(aacbuffer);
-	free(aacframe);
+	scanner.Close();
 
 	return 0;
 }
@@ -2632,183 +2516,532 @@ typedef struct MPEGTS_FIXED_HEADER
 	unsigned continuity_counter: 4;               //包递增计数器
 } MPEGTS_FIXED_HEADER;
 
-static int simplest_udp_parser(int port)
+//每个接收线程每处理该数量的UDP包，或者距上次发布超过UDP_TS_STATS_MS(按包的到达时刻)时发布一次TS解复用统计
+#define UDP_TS_STATS_INTERVAL 1000
+#define UDP_TS_STATS_MS       100
+
+static void print_ts_stats(FILE *myout,const TsDemuxStats& stats)
+{
+	fprintf(myout,"[MPEGTS Stats] packets: %llu, units: %llu, sync errors: %llu, transport errors: %llu, cc errors: %llu, duplicates: %llu, "
+		"scrambled: %llu, sections: %llu, crc errors: %llu, pcrs: %llu, truncated: %llu, filtered: %llu, kernel: %s\n",
+		(unsigned long long)stats.packets,(unsigned long long)stats.units,(unsigned long long)stats.sync_errors,
+		(unsigned long long)stats.transport_errors,(unsigned long long)stats.cc_errors,(unsigned long long)stats.duplicates,
+		(unsigned long long)stats.scrambled,(unsigned long long)stats.sections,(unsigned long long)stats.crc_errors,
+		(unsigned long long)stats.pcrs,(unsigned long long)stats.truncated,(unsigned long long)stats.filtered,CTsDemuxer::KernelName());
+}
+
+static void add_ts_stats(TsDemuxStats& sum,const TsDemuxStats& s)
+{
+	sum.packets += s.packets;
+	sum.sync_errors += s.sync_errors;
+	sum.transport_errors += s.transport_errors;
+	sum.cc_errors += s.cc_errors;
+	sum.duplicates += s.duplicates;
+	sum.scrambled += s.scrambled;
+	sum.sections += s.sections;
+	sum.crc_errors += s.crc_errors;
+	sum.pcrs += s.pcrs;
+	sum.units += s.units;
+	sum.truncated += s.truncated;
+	sum.filtered += s.filtered;
+}
+
+//RFC3551
+static const char* rtp_payload_desc(int payload)
+{
+	switch(payload)
+	{
+		case 0:
+			return "encoding name: PCMU,media type: Audio,clock rate:8khz,channels:1";
+		case 1:
+		case 2:
+			return "media type:Audio";
+		case 3:
+			return "encoding name: GSM,media type: Audio,clock rate:8khz,channels:1";
+		case 4:
+			return "encoding name: G723,media type: Audio,clock rate:8khz,channels:1";
+		case 5:
+			return "encoding name: DVI4,media type: Audio,clock rate:8khz,channels:1";
+		case 6:
+			return "encoding name: DVI4,media type: Audio,clock rate:16khz,channels:1";
+		case 7:
+			return "encoding name: LPC,media type: Audio,clock rate:8khz,channels:1";
+		case 8:
+			return "encoding name: PCMA,media type: Audio,clock rate:8khz,channels:1";
+		case 9:
+			return "encoding name: G722,media type: Audio,clock rate:8khz,channels:1";
+		case 10:
+			return "encoding name: L16,media type: Audio,clock rate:44.1khz,channels:2";
+		case 11:
+			return "encoding name: L16,media type: Audio,clock rate:44.1khz,channels:1";
+		case 12:
+			return "encoding name: QCELP,media type: Audio,clock rate:8khz,channels:1";
+		case 13:
+			return "encoding name: CN,media type: Audio,clock rate:8khz,channels:1";
+		case 14:
+			return "encoding name: MPA,media type: Audio,clock rate:90khz,channels:1";
+		case 15:
+			return "encoding name: G728,media type: Audio,clock rate:8khz,channels:1";
+		case 16:
+			return "encoding name: DVI4,media type: Audio,clock rate:11.025khz,channels:1";
+		case 17:
+			return "encoding name: DVI4,media type: Audio,clock rate:22.05khz,channels:1";
+		case 18:
+			return "encoding name: G729,media type: Audio,clock rate:8khz,channels:1";
+		case 25:
+			return "encoding name: CelB,media type: Vedio,clock rate:90khz";
+		case 26:
+			return "encoding name: JPEG,media type: Vedio,clock rate:90khz";
+		case 31:
+			return "encoding name: H261,media type: Vedio,clock rate:90khz";
+		case 32:
+			return "encoding name: MPV,media type: Vedio,clock rate:90khz";
+		case 33:
+			return "encoding name: MP2T,media type: AV,clock rate:90khz";
+		case 34:
+			return "encoding name: H263,media type: Vedio,clock rate:90khz";
+		case 96:
+			return "encoding name: PCMU,media type: Audio,clock rate:8khz,channels:2";
+	}
+	return "";
+}
+
+/**
+ * _UdpParser
+ * 一个接收线程的解析状态，线程之间不共享。统计每UDP_TS_STATS_INTERVAL个包、每UDP_TS_STATS_MS以及接收空闲时在锁内复制一次，供打印线程读取
+ */
+typedef struct _UdpParser
+{
+	CTsDemuxer demuxer;
+	CTsAnalyzer *analyzer;        //健康分析，为NULL时不分析
+	FILE *dump;                   //UDP负载(TS流)的转储文件，只有一个接收线程时写
+	int verbose;                  //逐包、逐访问单元打印
+	uint64_t cnt;
+	uint64_t rtp_packets;
+	uint64_t ts_packets;          //非RTP封装的TS包所在的UDP包数
+	uint64_t published;           //上次发布统计时的cnt
+	int64_t publish_time;         //上次发布统计时包的到达时刻，纳秒
+	std::mutex lock;
+	TsDemuxStats snapshot;
+}UdpParser;
+
+static void udp_publish_stats(UdpParser& parser)
+{
+	std::lock_guard<std::mutex> guard(parser.lock);
+	parser.demuxer.GetStats(&parser.snapshot);
+	parser.published = parser.cnt;
+}
+
+/**
+ * 初始化一个接收线程的解析状态
+ * @param index 接收线程的编号
+ * @param analyze 为1时创建健康分析，每秒(按到达时刻)输出一次汇总表
+ */
+static void udp_parser_init(UdpParser& parser,int index,FILE *dump,int verbose,int analyze,FILE *myout)
+{
+	parser.dump = dump;
+	parser.verbose = verbose;
+	parser.analyzer = NULL;
+	if(analyze)
+	{
+		//汇总在接收线程中输出，锁住stdout使各线程的表不交错
+		parser.analyzer = new CTsAnalyzer;
+		parser.analyzer->SetReport(1000,[myout,index](const CTsAnalyzer& analyzer) {
+			flockfile(myout);
+			fprintf(myout,"[worker %d] ",index);
+			analyzer.Print(myout);
+			funlockfile(myout);
+		});
+	}
+	parser.cnt = 0;
+	parser.rtp_packets = 0;
+	parser.ts_packets = 0;
+	parser.published = 0;
+	parser.publish_time = 0;
+	memset(&parser.snapshot,0,sizeof(parser.snapshot));
+	//TS包在解复用器中组装成PES，verbose时每个完整的访问单元打印一行
+	if(verbose)
+	{
+		parser.demuxer.SetCallback([myout](const TsAccessUnit& au) {
+			fprintf(myout,"   [MPEGTS AU] pid: 0x%04x| type: 0x%02x| pts: %10lld| dts: %10lld| size: %7u| rai: %d| disc: %d|\n",au.pid,au.stream_type,
+				(long long)au.pts,(long long)au.dts,au.size,au.random_access,au.discontinuity);
+		});
+	}
+}
+
+/**
+ * 解析一个UDP包：188字节整数倍且以0x47开始的是直接UDP封装的TS流，否则按RTP解析，负载类型33时负载送入TS解复用器，
+ * 分析模式下同时送入健康分析。在接收线程中调用，verbose为0时不打印
+ * @param arrival 到达时刻，纳秒
+ */
+static void udp_parse_datagram(UdpParser& parser,const unsigned char *data,int pktsize,int64_t arrival)
+{
+	FILE *myout = stdout;
+	int parse_mpegts = 1;//MPEG-TS解析开关
+
+	if(pktsize > 0 && data[0] == 0x47 && pktsize % 188 == 0)
+	{
+		if(parser.verbose)
+			fprintf(myout,"[UDP Pkt] %5llu| %5d|\n",(unsigned long long)parser.cnt,pktsize);
+		if(parser.dump)
+			fwrite(data,pktsize,1,parser.dump);
+		if(parse_mpegts != 0)
+			parser.demuxer.Input(data,pktsize);
+		if(parser.analyzer)
+			parser.analyzer->Input(data,pktsize,arrival);
+		parser.ts_packets++;
+	}
+	else if(pktsize >= (int)sizeof(RTP_FIXED_HEADER))
+	{
+		RTP_FIXED_HEADER rtp_header;
+		int rtp_header_size = sizeof(RTP_FIXED_HEADER);
+
+		//RTP Header
+		memcpy((void *)&rtp_header,data,rtp_header_size);
+		//固定头之后是csrc_len个CSRC，以及X为1时的扩展头(4字节，其中后2字节为以4字节为单位的长度)
+		rtp_header_size += rtp_header.csrc_len * 4;
+		if(rtp_header.extension && pktsize >= rtp_header_size + 4)
+			rtp_header_size += 4 + (((data[rtp_header_size + 2] << 8) | data[rtp_header_size + 3]) * 4);
+		//P为1时最后一个字节是填充的字节数
+		int padding_size = rtp_header.padding ? data[pktsize - 1] : 0;
+		if(rtp_header.version == 2 && rtp_header_size + padding_size <= pktsize)
+		{
+			int payload = rtp_header.payload;
+			if(parser.verbose)
+			{
+				unsigned int timestamp = ntohl(rtp_header.timestamp);
+				unsigned int seq_no = ntohs(rtp_header.seq_no);
+				fprintf(myout,"[RTP Pkt] %5llu| %5s| %10u| %5d| %5d|\n",(unsigned long long)parser.cnt,rtp_payload_desc(payload),timestamp,seq_no,pktsize);
+			}
+
+			//RTP Data
+			const unsigned char *rtp_data = data + rtp_header_size;
+			int rtp_data_size = pktsize - rtp_header_size - padding_size;
+			if(parser.dump)
+				fwrite(rtp_data,rtp_data_size,1,parser.dump);
+
+			//Parse MPEGTS
+			if(parse_mpegts != 0 && payload == 33)
+				parser.demuxer.Input(rtp_data,rtp_data_size);
+			if(parser.analyzer && payload == 33)
+				parser.analyzer->Input(rtp_data,rtp_data_size,arrival);
+			parser.rtp_packets++;
+		}
+	}
+
+	//低码率的流按时间发布，到达时刻回退(回放多遍抓包文件时)也发布一次
+	++parser.cnt;
+	if(parser.cnt % UDP_TS_STATS_INTERVAL == 0 || arrival - parser.publish_time >= UDP_TS_STATS_MS * 1000000LL || arrival < parser.publish_time)
+	{
+		udp_publish_stats(parser);
+		parser.publish_time = arrival;
+	}
+}
+
+/**
+ * UDP/RTP接收解析。CUdpIngest用recvmmsg成批接收，threads大于1时多个SO_REUSEPORT套接字各在一个绑定CPU核的线程中接收，
+ * 每个线程有自己的TS解复用器(同一个流总在同一个线程)。接收线程中不打印，主线程每秒输出一次接收和解复用统计
+ * @param ip 绑定的地址
+ * @param port 端口
+ * @param threads 接收线程数
+ * @param verbose 为1时逐包打印(与原来的输出相同)，会拖慢接收
+ * @param seconds 运行的秒数，0表示一直运行
+ * @param analyze 为1时分析TS流的健康状况，每个接收线程每秒输出一次汇总表
+ */
+static int simplest_udp_parser(const char *ip,int port,int threads = 1,int verbose = 0,int seconds = 0,int analyze = 0)
 {
-	int cnt = 0;
 	//FILE *myout=fopen("output_log.txt","wb+");
 	FILE *myout = stdout;
+	CUdpIngest ingest;
+
+	if(threads < 1)
+		threads = 1;
+	UdpParser *parsers = new UdpParser[threads];
+	//多个线程时各线程收到的包的先后无法还原，不转储
+	FILE *fp1 = threads == 1 ? fopen("out/udp-rtp/output_dump.ts","w+") : NULL;
+	for(int i = 0; i < threads; i++)
+		udp_parser_init(parsers[i],i,fp1,verbose,analyze,myout);
+
+	ingest.SetThreads(threads);
+	ingest.SetPinCores(threads > 1);
+	ingest.SetCallback([parsers](const UdpPacket& pkt) {
+		udp_parse_datagram(parsers[pkt.worker],pkt.data,pkt.len,pkt.arrival);
+	});
+	//流量停止后把最后的统计发布出去
+	ingest.SetIdleCallback([parsers](int worker) {
+		if(parsers[worker].cnt != parsers[worker].published)
+			udp_publish_stats(parsers[worker]);
+	});
+	if(!ingest.Open(ip,port) || !ingest.Start())
+	{
+		fprintf(myout,"bind %s:%d error\n",ip,port);
+		for(int i = 0; i < threads; i++)
+			delete parsers[i].analyzer;
+		delete[] parsers;
+		if(fp1)
+			fclose(fp1);
+		return -1;
+	}
+	fprintf(myout,"Listening on %s:%d, threads: %d, rcvbuf: %d\n",ip,port,threads,ingest.RcvBuf());
 
-	FILE *fp1 = fopen("out/udp-rtp/output_dump.ts","w+");
+	UdpIngestStats last;
+	memset(&last,0,sizeof(last));
+	for(int sec = 0; seconds == 0 || sec < seconds; sec++)
+	{
+		sleep(1);
+		UdpIngestStats st;
+		TsDemuxStats ts;
+		ingest.GetStats(&st);
+		memset(&ts,0,sizeof(ts));
+		for(int i = 0; i < threads; i++)
+		{
+			std::lock_guard<std::mutex> guard(parsers[i].lock);
+			add_ts_stats(ts,parsers[i].snapshot);
+		}
+		uint64_t batches = st.batches - last.batches;
+		fprintf(myout,"[UDP Stats] %llu pkts/s, %.2f Mbps, %.1f pkts/batch, total: %llu, drops: %llu, truncated: %llu\n",
+			(unsigned long long)(st.packets - last.packets),(st.bytes - last.bytes) * 8 / 1e6,batches ? (double)(st.packets - last.packets) / batches : 0,
+			(unsigned long long)st.packets,(unsigned long long)st.drops,(unsigned long long)st.truncated);
+		if(ts.packets > 0)
+			print_ts_stats(myout,ts);
+		last = st;
+	}
+
+	ingest.Stop();
+	TsDemuxStats ts;
+	uint64_t rtp = 0,udp = 0;
+	memset(&ts,0,sizeof(ts));
+	for(int i = 0; i < threads; i++)
+	{
+		parsers[i].demuxer.Flush();
+		udp_publish_stats(parsers[i]);
+		add_ts_stats(ts,parsers[i].snapshot);
+		rtp += parsers[i].rtp_packets;
+		udp += parsers[i].ts_packets;
+	}
+	fprintf(myout,"[UDP Total] rtp packets: %llu, udp ts packets: %llu\n",(unsigned long long)rtp,(unsigned long long)udp);
+	print_ts_stats(myout,ts);
+	for(int i = 0; i < threads; i++)
+	{
+		if(parsers[i].analyzer)
+		{
+			fprintf(myout,"[worker %d] ",i);
+			parsers[i].analyzer->Print(myout);
+			delete parsers[i].analyzer;
+		}
+	}
+	ingest.Close();
+	delete[] parsers;
+	if(fp1)
+		fclose(fp1);
+	return 0;
+}
+
+/**
+ * 抓包文件(pcap/pcapng)回放：取出其中的UDP负载，与simplest_udp_parser中接收到的包一样送入udp_parse_datagram，
+ * 到达时刻为抓包的时间戳，不需要网络。尽快回放时输出的吞吐量可作为解析代码的基准，按原始时间回放可以重现现场的时序
+ * @param url 抓包文件
+ * @param port 只回放目的端口为port的UDP包，0表示全部
+ * @param realtime 为1时按抓包时的间隔回放，否则尽快回放
+ * @param analyze 为1时分析TS流的健康状况
+ * @param loops 回放的遍数
+ */
+static int simplest_pcap_parser(const char *url,int port,int realtime = 0,int analyze = 0,int loops = 1)
+{
+	//FILE *myout=fopen("output_log.txt","w+");
+	FILE *myout = stdout;
+	CPcapReader reader;
 
-	int serSocket = socket(AF_INET,SOCK_DGRAM,IPPROTO_UDP);
-	if(serSocket ==-1){
-		fprintf(myout,"socket:%m\n");
+	if(!reader.Open(url))
+	{
+		printf("%s: Open file error\n",__FUNCTION__);
 		return -1;
 	}
-	fprintf(myout,"建立socket成功\n");
+	UdpParser *parser = new UdpParser;
+	//多遍回放时不转储
+	FILE *fp1 = loops == 1 ? fopen("out/udp-rtp/output_pcap_dump.ts","w+") : NULL;
+	udp_parser_init(*parser,0,fp1,0,analyze,myout);
+
+	reader.SetPort(port);
+	reader.SetLoops(loops);
+	int ret = reader.Run([parser](const UdpPacket& pkt) {
+		udp_parse_datagram(*parser,pkt.data,pkt.len,pkt.arrival);
+	},realtime ? PCAP_REPLAY_REALTIME : PCAP_REPLAY_FAST);
+	parser->demuxer.Flush();
+	udp_publish_stats(*parser);
+
+	PcapStats st;
+	reader.GetStats(&st);
+	fprintf(myout,"[PCAP Stats] %s, records: %llu, udp: %llu, filtered: %llu, skipped: %llu, truncated: %llu, capture: %.3f s, elapsed: %.3f s\n",
+		realtime ? "realtime" : "fast",(unsigned long long)st.records,(unsigned long long)st.packets,(unsigned long long)st.filtered,
+		(unsigned long long)st.skipped,(unsigned long long)st.truncated,st.duration,st.elapsed);
+	if(st.elapsed > 0)
+		fprintf(myout,"[PCAP Stats] %.0f pkts/s, %.2f Mbps\n",st.packets / st.elapsed,st.bytes * 8 / st.elapsed / 1e6);
+	fprintf(myout,"[UDP Total] rtp packets: %llu, udp ts packets: %llu\n",(unsigned long long)parser->rtp_packets,(unsigned long long)parser->ts_packets);
+	print_ts_stats(myout,parser->snapshot);
+	if(parser->analyzer)
+	{
+		parser->analyzer->Print(myout);
+		delete parser->analyzer;
+	}
+	delete parser;
+	if(fp1)
+		fclose(fp1);
+	return ret ? 0 : -1;
+}
 
-	struct sockaddr_in serAddr;
-	serAddr.sin_family = AF_INET;
-	serAddr.sin_port = htons(port);
-	inet_aton("127.0.0.1",&serAddr.sin_addr);
+/**
+ * MPEG-TS文件解析，打印每个TS包的包头
+ * 与simplest_udp_parser中的处理一样以同步字节0x47和188字节的包长定位TS包，188字节之后不是0x47时认为失去同步，逐字节重新查找。
+ * 文件映射到内存后由CChunkScanner分块在threads个线程中各自重新同步，再按顺序拼接，结果与从头顺序查找相同
+ * @param url TS文件
+ * @param threads 线程数
+ */
+static int simplest_ts_parser(const char *url,int threads = 1)
+{
+	CChunkScanner scanner;
+	int cnt = 0;
 
-	if(bind(serSocket,(struct sockaddr*)&serAddr, sizeof(serAddr)) == -1){
-		fprintf(myout,"bind error: %m!\n");
-		close(serSocket);
+	//FILE *myout=fopen("output_log.txt","w+");
+	FILE *myout = stdout;
+
+	if(!scanner.Open(url))
+	{
+		printf("%s: Open file error\n",__FUNCTION__);
 		return -1;
 	}
+	scanner.SetThreads(threads);
+
+	printf("-----+--------- MPEG-TS Packet Table --------+-----+----+\n");
+	printf(" NUM |      POS |    PID | TEI | PUSI | SC | AFC | CC |\n");
+	printf("-----+----------+--------+-----+------+----+-----+----+\n");
+
+	//MPEGTS_FIXED_HEADER的位域与字节序有关，这里直接按字节取包头各字段
+	scanner.Run(CChunkScanner::TsNext,[&](const unsigned char* data,const ChunkUnit& unit) {
+		const unsigned char* pkt = data + unit.offset;
+		int transport_error_indicator = pkt[1] >> 7;
+		int payload_unit_start_indicator = (pkt[1] >> 6) & 0x01;
+		int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+		int transport_scrambling_control = pkt[3] >> 6;
+		int adaptation_field_control = (pkt[3] >> 4) & 0x03;
+		int continuity_counter = pkt[3] & 0x0f;
+		fprintf(myout,"%5d| %8llu| 0x%04x| %3d| %4d| %2d| %3d| %2d|\n",cnt++,(unsigned long long)unit.offset,pid,transport_error_indicator,
+			payload_unit_start_indicator,transport_scrambling_control,adaptation_field_control,continuity_counter);
+	});
 
-	struct sockaddr_in remoteAddr;
-	socklen_t nAddrLen = sizeof(remoteAddr);
+	scanner.Close();
+	return 0;
+}
 
-	int parse_rtp = 1; //通过UDP推流RTP封装的MPEG-TS
-	int parse_mpegts = 1;//MPEG-TS解析开关
-	fprintf(myout,"Listening on port %d\n",port);
 
-	char recvData[10000];
+/**
+ * MPEG-TS文件解复用，与simplest_udp_parser使用同一个CTsDemuxer，
+ * 每个基本流的访问单元按顺序写到out/ts/output_<PID>.h264/.aac/.es，打印每个访问单元和最后的统计
+ * @param url TS文件
+ */
+static int simplest_ts_demux(const char *url)
+{
+	//FILE *myout=fopen("output_log.txt","w+");
+	FILE *myout = stdout;
+	std::vector<FILE*> outs(TS_MAX_PID,(FILE*)NULL);
+	std::vector<unsigned char> buf(TS_PACKET_SIZE * 7 * 64);
+	CTsDemuxer demuxer;
+	int cnt = 0;
 
-	while(1)
+	FILE *ifile = fopen(url,"rb");
+	if(!ifile)
 	{
-		int pktsize = recvfrom(serSocket,recvData,sizeof(recvData),0,(struct sockaddr *)&remoteAddr,&nAddrLen);
-		if(pktsize > 0)
-		{
-			fprintf(myout,"packet size:%d, 发送者IP: %s,端口: %hu\n",pktsize,inet_ntoa(remoteAddr.sin_addr),ntohs(remoteAddr.sin_port));
+		printf("%s: Open file error\n",__FUNCTION__);
+		return -1;
+	}
 
-			//Parse RTP
-			if(parse_rtp != 0)
-			{
-				char payload_str[50] = {0};
-				RTP_FIXED_HEADER rtp_header;
-				int rtp_header_size = sizeof(RTP_FIXED_HEADER);
+	printf("-----+--------- MPEG-TS Access Unit Table ----+-----------+---------+-----+\n");
+	printf(" NUM |    PID | TYPE |        PTS |        DTS |      SIZE | RAI | DISC |\n");
+	printf("-----+--------+------+------------+------------+-----------+-----+------+\n");
 
-				//RTP Header
-				memcpy((void *)&rtp_header,recvData,rtp_header_size);
+	demuxer.SetCallback([&](const TsAccessUnit& au) {
+		fprintf(myout,"%5d| 0x%04x| 0x%02x| %10lld| %10lld| %10u| %3d| %4d|\n",cnt++,au.pid,au.stream_type,
+			(long long)au.pts,(long long)au.dts,au.size,au.random_access,au.discontinuity);
+		if(outs[au.pid] == NULL)
+		{
+			char name[64];
+			const char* ext = au.stream_type == TS_STREAM_H264 ? "h264" : (au.stream_type == TS_STREAM_AAC ? "aac" : "es");
+			snprintf(name,sizeof(name),"out/ts/output_0x%04x.%s",au.pid,ext);
+			outs[au.pid] = fopen(name,"wb");
+			if(outs[au.pid] == NULL)
+				return;
+		}
+		fwrite(au.data,1,au.size,outs[au.pid]);
+	});
 
-				//RFC3551
-				char payload = rtp_header.payload;
-				switch(payload)
-				{
-					case 0:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","PCMU","Audio","8khz","1");
-						break;
-					case 1:
-					case 2:
-						sprintf(payload_str,"media type:%s","Audio");
-						break;
-					case 3:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","GSM","Audio","8khz","1");
-						break;
-					case 4:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","G723","Audio","8khz","1");
-						break;
-					case 5:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","DVI4","Audio","8khz","1");
-						break;
-					case 6:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","DVI4","Audio","16khz","1");
-						break;
-					case 7:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","LPC","Audio","8khz","1");
-						break;
-					case 8:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","PCMA","Audio","8khz","1");
-						break;
-					case 9:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","G722","Audio","8khz","1");
-						break;
-					case 10:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","L16","Audio","44.1khz","2");
-						break;
-					case 11:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","L16","Audio","44.1khz","1");
-						break;
-					case 12:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","QCELP","Audio","8khz","1");
-						break;
-					case 13:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","CN","Audio","8khz","1");
-						break;
-					case 14:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","MPA","Audio","90khz","1");
-						break;
-					case 15:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","G728","Audio","8khz","1");
-						break;
-					case 16:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","DVI4","Audio","11.025khz","1");
-						break;
-					case 17:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","DVI4","Audio","22.05khz","1");
-						break;
-					case 18:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","G729","Audio","8khz","1");
-						break;
-					case 25:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","CelB","Vedio","90khz");
-						break;
-					case 26:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","JPEG","Vedio","90khz");
-						break;
-					case 31:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","H261","Vedio","90khz");
-						break;
-					case 32:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","MPV","Vedio","90khz");
-						break;
-					case 33:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","MP2T","AV","90khz");
-						break;
-					case 34:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s","H263","Vedio","90khz");
-						break;
-					case 96:
-						sprintf(payload_str,"encoding name: %s,media type: %s,clock rate:%s,channels:%s","PCMU","Audio","8khz","2");
-						break;
-				}
+	//不足一个TS包的尾部留到下一次读入之前
+	size_t left = 0,n;
+	while((n = fread(&buf[left],1,buf.size() - left,ifile)) > 0)
+	{
+		size_t len = left + n;
+		size_t used = demuxer.Input(&buf[0],len) * TS_PACKET_SIZE;
+		left = len - used;
+		memmove(&buf[0],&buf[used],left);
+	}
+	demuxer.Flush();
+	TsDemuxStats stats;
+	demuxer.GetStats(&stats);
+	print_ts_stats(myout,stats);
 
-				unsigned int timestamp = ntohl(rtp_header.timestamp);
-				unsigned int seq_no = ntohs(rtp_header.seq_no);
-				fprintf(myout,"[RTP Pkt] %5d| %5s| %10u| %5d| %5d|\n",cnt,payload_str,timestamp,seq_no,pktsize);
+	for(size_t i = 0; i < outs.size(); i++)
+	{
+		if(outs[i])
+			fclose(outs[i]);
+	}
+	fclose(ifile);
+	return 0;
+}
 
-				//RTP Data
-				char *rtp_data = recvData + rtp_header_size;
-				int rtp_data_size = pktsize - rtp_header_size;
-				fwrite(rtp_data,rtp_data_size,1,fp1);
 
-				//Parse MPEGTS
-				if(parse_mpegts != 0 && payload == 33)
-				{
-					//暂时不对MPEG-TS流解析
-					MPEGTS_FIXED_HEADER mpegts_header;
-					for(int i=0;i<rtp_data_size;i=i+188)
-					{
-						//判断是否是一个TS包的开始
-						if(rtp_data[i] != 0x47)
-							break;
-						//MPEGTS Header
-						//memcpy((void *)&mpegts_header,rtp_data+i,sizeof(MPEGTS_FIXED_HEADER));
-						fprintf(myout,"   [MPEGTS Pkt]\n");
-					}
-				}
-			}
-			else
-			{
-				fprintf(myout,"[UDP Pkt] %5d| %5d|\n",cnt,pktsize);
-				fwrite(recvData,pktsize,1,fp1);
-			}
+/**
+ * MPEG-TS文件健康分析：连续计数器、PCR间隔、各PID码率以及PES时间戳空缺。文件没有到达时刻，以PCR作为时间基准，
+ * 每10秒(流的时间)输出一次汇总表，最后再输出一次
+ * @param url TS文件
+ */
+static int simplest_ts_analyze(const char *url)
+{
+	//FILE *myout=fopen("output_log.txt","w+");
+	FILE *myout = stdout;
+	std::vector<unsigned char> buf(TS_PACKET_SIZE * 7 * 64);
+	CTsAnalyzer *analyzer = new CTsAnalyzer;
 
-			cnt++;
-		}
+	FILE *ifile = fopen(url,"rb");
+	if(!ifile)
+	{
+		printf("%s: Open file error\n",__FUNCTION__);
+		delete analyzer;
+		return -1;
 	}
+	analyzer->SetReport(10000,[myout](const CTsAnalyzer& a) {
+		a.Print(myout);
+	});
 
-	close(serSocket);
-	fclose(fp1);
+	size_t left = 0,n;
+	while((n = fread(&buf[left],1,buf.size() - left,ifile)) > 0)
+	{
+		size_t len = left + n;
+		size_t used = analyzer->Input(&buf[0],len) * TS_PACKET_SIZE;
+		left = len - used;
+		memmove(&buf[0],&buf[used],left);
+	}
+	analyzer->Print(myout);
+
+	fclose(ifile);
+	delete analyzer;
 	return 0;
 }
 
 
 int main(int argc, char* argv[])
 {
+	  //码流解析按CPU核数分块并行查找
+	  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
 	  simplest_yuv420_split("yuv420p/lena_256x256_yuv420p.yuv",256,256,1);
       simplest_yuv444_split("yuv444p/lena_256x256_yuv444p.yuv",256,256,1);
       simplest_yuv420_gray("yuv420p/lena_256x256_yuv420p.yuv",256,256,1);
@@ -2828,13 +3061,38 @@ int main(int argc, char* argv[])
       simplest_pcm16le_cut_singlechannel("pcm/drum.pcm",2360,120);
       simplest_pcm16le_to_wave("pcm/NocturneNo2inEflat_44.1k_s16le.pcm",2,44100,"out/pcm/output_nocturne.wav");
 
-	  simplest_h264_parser("h264/sintel.h264");
+	  simplest_h264_parser("h264/sintel.h264",threads);
+	  simplest_h264_stats("h264/sintel.h264",H264_STATS_JSON);
 
-	  simplest_aac_parser("aac/nocturne.aac");
+	  simplest_aac_parser("aac/nocturne.aac",threads);
 
       simplest_flv_parser("flv/cuc_ieschool.flv");
 
-	  simplest_udp_parser(8888);
+	  //./a.out xxx.ts [IP:端口] [接收线程数] [analyze] 解析MPEG-TS文件，之后在IP:端口上接收UDP/RTP，analyze为1时分析TS流的健康状况；
+	  //xxx.ts为-时不解析文件
+	  //./a.out xxx.pcap [IP:端口] [realtime] [analyze] [遍数] 回放抓包文件(pcap/pcapng)中目的端口为该端口的UDP包(不给出时全部)，不接收网络
+	  const char *ext = argc > 1 ? strrchr(argv[1],'.') : NULL;
+	  if(ext && (strcmp(ext,".pcap") == 0 || strcmp(ext,".pcapng") == 0))
+	  {
+		  char ip[64];
+		  int port = 0;
+		  if(argc > 2 && sscanf(argv[2],"%63[^:]:%d",ip,&port) != 2)
+			  printf("invalid address %s\n",argv[2]);
+		  simplest_pcap_parser(argv[1],port,argc > 3 ? atoi(argv[3]) : 0,argc > 4 ? atoi(argv[4]) : 0,argc > 5 ? atoi(argv[5]) : 1);
+		  return 0;
+	  }
+	  if(argc > 1 && strcmp(argv[1],"-") != 0)
+	  {
+		  simplest_ts_parser(argv[1],threads);
+		  simplest_ts_demux(argv[1]);
+		  simplest_ts_analyze(argv[1]);
+	  }
+
+	  char ip[64] = "127.0.0.1";
+	  int port = 8888;
+	  if(argc > 2 && sscanf(argv[2],"%63[^:]:%d",ip,&port) != 2)
+		  printf("invalid address %s\n",argv[2]);
+	  simplest_udp_parser(ip,port,argc > 3 ? atoi(argv[3]) : 1,0,0,argc > 4 ? atoi(argv[4]) : 0);
 
 	return 0;
 }
@@ -0,0 +1,531 @@
+/*************************************************************************
+    > File Name: CRtcp.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 02时05分12秒
+ ************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <random>
+#include "CRtcp.h"
+
+//NTP时间从1900年开始，Unix时间从1970年开始，相差的秒数
+#define NTP_UNIX_OFFSET         2208988800ULL
+
+static void put16(unsigned char* p,unsigned int v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void put32(unsigned char* p,unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static unsigned int get32(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+CRtcp::CRtcp() : m_nFd(-1),m_nInterval(RTCP_INTERVAL_MS),m_nNextReport(0)
+{
+	std::random_device rd;
+	char host[48];
+
+	m_nSsrc = rd();
+	//CNAME为user@host形式的规范名，这里用程序名和主机名
+	if(gethostname(host,sizeof(host)) != 0)
+		strcpy(host,"localhost");
+	host[sizeof(host) - 1] = 0;
+	snprintf(m_szCname,sizeof(m_szCname),"rtp@%s",host);
+}
+
+CRtcp::~CRtcp()
+{
+	Close();
+}
+
+int CRtcp::Open(int port,const char* ip)
+{
+	struct sockaddr_in addr;
+
+	Close();
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET,ip,&addr.sin_addr) != 1 || (m_nFd = socket(AF_INET,SOCK_DGRAM,0)) < 0)
+	{
+		printf("%s: ====haoge====rtcp socket error\n",__FUNCTION__);
+		return 0;
+	}
+	if(bind(m_nFd,(struct sockaddr*)&addr,sizeof(addr)) != 0)
+	{
+		printf("%s: ====haoge====bind rtcp port %d error: %s\n",__FUNCTION__,port,strerror(errno));
+		Close();
+		return 0;
+	}
+	//由内核记录包的到达时刻，发送端每帧才读取一次RR，读取前的等待不能算进RTT
+	int on = 1;
+	setsockopt(m_nFd,SOL_SOCKET,SO_TIMESTAMPNS,&on,sizeof(on));
+	return 1;
+}
+
+void CRtcp::Close()
+{
+	if(m_nFd >= 0)
+		close(m_nFd);
+	m_nFd = -1;
+	m_nNextReport = 0;
+}
+
+void CRtcp::SetInterval(int ms)
+{
+	if(ms > 0)
+		m_nInterval = ms;
+}
+
+bool CRtcp::ReportDue(int64_t now)
+{
+	static std::minstd_rand rng(std::random_device{}());
+	std::uniform_real_distribution<double> dist(0.5,1.5);
+
+	if(m_nNextReport != 0 && now < m_nNextReport)
+		return false;
+	m_nNextReport = now + (int64_t)(m_nInterval * dist(rng) * 1000000);
+	return true;
+}
+
+uint64_t CRtcp::ToNtp(const struct timespec& ts)
+{
+	return ((uint64_t)(ts.tv_sec + NTP_UNIX_OFFSET) << 32) | (((uint64_t)ts.tv_nsec << 32) / 1000000000ULL);
+}
+
+uint64_t CRtcp::NtpNow()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME,&ts);
+	return ToNtp(ts);
+}
+
+uint64_t CRtcp::RtpToNtp(uint64_t sr_ntp,unsigned int sr_rtp,unsigned int ts)
+{
+	//时间戳之差按有符号数处理，ts可以在SR之前；整秒和余数分开换算，避免溢出
+	int64_t diff = (int32_t)(ts - sr_rtp);
+	int64_t sec = diff / RTCP_CLOCK_RATE;
+	int64_t rem = diff % RTCP_CLOCK_RATE;
+	return sr_ntp + (uint64_t)(sec << 32) + (uint64_t)(rem * (int64_t)(1LL << 32) / RTCP_CLOCK_RATE);
+}
+
+int CRtcp::WriteBlocks(unsigned char* buf,const RtcpReportBlock* blocks,int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		unsigned char* p = buf + 24 * i;
+		int lost = blocks[i].lost;
+		//累计丢包数为24位有符号数，超出范围时取最大/最小值
+		if(lost > 0x7fffff)
+			lost = 0x7fffff;
+		else if(lost < -0x800000)
+			lost = -0x800000;
+		put32(p,blocks[i].ssrc);
+		put32(p + 4,(blocks[i].fraction_lost << 24) | (lost & 0xffffff));
+		put32(p + 8,blocks[i].highest_seq);
+		put32(p + 12,blocks[i].jitter);
+		put32(p + 16,blocks[i].lsr);
+		put32(p + 20,blocks[i].dlsr);
+	}
+	return 24 * count;
+}
+
+int CRtcp::WriteSdes(unsigned char* buf,unsigned int ssrc) const
+{
+	int n = strlen(m_szCname);
+	//SSRC + CNAME(类型1、长度、文本) + 结束项(0)，补0到4字节对齐
+	int len = (4 + 2 + n + 1 + 3) & ~3;
+	memset(buf,0,4 + len);
+	buf[0] = 0x81;
+	buf[1] = RTCP_SDES;
+	put16(buf + 2,len / 4);
+	put32(buf + 4,ssrc);
+	buf[8] = 1;
+	buf[9] = n;
+	memcpy(buf + 10,m_szCname,n);
+	return 4 + len;
+}
+
+int CRtcp::Send(const struct sockaddr_in* to,int len)
+{
+	if(m_nFd < 0)
+		return 0;
+	while(sendto(m_nFd,m_Buf,len,0,(const struct sockaddr*)to,sizeof(*to)) < 0)
+	{
+		if(errno == EINTR)
+			continue;
+		printf("%s: ====haoge====send rtcp error: %s\n",__FUNCTION__,strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+int CRtcp::SendSr(const struct sockaddr_in* to,unsigned int ssrc,uint64_t ntp,unsigned int rtp,unsigned int packets,unsigned int octets,
+	const RtcpReportBlock* blocks,int count)
+{
+	if(count > RTCP_MAX_BLOCKS)
+		count = RTCP_MAX_BLOCKS;
+	int len = 28 + 24 * count;
+	m_Buf[0] = 0x80 | count;
+	m_Buf[1] = RTCP_SR;
+	put16(m_Buf + 2,len / 4 - 1);
+	put32(m_Buf + 4,ssrc);
+	put32(m_Buf + 8,ntp >> 32);
+	put32(m_Buf + 12,(unsigned int)ntp);
+	put32(m_Buf + 16,rtp);
+	put32(m_Buf + 20,packets);
+	put32(m_Buf + 24,octets);
+	WriteBlocks(m_Buf + 28,blocks,count);
+	len += WriteSdes(m_Buf + len,ssrc);
+	return Send(to,len);
+}
+
+int CRtcp::SendRr(const struct sockaddr_in* to,const RtcpReportBlock* blocks,int count)
+{
+	if(count > RTCP_MAX_BLOCKS)
+		count = RTCP_MAX_BLOCKS;
+	int len = 8 + 24 * count;
+	m_Buf[0] = 0x80 | count;
+	m_Buf[1] = RTCP_RR;
+	put16(m_Buf + 2,len / 4 - 1);
+	put32(m_Buf + 4,m_nSsrc);
+	WriteBlocks(m_Buf + 8,blocks,count);
+	len += WriteSdes(m_Buf + len,m_nSsrc);
+	return Send(to,len);
+}
+
+int CRtcp::SendNack(const struct sockaddr_in* to,unsigned int media_ssrc,const unsigned short* seqs,int count)
+{
+	int len = 12;
+
+	if(count <= 0)
+		return 0;
+	if(count > RTCP_MAX_NACKS)
+		count = RTCP_MAX_NACKS;
+	//PID之后16个序列号内丢失的包用BLP的位表示，其余的另起一个FCI
+	for(int i = 0; i < count; )
+	{
+		unsigned short pid = seqs[i++];
+		unsigned int blp = 0;
+		while(i < count && (unsigned short)(seqs[i] - pid) >= 1 && (unsigned short)(seqs[i] - pid) <= 16)
+			blp |= 1 << ((unsigned short)(seqs[i++] - pid) - 1);
+		put16(m_Buf + len,pid);
+		put16(m_Buf + len + 2,blp);
+		len += 4;
+	}
+	m_Buf[0] = 0x80 | RTCP_FMT_NACK;
+	m_Buf[1] = RTCP_RTPFB;
+	put16(m_Buf + 2,len / 4 - 1);
+	put32(m_Buf + 4,m_nSsrc);
+	put32(m_Buf + 8,media_ssrc);
+	return Send(to,len);
+}
+
+int CRtcp::SendTransportFeedback(const struct sockaddr_in* to,unsigned int media_ssrc,unsigned short base,int fb_count,const int64_t* arrival,int count)
+{
+	unsigned char sym[RTCP_MAX_TWCC];
+	int deltas[RTCP_MAX_TWCC];
+	int len = 20,n;
+
+	if(count > RTCP_MAX_TWCC)
+		count = RTCP_MAX_TWCC;
+	for(n = 0; n < count && arrival[n] < 0; n++)
+		;
+	if(n == count)
+		return 0;
+	//参考时刻为第一个收到的包的到达时刻按64ms向下取整，之后每个收到的包相对于上一个的间隔按250us取整，误差不累积
+	int64_t ref = arrival[n] / 64000;
+	int64_t prev = ref * 64000;
+	for(n = 0; n < count; n++)
+	{
+		if(arrival[n] < 0)
+		{
+			sym[n] = 0;
+			continue;
+		}
+		int64_t d = (arrival[n] - prev) / 250;
+		if(d < -32768 || d > 32767)
+			break;
+		sym[n] = (d >= 0 && d <= 255) ? 1 : 2;
+		deltas[n] = (int)d;
+		prev += d * 250;
+	}
+	count = n;
+
+	//包状态：连续相同的状态不少于14个时用游程编码，否则用7个2位状态的状态向量
+	for(int i = 0; i < count; )
+	{
+		int run = 1;
+		unsigned int chunk;
+		while(i + run < count && sym[i + run] == sym[i] && run < 0x1fff)
+			run++;
+		if(run >= 14)
+		{
+			chunk = (sym[i] << 13) | run;
+			i += run;
+		}
+		else
+		{
+			chunk = 0xc000;
+			for(int k = 0; k < 7 && i + k < count; k++)
+				chunk |= sym[i + k] << (12 - 2 * k);
+			i += 7;
+		}
+		put16(m_Buf + len,chunk);
+		len += 2;
+	}
+	for(int i = 0; i < count; i++)
+	{
+		if(sym[i] == 1)
+			m_Buf[len++] = deltas[i];
+		else if(sym[i] == 2)
+		{
+			put16(m_Buf + len,deltas[i] & 0xffff);
+			len += 2;
+		}
+	}
+	//补齐到4字节：P位置1，最后一个字节为填充的字节数
+	int pad = (4 - len % 4) % 4;
+	if(pad > 0)
+	{
+		memset(m_Buf + len,0,pad);
+		len += pad;
+		m_Buf[len - 1] = pad;
+	}
+	m_Buf[0] = 0x80 | (pad > 0 ? 0x20 : 0) | RTCP_FMT_TWCC;
+	m_Buf[1] = RTCP_RTPFB;
+	put16(m_Buf + 2,len / 4 - 1);
+	put32(m_Buf + 4,m_nSsrc);
+	put32(m_Buf + 8,media_ssrc);
+	put16(m_Buf + 12,base);
+	put16(m_Buf + 14,count);
+	m_Buf[16] = ref >> 16;
+	m_Buf[17] = ref >> 8;
+	m_Buf[18] = ref;
+	m_Buf[19] = fb_count;
+	return Send(to,len) ? count : 0;
+}
+
+void CRtcp::ParseTransportFeedback(const unsigned char* p,int size,RtcpReport* report)
+{
+	unsigned char sym[RTCP_MAX_TWCC];
+	int off = 20,i = 0;
+
+	if(size < 20)
+		return;
+	int total = (p[14] << 8) | p[15];
+	int ref = (p[16] << 16) | (p[17] << 8) | p[18];
+	if(ref & 0x800000)
+		ref -= 0x1000000;
+
+	//先读完所有的包状态才知道recv delta从哪里开始，只保留前RTCP_MAX_TWCC个
+	while(i < total)
+	{
+		if(off + 2 > size)
+			return;
+		unsigned int chunk = (p[off] << 8) | p[off + 1];
+		off += 2;
+		if(!(chunk & 0x8000))
+		{
+			for(int k = 0; k < (int)(chunk & 0x1fff) && i < total; k++, i++)
+			{
+				if(i < RTCP_MAX_TWCC)
+					sym[i] = (chunk >> 13) & 3;
+			}
+		}
+		else if(!(chunk & 0x4000))
+		{
+			for(int k = 0; k < 14 && i < total; k++, i++)
+			{
+				if(i < RTCP_MAX_TWCC)
+					sym[i] = (chunk >> (13 - k)) & 1;
+			}
+		}
+		else
+		{
+			for(int k = 0; k < 7 && i < total; k++, i++)
+			{
+				if(i < RTCP_MAX_TWCC)
+					sym[i] = (chunk >> (12 - 2 * k)) & 3;
+			}
+		}
+	}
+
+	int64_t t = (int64_t)ref * 64000;
+	int n = total < RTCP_MAX_TWCC ? total : RTCP_MAX_TWCC;
+	for(i = 0; i < n; i++)
+	{
+		if(sym[i] == 1 && off + 1 <= size)
+		{
+			t += p[off] * 250;
+			off += 1;
+		}
+		else if(sym[i] == 2 && off + 2 <= size)
+		{
+			t += (int16_t)((p[off] << 8) | p[off + 1]) * 250;
+			off += 2;
+		}
+		else if(sym[i] == 1 || sym[i] == 2)
+			break;
+		else
+		{
+			//状态3保留，当作没有收到
+			report->twcc_arrival[i] = -1;
+			continue;
+		}
+		report->twcc_arrival[i] = t;
+	}
+	report->twcc_ssrc = get32(p + 8);
+	report->twcc_base = (p[12] << 8) | p[13];
+	report->twcc_fb_count = p[19];
+	report->twcc_count = i;
+}
+
+int CRtcp::Parse(const unsigned char* buf,int len,RtcpReport* report)
+{
+	int off = 0;
+
+	report->has_report = 0;
+	report->has_sr = 0;
+	report->count = 0;
+	report->nack_count = 0;
+	report->twcc_count = 0;
+
+	//复合包由多个RTCP包连接而成，每个包的长度字段为32位字数减1
+	while(off + 4 <= len)
+	{
+		const unsigned char* p = buf + off;
+		int size = (((p[2] << 8) | p[3]) + 1) * 4;
+		int count = p[0] & 0x1f;
+		if((p[0] >> 6) != 2 || off + size > len)
+			return 0;
+		off += size;
+
+		if(p[1] == RTCP_RTPFB && count == RTCP_FMT_NACK && size >= 12)
+		{
+			if(!report->has_report)
+				report->ssrc = get32(p + 4);
+			report->nack_ssrc = get32(p + 8);
+			for(int k = 12; k + 4 <= size; k += 4)
+			{
+				unsigned short pid = (p[k] << 8) | p[k + 1];
+				unsigned int blp = (p[k + 2] << 8) | p[k + 3];
+				for(int b = -1; b < 16; b++)
+				{
+					if((b < 0 || (blp & (1 << b))) && report->nack_count < RTCP_MAX_NACKS)
+						report->nacks[report->nack_count++] = pid + b + 1;
+				}
+			}
+			continue;
+		}
+		if(p[1] == RTCP_RTPFB && count == RTCP_FMT_TWCC && report->twcc_count == 0)
+		{
+			if(!report->has_report)
+				report->ssrc = get32(p + 4);
+			//有填充时最后一个字节为填充的字节数
+			int padding = (p[0] & 0x20) ? p[size - 1] : 0;
+			if(padding <= size - 20)
+				ParseTransportFeedback(p,size - padding,report);
+			continue;
+		}
+
+		//只取第一个SR或RR
+		int head;
+		if(report->has_report)
+			continue;
+		if(p[1] == RTCP_SR && size >= 28)
+		{
+			report->has_sr = 1;
+			report->ntp = ((uint64_t)get32(p + 8) << 32) | get32(p + 12);
+			report->rtp = get32(p + 16);
+			report->packets = get32(p + 20);
+			report->octets = get32(p + 24);
+			head = 28;
+		}
+		else if(p[1] == RTCP_RR && size >= 8)
+		{
+			report->has_sr = 0;
+			head = 8;
+		}
+		else
+			continue;
+
+		report->ssrc = get32(p + 4);
+		if(head + 24 * count > size)
+			count = (size - head) / 24;
+		report->count = count;
+		for(int i = 0; i < count; i++)
+		{
+			const unsigned char* b = p + head + 24 * i;
+			unsigned int v = get32(b + 4);
+			RtcpReportBlock& block = report->blocks[i];
+			block.ssrc = get32(b);
+			block.fraction_lost = v >> 24;
+			block.lost = (v & 0x800000) ? (int)(v & 0xffffff) - 0x1000000 : (int)(v & 0xffffff);
+			block.highest_seq = get32(b + 8);
+			block.jitter = get32(b + 12);
+			block.lsr = get32(b + 16);
+			block.dlsr = get32(b + 20);
+		}
+		report->has_report = 1;
+	}
+	return report->has_report || report->nack_count > 0 || report->twcc_count > 0;
+}
+
+int CRtcp::Read(RtcpReport* report,struct sockaddr_in* from)
+{
+	struct sockaddr_in addr;
+	struct iovec iov;
+	struct msghdr msg;
+	char ctrl[CMSG_SPACE(sizeof(struct timespec))];
+
+	if(m_nFd < 0)
+		return 0;
+	iov.iov_base = m_Buf;
+	iov.iov_len = sizeof(m_Buf);
+	memset(&msg,0,sizeof(msg));
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+	int len = recvmsg(m_nFd,&msg,MSG_DONTWAIT);
+	if(len < 0)
+		return (errno == EINTR) ? -1 : 0;
+	if(from != NULL)
+		*from = addr;
+	if(!Parse(m_Buf,len,report))
+		return -1;
+
+	//到达时刻取内核的时间戳，没有时用当前时刻
+	report->arrival = 0;
+	for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg,cm))
+	{
+		if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			struct timespec ts;
+			memcpy(&ts,CMSG_DATA(cm),sizeof(ts));
+			report->arrival = ToNtp(ts);
+		}
+	}
+	if(report->arrival == 0)
+		report->arrival = NtpNow();
+	return 1;
+}
+
@@ -0,0 +1,292 @@
+/*************************************************************************
+    > File Name: CRtcp.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 02时05分12秒
+ ************************************************************************/
+
+#ifndef CRTCP_H
+#define CRTCP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+//RTCP包类型
+#define RTCP_SR                 200
+#define RTCP_RR                 201
+#define RTCP_SDES               202
+#define RTCP_BYE                203
+//RFC 4585传输层反馈，FMT为1时是通用NACK
+#define RTCP_RTPFB              205
+#define RTCP_FMT_NACK           1
+//一个包中最多请求重传的序列号数
+#define RTCP_MAX_NACKS          256
+//FMT为15时是传输层拥塞控制反馈(draft-holmer-rmcat-transport-wide-cc-extensions-01)
+#define RTCP_FMT_TWCC           15
+//一个拥塞控制反馈包最多报告的包数
+#define RTCP_MAX_TWCC           256
+//一个SR/RR最多的报告块数(RC字段为5位)
+#define RTCP_MAX_BLOCKS         31
+//默认的报告间隔。RFC 3550建议最小5秒，视频的码率较高，按6.2节的缩短最小间隔(360/kbps秒)用1秒
+#define RTCP_INTERVAL_MS        1000
+#define RTCP_MAX_PKT_SIZE       1500
+//H.264的RTP时钟频率
+#define RTCP_CLOCK_RATE         90000
+
+/******************************************************************
+RTCP SR (RFC 3550 6.4.1)，RR的格式相同，只是没有发送者信息
+0                   1                   2                   3
+0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|V=2|P|    RC   |   PT=SR=200   |             length            |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                         SSRC of sender                        |
++=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+|              NTP timestamp, most significant word             |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|             NTP timestamp, least significant word             |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                         RTP timestamp                         |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                     sender's packet count                     |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                      sender's octet count                     |
++=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+|                 SSRC_1 (SSRC of first source)                 |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+| fraction lost |       cumulative number of packets lost       |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|           extended highest sequence number received           |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                      interarrival jitter                      |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                         last SR (LSR)                         |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                   delay since last SR (DLSR)                  |
++=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+******************************************************************/
+
+/******************************************************************
+通用NACK (RFC 4585 6.2.1)，FCI可以有多个，每个请求PID以及其后BLP中置位的序列号
+0                   1                   2                   3
+0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|V=2|P| FMT=1   |   PT=RTPFB=205|             length            |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                  SSRC of packet sender                        |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                  SSRC of media source                         |
++=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+|            PID                |             BLP               |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+******************************************************************/
+
+/******************************************************************
+传输层拥塞控制反馈，报告一段连续的传输序列号各自是否收到以及到达时刻
+0                   1                   2                   3
+0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|V=2|P|  FMT=15 |   PT=RTPFB=205|             length            |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                  SSRC of packet sender                        |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                  SSRC of media source                         |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|      base sequence number     |      packet status count      |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                 reference time                | fb pkt. count |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|          packet chunk         |         packet chunk          |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+.                                                               .
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|         packet chunk          |  recv delta   |  recv delta   |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+.                                                               .
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+reference time为24位有符号数，单位64ms；packet chunk为游程编码(最高位0：2位状态、13位游程长度)
+或状态向量(最高位1：次高位0时14个1位状态，1时7个2位状态)，状态0为没有收到，1为小间隔(recv delta 1字节)，
+2为大间隔或负间隔(recv delta 2字节有符号)；recv delta单位250us，第一个相对于reference time，之后相对于上一个收到的包
+******************************************************************/
+
+/**
+ * _RtcpReportBlock
+ * SR/RR中的一个报告块
+ */
+typedef struct _RtcpReportBlock
+{
+	unsigned int ssrc;            //被报告的媒体源
+	unsigned int fraction_lost;   //上一个报告之后的丢包率，单位1/256
+	int lost;                     //累计丢包数，24位有符号(有重复包时可能为负)
+	unsigned int highest_seq;     //扩展的最大序列号(高16位为回绕次数)
+	unsigned int jitter;          //到达抖动，单位为RTP时间戳
+	unsigned int lsr;             //最近收到的SR的NTP时间戳中间32位，没有收到过SR为0
+	unsigned int dlsr;            //收到该SR到发送本报告的时间，单位1/65536秒
+}RtcpReportBlock;
+
+/**
+ * _RtcpReport
+ * 从一个复合RTCP包中解析出的SR或RR以及NACK
+ */
+typedef struct _RtcpReport
+{
+	unsigned int ssrc;            //发送该报告的SSRC
+	int has_report;               //有SR或RR
+	int has_sr;                   //是SR，下面的发送者信息有效
+	uint64_t ntp;                 //发送者信息：NTP时间戳(64位定点数，高32位为秒)
+	unsigned int rtp;             //与ntp同一时刻的RTP时间戳
+	unsigned int packets;         //已发送的RTP包数
+	unsigned int octets;          //已发送的负载字节数
+	uint64_t arrival;             //内核收到该包的时刻(NTP时间戳)，计算RTT、DLSR时不包括应用程序读取前的等待
+	int count;
+	RtcpReportBlock blocks[RTCP_MAX_BLOCKS];
+	unsigned int nack_ssrc;       //NACK请求重传的媒体源
+	int nack_count;
+	unsigned short nacks[RTCP_MAX_NACKS];
+	unsigned int twcc_ssrc;       //拥塞控制反馈对应的媒体源
+	int twcc_count;               //反馈中报告的包数，0表示没有反馈
+	unsigned short twcc_base;     //第一个包的传输序列号
+	int twcc_fb_count;            //反馈包的序号(8位)
+	int64_t twcc_arrival[RTCP_MAX_TWCC]; //各包的到达时刻(接收端的时钟)，单位微秒，小于0表示没有收到
+}RtcpReport;
+
+/**
+ * _RtcpStats
+ * 一个SSRC的传输统计，发送端由收到的RR得到，接收端由收到的RTP包和SR得到
+ */
+typedef struct _RtcpStats
+{
+	unsigned int ssrc;            //媒体源的SSRC
+	uint64_t packets;             //发送端为已发送的包数，接收端为收到的包数
+	uint64_t octets;              //负载字节数，接收端为SR中发送端给出的值
+	int64_t expected;             //接收端：按序列号范围应当收到的包数
+	int64_t lost;                 //累计丢包数
+	double fraction_lost;         //最近一个报告间隔的丢包率，0~1
+	unsigned int highest_seq;     //扩展的最大序列号
+	double jitter;                //RFC 3550到达抖动，单位毫秒
+	double rtt;                   //往返时间，单位毫秒，小于0表示未知(只有发送端能计算)
+	uint64_t reports;             //发送端为收到的RR数，接收端为收到的SR数
+	uint64_t sr_ntp;              //最近一个SR的NTP时间戳和RTP时间戳，用于音视频同步，0表示还没有
+	unsigned int sr_rtp;
+	uint64_t nacks;               //发送端为收到的NACK请求的包数，接收端为发出NACK请求的包数
+	uint64_t repaired;            //发送端为重传的包数，接收端为请求之后收到的包数
+}RtcpStats;
+
+/**
+ * RTCP(RFC 3550)：生成并发送SR、RR(复合包中带SDES CNAME)，接收并解析对端的SR、RR。
+ * 只负责报文和套接字，统计的计算由CRtpH264(发送端)和CRtpH264Receiver(接收端)完成
+ */
+class CRtcp
+{
+private:
+	int m_nFd;
+	unsigned int m_nSsrc;                  //本端发送RR时使用的SSRC
+	char m_szCname[64];
+	int m_nInterval;                       //报告间隔，毫秒
+	int64_t m_nNextReport;                 //下一次报告的时刻(CLOCK_MONOTONIC纳秒)，0表示还没有开始
+	unsigned char m_Buf[RTCP_MAX_PKT_SIZE];
+
+	//在buf中写SR/RR的报告块，返回写入的字节数
+	static int WriteBlocks(unsigned char* buf,const RtcpReportBlock* blocks,int count);
+	//在buf中写SDES CNAME，返回写入的字节数
+	int WriteSdes(unsigned char* buf,unsigned int ssrc) const;
+	int Send(const struct sockaddr_in* to,int len);
+	//解析一个拥塞控制反馈包(size字节，已去掉填充)，结果存入report的twcc_*
+	static void ParseTransportFeedback(const unsigned char* p,int size,RtcpReport* report);
+
+public:
+	CRtcp();
+	~CRtcp();
+
+	/**
+	 * 创建UDP套接字并绑定端口
+	 * @param port 本地端口，0表示由系统分配(发送端)
+	 * @param ip 本地地址
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Open(int port,const char* ip = "0.0.0.0");
+	void Close();
+	int Fd() const { return m_nFd; }
+
+	void SetSsrc(unsigned int ssrc) { m_nSsrc = ssrc; }
+	unsigned int Ssrc() const { return m_nSsrc; }
+	//报告间隔，毫秒
+	void SetInterval(int ms);
+
+	/**
+	 * 是否到了发送报告的时刻。到了则按RFC 3550 6.3.1在[0.5,1.5]倍间隔内随机确定下一次的时刻，
+	 * 避免多个接收端同步发送
+	 */
+	bool ReportDue(int64_t now);
+	//下一次报告的时刻，CLOCK_MONOTONIC纳秒
+	int64_t NextReportTime() const { return m_nNextReport; }
+
+	/**
+	 * 发送SR + SDES
+	 * @param to 目的地址
+	 * @param ssrc 发送端的SSRC
+	 * @param ntp 当前的NTP时间戳
+	 * @param rtp 与ntp同一时刻的RTP时间戳
+	 * @param packets,octets 已发送的包数和负载字节数
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int SendSr(const struct sockaddr_in* to,unsigned int ssrc,uint64_t ntp,unsigned int rtp,unsigned int packets,unsigned int octets,
+		const RtcpReportBlock* blocks,int count);
+
+	/**
+	 * 发送RR + SDES，SSRC为SetSsrc设置的值
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int SendRr(const struct sockaddr_in* to,const RtcpReportBlock* blocks,int count);
+
+	/**
+	 * 发送通用NACK(RFC 5506的精简RTCP包，不带RR)，SSRC为SetSsrc设置的值
+	 * @param media_ssrc 请求重传的媒体源
+	 * @param seqs 丢失的序列号，按发送顺序排列
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int SendNack(const struct sockaddr_in* to,unsigned int media_ssrc,const unsigned short* seqs,int count);
+
+	/**
+	 * 发送传输层拥塞控制反馈(RFC 5506的精简RTCP包)，SSRC为SetSsrc设置的值
+	 * @param media_ssrc 媒体源
+	 * @param base 第一个包的传输序列号
+	 * @param fb_count 反馈包的序号，每发送一个加1
+	 * @param arrival 从base开始各包的到达时刻，单位微秒，小于0表示没有收到，至少要有一个收到的包
+	 * @param count 包数，最多RTCP_MAX_TWCC
+	 * @返回报告了的包数(相邻两个到达时刻相差太大时只报告前面的部分) , 失败则返回 0
+	 */
+	int SendTransportFeedback(const struct sockaddr_in* to,unsigned int media_ssrc,unsigned short base,int fb_count,const int64_t* arrival,int count);
+
+	/**
+	 * 不等待地读取一个RTCP包并解析其中的SR、RR、NACK和拥塞控制反馈
+	 * @param report 存储解析结果
+	 * @param from 存储对端地址，可以为NULL
+	 * @读到SR、RR、NACK或拥塞控制反馈则返回 1 , 没有数据则返回 0 ; 其他RTCP包(如只有SDES、BYE)或无效的包返回 -1，可以继续读
+	 */
+	int Read(RtcpReport* report,struct sockaddr_in* from);
+
+	/**
+	 * 解析一个复合RTCP包，取其中第一个SR或RR、所有NACK以及第一个拥塞控制反馈
+	 * @成功则返回 1 , 没有SR/RR/NACK/拥塞控制反馈或包无效则返回 0
+	 */
+	static int Parse(const unsigned char* buf,int len,RtcpReport* report);
+
+	//当前时刻的NTP时间戳(64位定点数，从1900年开始的秒数)
+	static uint64_t NtpNow();
+	//CLOCK_REALTIME的时刻换算成NTP时间戳
+	static uint64_t ToNtp(const struct timespec& ts);
+	//NTP时间戳的中间32位，即LSR、DLSR使用的1/65536秒单位
+	static unsigned int NtpMiddle(uint64_t ntp) { return (unsigned int)(ntp >> 16); }
+	/**
+	 * 按SR中NTP时间戳和RTP时间戳的对应关系，把RTP时间戳换算成发送端的NTP时间戳
+	 */
+	static uint64_t RtpToNtp(uint64_t sr_ntp,unsigned int sr_rtp,unsigned int ts);
+};
+
+#endif
+
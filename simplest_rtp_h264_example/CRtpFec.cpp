@@ -0,0 +1,183 @@
+/*************************************************************************
+    > File Name: CRtpFec.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 03时12分40秒
+ ************************************************************************/
+
+#include "CRtpFec.h"
+
+CRtpFec::CRtpFec() : m_nL(0),m_nD(0),m_nIndex(0),m_nOut(0)
+{
+	m_Row.count = 0;
+	Reset(m_Row);
+}
+
+CRtpFec::~CRtpFec()
+{
+
+}
+
+void CRtpFec::Reset(Group& g)
+{
+	//只清零用过的部分，缓冲区保留给下一组
+	if(g.count > 0)
+		memset(&g.bits[0],0,8 + g.len);
+	g.len = 0;
+	g.count = 0;
+	g.ts.clear();
+}
+
+void CRtpFec::Xor(unsigned char* dst,const unsigned char* src,size_t n)
+{
+	size_t i = 0;
+	//每次8字节，memcpy避免非对齐访问
+	for(; i + 8 <= n; i += 8)
+	{
+		uint64_t a,b;
+		memcpy(&a,dst + i,8);
+		memcpy(&b,src + i,8);
+		a ^= b;
+		memcpy(dst + i,&a,8);
+	}
+	for(; i < n; i++)
+		dst[i] ^= src[i];
+}
+
+void CRtpFec::XorPacket(unsigned char* bits,const unsigned char* pkt,int len)
+{
+	//位串：包头前2字节、长度(包长减12)、时间戳，之后是RTP固定包头后面的所有字节
+	bits[0] ^= pkt[0];
+	bits[1] ^= pkt[1];
+	bits[2] ^= (len - 12) >> 8;
+	bits[3] ^= (len - 12) & 0xff;
+	Xor(bits + 4,pkt + 4,4);
+	Xor(bits + 8,pkt + 12,len - 12);
+}
+
+int CRtpFec::ParseHeader(const unsigned char* fec,int len,unsigned short* sn_base,int* L,int* D)
+{
+	//R=0、F=1：固定间隔的L、D
+	if(len < RTP_FEC_HDR_LEN || (fec[0] >> 6) != 1)
+		return 0;
+	*sn_base = (fec[8] << 8) | fec[9];
+	*L = fec[10];
+	*D = fec[11];
+	//length recovery是长度的异或，恢复出来之后才能检查
+	if(*L == 0)
+		return 0;
+	return 1;
+}
+
+void CRtpFec::Add(Group& g,const struct iovec* iov,int iovcnt,unsigned int len)
+{
+	const unsigned char* hdr = (const unsigned char*)iov[0].iov_base;
+	unsigned int pos = 8;
+
+	if(g.bits.size() < 8 + len - 12)
+		g.bits.resize(8 + len - 12);
+	if(len - 12 > g.len)
+		g.len = len - 12;
+	if(g.count == 0)
+		g.base = (hdr[2] << 8) | hdr[3];
+	g.count++;
+	g.ts.push_back(((unsigned int)hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7]);
+
+	//包头在第一段，负载分散在各段(包头存储区和NALU数据)，逐段异或
+	unsigned char* bits = &g.bits[0];
+	bits[0] ^= hdr[0];
+	bits[1] ^= hdr[1];
+	bits[2] ^= (len - 12) >> 8;
+	bits[3] ^= (len - 12) & 0xff;
+	Xor(bits + 4,hdr + 4,4);
+	Xor(bits + pos,hdr + 12,iov[0].iov_len - 12);
+	pos += iov[0].iov_len - 12;
+	for(int i = 1; i < iovcnt; i++)
+	{
+		Xor(bits + pos,(const unsigned char*)iov[i].iov_base,iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+}
+
+void CRtpFec::Emit(Group& g,int L,int D)
+{
+	if(m_nOut == (int)m_Out.size())
+		m_Out.resize(m_nOut + 1);
+	RtpFecPacket& p = m_Out[m_nOut++];
+	const unsigned char* bits = &g.bits[0];
+
+	p.len = RTP_FEC_HDR_LEN + g.len;
+	if(p.data.size() < p.len)
+		p.data.resize(p.len);
+	unsigned char* d = &p.data[0];
+	//前2位为R=0、F=1，其余为包头前2字节、长度和时间戳的异或
+	d[0] = 0x40 | (bits[0] & 0x3f);
+	d[1] = bits[1];
+	memcpy(d + 2,bits + 2,6);
+	d[8] = g.base >> 8;
+	d[9] = g.base & 0xff;
+	d[10] = L;
+	d[11] = D;
+	memcpy(d + RTP_FEC_HDR_LEN,bits + 8,g.len);
+	p.sn_base = g.base;
+	p.timestamp = g.ts.back();
+	p.ts = g.ts;
+	Reset(g);
+}
+
+void CRtpFec::BeginFrame(int L,int D)
+{
+	//上一帧没有结束时先生成它剩下的FEC包
+	EndFrame();
+	m_nL = (L > 0 && L <= RTP_FEC_MAX_LD) ? L : 0;
+	m_nD = (D >= 2 && D <= RTP_FEC_MAX_LD) ? D : 0;
+	m_nIndex = 0;
+	if(m_nD > 0 && (int)m_Cols.size() < m_nL)
+	{
+		size_t n = m_Cols.size();
+		m_Cols.resize(m_nL);
+		for(size_t i = n; i < m_Cols.size(); i++)
+		{
+			m_Cols[i].count = 0;
+			Reset(m_Cols[i]);
+		}
+	}
+}
+
+void CRtpFec::AddPacket(const struct iovec* iov,int iovcnt,unsigned int len)
+{
+	if(m_nL == 0 || len < 12 || iov[0].iov_len < 12)
+		return;
+	Add(m_Row,iov,iovcnt,len);
+	if(m_nD > 0)
+		Add(m_Cols[m_nIndex % m_nL],iov,iovcnt,len);
+	m_nIndex++;
+
+	//一行满了生成行FEC，一块满了生成各列的列FEC
+	if(m_Row.count == m_nL)
+		Emit(m_Row,m_nL,0);
+	if(m_nD > 0 && m_nIndex == m_nL * m_nD)
+	{
+		for(int i = 0; i < m_nL; i++)
+			Emit(m_Cols[i],m_nL,m_Cols[i].count);
+		m_nIndex = 0;
+	}
+}
+
+void CRtpFec::EndFrame()
+{
+	if(m_nL == 0)
+		return;
+	//不满的行按实际包数作为L；只有一个包的列等于复制一份，由行FEC保护即可
+	if(m_Row.count > 0)
+		Emit(m_Row,m_Row.count,0);
+	for(int i = 0; m_nD > 0 && i < m_nL; i++)
+	{
+		if(m_Cols[i].count >= 2)
+			Emit(m_Cols[i],m_nL,m_Cols[i].count);
+		else
+			Reset(m_Cols[i]);
+	}
+	m_nIndex = 0;
+	m_nL = 0;
+}
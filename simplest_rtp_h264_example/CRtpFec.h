@@ -0,0 +1,120 @@
+/*************************************************************************
+    > File Name: CRtpFec.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 03时12分40秒
+ ************************************************************************/
+
+#ifndef CRTP_FEC_H
+#define CRTP_FEC_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <vector>
+
+//FEC流默认的负载类型
+#define RTP_FEC_PT              98
+//FEC头的长度(跟在FEC包的RTP固定包头后面)
+#define RTP_FEC_HDR_LEN         12
+//L、D字段为8位
+#define RTP_FEC_MAX_LD          255
+
+/******************************************************************
+FEC头，按RFC 8627(FlexFEC)固定间隔(F=1)的格式
+0                   1                   2                   3
+0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|0|1|P|X|  CC   |M| PT recovery |        length recovery        |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                          TS recovery                          |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|           SN base             |  L (columns)  |    D (rows)   |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|                        repair payload ...                     |
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+每个受保护的包取出"位串"：RTP包头的前2字节、2字节的长度(包长减12)、4字节的时间戳，后面是RTP固定包头之后的所有字节，
+短的包后面补0，所有位串异或得到FEC头的前8字节和修复负载。受保护的包中只丢了一个时，其余的包与FEC包异或就恢复出它。
+D为0时是行FEC，保护从SN base开始连续的L个包；D不为0时是列FEC，保护SN base、SN base+L、...共D个包
+******************************************************************/
+
+/**
+ * _RtpFecPacket
+ * 生成的一个FEC包：FEC头加修复负载。SN base和TS recovery按原始的包头计算，
+ * 扇出时目的地址改写了序列号和时间戳，发送前按ts重新计算TS recovery
+ */
+typedef struct _RtpFecPacket
+{
+	std::vector<unsigned char> data;  //FEC头和修复负载
+	unsigned int len;
+	unsigned short sn_base;
+	unsigned int timestamp;           //最后一个受保护包的时间戳，用作FEC包自己的RTP时间戳
+	std::vector<unsigned int> ts;     //受保护包的时间戳
+}RtpFecPacket;
+
+/**
+ * 异或FEC编码：一个访问单元的包按行排成L列D行的块，每行生成一个行FEC包，块有多行时每列再生成一个列FEC包。
+ * 分组不跨访问单元，所以每帧可以用不同的保护强度，恢复也不用等后面的帧；代价是帧结束时不满的行和列也生成FEC包，
+ * 包数少于L的帧冗余为1/包数而不是1/L
+ */
+class CRtpFec
+{
+private:
+	typedef struct _Group
+	{
+		std::vector<unsigned char> bits;  //位串的异或，前8字节对应FEC头，之后为修复负载
+		unsigned int len;                 //最长的负载长度
+		int count;
+		unsigned short base;
+		std::vector<unsigned int> ts;
+	}Group;
+
+	int m_nL;
+	int m_nD;
+	int m_nIndex;                         //当前包在块中的位置
+	Group m_Row;
+	std::vector<Group> m_Cols;
+	std::vector<RtpFecPacket> m_Out;
+	int m_nOut;
+
+	void Reset(Group& g);
+	void Add(Group& g,const struct iovec* iov,int iovcnt,unsigned int len);
+	void Emit(Group& g,int L,int D);
+
+public:
+	CRtpFec();
+	~CRtpFec();
+
+	/**
+	 * 开始一帧，L为每行的包数，D为每块的行数：L为0时不保护，D小于2时只有行FEC
+	 */
+	void BeginFrame(int L,int D);
+	/**
+	 * 加入一个已发送的媒体包
+	 * @param iov 包的各段，第一段从RTP固定包头开始且不短于12字节
+	 * @param len 包长
+	 */
+	void AddPacket(const struct iovec* iov,int iovcnt,unsigned int len);
+	//帧结束，不满的行和列也生成FEC包
+	void EndFrame();
+
+	//已生成还没有取走的FEC包
+	int Count() const { return m_nOut; }
+	const RtpFecPacket& Packet(int i) const { return m_Out[i]; }
+	void Clear() { m_nOut = 0; }
+
+	//dst ^= src
+	static void Xor(unsigned char* dst,const unsigned char* src,size_t n);
+	/**
+	 * 把受保护包的位串异或到bits上，bits的长度不小于8 + len - 12
+	 */
+	static void XorPacket(unsigned char* bits,const unsigned char* pkt,int len);
+	/**
+	 * 解析FEC头
+	 * @成功则返回 1 , 不是固定间隔格式或长度不对则返回 0
+	 */
+	static int ParseHeader(const unsigned char* fec,int len,unsigned short* sn_base,int* L,int* D);
+};
+
+#endif
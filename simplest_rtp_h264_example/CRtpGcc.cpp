@@ -0,0 +1,370 @@
+/*************************************************************************
+    > File Name: CRtpGcc.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 04时21分37秒
+ ************************************************************************/
+
+#include <math.h>
+#include "CRtpGcc.h"
+
+//码率控制的状态
+#define RC_HOLD                 0
+#define RC_INCREASE             1
+#define RC_DECREASE             2
+
+CRtpGcc::CRtpGcc() : m_fStart(RTP_GCC_START_BPS),m_fMin(RTP_GCC_MIN_BPS),m_fMax(RTP_GCC_MAX_BPS)
+{
+	Reset();
+}
+
+CRtpGcc::~CRtpGcc()
+{
+
+}
+
+void CRtpGcc::Reset()
+{
+	m_fDelayRate = m_fStart;
+	m_fLossRate = m_fMax;
+	m_fRtt = 100;
+	m_bCur = false;
+	m_bPrev = false;
+	m_nDeltas = 0;
+	m_fAccDelay = 0;
+	m_fSmoothed = 0;
+	m_fFirstArrival = 0;
+	m_Window.clear();
+	m_fTrend = 0;
+	m_fThreshold = 12.5;
+	m_fLastThreshold = -1;
+	m_fOverTime = -1;
+	m_nOverCount = 0;
+	m_fPrevTrend = 0;
+	m_nState = RTP_GCC_NORMAL;
+	m_nRcState = RC_HOLD;
+	m_fLastChange = -1;
+	m_fLastDecrease = -1;
+	m_fAvgMax = -1;
+	m_fVarMax = 0.4;
+	m_Acked.clear();
+	m_nAckedBytes = 0;
+	m_nLossPkts = 0;
+	m_nLossLost = 0;
+	m_fLoss = 0;
+	m_fLastLossDecrease = -1;
+	m_fLastLossUpdate = -1;
+	m_nFeedbacks = 0;
+	m_nOveruses = 0;
+}
+
+void CRtpGcc::SetBitrates(double start,double min,double max)
+{
+	if(min <= 0 || max < min)
+		return;
+	m_fMin = min;
+	m_fMax = max;
+	m_fStart = start < min ? min : (start > max ? max : start);
+	Reset();
+}
+
+void CRtpGcc::OnFeedback(const RtpPacketResult* pkts,int count,int64_t now)
+{
+	int lost = 0;
+
+	m_nFeedbacks++;
+	for(int i = 0; i < count; i++)
+	{
+		const RtpPacketResult& p = pkts[i];
+		if(p.arrival < 0)
+		{
+			lost++;
+			continue;
+		}
+
+		//接收码率：最近RTP_GCC_ACKED_WINDOW_MS内到达的字节数
+		m_Acked.push_back(std::make_pair(p.arrival,p.size));
+		m_nAckedBytes += p.size;
+		while(p.arrival - m_Acked.front().first > RTP_GCC_ACKED_WINDOW_MS * 1000LL)
+		{
+			m_nAckedBytes -= m_Acked.front().second;
+			m_Acked.pop_front();
+		}
+
+		//发送时刻相差不超过RTP_GCC_BURST_MS的包为一组(一次突发)，一组的最后一个包到达之后才比较
+		if(!m_bCur)
+		{
+			m_Cur.first_send = m_Cur.last_send = p.send_time;
+			m_Cur.last_arrival = p.arrival;
+			m_bCur = true;
+			continue;
+		}
+		//比当前组更早发送的包(网络上重排序)不参与
+		if(p.send_time < m_Cur.first_send)
+			continue;
+		if(p.send_time - m_Cur.first_send <= RTP_GCC_BURST_MS * 1000000LL)
+		{
+			if(p.send_time > m_Cur.last_send)
+				m_Cur.last_send = p.send_time;
+			if(p.arrival > m_Cur.last_arrival)
+				m_Cur.last_arrival = p.arrival;
+			continue;
+		}
+		if(m_bPrev)
+			OnGroup((m_Cur.last_arrival - m_Prev.last_arrival) / 1000.0,(m_Cur.last_send - m_Prev.last_send) / 1e6,m_Cur.last_arrival / 1000.0);
+		m_Prev = m_Cur;
+		m_bPrev = true;
+		m_Cur.first_send = m_Cur.last_send = p.send_time;
+		m_Cur.last_arrival = p.arrival;
+	}
+
+	m_nLossPkts += count;
+	m_nLossLost += lost;
+	UpdateDelayRate(now / 1e6);
+	UpdateLossRate(now / 1e6);
+}
+
+void CRtpGcc::OnGroup(double arrival_delta,double send_delta,double arrival_ms)
+{
+	//排队时延的变化累加起来就是相对于第一组的排队时延，指数平滑后去掉噪声
+	double delta = arrival_delta - send_delta;
+	if(m_nDeltas < 1000)
+		m_nDeltas++;
+	m_fAccDelay += delta;
+	m_fSmoothed = RTP_GCC_SMOOTHING * m_fSmoothed + (1 - RTP_GCC_SMOOTHING) * m_fAccDelay;
+	if(m_Window.empty())
+		m_fFirstArrival = arrival_ms;
+	m_Window.push_back(std::make_pair(arrival_ms - m_fFirstArrival,m_fSmoothed));
+	if(m_Window.size() > RTP_GCC_WINDOW)
+		m_Window.pop_front();
+
+	//窗口满了之后对(到达时刻，排队时延)做最小二乘直线拟合，斜率为排队时延增长的速度
+	if(m_Window.size() == RTP_GCC_WINDOW)
+	{
+		double mx = 0,my = 0,num = 0,den = 0;
+		for(size_t i = 0; i < m_Window.size(); i++)
+		{
+			mx += m_Window[i].first;
+			my += m_Window[i].second;
+		}
+		mx /= m_Window.size();
+		my /= m_Window.size();
+		for(size_t i = 0; i < m_Window.size(); i++)
+		{
+			double dx = m_Window[i].first - mx;
+			num += dx * (m_Window[i].second - my);
+			den += dx * dx;
+		}
+		if(den != 0)
+			m_fTrend = num / den;
+	}
+	Detect(send_delta,arrival_ms);
+}
+
+void CRtpGcc::Detect(double send_delta,double arrival_ms)
+{
+	if(m_nDeltas < 2)
+	{
+		m_nState = RTP_GCC_NORMAL;
+		return;
+	}
+	//斜率乘以样本数(最多60)和增益，样本少时不容易误判
+	double trend = (m_nDeltas < 60 ? m_nDeltas : 60) * m_fTrend * RTP_GCC_GAIN;
+	if(trend > m_fThreshold)
+	{
+		//超过门限持续10ms以上且还在增长才判为过载
+		if(m_fOverTime < 0)
+			m_fOverTime = send_delta / 2;
+		else
+			m_fOverTime += send_delta;
+		m_nOverCount++;
+		if(m_fOverTime > 10 && m_nOverCount > 1 && trend >= m_fPrevTrend)
+		{
+			m_fOverTime = 0;
+			m_nOverCount = 0;
+			if(m_nState != RTP_GCC_OVERUSE)
+				m_nOveruses++;
+			m_nState = RTP_GCC_OVERUSE;
+		}
+	}
+	else if(trend < -m_fThreshold)
+	{
+		m_fOverTime = -1;
+		m_nOverCount = 0;
+		m_nState = RTP_GCC_UNDERUSE;
+	}
+	else
+	{
+		m_fOverTime = -1;
+		m_nOverCount = 0;
+		m_nState = RTP_GCC_NORMAL;
+	}
+	m_fPrevTrend = trend;
+	UpdateThreshold(trend,arrival_ms);
+}
+
+void CRtpGcc::UpdateThreshold(double trend,double arrival_ms)
+{
+	double t = trend < 0 ? -trend : trend;
+
+	if(m_fLastThreshold < 0)
+		m_fLastThreshold = arrival_ms;
+	//突然的大尖峰(如路由切换)不参与门限的调整
+	if(t > m_fThreshold + 15)
+	{
+		m_fLastThreshold = arrival_ms;
+		return;
+	}
+	//门限跟随趋势：趋势在门限以下时较快降低，超过时缓慢升高，避免与TCP等基于丢包的流竞争时饿死
+	double k = t < m_fThreshold ? 0.039 : 0.0087;
+	double dt = arrival_ms - m_fLastThreshold;
+	if(dt > 100)
+		dt = 100;
+	m_fThreshold += k * (t - m_fThreshold) * dt;
+	if(m_fThreshold < 6)
+		m_fThreshold = 6;
+	else if(m_fThreshold > 600)
+		m_fThreshold = 600;
+	m_fLastThreshold = arrival_ms;
+}
+
+double CRtpGcc::Acked() const
+{
+	//按窗口内第一个包到最后一个包的时间计算，发送端停发一段时间(如丢帧)之后窗口里的包很少，
+	//时间太短时还不知道，不能当作接收码率很低
+	if(m_Acked.empty())
+		return 0;
+	int64_t span = m_Acked.back().first - m_Acked.front().first;
+	if(span < RTP_GCC_ACKED_WINDOW_MS * 500LL)
+		return 0;
+	return (m_nAckedBytes - m_Acked.front().second) * 8e6 / span;
+}
+
+double CRtpGcc::AdditiveIncrease() const
+{
+	//按每秒30帧估计每帧的包数，每个响应时间(往返时间加100ms)增加一个平均包长的码率
+	double bits_per_frame = m_fDelayRate / 30;
+	double packets = ceil(bits_per_frame / (1200 * 8));
+	double response = m_fRtt + 100;
+	double increase = bits_per_frame / packets * 1000 / response;
+	return increase > 4000 ? increase : 4000;
+}
+
+void CRtpGcc::UpdateMaxAvg(double acked)
+{
+	//过载时的接收码率就是链路容量的一个样本，记下平均值和归一化的方差
+	if(m_fAvgMax < 0)
+		m_fAvgMax = acked;
+	else
+		m_fAvgMax = 0.95 * m_fAvgMax + 0.05 * acked;
+	double norm = m_fAvgMax > 1 ? m_fAvgMax : 1;
+	m_fVarMax = 0.95 * m_fVarMax + 0.05 * (m_fAvgMax - acked) * (m_fAvgMax - acked) / norm;
+	if(m_fVarMax < 0.4)
+		m_fVarMax = 0.4;
+	else if(m_fVarMax > 2.5)
+		m_fVarMax = 2.5;
+}
+
+void CRtpGcc::UpdateDelayRate(double now_ms)
+{
+	double acked = Acked();
+	double rate = m_fDelayRate;
+
+	switch(m_nState)
+	{
+	case RTP_GCC_NORMAL:
+		if(m_nRcState == RC_HOLD)
+			m_nRcState = RC_INCREASE;
+		break;
+	case RTP_GCC_OVERUSE:
+		m_nRcState = RC_DECREASE;
+		break;
+	case RTP_GCC_UNDERUSE:
+		//排队时延在减少，队列正在排空，先保持
+		m_nRcState = RC_HOLD;
+		break;
+	}
+
+	double dt = m_fLastChange < 0 ? 0 : now_ms - m_fLastChange;
+	if(dt > 1000)
+		dt = 1000;
+	if(m_nRcState == RC_INCREASE)
+	{
+		//接收码率明显超过上次过载时的位置，链路可能变好了，重新乘性增加
+		if(acked > 0 && m_fAvgMax >= 0 && acked > m_fAvgMax + 3 * sqrt(m_fVarMax * m_fAvgMax))
+			m_fAvgMax = -1;
+		if(m_fAvgMax >= 0)
+			rate += AdditiveIncrease() * dt / 1000;
+		else
+			rate *= pow(1.08,dt / 1000);
+		//不超过接收码率的1.5倍，发送的码率不够(如静止画面)时估计不会无限增长
+		if(acked > 0 && rate > 1.5 * acked + 10000)
+			rate = (1.5 * acked + 10000 > m_fDelayRate) ? 1.5 * acked + 10000 : m_fDelayRate;
+	}
+	else if(m_nRcState == RC_DECREASE)
+	{
+		double interval = m_fRtt > RTP_GCC_DECREASE_MS ? m_fRtt : RTP_GCC_DECREASE_MS;
+		if(m_fLastDecrease < 0 || now_ms - m_fLastDecrease >= interval)
+		{
+			double r = 0.85 * (acked > 0 ? acked : rate);
+			if(r < rate)
+				rate = r;
+			if(acked > 0)
+				UpdateMaxAvg(acked);
+			m_fLastDecrease = now_ms;
+		}
+		m_nRcState = RC_HOLD;
+	}
+	m_fLastChange = now_ms;
+
+	if(rate < m_fMin)
+		rate = m_fMin;
+	else if(rate > m_fMax)
+		rate = m_fMax;
+	m_fDelayRate = rate;
+}
+
+void CRtpGcc::UpdateLossRate(double now_ms)
+{
+	//至少20个包才计算丢包率，样本太少时波动太大
+	if(m_nLossPkts < 20)
+		return;
+	m_fLoss = (double)m_nLossLost / m_nLossPkts;
+	m_nLossPkts = 0;
+	m_nLossLost = 0;
+
+	double dt = m_fLastLossUpdate < 0 ? 0 : now_ms - m_fLastLossUpdate;
+	if(dt > 1000)
+		dt = 1000;
+	m_fLastLossUpdate = now_ms;
+	if(m_fLoss > 0.1)
+	{
+		//每(往返时间加300ms)最多降低一次，等降低的效果反映到丢包率上
+		if(m_fLastLossDecrease < 0 || now_ms - m_fLastLossDecrease >= m_fRtt + 300)
+		{
+			m_fLossRate = Target() * (1 - 0.5 * m_fLoss);
+			m_fLastLossDecrease = now_ms;
+		}
+	}
+	else if(m_fLoss < 0.02)
+		m_fLossRate *= pow(1.08,dt / 1000);
+
+	if(m_fLossRate < m_fMin)
+		m_fLossRate = m_fMin;
+	else if(m_fLossRate > m_fMax)
+		m_fLossRate = m_fMax;
+}
+
+void CRtpGcc::GetStats(RtpGccStats* stats) const
+{
+	stats->target = Target();
+	stats->delay_rate = m_fDelayRate;
+	stats->loss_rate = m_fLossRate;
+	stats->acked = Acked();
+	stats->trend = m_fPrevTrend;
+	stats->threshold = m_fThreshold;
+	stats->state = m_nState;
+	stats->loss = m_fLoss;
+	stats->feedbacks = m_nFeedbacks;
+	stats->overuses = m_nOveruses;
+}
@@ -0,0 +1,166 @@
+/*************************************************************************
+    > File Name: CRtpGcc.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 04时21分37秒
+ ************************************************************************/
+
+#ifndef CRTP_GCC_H
+#define CRTP_GCC_H
+
+#include <stdint.h>
+#include <deque>
+
+//默认的起始码率以及码率范围，单位bps
+#define RTP_GCC_START_BPS       300000
+#define RTP_GCC_MIN_BPS         50000
+#define RTP_GCC_MAX_BPS         20000000
+//发送时刻相差不超过该值(毫秒)的包作为一组，比较相邻两组的发送间隔和到达间隔
+#define RTP_GCC_BURST_MS        5
+//排队时延趋势线性回归的窗口(组数)、平滑系数和增益
+#define RTP_GCC_WINDOW          20
+#define RTP_GCC_SMOOTHING       0.9
+#define RTP_GCC_GAIN            4.0
+//计算接收码率的时间窗口，毫秒
+#define RTP_GCC_ACKED_WINDOW_MS 500
+//两次因过载降低码率的最小间隔(不小于往返时间)，留出排空队列的时间
+#define RTP_GCC_DECREASE_MS     200
+
+//排队时延检测的状态
+#define RTP_GCC_NORMAL          0
+#define RTP_GCC_OVERUSE         1
+#define RTP_GCC_UNDERUSE        2
+
+/**
+ * _RtpPacketResult
+ * 拥塞控制反馈中的一个包：发送端记录的发送时刻、包长，以及接收端报告的到达时刻
+ */
+typedef struct _RtpPacketResult
+{
+	int64_t send_time;            //发送时刻，CLOCK_MONOTONIC纳秒
+	int64_t arrival;              //到达时刻(接收端的时钟)，微秒，小于0表示丢失
+	unsigned int size;            //包长(RTP包头加负载)
+}RtpPacketResult;
+
+/**
+ * _RtpGccStats
+ * 带宽估计的状态
+ */
+typedef struct _RtpGccStats
+{
+	double target;                //目标码率，bps，为下面两者中较小的
+	double delay_rate;            //基于时延的估计
+	double loss_rate;             //基于丢包的估计
+	double acked;                 //接收端确认收到的码率，0表示还不知道
+	double trend;                 //放大后的排队时延趋势，毫秒
+	double threshold;             //自适应的过载门限
+	int state;                    //RTP_GCC_NORMAL、RTP_GCC_OVERUSE或RTP_GCC_UNDERUSE
+	double loss;                  //最近的丢包率，0~1
+	uint64_t feedbacks;           //处理的反馈包数
+	uint64_t overuses;            //检测到过载的次数
+}RtpGccStats;
+
+/**
+ * 基于接收端反馈的带宽估计(GCC，draft-ietf-rmcat-gcc-02)，只做计算，不涉及报文和套接字。
+ * 时延部分：相邻两组包的到达间隔减去发送间隔为排队时延的变化，累加平滑后对到达时刻做线性回归，
+ * 斜率(排队时延增长的速度)超过自适应门限并持续一段时间时判为过载，码率降到接收码率的0.85倍；
+ * 正常时远离上次过载的码率按每秒8%乘性增加，接近时按每个往返时间约一个包加性增加。
+ * 丢包部分：丢包率超过10%时按(1-0.5*丢包率)降低，低于2%时每秒增加8%。目标码率取两者中较小的
+ */
+class CRtpGcc
+{
+private:
+	typedef struct _Group
+	{
+		int64_t first_send;       //纳秒
+		int64_t last_send;
+		int64_t last_arrival;     //微秒
+	}Group;
+
+	double m_fStart;
+	double m_fMin;
+	double m_fMax;
+	double m_fDelayRate;
+	double m_fLossRate;
+	double m_fRtt;                //毫秒
+
+	//到达间隔
+	bool m_bCur;
+	bool m_bPrev;
+	Group m_Cur;
+	Group m_Prev;
+
+	//排队时延趋势
+	int m_nDeltas;
+	double m_fAccDelay;
+	double m_fSmoothed;
+	double m_fFirstArrival;       //毫秒
+	std::deque<std::pair<double,double> > m_Window; //(到达时刻，平滑后的累计排队时延)
+	double m_fTrend;
+
+	//过载检测
+	double m_fThreshold;
+	double m_fLastThreshold;      //上次更新门限的到达时刻，毫秒，小于0表示还没有
+	double m_fOverTime;           //持续过载的时间，毫秒，小于0表示没有过载
+	int m_nOverCount;
+	double m_fPrevTrend;
+	int m_nState;
+
+	//码率控制(AIMD)
+	int m_nRcState;
+	double m_fLastChange;         //上次调整码率的时刻，毫秒，小于0表示还没有
+	double m_fLastDecrease;
+	double m_fAvgMax;             //过载时接收码率的平均值(上次收敛的位置)，小于0表示未知
+	double m_fVarMax;
+
+	//接收码率
+	std::deque<std::pair<int64_t,unsigned int> > m_Acked; //(到达时刻微秒，包长)
+	uint64_t m_nAckedBytes;
+
+	//丢包
+	int m_nLossPkts;
+	int m_nLossLost;
+	double m_fLoss;
+	double m_fLastLossDecrease;   //上次因丢包降低码率以及上次更新的时刻，毫秒
+	double m_fLastLossUpdate;
+
+	uint64_t m_nFeedbacks;
+	uint64_t m_nOveruses;
+
+	void OnGroup(double arrival_delta,double send_delta,double arrival_ms);
+	void Detect(double send_delta,double arrival_ms);
+	void UpdateThreshold(double trend,double arrival_ms);
+	void UpdateDelayRate(double now_ms);
+	void UpdateLossRate(double now_ms);
+	void UpdateMaxAvg(double acked);
+	//每个往返时间加性增加的码率，bps/秒
+	double AdditiveIncrease() const;
+	double Acked() const;
+
+public:
+	CRtpGcc();
+	~CRtpGcc();
+
+	void Reset();
+
+	/**
+	 * 起始码率以及码率范围，单位bps，会清除之前的估计
+	 */
+	void SetBitrates(double start,double min,double max);
+	//RTCP得到的往返时间，毫秒，用于加性增加的速度和丢包降低码率的间隔
+	void SetRtt(double rtt) { if(rtt > 0) m_fRtt = rtt; }
+
+	/**
+	 * 处理一个拥塞控制反馈
+	 * @param pkts 反馈中的包，按传输序列号的顺序，不包括发送端已经不记得的包
+	 * @param count 包数
+	 * @param now 收到反馈的时刻，CLOCK_MONOTONIC纳秒
+	 */
+	void OnFeedback(const RtpPacketResult* pkts,int count,int64_t now);
+
+	//目标码率，bps
+	double Target() const { return m_fDelayRate < m_fLossRate ? m_fDelayRate : m_fLossRate; }
+	void GetStats(RtpGccStats* stats) const;
+};
+
+#endif
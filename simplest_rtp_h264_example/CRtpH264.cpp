@@ -8,18 +8,26 @@
 #include "CRtpH264.h"  
 
 
-CRtpH264::CRtpH264() : mSocketFd(0),mSeq_num(0),mTimestamp_increase(0),mTs_current(0),p_h264bitstream(NULL),p_Nalu(NULL)
+CRtpH264::CRtpH264() : mSocketFd(-1),mSeq_num(0),mTs_current(0),m_nMaxPayload(MAX_RTP_PKT_LENGTH),m_bStapA(true),
+	m_bBatchSend(true),m_nHdrUsed(0),m_bQueue(false),m_bGso(false),m_nPkts(0),mPktCount(0),m_nDestId(0),
+	m_nFrameDts(0),m_nFrameNs(0),m_nHistMs(RTP_HIST_MS),m_bRtx(false),m_nRtxPt(RTP_RTX_PT),m_bFec(false),m_nFecPt(RTP_FEC_PT),m_nFecCount(0),
+	m_bCc(false),m_nTwSeq(0),m_fCcStart(RTP_CC_START_BPS),m_fCcMin(RTP_GCC_MIN_BPS),m_fCcMax(RTP_GCC_MAX_BPS),m_fCcTarget(RTP_CC_START_BPS),
+	m_fCcBudget(0),m_bCcWaitIdr(false),m_nDropped(0)
 {
+	//按节奏发送时在等待的同时响应NACK
+	m_Pacer.SetWaiter([this](int64_t ns) { WaitFeedback(ns); });
+	//IDR帧丢失影响到下一个IDR之前的所有帧，保护最强；不被参考的帧丢失只影响自己，不保护
+	SetFecLevel(RTP_FEC_IDR,4,4);
+	SetFecLevel(RTP_FEC_REF,8,0);
+	SetFecLevel(RTP_FEC_NONREF,0,0);
 
 }
 
 CRtpH264::~CRtpH264()
 {
-	close(mSocketFd);
-	FreeNALU();
-	if(p_h264bitstream)
-		fclose(p_h264bitstream);
-    p_h264bitstream = NULL;
+	if(mSocketFd >= 0)
+		close(mSocketFd);
+	m_Scanner.Close();
 	printf("%s: ====haoge====\n",__FUNCTION__);
 }
 
@@ -28,343 +36,1174 @@ void CRtpH264::initSocket(const char* serIP,int port)
     mServer.sin_family = AF_INET;
     mServer.sin_port = htons(port);
     mServer.sin_addr.s_addr = inet_addr(serIP);
-    mSocketFd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(mSocketFd < 0)
+		mSocketFd = socket(AF_INET, SOCK_DGRAM, 0);
+
+	//initSocket给出的目的地址编号为0，包头不改写(SSRC为10，序列号和时间戳从0开始)
+	RtpDestination dest;
+	std::random_device rd;
+	dest.id = 0;
+	dest.addr = mServer;
+	dest.ssrc = 10;
+	dest.seq_offset = 0;
+	dest.ts_offset = 0;
+	dest.rewrite = false;
+	dest.packets = 0;
+	dest.octets = 0;
+	dest.rtcp_addr = mServer;
+	dest.rtcp_addr.sin_port = htons(port + 1);
+	memset(&dest.rtcp,0,sizeof(dest.rtcp));
+	dest.rtcp.ssrc = dest.ssrc;
+	dest.rtcp.rtt = -1;
+	dest.rtx_ssrc = rd();
+	dest.rtx_seq = (unsigned short)rd();
+	dest.fec_ssrc = rd();
+	dest.fec_seq = (unsigned short)rd();
+	dest.fec_packets = 0;
+	dest.gcc.SetBitrates(m_fCcStart,m_fCcMin,m_fCcMax);
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	m_Dests.push_back(dest);
 }
 
-void CRtpH264::AllocNALU(int buffersize)  
+int CRtpH264::AddDestination(const char* ip,int port)
 {
-	if((p_Nalu = (NALU_t*)calloc(1,sizeof(NALU_t))) == NULL)  
-	{
-		printf("%s: ===haoge===Alloc NALU: null\n",__FUNCTION__);  
-		exit(0);
-	}
+	RtpDestination dest;
+	std::random_device rd;
 
-	p_Nalu->max_size = buffersize;
-	if((p_Nalu->buf = (char*)calloc(buffersize, sizeof(char))) == NULL)  
+	memset(&dest.addr,0,sizeof(dest.addr));
+	dest.addr.sin_family = AF_INET;
+	dest.addr.sin_port = htons(port);
+	if(inet_pton(AF_INET,ip,&dest.addr.sin_addr) != 1)
 	{
-		free(p_Nalu); 
-		printf("%s: ===haoge====Alloc NALU: n->buf null\n",__FUNCTION__);
-		exit(0);
+		printf("%s: ====haoge====invalid address %s\n",__FUNCTION__,ip);
+		return -1;
 	}
-	return;
+	if(mSocketFd < 0)
+		mSocketFd = socket(AF_INET, SOCK_DGRAM, 0);
+
+	//按RFC 3550，每个接收端看到的SSRC、初始序列号和初始时间戳都是随机的
+	dest.ssrc = rd();
+	dest.seq_offset = (unsigned short)rd();
+	dest.ts_offset = rd();
+	dest.rewrite = true;
+	dest.packets = 0;
+	dest.octets = 0;
+	dest.rtcp_addr = dest.addr;
+	dest.rtcp_addr.sin_port = htons(port + 1);
+	memset(&dest.rtcp,0,sizeof(dest.rtcp));
+	dest.rtcp.ssrc = dest.ssrc;
+	dest.rtcp.rtt = -1;
+	dest.rtx_ssrc = rd();
+	dest.rtx_seq = (unsigned short)rd();
+	dest.fec_ssrc = rd();
+	dest.fec_seq = (unsigned short)rd();
+	dest.fec_packets = 0;
+	dest.gcc.SetBitrates(m_fCcStart,m_fCcMin,m_fCcMax);
+
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	dest.id = ++m_nDestId;
+	m_Dests.push_back(dest);
+	return dest.id;
 }
 
-void CRtpH264::FreeNALU()  
-{  
-	if(p_Nalu)
+int CRtpH264::RemoveDestination(int id)
+{
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
 	{
-		if(p_Nalu->buf)
+		if(it->id == id)
 		{
-			free(p_Nalu->buf);
-			p_Nalu->buf = NULL;
+			m_Dests.erase(it);
+			return 1;
 		}
-		free(p_Nalu);
-		p_Nalu = NULL;
 	}
+	return 0;
+}
+
+int CRtpH264::DestinationCount()
+{
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	return m_Dests.size();
+}
+
+void CRtpH264::SetBatchSend(bool bBatch)
+{
+	FlushPackets();
+	m_bBatchSend = bBatch;
+}
+
+void CRtpH264::SetGso(bool bGso)
+{
+	FlushPackets();
+	m_bGso = bGso;
 }
 
 void CRtpH264::OpenBitstreamFile(const char *fn)  
 {
-	if(NULL == (p_h264bitstream = fopen(fn, "r")))
+	//将整个码流文件映射到内存，之后每个NALU都直接以视图的方式读取，不再逐字节fgetc和拷贝
+	if(!m_Scanner.Open(fn))
 	{
 		printf("%s: ====haoge====open file error\n",__FUNCTION__);
 		exit(0);
 	}
+	//重传缓存中的负载指向之前映射的文件，已经无效
+	for(size_t i = 0; i < m_Hist.size(); i++)
+		m_Hist[i].valid = false;
 }
 
-
-int CRtpH264::FindStartCode2(unsigned char* Buf)  
-{  
-	if(Buf[0] != 0 || Buf[1] != 0 || Buf[2] != 1) 
-		return 0; //判断是否为0x000001,如果是返回 1
-	else
-		return 1;
+int CRtpH264::SetMtu(int mtu,int overhead)
+{
+	//RTP负载 = MTU - IP头(20) - UDP头(8) - 隧道等额外开销 - RTP固定包头(12) - FU indicator和FU header(2)
+	int payload = mtu - 20 - 8 - overhead - 12 - 2;
+	//拥塞控制时RTP包头后面还有传输序列号的头扩展
+	if(m_bCc)
+		payload -= RTP_TWCC_EXT_LEN;
+	if(overhead < 0 || mtu > 65535 || payload < RTP_MIN_PAYLOAD)
+	{
+		printf("%s: ====haoge====invalid mtu %d overhead %d\n",__FUNCTION__,mtu,overhead);
+		return 0;
+	}
+	m_nMaxPayload = payload;
+	return 1;
 }
 
-int CRtpH264::FindStartCode3(unsigned char* Buf)  
+void CRtpH264::SetStapA(bool bStapA)
 {
-	if(Buf[0] != 0 || Buf[1] != 0 || Buf[2] != 0 || Buf[3] != 1)
-		return 0;//判断是否为0x00000001,如果是返回 1
-	else
-		return 1;
+	m_bStapA = bStapA;
 }
 
-//这个函数主要功能为得到一个完整的NALU并保存在NALU_t的buf中，获取他的长度，填充F,IDC,TYPE位. 并且返回NALU的长度
-int CRtpH264::GetAnnexbNALU(NALU_t* nalu)  
+char* CRtpH264::AddHeader(int len)
 {
-	int mInfo2 = 0;
-	int mInfo3 = 0;
-	int pos = 0;
-	int rewind;
-	int StartCodeFound;
-	unsigned char* Buf;
+	//包头存储区按需扩容，iovec中先记录偏移，发送时再换成地址
+	if(m_nHdrUsed + len > m_HdrBuf.size())
+		m_HdrBuf.resize((m_nHdrUsed + len) * 2);
+	struct iovec iov;
+	iov.iov_base = (void*)m_nHdrUsed;
+	iov.iov_len = len;
+	m_Iovs.push_back(iov);
+	m_IovInHdr.push_back(1);
+	m_PktLen.back() += len;
+	m_nHdrUsed += len;
+	return &m_HdrBuf[m_nHdrUsed - len];
+}
 
-//	memset(nalu->buf,0,nalu->max_size);
+void CRtpH264::AddPayload(const unsigned char* payload,int len)
+{
+	//负载不复制，iovec直接指向NALU数据(映射的码流文件)
+	struct iovec iov;
+	iov.iov_base = (void*)payload;
+	iov.iov_len = len;
+	m_Iovs.push_back(iov);
+	m_IovInHdr.push_back(0);
+	m_PktLen.back() += len;
+}
 
-	if((Buf = (unsigned char*)calloc(nalu->max_size,sizeof(char))) == NULL)
-		printf("%s: =====haoge====GetAnnexbNALU: Could not allocate Buf memory\n",__FUNCTION__);
+char* CRtpH264::BeginPacket(bool bMarker,int extra)
+{
+	m_PktIov.push_back(m_Iovs.size());
+	m_PktLen.push_back(0);
+	int ext = m_bCc ? RTP_TWCC_EXT_LEN : 0;
+	char* sendbuf = AddHeader(12 + ext + extra);
 
-	printf("%s: =====haoge===nalu->max_size = %d\n",__FUNCTION__,nalu->max_size);
-	memset(Buf,0,nalu->max_size);
-	nalu->startcodeprefix_len = 3;//初始化码流序列的开始字符为3个字节
-	if(3 != fread(Buf, 1, 3, p_h264bitstream))//从码流中读3个字节
+	//rtp固定包头，为12字节,该句将sendbuf[0]的地址赋给pRtp_hdr，以后对pRtp_hdr的写入操作将直接写入sendbuf
+	RTP_FIXED_HEADER* pRtp_hdr = (RTP_FIXED_HEADER*)&sendbuf[0];
+	//设置RTP HEADER
+	pRtp_hdr->csrc_len  = 0;
+	pRtp_hdr->extension = m_bCc ? 1 : 0;         //拥塞控制时带传输序列号的头扩展
+	pRtp_hdr->padding   = 0;
+	pRtp_hdr->payload   = H264;                  //负载类型号
+	pRtp_hdr->version   = 2;                     //版本号，此版本固定为2
+	pRtp_hdr->marker    = bMarker ? 1 : 0;       //标志位，由具体协议规定其值
+	pRtp_hdr->seq_no    = htons(mSeq_num++);     //序列号，每发送一个RTP包增1  bytes 2, 3
+	pRtp_hdr->timestamp = htonl(mTs_current);    //同一访问单元的所有包时间戳相同
+	pRtp_hdr->ssrc      = htonl(10);             //随机指定为10，并且在本RTP会话中全局唯一  bytes 8-11
+	if(m_bCc)
 	{
-		free(Buf);
-		return 0;
+		//RFC 8285一字节头：0xBEDE、扩展长度1(32位字)，元素为ID(4位)、长度减1(4位)和2字节的传输序列号，最后1字节填充
+		unsigned char* e = (unsigned char*)sendbuf + 12;
+		e[0] = 0xbe;
+		e[1] = 0xde;
+		e[2] = 0;
+		e[3] = 1;
+		e[4] = (RTP_TWCC_EXT_ID << 4) | 1;
+		e[5] = m_nTwSeq >> 8;
+		e[6] = m_nTwSeq & 0xff;
+		e[7] = 0;
+		m_nTwSeq++;
 	}
+	return sendbuf + 12 + ext;
+}
+
+void CRtpH264::EndPacket()
+{
+	m_nPkts++;
+	//逐包发送时立即发送，批量发送时留在存储区
+	if(!m_bBatchSend && !m_bQueue)
+		FlushPackets();
+}
+
+unsigned int CRtpH264::BuildMessages(unsigned int first,unsigned int end,struct sockaddr_in* addr,struct iovec* iovs)
+{
+	unsigned int nmsg = 0,i = first;
+	size_t ctrl = CMSG_SPACE(sizeof(uint16_t));
 
-	//先找3字节的startCode 0x000001
-	mInfo2 = FindStartCode2(Buf);
-	if(mInfo2 != 1)
-	{  
-		//如果不是，再读一个字节  
-		if(1 != fread(Buf+3, 1, 1, p_h264bitstream))//读一个字节  
+	if(m_Msgs.size() < RTP_MMSG_BATCH)
+	{
+		m_Msgs.resize(RTP_MMSG_BATCH);
+		m_MsgPkts.resize(RTP_MMSG_BATCH);
+		m_Ctrl.resize(RTP_MMSG_BATCH * ctrl);
+	}
+	while(i < end && nmsg < RTP_MMSG_BATCH)
+	{
+		unsigned int n = 1;
+		size_t seg = PacketLen(i),bytes = seg;
+		if(m_bGso)
 		{
-			free(Buf);
-			return 0;
+			//长度相同的连续包(一个NALU的FU-A分片)放入同一个消息，最后还可以跟一个较短的包(最后一个分片)
+			while(i + n < end && n < RTP_GSO_MAX_SEGS && bytes + PacketLen(i + n) <= RTP_GSO_MAX_BYTES &&
+				PacketIovEnd(i + n) - m_PktIov[i] <= RTP_MAX_IOV)
+			{
+				size_t len = PacketLen(i + n);
+				if(len > seg)
+					break;
+				bytes += len;
+				n++;
+				if(len < seg)
+					break;
+			}
 		}
-		//再找4字节的StartCode 0x00000001
-		mInfo3 = FindStartCode3(Buf);
-		if(mInfo3 != 1)//如果不是，返回-1
+
+		struct mmsghdr* msg = &m_Msgs[nmsg];
+		memset(msg,0,sizeof(struct mmsghdr));
+		msg->msg_hdr.msg_name = addr;
+		msg->msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		msg->msg_hdr.msg_iov = &iovs[m_PktIov[i]];
+		msg->msg_hdr.msg_iovlen = PacketIovEnd(i + n - 1) - m_PktIov[i];
+		if(n > 1)
 		{
-			free(Buf);
-			return -1;
+			//UDP_SEGMENT：内核按seg字节把整个消息切成多个UDP包，每段的开头就是该包的RTP包头
+			char* buf = &m_Ctrl[nmsg * ctrl];
+			memset(buf,0,ctrl);
+			msg->msg_hdr.msg_control = buf;
+			msg->msg_hdr.msg_controllen = ctrl;
+			struct cmsghdr* cm = CMSG_FIRSTHDR(&msg->msg_hdr);
+			cm->cmsg_level = IPPROTO_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t size = seg;
+			memcpy(CMSG_DATA(cm),&size,sizeof(size));
 		}
-		else
+		m_MsgPkts[nmsg++] = n;
+		i += n;
+	}
+	return nmsg;
+}
+
+int CRtpH264::SendPackets(unsigned int first,unsigned int end)
+{
+	unsigned int sent = 0;
+	uint64_t octets = 0;
+
+	//存储区在填包的过程中可能扩容，所以等一个访问单元的包都生成之后再把包头的偏移换成地址
+	for(unsigned int i = m_PktIov[first]; i < PacketIovEnd(end - 1); i++)
+	{
+		if(m_IovInHdr[i])
 		{
-			//如果是0x00000001,得到开始前缀为4个字节
-			pos = 4;
-			nalu->startcodeprefix_len = 4;
+			m_Iovs[i].iov_base = &m_HdrBuf[(size_t)m_Iovs[i].iov_base];
+			m_IovInHdr[i] = 0;
 		}
 	}
-	else  
+
+	for(unsigned int i = first; i < end; i++)
+		octets += PacketLen(i) - 12;
+	int64_t now = CRtpPacer::Now();
+	if(m_nHistMs > 0)
+		SavePackets(first,end,now);
+	if(m_bCc)
+		SaveTransportSeqs(first,end,now);
+	//FEC按原始的包头计算，一行或一块满了就生成FEC包，跟在这批媒体包后面发送
+	if(m_bFec)
 	{
-		//如果是0x000001,得到开始前缀为3个字节  
-		nalu->startcodeprefix_len = 3;
-		pos = 3;
+		for(unsigned int i = first; i < end; i++)
+			m_Fec.AddPacket(&m_Iovs[m_PktIov[i]],PacketIovEnd(i) - m_PktIov[i],PacketLen(i));
 	}
 
-	StartCodeFound = 0;
-	mInfo2 = 0;
-	mInfo3 = 0;
-    //找到StartCode后，查找相邻的下一个StartCode的位置
-	while(!StartCodeFound)
+	//同一份包发送到每个目的地址，需要改写包头的目的地址使用各自的包头副本，负载仍然共享
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
 	{
-		if(feof(p_h264bitstream))//判断是否到了文件尾
+		struct iovec* iovs = &m_Iovs[0];
+		if(it->rewrite)
 		{
-			//所谓文件末尾即最后一个字符的下一个位置，所以达到文件末尾时，此时pos-1代表Buf中的字节总数
-			nalu->len = (pos-1) - nalu->startcodeprefix_len;//NALU的大小，包括一个字节NALU头和EBSP数据
-			printf("%s: ====haoge===1===nalu->len = %d\n",__FUNCTION__,nalu->len);
-			memcpy(nalu->buf, &Buf[nalu->startcodeprefix_len], nalu->len); //拷贝一个完整NALU，不拷贝起始前缀0x000001或0x00000001
-			nalu->forbidden_bit 	= nalu->buf[0] & 0x80;     // 1 bit
-			nalu->nal_reference_idc = nalu->buf[0] & 0x60;     // 2 bit
-			nalu->nal_unit_type		= nalu->buf[0] & 0x1f;     // 5 bit
-			free(Buf);
-			return pos - 1;
+			RewriteHeaders(*it,first,end);
+			iovs = &it->iovs[0];
 		}
+		unsigned int n = SendPacketsTo(&it->addr,iovs,first,end);
+		it->packets += n;
+		//只发送了一部分时负载字节数按包数折算
+		it->octets += (n == end - first) ? octets : octets * n / (end - first);
+		sent += n;
+	}
+	if(m_Fec.Count() > 0)
+		SendFecPackets();
+	mPktCount += sent;
+	return sent;
+}
+
+void CRtpH264::RewriteHeaders(RtpDestination& dest,unsigned int first,unsigned int end)
+{
+	if(dest.iovs.size() < m_Iovs.size())
+		dest.iovs.resize(m_Iovs.size());
+	if(dest.hdr.size() < m_nPkts * RTP_HDR_COPY_SIZE)
+		dest.hdr.resize(m_nPkts * RTP_HDR_COPY_SIZE);
+	memcpy(&dest.iovs[m_PktIov[first]],&m_Iovs[m_PktIov[first]],(PacketIovEnd(end - 1) - m_PktIov[first]) * sizeof(struct iovec));
 
-		//pos代表Buf中存储的字节个数
-		Buf[pos++] = fgetc(p_h264bitstream);//读一个字节到BUF中
-		mInfo3 = FindStartCode3(&Buf[pos-4]);//判断是否为0x00000001
-		if(mInfo3 != 1)
+	//每个包的第一段是RTP固定包头加上NALU头、STAP-A头或FU indicator、FU header，复制后改写序列号、时间戳和SSRC
+	for(unsigned int i = first; i < end; i++)
+	{
+		struct iovec& iov = dest.iovs[m_PktIov[i]];
+		char* hdr = &dest.hdr[i * RTP_HDR_COPY_SIZE];
+		memcpy(hdr,iov.iov_base,iov.iov_len);
+		RTP_FIXED_HEADER* pRtp_hdr = (RTP_FIXED_HEADER*)hdr;
+		pRtp_hdr->seq_no    = htons((unsigned short)(ntohs(pRtp_hdr->seq_no) + dest.seq_offset));
+		pRtp_hdr->timestamp = htonl(ntohl(pRtp_hdr->timestamp) + dest.ts_offset);
+		pRtp_hdr->ssrc      = htonl(dest.ssrc);
+		iov.iov_base = hdr;
+	}
+}
+
+unsigned int CRtpH264::SendPacketsTo(struct sockaddr_in* addr,struct iovec* iovs,unsigned int first,unsigned int end)
+{
+	unsigned int sent = 0;
+	int retry = 0;
+
+	while(first < end)
+	{
+		unsigned int nmsg = BuildMessages(first,end,addr,iovs),done = 0;
+		bool rebuild = false;
+
+		//sendmmsg可能只发送了一部分(被信号打断、发送缓冲区满或者中间某个消息出错)，从没有发送的消息继续
+		while(done < nmsg && !rebuild)
 		{
-			mInfo2 = FindStartCode2(&Buf[pos-3]);//判断是否为0x000001
+			int ret;
+			if(nmsg - done == 1)
+				ret = sendmsg(mSocketFd,&m_Msgs[done].msg_hdr,0) >= 0 ? 1 : -1;
+			else
+				ret = sendmmsg(mSocketFd,&m_Msgs[done],nmsg - done,0);
+			if(ret > 0)
+			{
+				for(int k = 0; k < ret; k++, done++)
+				{
+					sent += m_MsgPkts[done];
+					first += m_MsgPkts[done];
+				}
+				retry = 0;
+				continue;
+			}
+			if(ret < 0 && errno == EINTR)
+				continue;
+			if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) && retry++ < RTP_SEND_RETRY)
+			{
+				//发送缓冲区满，等待可写后重试(ENOBUFS时poll不会等待，稍等再试)；多次失败后丢弃当前消息，保证不会一直卡住
+				if(errno == ENOBUFS)
+					usleep(1000);
+				else
+				{
+					struct pollfd pfd;
+					pfd.fd = mSocketFd;
+					pfd.events = POLLOUT;
+					poll(&pfd,1,RTP_SEND_WAIT_MS);
+				}
+				continue;
+			}
+			retry = 0;
+			if(m_MsgPkts[done] > 1 && (errno == EINVAL || errno == EIO || errno == ENOPROTOOPT || errno == EOPNOTSUPP))
+			{
+				//内核不支持UDP_SEGMENT或者网卡不能计算校验和，关闭GSO，剩下的包重新按每包一个消息发送
+				printf("%s: ====haoge====UDP GSO not supported (%s), fall back to normal send\n",__FUNCTION__,strerror(errno));
+				m_bGso = false;
+				rebuild = true;
+				continue;
+			}
+			//当前这个消息发送失败(如目的不可达)，丢弃它并继续发送后面的消息
+			printf("%s: ====haoge====sendmmsg packet %u failed: %s\n",__FUNCTION__,first,strerror(errno));
+			first += m_MsgPkts[done];
+			done++;
 		}
-		StartCodeFound = (mInfo2 == 1 || mInfo3 == 1);
-	}
-
-	// Here, we have found another start code (and read length of startcode bytes more than we should  
-	// have.  Hence, go back in the file  
-	rewind = (mInfo3 == 1) ? -4 : -3;
-	
-	if(0 != fseek(p_h264bitstream, rewind, SEEK_CUR))//把文件指针指向前一个NALU的末尾
-	{
-		free(Buf);
-		printf("%s :=====haoge====Cannot fseek in the bit stream file\n",__FUNCTION__);
-	}
-	
-	// Here the Start code, the complete NALU, and the next start code is in the Buf.    
-	// The size of Buf is pos, pos+rewind are the number of bytes excluding the next  
-	// start code, and (pos+rewind)-startcodeprefix_len is the size of the NALU excluding the start code  
-	
-	nalu->len = (pos+rewind) - nalu->startcodeprefix_len; //NALU的大小，包括一个字节NALU头和EBSP数据 
-	printf("%s: ===haoge=====2====nalu->len =  %d\n",__FUNCTION__,nalu->len);
-	memcpy(nalu->buf,&Buf[nalu->startcodeprefix_len],nalu->len);//拷贝一个完整NALU，不拷贝起始前缀0x000001或0x00000001  
-	nalu->forbidden_bit		 = nalu->buf[0] & 0x80; 	// 1  bit  提取NALU头中的forbidden_bit (禁止位)
-	nalu->nal_reference_idc  = nalu->buf[0] & 0x60;     // 2  bit  提取NALU头中的nal_reference_bit (优先级)
-	nalu->nal_unit_type		 = nalu->buf[0] & 0x1f;     // 5  bit  提取NALU头中的nal_unit_type (NAL类型)
-	free(Buf);
-
-    //返回两个起始码之间间隔的字节数，即包含有前缀的NALU的长度
-	return (pos+rewind);
-}  
-
-int CRtpH264::SendRtpPacket(char* sendbuf, NALU_t* n)
-{
-	int mBytes = 0;
-	RTP_FIXED_HEADER* pRtp_hdr  = NULL;
+	}
+	return sent;
+}
+
+int CRtpH264::FlushPackets()
+{
+	int sent = 0;
+
+	if(m_nPkts > 0)
+		sent = SendPackets(0,m_nPkts);
+	ClearPackets();
+	return sent;
+}
+
+void CRtpH264::ClearPackets()
+{
+	m_nPkts = 0;
+	m_nHdrUsed = 0;
+	m_Iovs.clear();
+	m_IovInHdr.clear();
+	m_PktIov.clear();
+	m_PktLen.clear();
+}
+
+int CRtpH264::SendRtpPacket(const NaluView* n, bool bLastOfAu)
+{
+	char* sendbuf = NULL;
 	NALU_HEADER*      pNalu_hdr = NULL;
 	FU_INDICATOR*     pFu_ind   = NULL;
 	FU_HEADER*        pFu_hdr   = NULL;
-	char* nalu_payload = NULL;
-	//rtp固定包头，为12字节,该句将sendbuf[0]的地址赋给pRtp_hdr，以后对pRtp_hdr的写入操作将直接写入sendbuf
-    pRtp_hdr = (RTP_FIXED_HEADER*)&sendbuf[0];
-	//设置RTP HEADER
-    pRtp_hdr->csrc_len	 = 0;
-	pRtp_hdr->extension = 0;
-    pRtp_hdr->padding = 0;
-	pRtp_hdr->payload = H264;  		//负载类型号
-    pRtp_hdr->version = 2;  		//版本号，此版本固定为2
-    pRtp_hdr->marker = 0;   		//标志位，由具体协议规定其值
-    pRtp_hdr->ssrc = htonl(10); 	//随机指定为10，并且在本RTP会话中全局唯一  bytes 8-11
-	//当一个NALU小于1400字节的时候，采用一个单RTP包发送
-    if(n->len <= 1400)
-	{
-		//设置rtp M 位；
-		pRtp_hdr->marker = 1;  
-        pRtp_hdr->seq_no = htons(mSeq_num++); //序列号，每发送一个RTP包增1  bytes 2, 3
-        //设置NALU HEADER,并将这个HEADER填入sendbuf[12]
-        pNalu_hdr 		= (NALU_HEADER*)&sendbuf[12]; //将sendbuf[12]的地址赋给pNalu_hdr，之后对pNalu_hdr的写入就将写入sendbuf中；
-        pNalu_hdr->F 	= n->forbidden_bit >> 7;
-        pNalu_hdr->NRI 	= n->nal_reference_idc >> 5;//有效数据在n->nal_reference_idc的第6，7位，需要右移5位才能将其值赋给nalu_hdr->NRI
-        pNalu_hdr->TYPE	= n->nal_unit_type;
-
-		nalu_payload	= &sendbuf[13];//同理将sendbuf[13]赋给nalu_payload  
-        memcpy(nalu_payload, n->buf + 1, n->len - 1);//去掉nalu头的nalu剩余内容写入sendbuf[13]开始的字符串
-
-		mTs_current = mTs_current + mTimestamp_increase;
-        pRtp_hdr->timestamp = htonl(mTs_current);
-		printf("%s: ======haoge===timestamp = %u, ts_current = %u\n",__FUNCTION__,pRtp_hdr->timestamp,mTs_current);
-        mBytes = n->len + 12; //获得sendbuf的长度,为nalu的长度（包含NALU头但除去起始前缀）加上rtp_header的固定长度12字节
-
-		sendto(mSocketFd,sendbuf,mBytes,0,(struct sockaddr *)&mServer, sizeof(mServer));
-		usleep(50000);
+	//当一个NALU不超过m_nMaxPayload字节的时候，采用一个单RTP包发送
+	if(n->len <= m_nMaxPayload)
+	{
+		//设置rtp M 位；只有访问单元的最后一个包置1
+		sendbuf = BeginPacket(bLastOfAu,1);
+		//设置NALU HEADER,并将这个HEADER填入RTP包头之后的sendbuf[0]
+		pNalu_hdr       = (NALU_HEADER*)&sendbuf[0];
+		pNalu_hdr->F    = n->forbidden_bit >> 7;
+		pNalu_hdr->NRI  = n->nal_reference_idc >> 5;//有效数据在n->nal_reference_idc的第6，7位，需要右移5位才能将其值赋给nalu_hdr->NRI
+		pNalu_hdr->TYPE = n->nal_unit_type;
+		//包头为rtp_header的固定长度12字节加上NALU头，负载为去掉nalu头的nalu剩余内容
+		AddPayload(n->data + 1,n->len - 1);
+		EndPacket();
+		return 1;
 	}
+
 	/*
 	 * 同一个NALU分包的FU indicator头是完全一致的，FU header只有S以及E位有区别，分别标记开始和结束，它们的RTP分包的序列号应该是依次递增的，
-	 * 并且它们的时间戳必须一致，而负载数据为NALU包去掉1个字节的NALU头后对剩余数据的拆分
+	 * 并且它们的时间戳必须一致，而负载数据为NALU包去掉1个字节的NALU头后对剩余数据的拆分，每片m_nMaxPayload字节，最后一片为剩余的字节
 	 */
-	else if(n->len > 1400)
-	{
-		//得到该nalu需要用多少长度为1400字节的RTP包来发送
-        int k = 0;
-		int l = 0;
-		int t = 0;          //用于指示当前发送的是第几个分片RTP包
-        k = n->len / 1400;	//需要k个1400字节的RTP包
-        l = n->len % 1400;	//最后一个RTP包的需要装载的字节数
-
-		mTs_current = mTs_current + mTimestamp_increase;
-		printf("%s: ======haoge=====ts_current = %d\n",__FUNCTION__,mTs_current);
-        pRtp_hdr->timestamp = htonl(mTs_current);
-		while(t <= k)
+	unsigned int pos = 1;
+	while(pos < n->len)
+	{
+		unsigned int size = n->len - pos;
+		if(size > m_nMaxPayload)
+			size = m_nMaxPayload;
+		bool bLast = (pos + size == n->len);
+
+		//设置rtp M 位；当前传输的是访问单元最后一个NALU的最后一个分片时该位置1
+		sendbuf = BeginPacket(bLast && bLastOfAu,2);
+		//设置FU INDICATOR,并将这个HEADER填入RTP包头之后的sendbuf[0]
+		pFu_ind       = (FU_INDICATOR*)&sendbuf[0];
+		pFu_ind->F    = n->forbidden_bit >> 7;
+		pFu_ind->NRI  = n->nal_reference_idc >> 5;
+		pFu_ind->TYPE = 28; //FU-A类型
+		//设置FU HEADER,并将这个HEADER填入sendbuf[1]，第一个分片置S位，最后一个分片置E位
+		pFu_hdr       = (FU_HEADER*)&sendbuf[1];
+		pFu_hdr->S    = (pos == 1) ? 1 : 0;
+		pFu_hdr->E    = bLast ? 1 : 0;
+		pFu_hdr->R    = 0;
+		pFu_hdr->TYPE = n->nal_unit_type;
+		//包头为rtp_header，fu_ind，fu_hdr的固定长度14字节，负载为NALU中接下来的size字节
+		AddPayload(n->data + pos,size);
+		EndPacket();
+		pos += size;
+	}
+	return 1;
+}
+
+int CRtpH264::SendStapA(const NaluView* n,int count,bool bLastOfAu)
+{
+	int F = 0,NRI = 0;
+
+	//STAP-A头的F为各NALU的F之或，NRI取各NALU中最大的
+	for(int i = 0; i < count; i++)
+	{
+		F |= n[i].forbidden_bit >> 7;
+		if((n[i].nal_reference_idc >> 5) > NRI)
+			NRI = n[i].nal_reference_idc >> 5;
+	}
+	char* sendbuf = BeginPacket(bLastOfAu,1);
+	NALU_HEADER* pStap_hdr = (NALU_HEADER*)&sendbuf[0];
+	pStap_hdr->F    = F;
+	pStap_hdr->NRI  = NRI;
+	pStap_hdr->TYPE = 24; //STAP-A类型
+
+	//每个聚合单元为2字节的NALU长度(网络字节序)加上包括NALU头的完整NALU
+	for(int i = 0; i < count; i++)
+	{
+		unsigned char* size = (unsigned char*)AddHeader(2);
+		size[0] = n[i].len >> 8;
+		size[1] = n[i].len & 0xff;
+		AddPayload(n[i].data,n[i].len);
+	}
+	EndPacket();
+	return 1;
+}
+
+void CRtpH264::PacketizeAccessUnit(const AccessUnit& au)
+{
+	size_t i = 0,count = au.nalus.size();
+
+	//（1）一个NALU就是一个RTP包的情况： RTP_FIXED_HEADER（12字节）  + NALU_HEADER（1字节） + EBPS
+	//（2）多个小NALU聚合成一个RTP包的情况： RTP_FIXED_HEADER（12字节） + STAP-A头（1字节） + 多个(长度（2字节） + NALU)
+	//（3）一个NALU分成多个RTP包的情况： RTP_FIXED_HEADER （12字节） + FU_INDICATOR （1字节）+  FU_HEADER（1字节） + EBPS
+	mTs_current = (unsigned int)au.pts;
+	if(m_bFec)
+	{
+		int type = au.idr ? RTP_FEC_IDR : (au.reference || !au.has_picture ? RTP_FEC_REF : RTP_FEC_NONREF);
+		m_Fec.BeginFrame(m_FecL[type],m_FecD[type]);
+	}
+	while(i < count)
+	{
+		size_t j = i;
+		unsigned int size = 1;
+		//同一访问单元(时间戳相同)中连续的小NALU(SPS、PPS、SEI以及小的片)尽量放入一个STAP-A包
+		while(m_bStapA && j < count && j - i < RTP_STAP_MAX_NALUS && size + 2 + au.nalus[j].len <= m_nMaxPayload)
+			size += 2 + au.nalus[j++].len;
+		if(j - i >= 2)
 		{
-			pRtp_hdr->seq_no = htons(mSeq_num++);   //序列号，每发送一个RTP包增1
-			//发送一个需要分片的NALU的第一个分片，置FU HEADER的S位
-            if(!t)
+			SendStapA(&au.nalus[i],j - i,j == count);
+			i = j;
+		}
+		else
+		{
+			SendRtpPacket(&au.nalus[i],i + 1 == count);
+			i++;
+		}
+	}
+}
+
+int CRtpH264::SendAccessUnit(const AccessUnit& au)
+{
+	unsigned int before = mPktCount;
+
+	if(DropForCongestion(au))
+		return 0;
+	m_nFrameDts = au.dts;
+	m_nFrameNs = CRtpPacer::Now();
+	PacketizeAccessUnit(au);
+	//批量发送时整个访问单元的包用sendmmsg一起发出
+	FlushPackets();
+	EndFecFrame();
+	return mPktCount - before;
+}
+
+int CRtpH264::SendAccessUnitPaced(const AccessUnit& au)
+{
+	unsigned int before = mPktCount;
+	unsigned int i = 0;
+	uint64_t bytes = 0,offset = 0;
+
+	if(DropForCongestion(au))
+	{
+		//丢弃的帧也要等到它的计划时刻，否则会快速读过这些帧，发送节奏变快
+		m_Pacer.BeginFrame(au.dts,au.duration,0);
+		return 0;
+	}
+	//先把整个访问单元打包到存储区，得到总字节数后再按令牌桶分批发出
+	m_bQueue = true;
+	PacketizeAccessUnit(au);
+	m_bQueue = false;
+	for(unsigned int k = 0; k < m_nPkts; k++)
+		bytes += PacketLen(k);
+
+	m_Pacer.BeginFrame(au.dts,au.duration,bytes);
+	m_nFrameDts = au.dts;
+	m_nFrameNs = CRtpPacer::Now();
+	while(i < m_nPkts)
+	{
+		int64_t sched = m_Pacer.PacketTime(offset,PacketLen(i));
+		m_Pacer.Wait(sched);
+		int64_t now = CRtpPacer::Now();
+
+		//等待的包一定发送(即使提前醒来)，之后令牌已经足够的包一起发送
+		unsigned int j = i;
+		do
+		{
+			m_Pacer.Record(sched,now);
+			offset += PacketLen(j++);
+			if(j < m_nPkts)
+				sched = m_Pacer.PacketTime(offset,PacketLen(j));
+		}while(j < m_nPkts && sched <= now);
+		SendPackets(i,j);
+		i = j;
+	}
+	ClearPackets();
+	EndFecFrame();
+	return mPktCount - before;
+}
+
+void CRtpH264::SetPacing(double fraction,unsigned int burst)
+{
+	m_Pacer.SetFraction(fraction);
+	m_Pacer.SetBurst(burst);
+}
+
+void CRtpH264::GetPacerStats(RtpPacerStats* stats) const
+{
+	m_Pacer.GetStats(stats);
+}
+
+void CRtpH264::ConstructRtpPacket(const char* file,double start_sec)
+{
+    float framerate = 25;
+    mSeq_num = 0;
+	mTs_current = 0;
+
+	OpenBitstreamFile(file);
+	//h264的采样率为90000HZ，因此时间戳的单位为1(秒)/90000。帧率和每帧的时间戳由组装器根据SPS的VUI计时信息和POC给出，
+	//码流中没有计时信息时按framerate计算，如25fps时时间戳增量为3600
+	m_Assembler.Attach(&m_Scanner);
+	m_Assembler.SetDefaultFrameRate(framerate);
+	if(start_sec > 0)
+	{
+		//从索引文件中找到start_sec之前最近的IDR，直接跳转过去发送，索引文件不存在或已过期时先扫描一遍建立
+		CNaluIndex index;
+		int key = index.LoadOrBuild(file) ? index.FindKeyframe((int64_t)(start_sec * AU_TIME_BASE)) : -1;
+		if(key < 0 || !index.SeekToKeyframe(key,m_Scanner,m_Assembler))
+			printf("%s: ====haoge====seek to %.3fs failed, send from the beginning\n",__FUNCTION__,start_sec);
+	}
+
+	AccessUnit au;
+	while(m_Assembler.Next(au))//每次取得一个访问单元(一帧)，其中所有NALU的RTP时间戳相同
+	{
+		//等到该帧的计划时刻，帧内的包分散在帧间隔的一部分内发送
+		int pkts = SendAccessUnitPaced(au);
+		ProcessRtcp();
+		if(m_bCc)
+			printf("%s: ======haoge===ts_current = %u, nalu: %d, rtp packets: %d, target: %.0fkbps\n",__FUNCTION__,
+				(unsigned int)au.pts,(int)au.nalus.size(),pkts,m_fCcTarget / 1000);
+		else
+			printf("%s: ======haoge===ts_current = %u, nalu: %d, rtp packets: %d\n",__FUNCTION__,mTs_current,(int)au.nalus.size(),pkts);
+	}
+
+	RtpPacerStats stats;
+	m_Pacer.GetStats(&stats);
+	PrintRtcpStats();
+	if(m_bCc)
+		printf("%s: ====haoge====congestion control: target: %.0fkbps, dropped frames: %u\n",__FUNCTION__,m_fCcTarget / 1000,m_nDropped);
+	printf("%s: ====haoge====packets: %llu, send jitter: %.1fus, late mean: %.1fus, max: %.1fus\n",__FUNCTION__,
+		(unsigned long long)stats.packets,stats.jitter,stats.mean_late,stats.max_late);
+}
+
+void CRtpH264::SetRtcpInterval(int ms)
+{
+	m_Rtcp.SetInterval(ms);
+}
+
+void CRtpH264::UpdateRtcpStats(RtpDestination& dest,const RtcpReportBlock& block,unsigned int now)
+{
+	RtcpStats& s = dest.rtcp;
+	s.reports++;
+	s.fraction_lost = block.fraction_lost / 256.0;
+	s.lost = block.lost;
+	s.highest_seq = block.highest_seq;
+	s.jitter = block.jitter * 1000.0 / RTCP_CLOCK_RATE;
+	//RTT = 收到RR的时刻 - LSR - DLSR，都是NTP时间戳的中间32位(1/65536秒)；接收端还没有收到SR时LSR为0
+	if(block.lsr != 0)
+	{
+		int rtt = (int)(now - block.lsr - block.dlsr);
+		if(rtt >= 0)
+			s.rtt = rtt * 1000.0 / 65536;
+	}
+	dest.gcc.SetRtt(s.rtt);
+}
+
+int CRtpH264::ReadFeedback()
+{
+	RtcpReport report;
+	int ret,reports = 0;
+
+	while((ret = m_Rtcp.Read(&report,NULL)) != 0)
+	{
+		if(ret < 0)
+			continue;
+		reports++;
+		//NACK：从重传缓存中找到请求的包，只重发给发出请求的目的地址
+		if(report.nack_count > 0)
+		{
+			int64_t ns = CRtpPacer::Now();
+			for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
 			{
-				//设置rtp M 位；
-                pRtp_hdr->marker = 0; 
-                //设置FU INDICATOR,并将这个HEADER填入sendbuf[12]  
-                pFu_ind 	 = (FU_INDICATOR*)&sendbuf[12]; //将sendbuf[12]的地址赋给pFu_ind，之后对pFu_ind的写入就将写入sendbuf中；
-                pFu_ind->F 	 = n->forbidden_bit >> 7;
-                pFu_ind->NRI = n->nal_reference_idc >> 5;
-                pFu_ind->TYPE = 28; //FU-A类型
-                //设置FU HEADER,并将这个HEADER填入sendbuf[13]
-                pFu_hdr 	 = (FU_HEADER*)&sendbuf[13];
-                pFu_hdr->E	 = 0;
-                pFu_hdr->R	 = 0;
-                pFu_hdr->S	 = 1;
-                pFu_hdr->TYPE = n->nal_unit_type;
-                nalu_payload = &sendbuf[14];               //同理将sendbuf[14]赋给nalu_payload
-                memcpy(nalu_payload, n->buf + 1, 1400);    //去掉NALU头
-                mBytes = 1400 + 12 + 2;                    //获得sendbuf的长度,为nalu的长度（除去起始前缀和NALU头）加上rtp_header，fu_ind，fu_hdr的固定长度14字节
-
-
-				sendto(mSocketFd, sendbuf,mBytes,0,(struct sockaddr *)&mServer, sizeof(mServer));
-                t++;
+				if(it->ssrc != report.nack_ssrc)
+					continue;
+				it->rtcp.nacks += report.nack_count;
+				for(int i = 0; i < report.nack_count; i++)
+					it->rtcp.repaired += Retransmit(*it,report.nacks[i],ns);
+				break;
 			}
-			//发送一个需要分片的NALU的非第一个分片，清零FU HEADER的S位，如果该分片是该NALU的最后一个分片，置FU HEADER的E位
-			else if(t < k && 0 != t)
+		}
+		if(report.twcc_count > 0)
+			OnTransportFeedback(report,CRtpPacer::Now());
+
+		unsigned int now = CRtcp::NtpMiddle(report.arrival);
+		//按报告块中被报告的SSRC找到对应的目的地址
+		for(int i = 0; i < report.count; i++)
+		{
+			for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
 			{
-				//设置rtp M 位；
-                pRtp_hdr->marker = 0;
-                //设置FU INDICATOR,并将这个HEADER填入sendbuf[12]
-                pFu_ind 		= (FU_INDICATOR*)&sendbuf[12]; //将sendbuf[12]的地址赋给pFu_ind，之后对pFu_ind的写入就将写入sendbuf中；  
-                pFu_ind->F 		= n->forbidden_bit >> 7;
-                pFu_ind->NRI 	= n->nal_reference_idc >> 5;
-                pFu_ind->TYPE 	= 28;
-                //设置FU HEADER,并将这个HEADER填入sendbuf[13]
-                pFu_hdr 		= (FU_HEADER*)&sendbuf[13];
-                pFu_hdr->R 		= 0;
-                pFu_hdr->S 		= 0;
-                pFu_hdr->E 		= 0;
-                pFu_hdr->TYPE 	= n->nal_unit_type;
-                nalu_payload 	= &sendbuf[14];                     //同理将sendbuf[14]的地址赋给nalu_payload
-                memcpy(nalu_payload, n->buf + t * 1400 + 1, 1400);  //去掉起始前缀的nalu剩余内容写入sendbuf[14]开始的字符串
-                mBytes = 1400 + 12 + 2;                             //获得sendbuf的长度,为nalu的长度（除去原NALU头）加上rtp_header，fu_ind，fu_hdr的固定长度14字节
-
-
-			    sendto(mSocketFd, sendbuf, mBytes, 0, (struct sockaddr *)&mServer, sizeof(mServer));
-                t++; 
+				if(it->ssrc != report.blocks[i].ssrc)
+					continue;
+				UpdateRtcpStats(*it,report.blocks[i],now);
+				printf("%s: ====haoge====rr from dest %d: fraction lost: %.2f%%, lost: %lld, jitter: %.2fms, rtt: %.2fms\n",__FUNCTION__,
+					it->id,it->rtcp.fraction_lost * 100,(long long)it->rtcp.lost,it->rtcp.jitter,it->rtcp.rtt);
+				break;
 			}
-			//发送的是最后一个分片，注意最后一个分片的长度可能超过1400字节 (当l>1386时)
-            else if(k == t)
+		}
+	}
+	return reports;
+}
+
+int CRtpH264::ProcessRtcp()
+{
+	if(m_Rtcp.Fd() < 0 && !m_Rtcp.Open(0))
+		return 0;
+
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	int reports = ReadFeedback();
+	int64_t ns = CRtpPacer::Now();
+	if(mPktCount > 0 && m_Rtcp.ReportDue(ns))
+	{
+		//SR中的RTP时间戳为当前时刻对应的媒体时间：最近一帧的DTS加上从它开始发送经过的时间，与包中的时间戳在同一时间轴上
+		uint64_t ntp = CRtcp::NtpNow();
+		unsigned int rtp = (unsigned int)(m_nFrameDts + (ns - m_nFrameNs) * RTCP_CLOCK_RATE / 1000000000LL);
+		for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+			m_Rtcp.SendSr(&it->rtcp_addr,it->ssrc,ntp,rtp + it->ts_offset,(unsigned int)it->packets,(unsigned int)it->octets,NULL,0);
+	}
+	return reports;
+}
+
+int CRtpH264::GetRtcpStats(int id,RtcpStats* stats)
+{
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		if(it->id == id)
+		{
+			*stats = it->rtcp;
+			stats->packets = it->packets;
+			stats->octets = it->octets;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void CRtpH264::PrintRtcpStats()
+{
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		const RtcpStats& s = it->rtcp;
+		printf("%s: ====haoge====dest %d ssrc %u: packets: %llu, octets: %llu, rr: %llu, fraction lost: %.2f%%, lost: %lld, jitter: %.2fms, rtt: %.2fms, nack: %llu, retransmitted: %llu, fec: %llu\n",
+			__FUNCTION__,it->id,it->ssrc,(unsigned long long)it->packets,(unsigned long long)it->octets,(unsigned long long)s.reports,
+			s.fraction_lost * 100,(long long)s.lost,s.jitter,s.rtt,(unsigned long long)s.nacks,(unsigned long long)s.repaired,(unsigned long long)it->fec_packets);
+		if(m_bCc)
+		{
+			RtpGccStats cc;
+			it->gcc.GetStats(&cc);
+			printf("%s: ====haoge====dest %d cc: target: %.0fkbps, delay based: %.0fkbps, loss based: %.0fkbps, acked: %.0fkbps, loss: %.2f%%, feedback: %llu, overuse: %llu\n",
+				__FUNCTION__,it->id,cc.target / 1000,cc.delay_rate / 1000,cc.loss_rate / 1000,cc.acked / 1000,cc.loss * 100,
+				(unsigned long long)cc.feedbacks,(unsigned long long)cc.overuses);
+		}
+	}
+}
+
+void CRtpH264::SetNackHistory(int ms)
+{
+	m_nHistMs = ms > 0 ? ms : 0;
+	if(m_nHistMs == 0)
+		m_Hist.clear();
+}
+
+void CRtpH264::SetRtx(bool bRtx,int pt)
+{
+	m_bRtx = bRtx;
+	m_nRtxPt = pt & 0x7f;
+}
+
+void CRtpH264::SavePackets(unsigned int first,unsigned int end,int64_t now)
+{
+	const char* hdr_begin = &m_HdrBuf[0];
+	const char* hdr_end = hdr_begin + m_nHdrUsed;
+
+	if(m_Hist.empty())
+		m_Hist.resize(RTP_HIST_SLOTS);
+	for(unsigned int i = first; i < end; i++)
+	{
+		unsigned int b = m_PktIov[i],e = PacketIovEnd(i);
+		const RTP_FIXED_HEADER* pRtp_hdr = (const RTP_FIXED_HEADER*)m_Iovs[b].iov_base;
+		unsigned short seq = ntohs(pRtp_hdr->seq_no);
+		RtpHistEntry& entry = m_Hist[seq & (RTP_HIST_SLOTS - 1)];
+
+		//包头存储区会被下一个访问单元重用，其中的段(RTP包头、FU头、STAP-A长度)复制一份；负载仍然指向NALU数据
+		size_t hdrlen = 0,pos = 0;
+		for(unsigned int k = b; k < e; k++)
+		{
+			const char* base = (const char*)m_Iovs[k].iov_base;
+			if(base >= hdr_begin && base < hdr_end)
+				hdrlen += m_Iovs[k].iov_len;
+		}
+		entry.hdr.resize(hdrlen);
+		entry.iovs.resize(e - b);
+		for(unsigned int k = b; k < e; k++)
+		{
+			const char* base = (const char*)m_Iovs[k].iov_base;
+			entry.iovs[k - b] = m_Iovs[k];
+			if(base >= hdr_begin && base < hdr_end)
 			{
-				//设置rtp M 位；当前传输的是最后一个分片时该位置1
-                pRtp_hdr->marker = 1;
-
-				//设置FU INDICATOR,并将这个HEADER填入sendbuf[12]
-                pFu_ind			= (FU_INDICATOR*)&sendbuf[12]; //将sendbuf[12]的地址赋给pFu_ind，之后对pFu_ind的写入就将写入sendbuf中;
-                pFu_ind->F		= n->forbidden_bit >> 7;
-                pFu_ind->NRI	= n->nal_reference_idc >> 5;
-                pFu_ind->TYPE	= 28;
-
-				//设置FU HEADER,并将这个HEADER填入sendbuf[13]
-                pFu_hdr 		= (FU_HEADER*)&sendbuf[13];
-                pFu_hdr->R      = 0;
-                pFu_hdr->S 		= 0;
-                pFu_hdr->TYPE	= n->nal_unit_type;
-                pFu_hdr->E		= 1;
-                nalu_payload	= &sendbuf[14];//同理将sendbuf[14]的地址赋给nalu_payload
-				if((n != NULL) && (n->buf != NULL) && (l > 1))
-				{
-					memcpy(nalu_payload, n->buf + t * 1400 + 1, l - 1); //将nalu最后剩余的l-1(去掉了一个字节的NALU头)字节内容写入sendbuf[14]开始的字符串.
-					mBytes = l - 1 + 12 + 2;                             //获得sendbuf的长度,为剩余nalu的长度l-1加上rtp_header，FU_INDICATOR,FU_HEADER三个包头共14字节
-			        sendto(mSocketFd, sendbuf, mBytes, 0, (struct sockaddr *)&mServer, sizeof(mServer));
-				}
-				else
-					printf("%s: ======haoge=====n->buf == NULL !\n",__FUNCTION__);
-				t++;
+				memcpy(&entry.hdr[pos],base,m_Iovs[k].iov_len);
+				entry.iovs[k - b].iov_base = &entry.hdr[pos];
+				pos += m_Iovs[k].iov_len;
 			}
 		}
-		usleep(50000);
+		entry.valid = true;
+		entry.seq = seq;
+		entry.time = now;
 	}
 }
 
+int CRtpH264::Retransmit(RtpDestination& dest,unsigned short seq,int64_t now)
+{
+	//目的地址看到的序列号减去偏移得到原始的序列号
+	unsigned short orig = seq - dest.seq_offset;
+	if(m_Hist.empty())
+		return 0;
+	RtpHistEntry& entry = m_Hist[orig & (RTP_HIST_SLOTS - 1)];
+	if(!entry.valid || entry.seq != orig || now - entry.time > (int64_t)m_nHistMs * 1000000)
+		return 0;
 
+	char hdr[RTP_HDR_COPY_SIZE];
+	const struct iovec& first = entry.iovs[0];
+	const unsigned char* orig_hdr = (const unsigned char*)first.iov_base;
+	RTP_FIXED_HEADER* pRtp_hdr = (RTP_FIXED_HEADER*)hdr;
+	//重传的包去掉传输序列号的头扩展，不参与拥塞控制(它的传输序列号在其他目的地址已经收到)
+	size_t hl = 12;
+	if(orig_hdr[0] & 0x10)
+		hl += 4 + 4 * ((orig_hdr[14] << 8) | orig_hdr[15]);
+	memcpy(hdr,first.iov_base,12);
+	pRtp_hdr->extension = 0;
+	pRtp_hdr->timestamp = htonl(ntohl(pRtp_hdr->timestamp) + dest.ts_offset);
 
-void CRtpH264::ConstructRtpPacket(const char* file)
+	std::vector<struct iovec> iovs(entry.iovs.size() + 1);
+	size_t n = 0;
+	if(m_bRtx)
+	{
+		//RTX包：自己的SSRC、序列号和负载类型，负载为2字节的原始序列号加上原来的负载(包括FU indicator、FU header)
+		pRtp_hdr->payload = m_nRtxPt;
+		pRtp_hdr->seq_no = htons(dest.rtx_seq++);
+		pRtp_hdr->ssrc = htonl(dest.rtx_ssrc);
+		hdr[12] = seq >> 8;
+		hdr[13] = seq & 0xff;
+		iovs[n].iov_base = hdr;
+		iovs[n++].iov_len = 14;
+		if(first.iov_len > hl)
+		{
+			iovs[n].iov_base = (char*)first.iov_base + hl;
+			iovs[n++].iov_len = first.iov_len - hl;
+		}
+	}
+	else
+	{
+		//用原来的SSRC和序列号重发，接收端当作乱序到达的包
+		pRtp_hdr->seq_no = htons(seq);
+		pRtp_hdr->ssrc = htonl(dest.ssrc);
+		memcpy(hdr + 12,(char*)first.iov_base + hl,first.iov_len - hl);
+		iovs[n].iov_base = hdr;
+		iovs[n++].iov_len = 12 + first.iov_len - hl;
+	}
+	for(size_t k = 1; k < entry.iovs.size(); k++)
+		iovs[n++] = entry.iovs[k];
+
+	struct msghdr msg;
+	memset(&msg,0,sizeof(msg));
+	msg.msg_name = &dest.addr;
+	msg.msg_namelen = sizeof(dest.addr);
+	msg.msg_iov = &iovs[0];
+	msg.msg_iovlen = n;
+	if(sendmsg(mSocketFd,&msg,0) < 0)
+	{
+		printf("%s: ====haoge====retransmit seq %u failed: %s\n",__FUNCTION__,seq,strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+void CRtpH264::WaitFeedback(int64_t ns)
 {
-    char  sendbuf[1500];
-    float framerate = 25;
-    mSeq_num = 0;
-    mTimestamp_increase = 0;
-	mTs_current = 0;
+	//不响应NACK、没有拥塞控制时只需要等待
+	if((m_nHistMs <= 0 && !m_bCc) || m_Rtcp.Fd() < 0)
+	{
+		CRtpPacer::WaitUntil(ns);
+		return;
+	}
+	while(1)
+	{
+		int64_t now = CRtpPacer::Now();
+		if(now >= ns)
+			return;
+		struct pollfd pfd;
+		struct timespec ts;
+		pfd.fd = m_Rtcp.Fd();
+		pfd.events = POLLIN;
+		ts.tv_sec = (ns - now) / 1000000000LL;
+		ts.tv_nsec = (ns - now) % 1000000000LL;
+		if(ppoll(&pfd,1,&ts,NULL) > 0)
+		{
+			std::lock_guard<std::mutex> guard(m_DestLock);
+			ReadFeedback();
+		}
+	}
+}
 
-	OpenBitstreamFile(file);
-	//h264的采样率为90000HZ，因此时间戳的单位为1(秒)/90000，因此如果当前视频帧率为25fps，那时间戳间隔或者说增量应该为3600，
-	//每帧是1/25秒，那么这1/25秒有多少个时间戳单元呢，除以1/90000即可。而如果帧率为30fps，则增量为3000，以此类推
-    mTimestamp_increase = (unsigned int)(90000.0 / framerate); //+0.5);
-    AllocNALU(8000000);//为结构体nalu_t及其成员buf分配空间。返回值为指向nalu_t存储空间的指针
 
-	while(!feof(p_h264bitstream))
+void CRtpH264::SetFec(bool bFec,int pt)
+{
+	FlushPackets();
+	m_Fec.EndFrame();
+	m_Fec.Clear();
+	m_bFec = bFec;
+	m_nFecPt = pt & 0x7f;
+}
+
+int CRtpH264::SetFecLevel(int type,int L,int D)
+{
+	if(type < RTP_FEC_IDR || type > RTP_FEC_NONREF || L < 0 || L > RTP_FEC_MAX_LD || D < 0 || D > RTP_FEC_MAX_LD)
+	{
+		printf("%s: ====haoge====invalid fec level %d: L %d D %d\n",__FUNCTION__,type,L,D);
+		return 0;
+	}
+	m_FecL[type] = L;
+	m_FecD[type] = D;
+	return 1;
+}
+
+void CRtpH264::EndFecFrame()
+{
+	if(!m_bFec)
+		return;
+	m_Fec.EndFrame();
+	if(m_Fec.Count() > 0)
 	{
-		GetAnnexbNALU(p_Nalu);//每执行一次，文件的指针指向本次找到的NALU的末尾，下一个位置即为下个NALU的起始码
-		//（1）一个NALU就是一个RTP包的情况： RTP_FIXED_HEADER（12字节）  + NALU_HEADER（1字节） + EBPS
-        //（2）一个NALU分成多个RTP包的情况： RTP_FIXED_HEADER （12字节） + FU_INDICATOR （1字节）+  FU_HEADER（1字节） + EBPS(1400字节)
-        memset(sendbuf, 0, 1500);//清空sendbuf；此时会将上次的时间戳清空，因此需要mTs_current来保存上次的时间戳值
-		SendRtpPacket(sendbuf,p_Nalu);
+		std::lock_guard<std::mutex> guard(m_DestLock);
+		SendFecPackets();
 	}
 }
 
+void CRtpH264::SendFecPackets()
+{
+	const int hdrlen = 12 + RTP_FEC_HDR_LEN;
+	int n = m_Fec.Count();
 
+	if(m_FecHdr.size() < (size_t)n * hdrlen)
+		m_FecHdr.resize(n * hdrlen);
+	if(m_FecIovs.size() < (size_t)n * 2)
+		m_FecIovs.resize(n * 2);
+	if(m_FecMsgs.size() < (size_t)n)
+		m_FecMsgs.resize(n);
+
+	//修复负载共享，每个目的地址只生成RTP包头和FEC头：序列号、时间戳改写后SN base加上偏移，TS recovery重新异或
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const RtpFecPacket& p = m_Fec.Packet(i);
+			unsigned char* hdr = &m_FecHdr[i * hdrlen];
+			RTP_FIXED_HEADER* pRtp_hdr = (RTP_FIXED_HEADER*)hdr;
+			pRtp_hdr->csrc_len  = 0;
+			pRtp_hdr->extension = 0;
+			pRtp_hdr->padding   = 0;
+			pRtp_hdr->payload   = m_nFecPt;
+			pRtp_hdr->version   = 2;
+			pRtp_hdr->marker    = 0;
+			pRtp_hdr->seq_no    = htons(it->fec_seq++);
+			pRtp_hdr->timestamp = htonl(p.timestamp + it->ts_offset);
+			pRtp_hdr->ssrc      = htonl(it->fec_ssrc);
+
+			unsigned char* fec = hdr + 12;
+			unsigned int ts = 0;
+			unsigned short base = p.sn_base + it->seq_offset;
+			for(size_t k = 0; k < p.ts.size(); k++)
+				ts ^= p.ts[k] + it->ts_offset;
+			memcpy(fec,&p.data[0],RTP_FEC_HDR_LEN);
+			fec[4] = ts >> 24;
+			fec[5] = ts >> 16;
+			fec[6] = ts >> 8;
+			fec[7] = ts;
+			fec[8] = base >> 8;
+			fec[9] = base & 0xff;
+
+			m_FecIovs[i * 2].iov_base = hdr;
+			m_FecIovs[i * 2].iov_len = hdrlen;
+			m_FecIovs[i * 2 + 1].iov_base = (void*)&p.data[RTP_FEC_HDR_LEN];
+			m_FecIovs[i * 2 + 1].iov_len = p.len - RTP_FEC_HDR_LEN;
+			memset(&m_FecMsgs[i],0,sizeof(struct mmsghdr));
+			m_FecMsgs[i].msg_hdr.msg_name = &it->addr;
+			m_FecMsgs[i].msg_hdr.msg_namelen = sizeof(it->addr);
+			m_FecMsgs[i].msg_hdr.msg_iov = &m_FecIovs[i * 2];
+			m_FecMsgs[i].msg_hdr.msg_iovlen = 2;
+		}
+
+		//FEC包尽力发送，失败时丢弃该目的地址剩下的FEC包，不重试
+		int done = 0;
+		while(done < n)
+		{
+			int ret = sendmmsg(mSocketFd,&m_FecMsgs[done],n - done,0);
+			if(ret < 0 && errno == EINTR)
+				continue;
+			if(ret <= 0)
+			{
+				printf("%s: ====haoge====send fec to dest %d failed: %s\n",__FUNCTION__,it->id,strerror(errno));
+				break;
+			}
+			done += ret;
+		}
+		it->fec_packets += done;
+		m_nFecCount += done;
+	}
+	m_Fec.Clear();
+}
+
+void CRtpH264::SetCongestionControl(bool bCc,unsigned int start_bps,unsigned int min_bps,unsigned int max_bps)
+{
+	FlushPackets();
+	//头扩展占用了负载的长度，打开和关闭时相应调整，包长仍然不超过MTU
+	if(bCc && !m_bCc)
+		m_nMaxPayload -= RTP_TWCC_EXT_LEN;
+	else if(!bCc && m_bCc)
+		m_nMaxPayload += RTP_TWCC_EXT_LEN;
+	m_bCc = bCc;
+	if(min_bps > 0 && max_bps >= min_bps)
+	{
+		m_fCcMin = min_bps;
+		m_fCcMax = max_bps;
+	}
+	m_fCcStart = start_bps < m_fCcMin ? m_fCcMin : (start_bps > m_fCcMax ? m_fCcMax : start_bps);
+	m_fCcTarget = m_fCcStart;
+	m_fCcBudget = 0;
+	m_bCcWaitIdr = false;
+	m_Pacer.SetMaxRate(m_bCc ? m_fCcTarget : 0);
+
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+		it->gcc.SetBitrates(m_fCcStart,m_fCcMin,m_fCcMax);
+}
+
+int CRtpH264::GetCcStats(int id,RtpGccStats* stats)
+{
+	std::lock_guard<std::mutex> guard(m_DestLock);
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		if(it->id == id)
+		{
+			it->gcc.GetStats(stats);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void CRtpH264::SaveTransportSeqs(unsigned int first,unsigned int end,int64_t now)
+{
+	if(m_TwHist.empty())
+		m_TwHist.resize(RTP_TWCC_HIST);
+	for(unsigned int i = first; i < end; i++)
+	{
+		//传输序列号在头扩展的第5、6字节，打开拥塞控制之前生成的包没有头扩展
+		const unsigned char* hdr = (const unsigned char*)m_Iovs[m_PktIov[i]].iov_base;
+		if(!(hdr[0] & 0x10))
+			continue;
+		unsigned short seq = (hdr[17] << 8) | hdr[18];
+		RtpTwccEntry& entry = m_TwHist[seq & (RTP_TWCC_HIST - 1)];
+		entry.valid = true;
+		entry.seq = seq;
+		entry.time = now;
+		entry.size = PacketLen(i);
+	}
+}
+
+void CRtpH264::OnTransportFeedback(const RtcpReport& report,int64_t now)
+{
+	if(!m_bCc || m_TwHist.empty())
+		return;
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		if(it->ssrc != report.twcc_ssrc)
+			continue;
+		//所有目的地址收到的是同一份包，传输序列号相同，按序列号取出发送时刻和包长；已经被覆盖的记录不参与
+		m_CcResults.clear();
+		for(int i = 0; i < report.twcc_count; i++)
+		{
+			unsigned short seq = report.twcc_base + i;
+			const RtpTwccEntry& entry = m_TwHist[seq & (RTP_TWCC_HIST - 1)];
+			if(!entry.valid || entry.seq != seq)
+				continue;
+			RtpPacketResult r;
+			r.send_time = entry.time;
+			r.arrival = report.twcc_arrival[i];
+			r.size = entry.size;
+			m_CcResults.push_back(r);
+		}
+		if(!m_CcResults.empty())
+			it->gcc.OnFeedback(&m_CcResults[0],m_CcResults.size(),now);
+		break;
+	}
+	UpdateTarget();
+}
+
+void CRtpH264::UpdateTarget()
+{
+	double target = 0;
+
+	//同一份包发送给所有目的地址，只能按最差的链路发送
+	for(std::list<RtpDestination>::iterator it = m_Dests.begin(); it != m_Dests.end(); ++it)
+	{
+		double t = it->gcc.Target();
+		if(target == 0 || t < target)
+			target = t;
+	}
+	if(target > 0)
+		m_fCcTarget = target;
+	m_Pacer.SetMaxRate(m_fCcTarget);
+}
+
+bool CRtpH264::DropForCongestion(const AccessUnit& au)
+{
+	if(!m_bCc)
+		return false;
+
+	//每帧按目标码率增加预算，发送之后扣除该帧的字节数，积累的预算不超过RTP_CC_BUDGET_MS的字节数
+	double rate = m_fCcTarget / 8;
+	double limit = rate * RTP_CC_BUDGET_MS / 1000;
+	m_fCcBudget += rate * au.duration / AU_TIME_BASE;
+	if(m_fCcBudget > limit)
+		m_fCcBudget = limit;
+
+	bool drop = false;
+	if(au.idr)
+		m_bCcWaitIdr = false;
+	if(au.has_picture && !au.idr)
+	{
+		if(m_bCcWaitIdr)
+			drop = true;
+		else if(m_fCcBudget < 0 && !au.reference)
+		{
+			//不被参考的帧丢弃后不影响其他帧的解码，先丢弃它们
+			drop = true;
+		}
+		else if(m_fCcBudget < -2 * limit)
+		{
+			//只丢弃不被参考的帧还不够：丢弃被参考的帧之后，到下一个IDR帧之前的帧都无法正确解码，一起丢弃
+			drop = true;
+			m_bCcWaitIdr = true;
+		}
+	}
+	if(drop)
+	{
+		m_nDropped++;
+		return true;
+	}
+	m_fCcBudget -= au.size;
+	//IDR帧必须发送，它超出的部分由发送控制慢慢排出，欠下的预算最多记limit，不因为一个IDR帧就丢弃后面被参考的帧
+	if(au.idr && m_fCcBudget < -limit)
+		m_fCcBudget = -limit;
+	return false;
+}
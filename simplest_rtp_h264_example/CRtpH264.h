@@ -17,9 +17,63 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h> 
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <netinet/udp.h>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <random>
+#include "../common/CAnnexbScanner.h"
+#include "CRtpPacer.h"
+#include "CRtcp.h"
+#include "CRtpFec.h"
+#include "CRtpGcc.h"
+#include "../common/CAccessUnitAssembler.h"
+#include "../common/CNaluIndex.h"
   
+//默认的RTP负载长度(不包括RTP固定包头、FU indicator和FU header)，可以用SetMtu按MTU修改
 #define MAX_RTP_PKT_LENGTH     1400  
 #define H264                   96  
+//SetMtu允许的最小负载长度
+#define RTP_MIN_PAYLOAD        64
+//一个STAP-A包最多聚合的NALU数
+#define RTP_STAP_MAX_NALUS     64
+//一次sendmmsg最多发送的包数以及一个消息最多的iovec数(内核限制为UIO_MAXIOV)
+#define RTP_MMSG_BATCH         1024
+#define RTP_MAX_IOV            1024
+//UDP GSO一个消息最多的段数以及总字节数
+#define RTP_GSO_MAX_SEGS       64
+#define RTP_GSO_MAX_BYTES      65000
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT            103
+#endif
+//扇出时每个目的地址的包头副本在存储区中占用的大小(RTP固定包头12字节、传输序列号头扩展8字节加上最多2字节)
+#define RTP_HDR_COPY_SIZE      24
+//发送缓冲区满时等待可写的时间
+#define RTP_SEND_WAIT_MS       100
+//发送缓冲区满时最多重试的次数，之后丢弃当前包
+#define RTP_SEND_RETRY         10
+//重传缓存的槽数(2的幂)以及默认保留的时间
+#define RTP_HIST_SLOTS         8192
+#define RTP_HIST_MS            1000
+//RTX(RFC 4588)默认的负载类型
+#define RTP_RTX_PT             97
+//FEC按帧类别设置保护强度：IDR帧、被参考的帧、不被参考的帧(nal_ref_idc为0)
+#define RTP_FEC_IDR            0
+#define RTP_FEC_REF            1
+#define RTP_FEC_NONREF         2
+//拥塞控制：传输序列号放在RFC 8285一字节头的RTP头扩展中，扩展的ID以及头扩展的总长度
+#define RTP_TWCC_EXT_ID        5
+#define RTP_TWCC_EXT_LEN       8
+//按传输序列号记录发送时刻的槽数(2的幂)
+#define RTP_TWCC_HIST          4096
+//按目标码率积累的发送预算最多为这段时间的字节数，欠下的超过两倍时丢弃被参考的帧
+#define RTP_CC_BUDGET_MS       500
+//拥塞控制的起始码率，bps。发送的是编码好的码流，码率不能随目标码率调整，从低码率慢慢增加时会一直丢帧，
+//所以从较高的码率开始，由时延检测很快降到链路的容量
+#define RTP_CC_START_BPS       1500000
   
 
 /******************************************************************
@@ -229,16 +283,56 @@ typedef struct
 }FU_HEADER;	/* 1 BYTES */
 
 
-typedef struct  
+/**
+ * _RtpDestination
+ * 扇出的一个目的地址，同一份包发送时改写为各自的SSRC、序列号和时间戳
+ */
+typedef struct _RtpDestination
+{
+	int id;
+	struct sockaddr_in addr;
+	unsigned int ssrc;
+	unsigned short seq_offset;    //加到序列号上的偏移
+	unsigned int ts_offset;       //加到时间戳上的偏移
+	bool rewrite;                 //initSocket的目的地址使用原始包头，不需要改写
+	uint64_t packets;             //已经发送的包数
+	uint64_t octets;              //已经发送的负载字节数(不包括RTP固定包头)
+	struct sockaddr_in rtcp_addr; //SR的目的地址，RTP端口加1
+	RtcpStats rtcp;               //由该目的地址发回的RR得到的统计
+	unsigned int rtx_ssrc;        //RTX流的SSRC和下一个序列号
+	unsigned short rtx_seq;
+	unsigned int fec_ssrc;        //FEC流的SSRC和下一个序列号
+	unsigned short fec_seq;
+	uint64_t fec_packets;         //已经发送的FEC包数
+	CRtpGcc gcc;                  //由该目的地址的拥塞控制反馈得到的带宽估计
+	std::vector<char> hdr;        //包头副本，每包RTP_HDR_COPY_SIZE字节
+	std::vector<struct iovec> iovs; //第一段指向包头副本，其余与共享的包相同
+}RtpDestination;
+
+/**
+ * _RtpHistEntry
+ * 重传缓存中的一个已发送的包：包头复制一份，负载的iovec仍然指向NALU数据
+ */
+typedef struct _RtpHistEntry
+{
+	bool valid;
+	unsigned short seq;           //原始的序列号(目的地址改写之前)
+	int64_t time;                 //发送时刻，CLOCK_MONOTONIC纳秒
+	std::vector<char> hdr;        //包中所有在包头存储区的段
+	std::vector<struct iovec> iovs; //第一段为RTP固定包头开始的包头
+}RtpHistEntry;
+
+/**
+ * _RtpTwccEntry
+ * 按传输序列号记录的一个已发送的媒体包，收到拥塞控制反馈时与到达时刻对应
+ */
+typedef struct _RtpTwccEntry
 {
-	int startcodeprefix_len;      //! 4 for parameter sets and first slice in picture, 3 for everything else (suggested)
-	unsigned int len;             //! Length of the NAL unit (Excluding the start code, which does not belong to the NALU)
-	unsigned int max_size;        //! Nal Unit Buffer size
-	int forbidden_bit;            //! should be always FALSE
-	int nal_reference_idc;        //! NALU_PRIORITY_xxxx
-	int nal_unit_type;            //! NALU_TYPE_xxxx
-	char *buf;                    //! contains the first byte followed by the EBSP
-}NALU_t;
+	bool valid;
+	unsigned short seq;           //传输序列号
+	int64_t time;                 //发送时刻，CLOCK_MONOTONIC纳秒
+	unsigned int size;            //包长
+}RtpTwccEntry;
 
 //RTP传输H264视频碼流
 class CRtpH264
@@ -246,26 +340,278 @@ class CRtpH264
 private:
 	struct sockaddr_in mServer;
 	int mSocketFd;
-	FILE* p_h264bitstream;             //!< the bit stream file
+	CAnnexbScanner m_Scanner;          //!< the bit stream file,映射到内存后按NALU视图读取
+	CAccessUnitAssembler m_Assembler;  //把NALU组成访问单元(帧)，并给出时间戳
 	unsigned short mSeq_num;
-	unsigned int mTimestamp_increase;
 	unsigned int mTs_current;
-	NALU_t* p_Nalu;
+
+	unsigned int m_nMaxPayload;        //FU-A分片的负载长度，也是单NALU包和STAP-A包的最大负载长度
+	bool m_bStapA;                     //连续的小NALU聚合成STAP-A包
+
+	bool m_bBatchSend;                 //用sendmmsg一次发送一个访问单元的所有RTP包
+	std::vector<char> m_HdrBuf;        //RTP包头、NALU头、FU indicator、FU header以及STAP-A中NALU长度的存储区
+	size_t m_nHdrUsed;
+	bool m_bQueue;                     //逐包发送时也先放入存储区(按节奏发送)
+	CRtpPacer m_Pacer;
+	bool m_bGso;                       //批量发送时长度相同的连续包用UDP_SEGMENT合成一个消息
+	std::vector<struct mmsghdr> m_Msgs;
+	std::vector<unsigned int> m_MsgPkts; //每个消息包含的RTP包数
+	std::vector<char> m_Ctrl;          //每个消息的UDP_SEGMENT控制信息
+	std::vector<struct iovec> m_Iovs;  //所有包的各段：存储区中的包头和直接指向NALU数据的负载
+	std::vector<char> m_IovInHdr;      //iovec的地址还是存储区中的偏移
+	std::vector<unsigned int> m_PktIov; //每个包的第一段在m_Iovs中的下标
+	std::vector<unsigned int> m_PktLen; //每个包的长度
+	unsigned int m_nPkts;              //存储区中还没有发送的包数
+	unsigned int mPktCount;            //已经发送的RTP包数(所有目的地址)
+
+	std::mutex m_DestLock;             //目的地址可以在其他线程中增删
+	std::list<RtpDestination> m_Dests;
+	int m_nDestId;
+
+	CRtcp m_Rtcp;                      //发送SR、接收RR，套接字在第一次ProcessRtcp时创建
+	int64_t m_nFrameDts;               //最近发送的访问单元的DTS以及开始发送的时刻，用于SR中NTP与RTP时间戳的对应
+	int64_t m_nFrameNs;
+
+	std::vector<RtpHistEntry> m_Hist;  //按序列号索引的重传缓存，响应NACK
+	int m_nHistMs;                     //保留的时间，0表示不保存
+	bool m_bRtx;                       //用RTX流重传，否则用原来的SSRC和序列号
+	int m_nRtxPt;
+
+	CRtpFec m_Fec;                     //异或FEC编码，按帧类别取每行的包数L和每块的行数D
+	bool m_bFec;
+	int m_nFecPt;
+	int m_FecL[3];
+	int m_FecD[3];
+	unsigned int m_nFecCount;
+	std::vector<unsigned char> m_FecHdr; //发送FEC包时各包的RTP包头和FEC头
+	std::vector<struct iovec> m_FecIovs;
+	std::vector<struct mmsghdr> m_FecMsgs;
+
+	bool m_bCc;                        //基于接收端反馈的拥塞控制，媒体包带传输序列号的头扩展
+	unsigned short m_nTwSeq;           //下一个传输序列号
+	std::vector<RtpTwccEntry> m_TwHist; //按传输序列号索引的发送记录
+	std::vector<RtpPacketResult> m_CcResults;
+	double m_fCcStart;
+	double m_fCcMin;
+	double m_fCcMax;
+	double m_fCcTarget;                //所有目的地址中最小的目标码率，bps
+	double m_fCcBudget;                //按目标码率积累的发送预算，字节，为负时说明发送的超过了目标码率
+	bool m_bCcWaitIdr;                 //丢弃了被参考的帧，一直丢弃到下一个IDR帧
+	unsigned int m_nDropped;           //因拥塞丢弃的帧数
 
 private:
-	int FindStartCode2(unsigned char *Buf);//查找3字节起始码0x000001
-	int FindStartCode3(unsigned char *Buf);//查找4字节起始码0x00000001
-	int SendRtpPacket(char* sendbuf, NALU_t* n);
-	int GetAnnexbNALU(NALU_t* nalu);
+	/**
+	 * 发送一个NALU
+	 * @param n NALU视图
+	 * @param bLastOfAu 是否为访问单元的最后一个NALU，是则在最后一个RTP包上置M位
+	 */
+	int SendRtpPacket(const NaluView* n, bool bLastOfAu);
+
+	/**
+	 * 把count个连续的小NALU聚合成一个STAP-A包发送
+	 * @param bLastOfAu 包含访问单元的最后一个NALU，是则置M位
+	 */
+	int SendStapA(const NaluView* n,int count,bool bLastOfAu);
+
+	//设置时间戳，把访问单元的所有NALU打包(单NALU包、STAP-A或FU-A)
+	void PacketizeAccessUnit(const AccessUnit& au);
+
+	/**
+	 * 开始下一个RTP包：在存储区中分配RTP固定包头(拥塞控制时加上传输序列号的头扩展)加extra字节的包头，
+	 * 填好RTP固定包头和头扩展，序列号加1
+	 * @返回RTP包头之后extra字节的地址，在下一次AddHeader之前有效
+	 */
+	char* BeginPacket(bool bMarker,int extra);
+	//在当前包后面加上存储区中的len字节，返回其地址
+	char* AddHeader(int len);
+	//在当前包后面加上负载，指向NALU数据，不复制，发送之前必须有效
+	void AddPayload(const unsigned char* payload,int len);
+	//RTP包填好，逐包发送时立即发送，批量发送时留在存储区
+	void EndPacket();
+	size_t PacketLen(unsigned int i) const { return m_PktLen[i]; }
+	//第i个包最后一段的下一段在m_Iovs中的下标
+	unsigned int PacketIovEnd(unsigned int i) const { return i + 1 < m_PktIov.size() ? m_PktIov[i + 1] : m_Iovs.size(); }
+	/**
+	 * 从第first个包开始生成最多RTP_MMSG_BATCH个消息，不超过第end个包，GSO时一个消息可以包含多个包
+	 * @返回消息数
+	 */
+	unsigned int BuildMessages(unsigned int first,unsigned int end,struct sockaddr_in* addr,struct iovec* iovs);
+	/**
+	 * 把存储区中的第first到第end-1个包发送到所有目的地址
+	 * @返回成功发送的包数
+	 */
+	int SendPackets(unsigned int first,unsigned int end);
+	//为目的地址复制并改写第first到第end-1个包的包头
+	void RewriteHeaders(RtpDestination& dest,unsigned int first,unsigned int end);
+	//用sendmmsg把第first到第end-1个包发送到一个目的地址，iovs为该目的地址使用的各段
+	unsigned int SendPacketsTo(struct sockaddr_in* addr,struct iovec* iovs,unsigned int first,unsigned int end);
+	/**
+	 * 用sendmmsg发送存储区中的所有包并清空存储区，处理只发送了一部分的情况
+	 * @返回成功发送的包数
+	 */
+	int FlushPackets();
+	void ClearPackets();
+	//用RR中的报告块更新目的地址的统计
+	void UpdateRtcpStats(RtpDestination& dest,const RtcpReportBlock& block,unsigned int now);
+	//把存储区中第first到第end-1个已发送的包放入重传缓存
+	void SavePackets(unsigned int first,unsigned int end,int64_t now);
+	/**
+	 * 向目的地址重传一个包
+	 * @param seq 该目的地址看到的序列号
+	 * @成功则返回 1 , 包已经不在重传缓存中则返回 0
+	 */
+	int Retransmit(RtpDestination& dest,unsigned short seq,int64_t now);
+	//读取RR和NACK，响应NACK，返回收到的RTCP包数，调用时必须持有m_DestLock
+	int ReadFeedback();
+	//等待到绝对时刻ns，期间收到NACK立即重传(按节奏发送时的等待函数)
+	void WaitFeedback(int64_t ns);
+	//把已生成的FEC包发送到所有目的地址，调用时必须持有m_DestLock
+	void SendFecPackets();
+	//访问单元的包都发送之后，生成并发送不满的行和列的FEC包
+	void EndFecFrame();
+	//按传输序列号记录第first到第end-1个包的发送时刻
+	void SaveTransportSeqs(unsigned int first,unsigned int end,int64_t now);
+	//用拥塞控制反馈更新对应目的地址的带宽估计，调用时必须持有m_DestLock
+	void OnTransportFeedback(const RtcpReport& report,int64_t now);
+	//取所有目的地址中最小的目标码率作为发送的上限，调用时必须持有m_DestLock
+	void UpdateTarget();
+	/**
+	 * 拥塞控制：按目标码率积累发送预算，决定是否丢弃这个访问单元
+	 * @返回 true 表示丢弃
+	 */
+	bool DropForCongestion(const AccessUnit& au);
 
 public:
 	CRtpH264();
 	~CRtpH264();
 	void initSocket(const char* serIP,int port);
-	void AllocNALU(int buffersize);
-	void FreeNALU();
+
+	/**
+	 * 扇出：增加一个单播目的地址，可以在发送过程中从其他线程调用。每个访问单元只打包一次，
+	 * 发送到各目的地址时只复制并改写包头(随机的SSRC、序列号和时间戳偏移)，负载共享
+	 * @返回目的地址编号，失败则返回 -1
+	 */
+	int AddDestination(const char* ip,int port);
+	/**
+	 * 删除目的地址，initSocket给出的目的地址编号为0
+	 * @成功则返回 1 , 没有该编号则返回 0
+	 */
+	int RemoveDestination(int id);
+	int DestinationCount();
 	void OpenBitstreamFile(const char* fn);
-	void ConstructRtpPacket(const char* file);
+	//start_sec大于0时借助索引文件从该时间之前最近的IDR开始发送
+	void ConstructRtpPacket(const char* file,double start_sec = 0);
+
+	/**
+	 * 打包并发送一个访问单元，不等待
+	 * @返回发送的RTP包数
+	 */
+	int SendAccessUnit(const AccessUnit& au);
+
+	/**
+	 * 按节奏发送一个访问单元：等到由DTS换算出的绝对时刻，再用令牌桶把包分散在帧间隔的一部分内发出
+	 * @返回发送的RTP包数
+	 */
+	int SendAccessUnitPaced(const AccessUnit& au);
+
+	/**
+	 * 帧内发送占帧间隔的比例(0~1]以及令牌桶深度(字节)，默认RTP_PACER_FRACTION、RTP_PACER_BURST
+	 */
+	void SetPacing(double fraction,unsigned int burst);
+	//按节奏发送时实际发送时刻的抖动和延迟
+	void GetPacerStats(RtpPacerStats* stats) const;
+
+	/**
+	 * 发送方式，默认为true：一个访问单元的RTP包都生成后用一次sendmmsg发送；false：每个包调用一次sendmsg
+	 */
+	void SetBatchSend(bool bBatch);
+
+	/**
+	 * 按链路MTU确定RTP包的大小，支持巨帧(如9000)
+	 * @param mtu 链路MTU
+	 * @param overhead IP/UDP之外的额外开销，如隧道封装(VXLAN为50字节，IPsec、WireGuard等按实际)
+	 * @成功则返回 1 , MTU太小则返回 0
+	 */
+	int SetMtu(int mtu,int overhead = 0);
+
+	/**
+	 * STAP-A聚合，默认打开：同一访问单元中连续的小NALU放入一个RTP包，需要接收端支持packetization-mode=1
+	 */
+	void SetStapA(bool bStapA);
+
+	/**
+	 * UDP GSO，默认关闭，只在批量发送时有效。打开后一个NALU的FU-A分片(长度相同，只有最后一个较短)
+	 * 连同各自的RTP包头放入一个消息，由内核按包长切分，减少每包的协议栈开销。内核拒绝时自动关闭，改为普通发送
+	 */
+	void SetGso(bool bGso);
+	bool IsGso() const { return m_bGso; }
+	unsigned int PacketCount() const { return mPktCount; }
+	//已经发送的FEC包数(所有目的地址)
+	unsigned int FecPacketCount() const { return m_nFecCount; }
+
+	/**
+	 * RTCP：读取接收端发回的RR和NACK(从重传缓存中重发请求的包)，到了报告间隔时向每个目的地址的RTP端口加1发送SR。
+	 * 每发送一个访问单元之后调用，不等待；按节奏发送时等待的过程中也会处理NACK
+	 * @返回本次收到的RTCP包数
+	 */
+	int ProcessRtcp();
+	//SR的发送间隔，毫秒，默认RTCP_INTERVAL_MS
+	void SetRtcpInterval(int ms);
+
+	/**
+	 * 重传缓存保留的时间，默认RTP_HIST_MS，0表示不响应NACK。缓存中的负载直接指向NALU数据，
+	 * 用SendAccessUnit发送外部的访问单元时，数据在这段时间内必须有效
+	 */
+	void SetNackHistory(int ms);
+	/**
+	 * 重传方式，默认关闭：用原来的SSRC和序列号重发；打开后用RTX流(RFC 4588)，每个目的地址一个随机的SSRC，
+	 * 负载类型为pt，负载前加2字节的原始序列号，接收端需要按负载类型区分
+	 */
+	void SetRtx(bool bRtx,int pt = RTP_RTX_PT);
+	/**
+	 * 前向纠错，默认关闭：用于往返时间太长、不适合重传的单向链路。媒体包按访问单元分块，
+	 * 每行L个包生成一个异或的行FEC包，块有D行时每列再生成一个列FEC包(可以恢复连续丢失的L个包)。
+	 * FEC包是单独的RTP流(每个目的地址一个随机的SSRC)，负载类型为pt，与媒体包发送到同一个端口
+	 */
+	void SetFec(bool bFec,int pt = RTP_FEC_PT);
+	/**
+	 * 一类帧的保护强度，默认IDR帧L=4、D=4，被参考的帧L=8、D=0，不被参考的帧不保护。
+	 * 名义冗余为1/L(行)加上1/D(列)，即12.5%和50%；但分组不跨帧，帧结尾不满的行也生成一个行FEC包，
+	 * 每帧的实际冗余约为1/min(L,该帧的包数)，只有一两个包的帧是50%~100%，小帧多的码流实际冗余远高于名义值
+	 * (rtpfecloss按码流实际的包数输出两者)
+	 * @param type RTP_FEC_IDR、RTP_FEC_REF或RTP_FEC_NONREF
+	 * @param L 每行的包数，0表示不保护
+	 * @param D 每块的行数，小于2时只有行FEC
+	 * @成功则返回 1 , 参数错误则返回 0
+	 */
+	int SetFecLevel(int type,int L,int D);
+	void GetFecLevel(int type,int* L,int* D) const { *L = m_FecL[type]; *D = m_FecD[type]; }
+	/**
+	 * 取得一个目的地址的传输统计(丢包率、累计丢包、到达抖动、往返时间)，由该目的地址的RR得到
+	 * @成功则返回 1 , 没有该编号则返回 0
+	 */
+	int GetRtcpStats(int id,RtcpStats* stats);
+	//输出所有目的地址的传输统计
+	void PrintRtcpStats();
+
+	/**
+	 * 基于接收端反馈的拥塞控制，默认关闭。打开后每个媒体包带传输序列号的RTP头扩展(RFC 8285一字节头，ID为RTP_TWCC_EXT_ID)，
+	 * 接收端按各包的到达时刻发回传输层拥塞控制反馈，每个目的地址各自用CRtpGcc估计带宽，取最小的作为目标码率：
+	 * 按节奏发送时令牌速率不超过目标码率；发送的码率超过目标码率时先丢弃不被参考的帧(nal_ref_idc为0)，
+	 * 欠下的超过两倍RTP_CC_BUDGET_MS时丢弃被参考的帧，之后一直丢到下一个IDR帧。重传和FEC包不带传输序列号
+	 * @param start_bps,min_bps,max_bps 起始码率以及码率范围，单位bps
+	 */
+	void SetCongestionControl(bool bCc,unsigned int start_bps = RTP_CC_START_BPS,unsigned int min_bps = RTP_GCC_MIN_BPS,
+		unsigned int max_bps = RTP_GCC_MAX_BPS);
+	//当前的目标码率，bps，没有打开拥塞控制时为0
+	double TargetBitrate() const { return m_bCc ? m_fCcTarget : 0; }
+	//因拥塞丢弃的帧数
+	unsigned int DroppedFrameCount() const { return m_nDropped; }
+	/**
+	 * 取得一个目的地址的带宽估计
+	 * @成功则返回 1 , 没有该编号则返回 0
+	 */
+	int GetCcStats(int id,RtpGccStats* stats);
 
 };
 
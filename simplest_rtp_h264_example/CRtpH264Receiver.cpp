@@ -0,0 +1,1093 @@
+/*************************************************************************
+    > File Name: CRtpH264Receiver.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 00时42分37秒
+ ************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include "CRtpH264Receiver.h"
+
+//乱序包等待时间的峰值每输出一帧衰减一次
+#define RTP_JB_DECAY            0.98
+//抖动缓冲区深度为到达抖动的倍数
+#define RTP_JB_JITTER_K         4
+
+static const unsigned char s_StartCode[4] = { 0, 0, 0, 1 };
+
+static int64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+CRtpH264Receiver::CRtpH264Receiver() : m_nFd(-1),m_nPktSize(RTP_RECV_PKT_SIZE),m_nOut(-1),m_nCur(-1)
+{
+	m_FrameBufs.resize(RTP_FRAME_BUFS);
+	for(int i = 0; i < RTP_FRAME_BUFS; i++)
+	{
+		m_FrameBufs[i].reserve(RTP_FRAME_BUF_SIZE);
+		m_FreeFrames.push_back(i);
+	}
+	m_Slots.resize(RTP_JB_SLOTS);
+	for(int i = 0; i < RTP_JB_SLOTS; i++)
+	{
+		m_Slots[i].present = false;
+		m_Slots[i].kept = false;
+	}
+	memset(&m_Stats,0,sizeof(m_Stats));
+	memset(&m_Cur,0,sizeof(m_Cur));
+	m_bStarted = false;
+	m_nSsrc = 0;
+	m_nNextSeq = 0;
+	m_nMaxSeq = -1;
+	m_bHasTransit = false;
+	m_nTransitArrival = 0;
+	m_nTransitTs = 0;
+	m_fJitter = 0;
+	m_fReorderWait = 0;
+	m_fDepth = RTP_JB_MIN_DEPTH_MS / 1000.0;
+	m_bNextDamaged = false;
+	m_bInFu = false;
+	m_nFuStart = 0;
+	m_bHasPeer = false;
+	memset(&m_RtcpPeer,0,sizeof(m_RtcpPeer));
+	m_nSrSsrc = 0;
+	m_nSrCount = 0;
+	m_nSrNtp = 0;
+	m_nSrRtp = 0;
+	m_nSrOctets = 0;
+	m_nSrArrival = 0;
+	m_bNack = true;
+	m_nRtxPt = RTP_RECV_RTX_PT;
+	m_nNackDue = 0;
+	m_nLastNack = 0;
+	m_fRepairRtt = 0;
+	m_bFec = true;
+	m_nFecPt = RTP_FEC_PT;
+	m_fDropRate = 0;
+	m_nDropBurst = 1;
+	m_nDropLeft = 0;
+	m_bTwcc = true;
+	m_nTwccId = RTP_RECV_TWCC_EXT_ID;
+	m_TwccArrival.resize(RTP_TWCC_SLOTS);
+	m_nTwccBase = -1;
+	m_nTwccMax = -1;
+	m_nTwccEpoch = 0;
+	m_nNextTwcc = 0;
+	m_nTwccFbCount = 0;
+}
+
+CRtpH264Receiver::~CRtpH264Receiver()
+{
+	Close();
+}
+
+void CRtpH264Receiver::SetNack(bool bNack,int rtx_pt)
+{
+	m_bNack = bNack;
+	m_nRtxPt = rtx_pt & 0x7f;
+}
+
+void CRtpH264Receiver::SetFec(bool bFec,int fec_pt)
+{
+	m_bFec = bFec;
+	m_nFecPt = fec_pt & 0x7f;
+}
+
+void CRtpH264Receiver::SetTransportFeedback(bool bTwcc,int ext_id)
+{
+	m_bTwcc = bTwcc;
+	if(ext_id >= 1 && ext_id <= 14)
+		m_nTwccId = ext_id;
+}
+
+void CRtpH264Receiver::SetLossSimulation(double loss,int burst,unsigned int seed)
+{
+	m_fDropRate = loss > 0 ? loss : 0;
+	m_nDropBurst = burst > 1 ? burst : 1;
+	m_nDropLeft = 0;
+	m_Rand.seed(seed);
+}
+
+bool CRtpH264Receiver::SimulateLoss()
+{
+	if(m_nDropLeft > 0)
+	{
+		m_nDropLeft--;
+		return true;
+	}
+	//每次丢包事件连续丢弃m_nDropBurst个包，事件的概率相应减小
+	if(m_Rand() / 4294967296.0 < m_fDropRate / m_nDropBurst)
+	{
+		m_nDropLeft = m_nDropBurst - 1;
+		return true;
+	}
+	return false;
+}
+
+void CRtpH264Receiver::SetMaxPacketSize(int size)
+{
+	if(size > 12 && m_nFd < 0)
+		m_nPktSize = size;
+}
+
+int CRtpH264Receiver::Open(int port,const char* ip)
+{
+	struct sockaddr_in addr;
+	int bufsize = RTP_RECV_SOCK_BUF;
+
+	Close();
+	ResetSequence();
+	//包缓冲区：抖动缓冲区的每个槽一个，再加上recvmmsg一批、缓存的FEC包以及恢复时用的一个，接收之后只交换缓冲区编号，不复制
+	int bufs = RTP_JB_SLOTS + RTP_RECV_BATCH + RTP_FEC_PENDING + 1;
+	m_Pool.resize((size_t)bufs * m_nPktSize);
+	m_FreeBufs.clear();
+	for(int i = bufs - 1; i >= 0; i--)
+		m_FreeBufs.push_back(i);
+	m_BatchBufs.resize(RTP_RECV_BATCH);
+	for(int i = 0; i < RTP_RECV_BATCH; i++)
+	{
+		m_BatchBufs[i] = m_FreeBufs.back();
+		m_FreeBufs.pop_back();
+	}
+	m_Msgs.resize(RTP_RECV_BATCH);
+	m_Iovs.resize(RTP_RECV_BATCH);
+	m_Ctrl.resize(RTP_RECV_BATCH * CMSG_SPACE(sizeof(struct timespec)));
+	m_nTwccBase = -1;
+	m_nTwccMax = -1;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET,ip,&addr.sin_addr) != 1 || (m_nFd = socket(AF_INET,SOCK_DGRAM,0)) < 0)
+	{
+		printf("%s: ====haoge====socket error\n",__FUNCTION__);
+		return 0;
+	}
+	//视频的IDR帧会一次到达很多包，加大接收缓冲区；拥塞控制反馈需要每个包的到达时刻，由内核记录，一批包不会是同一个时刻
+	int on = 1;
+	setsockopt(m_nFd,SOL_SOCKET,SO_RCVBUF,&bufsize,sizeof(bufsize));
+	setsockopt(m_nFd,SOL_SOCKET,SO_TIMESTAMPNS,&on,sizeof(on));
+	if(bind(m_nFd,(struct sockaddr*)&addr,sizeof(addr)) != 0)
+	{
+		printf("%s: ====haoge====bind port %d error: %s\n",__FUNCTION__,port,strerror(errno));
+		Close();
+		return 0;
+	}
+	//RTCP不影响接收，端口被占用时只是没有SR/RR
+	m_bHasPeer = false;
+	m_nSrCount = 0;
+	m_Rtcp.Open(port + 1,ip);
+	return 1;
+}
+
+void CRtpH264Receiver::Close()
+{
+	if(m_nFd >= 0)
+		close(m_nFd);
+	m_nFd = -1;
+	m_Rtcp.Close();
+}
+
+void CRtpH264Receiver::ResetSequence()
+{
+	for(int i = 0; i < RTP_JB_SLOTS; i++)
+	{
+		if(m_Slots[i].present)
+			m_FreeBufs.push_back(m_Slots[i].buf);
+		m_Slots[i].present = false;
+		ReleaseSlot(m_Slots[i]);
+	}
+	for(size_t i = 0; i < m_Fec.size(); i++)
+		m_FreeBufs.push_back(m_Fec[i].buf);
+	m_Fec.clear();
+	m_bStarted = false;
+	m_nNextSeq = 0;
+	m_nMaxSeq = -1;
+	m_bHasTransit = false;
+	m_nBaseSeq = 0;
+	m_nReceived = 0;
+	m_nExpectedPrior = 0;
+	m_nReceivedPrior = 0;
+	m_fFractionLost = 0;
+	m_nNackDue = 0;
+}
+
+int CRtpH264Receiver::ReadBatch(int64_t now)
+{
+	size_t ctrl = CMSG_SPACE(sizeof(struct timespec));
+
+	for(int i = 0; i < RTP_RECV_BATCH; i++)
+	{
+		m_Iovs[i].iov_base = Buf(m_BatchBufs[i]);
+		m_Iovs[i].iov_len = m_nPktSize;
+		memset(&m_Msgs[i],0,sizeof(struct mmsghdr));
+		m_Msgs[i].msg_hdr.msg_iov = &m_Iovs[i];
+		m_Msgs[i].msg_hdr.msg_iovlen = 1;
+		m_Msgs[i].msg_hdr.msg_control = &m_Ctrl[i * ctrl];
+		m_Msgs[i].msg_hdr.msg_controllen = ctrl;
+	}
+	int n = recvmmsg(m_nFd,&m_Msgs[0],RTP_RECV_BATCH,MSG_DONTWAIT,NULL);
+	for(int i = 0; i < n; i++)
+	{
+		if(m_Msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			m_Stats.invalid++;
+			continue;
+		}
+		if(m_fDropRate > 0 && SimulateLoss())
+		{
+			m_Stats.dropped++;
+			continue;
+		}
+		if(m_bTwcc)
+		{
+			//到达时刻取内核的时间戳，没有时用当前时刻
+			struct timespec ts;
+			struct cmsghdr* cm = CMSG_FIRSTHDR(&m_Msgs[i].msg_hdr);
+			if(cm != NULL && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS)
+				memcpy(&ts,CMSG_DATA(cm),sizeof(ts));
+			else
+				clock_gettime(CLOCK_REALTIME,&ts);
+			RecordTransportSeq(Buf(m_BatchBufs[i]),m_Msgs[i].msg_len,(int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+		}
+		Insert(&m_BatchBufs[i],m_Msgs[i].msg_len,now);
+	}
+	return n;
+}
+
+void CRtpH264Receiver::RecordTransportSeq(const unsigned char* p,int len,int64_t arrival)
+{
+	int off = 12 + 4 * (p[0] & 0x0f);
+	int seq = -1;
+
+	//只处理RFC 8285一字节头的头扩展：0xBEDE、扩展长度，之后每个元素为ID(4位)、长度减1(4位)和数据
+	if(len < off + 4 || (p[0] >> 6) != 2 || !(p[0] & 0x10) || p[off] != 0xbe || p[off + 1] != 0xde)
+		return;
+	int end = off + 4 + 4 * ((p[off + 2] << 8) | p[off + 3]);
+	if(end > len)
+		return;
+	for(int i = off + 4; i < end; )
+	{
+		int id = p[i] >> 4,size = (p[i] & 0x0f) + 1;
+		//ID为0的是填充字节，15表示后面没有元素了
+		if(id == 0)
+		{
+			i++;
+			continue;
+		}
+		if(id == 15 || i + 1 + size > end)
+			break;
+		if(id == m_nTwccId && size == 2)
+		{
+			seq = (p[i + 1] << 8) | p[i + 2];
+			break;
+		}
+		i += 1 + size;
+	}
+	if(seq < 0)
+		return;
+
+	int64_t ext = m_nTwccMax + (int16_t)(seq - (unsigned short)m_nTwccMax);
+	//第一个包，或者序列号跳得太远(发送端重新启动)时重新开始
+	if(m_nTwccBase < 0 || ext < m_nTwccBase - RTP_TWCC_SLOTS || ext > m_nTwccMax + RTP_TWCC_SLOTS)
+	{
+		if(m_nTwccBase < 0)
+			m_nTwccEpoch = arrival;
+		ext = seq;
+		m_nTwccBase = ext;
+		m_nTwccMax = ext - 1;
+	}
+	//已经反馈过(报告为没有收到)的包不再报告
+	if(ext < m_nTwccBase)
+		return;
+	for(int64_t q = m_nTwccMax + 1; q <= ext; q++)
+		m_TwccArrival[q & (RTP_TWCC_SLOTS - 1)] = -1;
+	if(ext > m_nTwccMax)
+		m_nTwccMax = ext;
+	//还不知道发送端的地址时只保留最近的RTP_TWCC_SLOTS个
+	if(m_nTwccMax - m_nTwccBase >= RTP_TWCC_SLOTS)
+		m_nTwccBase = m_nTwccMax - RTP_TWCC_SLOTS + 1;
+	int64_t us = (arrival - m_nTwccEpoch) / 1000;
+	m_TwccArrival[ext & (RTP_TWCC_SLOTS - 1)] = us > 0 ? us : 0;
+}
+
+void CRtpH264Receiver::SendTransportFeedback(int64_t now)
+{
+	int64_t arrival[RTCP_MAX_TWCC];
+
+	if(!m_bTwcc || !m_bHasPeer || m_nTwccBase < 0 || m_nTwccBase > m_nTwccMax || now < m_nNextTwcc)
+		return;
+	m_nNextTwcc = now + RTP_TWCC_INTERVAL_MS * 1000000LL;
+	//上一个反馈之后的所有包，一个反馈包最多报告RTCP_MAX_TWCC个
+	while(m_nTwccBase <= m_nTwccMax)
+	{
+		int n = m_nTwccMax - m_nTwccBase + 1 < RTCP_MAX_TWCC ? (int)(m_nTwccMax - m_nTwccBase + 1) : RTCP_MAX_TWCC;
+		bool received = false;
+		for(int k = 0; k < n; k++)
+		{
+			arrival[k] = m_TwccArrival[(m_nTwccBase + k) & (RTP_TWCC_SLOTS - 1)];
+			if(arrival[k] >= 0)
+				received = true;
+		}
+		if(!received)
+		{
+			m_nTwccBase += n;
+			continue;
+		}
+		int sent = m_Rtcp.SendTransportFeedback(&m_RtcpPeer,m_nSsrc,(unsigned short)m_nTwccBase,m_nTwccFbCount,arrival,n);
+		if(sent <= 0)
+			break;
+		m_nTwccFbCount = (m_nTwccFbCount + 1) & 0xff;
+		m_nTwccBase += sent;
+		m_Stats.feedbacks++;
+	}
+}
+
+void CRtpH264Receiver::Insert(int* buf,int len,int64_t now,bool recovered)
+{
+	unsigned char* p = Buf(*buf);
+	int off = 0;
+	if(len < 12 || (p[0] >> 6) != 2)
+	{
+		m_Stats.invalid++;
+		return;
+	}
+	if(!recovered && m_bFec && (p[1] & 0x7f) == m_nFecPt)
+	{
+		InsertFec(buf,len);
+		return;
+	}
+	bool rtx = !recovered && ((p[1] & 0x7f) == m_nRtxPt);
+	if(rtx)
+	{
+		//RTX包：负载的前2字节为原始序列号。把RTP固定包头后移2字节盖住它，改回原始的序列号和SSRC，就是原来的包
+		if(!m_bStarted || len < 14 || (p[0] & 0x1f) != 0)
+		{
+			m_Stats.invalid++;
+			return;
+		}
+		unsigned char osn[2] = { p[12], p[13] };
+		memmove(p + 2,p,12);
+		off = 2;
+		p += 2;
+		len -= 2;
+		p[2] = osn[0];
+		p[3] = osn[1];
+		p[8] = m_nSsrc >> 24;
+		p[9] = m_nSsrc >> 16;
+		p[10] = m_nSsrc >> 8;
+		p[11] = m_nSsrc;
+		m_Stats.rtx++;
+	}
+	unsigned short seq = (p[2] << 8) | p[3];
+	unsigned int ts = ((unsigned int)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+	unsigned int ssrc = ((unsigned int)p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11];
+	if(!recovered)
+	{
+		m_Stats.packets++;
+		m_Stats.bytes += len;
+	}
+
+	//SSRC变化(发送端重新启动)时输出缓存的包，重新开始
+	if(m_bStarted && ssrc != m_nSsrc)
+	{
+		Drain(now,true);
+		if(m_nCur >= 0)
+			FinishFrame();
+		ResetSequence();
+	}
+	int64_t ext;
+	if(!m_bStarted)
+	{
+		m_bStarted = true;
+		m_nSsrc = ssrc;
+		m_nNextSeq = seq;
+		m_nMaxSeq = seq - 1;
+		m_nBaseSeq = seq;
+		ext = seq;
+	}
+	else
+	{
+		//取与最大序列号最接近的扩展序列号，处理16位序列号的回绕
+		ext = m_nMaxSeq + (int16_t)(seq - (unsigned short)m_nMaxSeq);
+	}
+
+	//RFC 3550附录A.3：收到的包数包括重复和迟到的包，累计丢包数为应收到的包数减去它，可能为负；RTX包和恢复的包不计入原始流
+	if(!rtx && !recovered)
+		m_nReceived++;
+
+	//请求重传之后到达的包不参与到达抖动的计算，否则抖动里会包括往返时间
+	Slot& s = m_Slots[ext & (RTP_JB_SLOTS - 1)];
+	bool repaired = ext >= m_nNextSeq && ext <= m_nMaxSeq && s.seq == ext && !s.present && s.nacks > 0;
+	if(!rtx && !repaired && !recovered)
+	{
+		//RFC 3550到达抖动：J = J + (|D| - J)/16，D为相邻两包的传输时间之差。
+		//按附录A.8由到达间隔减去时间戳间隔得到D，时间戳间隔取32位有符号差，不受时间戳回绕影响
+		if(m_bHasTransit)
+		{
+			double d = (now - m_nTransitArrival) / 1e9 - (int32_t)(ts - m_nTransitTs) / 90000.0;
+			m_fJitter += ((d < 0 ? -d : d) - m_fJitter) / 16;
+		}
+		m_bHasTransit = true;
+		m_nTransitArrival = now;
+		m_nTransitTs = ts;
+	}
+
+	if(ext < m_nNextSeq)
+	{
+		m_Stats.late++;
+		return;
+	}
+	if(ext - m_nNextSeq >= RTP_JB_SLOTS)
+	{
+		//序列号跳得太远(长时间中断)：放弃缓存中的空缺，跳过的序列号都算丢失
+		Drain(now,true);
+		if(ext > m_nNextSeq)
+		{
+			m_Stats.lost += ext - m_nNextSeq;
+			MarkLoss();
+		}
+		m_nNextSeq = ext;
+		m_nMaxSeq = ext - 1;
+	}
+
+	double wait = 0;
+	if(ext <= m_nMaxSeq)
+	{
+		if(s.present && s.seq == ext)
+		{
+			m_Stats.duplicates++;
+			return;
+		}
+		if(s.seq == ext && !recovered)
+			wait = (now - s.missing_since) / 1e9;
+		if(recovered)
+		{
+			//FEC恢复的包在下面计数
+		}
+		else if(s.seq == ext && s.nacks > 0)
+		{
+			//重传的包填补了空缺，更新从请求到收到的时间
+			double rtt = (now - s.nack_time) / 1e9;
+			m_fRepairRtt = (m_fRepairRtt > 0) ? m_fRepairRtt + (rtt - m_fRepairRtt) / 8 : rtt;
+			m_Stats.repaired++;
+		}
+		else
+		{
+			//乱序到达，填补了空缺
+			m_Stats.reordered++;
+		}
+	}
+	else
+	{
+		//中间的序列号空缺，记录发现空缺的时刻，等待RTP_NACK_WAIT_MS之后还没有到达再请求重传
+		for(int64_t q = m_nMaxSeq + 1; q < ext; q++)
+		{
+			Slot& m = m_Slots[q & (RTP_JB_SLOTS - 1)];
+			ReleaseSlot(m);
+			m.seq = q;
+			m.present = false;
+			m.missing_since = now;
+			m.nacks = 0;
+			m.next_nack = now + RTP_NACK_WAIT_MS * 1000000LL;
+			if(m_nNackDue == 0 || m.next_nack < m_nNackDue)
+				m_nNackDue = m.next_nack;
+		}
+		m_nMaxSeq = ext;
+	}
+	UpdateDepth(wait);
+	if(recovered)
+		m_Stats.recovered++;
+
+	ReleaseSlot(s);
+	s.seq = ext;
+	s.present = true;
+	s.off = off;
+	s.len = len;
+	s.buf = *buf;
+	*buf = m_FreeBufs.back();
+	m_FreeBufs.pop_back();
+}
+
+void CRtpH264Receiver::ReleaseSlot(Slot& s)
+{
+	if(s.kept)
+		m_FreeBufs.push_back(s.buf);
+	s.kept = false;
+}
+
+void CRtpH264Receiver::InsertFec(int* buf,int len)
+{
+	const unsigned char* p = Buf(*buf);
+	int off = 12 + 4 * (p[0] & 0x0f);
+	unsigned short sn_base;
+	int L,D;
+
+	if(!m_bStarted || len < off + RTP_FEC_HDR_LEN || !CRtpFec::ParseHeader(p + off,len - off,&sn_base,&L,&D))
+	{
+		m_Stats.invalid++;
+		return;
+	}
+	m_Stats.fec++;
+	FecEntry e;
+	e.buf = *buf;
+	e.off = off;
+	e.len = len;
+	e.base = m_nMaxSeq + (int16_t)(sn_base - (unsigned short)m_nMaxSeq);
+	e.L = L;
+	e.D = D;
+	e.last = (D == 0) ? e.base + L - 1 : e.base + (int64_t)(D - 1) * L;
+	//保护的包都已经输出或放弃
+	if(e.last < m_nNextSeq)
+		return;
+	if(m_Fec.size() >= RTP_FEC_PENDING)
+	{
+		m_FreeBufs.push_back(m_Fec[0].buf);
+		m_Fec.erase(m_Fec.begin());
+	}
+	m_Fec.push_back(e);
+	*buf = m_FreeBufs.back();
+	m_FreeBufs.pop_back();
+}
+
+void CRtpH264Receiver::RecoverPackets(int64_t now)
+{
+	bool progress = true;
+
+	while(progress)
+	{
+		progress = false;
+		for(size_t i = 0; i < m_Fec.size();)
+		{
+			const FecEntry& e = m_Fec[i];
+			int count = (e.D == 0) ? e.L : e.D;
+			int64_t step = (e.D == 0) ? 1 : e.L,lost = -1;
+			int missing = 0;
+			bool dead = false;
+			for(int k = 0; k < count && !dead; k++)
+			{
+				int64_t q = e.base + k * step;
+				const Slot& s = m_Slots[q & (RTP_JB_SLOTS - 1)];
+				if(s.seq == q && (s.present || s.kept))
+					continue;
+				//已经放弃的包或者槽已经被重用，这一组不能再恢复
+				if(q < m_nNextSeq)
+					dead = true;
+				missing++;
+				lost = q;
+			}
+			if(!dead && missing == 1 && lost - m_nNextSeq < RTP_JB_SLOTS)
+			{
+				progress |= RecoverPacket(e,lost,now) != 0;
+				dead = true;
+			}
+			//没有丢包或者恢复完的组不再需要
+			if(dead || missing == 0 || e.last < m_nNextSeq)
+			{
+				m_FreeBufs.push_back(e.buf);
+				m_Fec.erase(m_Fec.begin() + i);
+				continue;
+			}
+			i++;
+		}
+	}
+}
+
+int CRtpH264Receiver::RecoverPacket(const FecEntry& e,int64_t seq,int64_t now)
+{
+	const unsigned char* fec = Buf(e.buf) + e.off;
+	int paylen = e.len - e.off - RTP_FEC_HDR_LEN;
+	int count = (e.D == 0) ? e.L : e.D;
+	int64_t step = (e.D == 0) ? 1 : e.L;
+	if(12 + paylen > m_nPktSize)
+		return 0;
+
+	//位串放在out + 4，FEC头的前8字节对应包头的4~11字节，修复负载正好落在RTP固定包头之后
+	int b = m_FreeBufs.back();
+	m_FreeBufs.pop_back();
+	unsigned char* out = Buf(b);
+	memcpy(out + 4,fec,8);
+	memcpy(out + 12,fec + RTP_FEC_HDR_LEN,paylen);
+	for(int k = 0; k < count; k++)
+	{
+		int64_t q = e.base + k * step;
+		if(q == seq)
+			continue;
+		const Slot& s = m_Slots[q & (RTP_JB_SLOTS - 1)];
+		if(s.len - 12 > paylen)
+		{
+			m_FreeBufs.push_back(b);
+			return 0;
+		}
+		CRtpFec::XorPacket(out + 4,Buf(s.buf) + s.off,s.len);
+	}
+
+	//由异或结果还原包头，序列号为丢失的序列号，SSRC为媒体流的SSRC
+	unsigned char b0 = out[4],b1 = out[5];
+	int len = 12 + ((out[6] << 8) | out[7]);
+	unsigned char ts[4] = { out[8], out[9], out[10], out[11] };
+	if(len > 12 + paylen)
+	{
+		m_FreeBufs.push_back(b);
+		return 0;
+	}
+	out[0] = 0x80 | (b0 & 0x3f);
+	out[1] = b1;
+	out[2] = (seq >> 8) & 0xff;
+	out[3] = seq & 0xff;
+	memcpy(out + 4,ts,4);
+	out[8] = m_nSsrc >> 24;
+	out[9] = m_nSsrc >> 16;
+	out[10] = m_nSsrc >> 8;
+	out[11] = m_nSsrc;
+	Insert(&b,len,now,true);
+	m_FreeBufs.push_back(b);
+	return 1;
+}
+
+void CRtpH264Receiver::UpdateDepth(double wait)
+{
+	//深度取到达抖动的若干倍与乱序包等待时间峰值的1.5倍中较大的一个
+	if(wait > m_fReorderWait)
+		m_fReorderWait = wait;
+	double depth = RTP_JB_JITTER_K * m_fJitter;
+	if(1.5 * m_fReorderWait > depth)
+		depth = 1.5 * m_fReorderWait;
+	if(depth < RTP_JB_MIN_DEPTH_MS / 1000.0)
+		depth = RTP_JB_MIN_DEPTH_MS / 1000.0;
+	if(depth > RTP_JB_MAX_DEPTH_MS / 1000.0)
+		depth = RTP_JB_MAX_DEPTH_MS / 1000.0;
+	m_fDepth = depth;
+}
+
+void CRtpH264Receiver::Drain(int64_t now,bool flush)
+{
+	while(m_bStarted && m_nNextSeq <= m_nMaxSeq)
+	{
+		Slot& s = m_Slots[m_nNextSeq & (RTP_JB_SLOTS - 1)];
+		if(s.present && s.seq == m_nNextSeq)
+		{
+			Depacketize(Buf(s.buf) + s.off,s.len);
+			//打开FEC时保留已输出的包，同一组中后面的包丢失时还要用它恢复
+			if(m_bFec)
+				s.kept = true;
+			else
+				m_FreeBufs.push_back(s.buf);
+			s.present = false;
+			m_nNextSeq++;
+			continue;
+		}
+		//空缺的序列号等待超过抖动缓冲区深度后放弃
+		if(!flush && now - s.missing_since < (int64_t)(m_fDepth * 1e9))
+			break;
+		m_Stats.lost++;
+		MarkLoss();
+		m_nNextSeq++;
+	}
+}
+
+int64_t CRtpH264Receiver::NextDeadline() const
+{
+	if(!m_bStarted || m_nNextSeq > m_nMaxSeq)
+		return -1;
+	const Slot& s = m_Slots[m_nNextSeq & (RTP_JB_SLOTS - 1)];
+	if(s.present && s.seq == m_nNextSeq)
+		return 0;
+	return s.missing_since + (int64_t)(m_fDepth * 1e9);
+}
+
+void CRtpH264Receiver::BeginFrame(unsigned int timestamp)
+{
+	if(m_FreeFrames.empty())
+	{
+		//调用者还没有取走的帧太多，增加一个帧缓冲区
+		m_FrameBufs.push_back(std::vector<unsigned char>());
+		m_FrameBufs.back().reserve(RTP_FRAME_BUF_SIZE);
+		m_FreeFrames.push_back(m_FrameBufs.size() - 1);
+	}
+	m_nCur = m_FreeFrames.back();
+	m_FreeFrames.pop_back();
+	m_FrameBufs[m_nCur].clear();
+	memset(&m_Cur,0,sizeof(m_Cur));
+	m_Cur.timestamp = timestamp;
+	m_Cur.complete = !m_bNextDamaged;
+	m_bNextDamaged = false;
+	m_bInFu = false;
+}
+
+void CRtpH264Receiver::FinishFrame()
+{
+	std::vector<unsigned char>& buf = m_FrameBufs[m_nCur];
+	if(m_bInFu)
+	{
+		//没有收到最后一个分片的NALU丢弃
+		buf.resize(m_nFuStart);
+		m_Cur.complete = 0;
+		m_bInFu = false;
+	}
+	if(buf.empty())
+	{
+		//整帧都丢了，丢包记到下一帧上
+		if(!m_Cur.complete)
+			m_bNextDamaged = true;
+		m_FreeFrames.push_back(m_nCur);
+	}
+	else
+	{
+		m_Cur.size = buf.size();
+		m_Ready.push_back(m_Cur);
+		m_ReadyBufs.push_back(m_nCur);
+		m_Stats.frames++;
+		if(!m_Cur.complete)
+			m_Stats.damaged++;
+	}
+	m_nCur = -1;
+	m_fReorderWait *= RTP_JB_DECAY;
+}
+
+void CRtpH264Receiver::MarkLoss()
+{
+	if(m_nCur < 0)
+	{
+		//丢失的可能是下一帧的第一个包
+		m_bNextDamaged = true;
+		return;
+	}
+	m_Cur.complete = 0;
+	if(m_bInFu)
+	{
+		//分片丢失，这个NALU的其余分片也没有用了
+		m_FrameBufs[m_nCur].resize(m_nFuStart);
+		m_bInFu = false;
+	}
+}
+
+void CRtpH264Receiver::AppendNalu(const unsigned char* hdr,int hdrlen,const unsigned char* data,int len)
+{
+	std::vector<unsigned char>& buf = m_FrameBufs[m_nCur];
+	buf.insert(buf.end(),s_StartCode,s_StartCode + 4);
+	buf.insert(buf.end(),hdr,hdr + hdrlen);
+	buf.insert(buf.end(),data,data + len);
+}
+
+void CRtpH264Receiver::Depacketize(const unsigned char* pkt,int len)
+{
+	int off = 12 + 4 * (pkt[0] & 0x0f);
+	int end = len;
+	bool marker = pkt[1] >> 7;
+	unsigned int ts = ((unsigned int)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) | pkt[7];
+
+	//跳过扩展头，去掉填充
+	if((pkt[0] & 0x10) && off + 4 <= len)
+		off += 4 + 4 * ((pkt[off + 2] << 8) | pkt[off + 3]);
+	if(pkt[0] & 0x20)
+		end -= pkt[len - 1];
+	if(off >= end)
+	{
+		m_Stats.invalid++;
+		return;
+	}
+
+	//时间戳变化说明上一帧带M位的包丢失了
+	if(m_nCur >= 0 && ts != m_Cur.timestamp)
+		FinishFrame();
+	if(m_nCur < 0)
+		BeginFrame(ts);
+
+	const unsigned char* p = pkt + off;
+	int n = end - off;
+	int type = p[0] & 0x1f;
+	if(type >= 1 && type <= 23)
+	{
+		//单NALU包
+		AppendNalu(p,1,p + 1,n - 1);
+		m_Cur.nalus++;
+		if(type == 5)
+			m_Cur.keyframe = 1;
+	}
+	else if(type == 24)
+	{
+		//STAP-A：多个(2字节长度 + NALU)
+		int i = 1;
+		while(i + 2 <= n)
+		{
+			int size = (p[i] << 8) | p[i + 1];
+			i += 2;
+			if(size == 0 || i + size > n)
+			{
+				m_Cur.complete = 0;
+				break;
+			}
+			AppendNalu(p + i,1,p + i + 1,size - 1);
+			m_Cur.nalus++;
+			if((p[i] & 0x1f) == 5)
+				m_Cur.keyframe = 1;
+			i += size;
+		}
+	}
+	else if(type == 28 && n >= 2)
+	{
+		//FU-A：由FU indicator的F、NRI和FU header的类型恢复NALU头
+		bool S = p[1] >> 7;
+		bool E = (p[1] >> 6) & 1;
+		unsigned char h = (p[0] & 0xe0) | (p[1] & 0x1f);
+		if(S)
+		{
+			if(m_bInFu)
+			{
+				m_FrameBufs[m_nCur].resize(m_nFuStart);
+				m_Cur.complete = 0;
+			}
+			m_nFuStart = m_FrameBufs[m_nCur].size();
+			AppendNalu(&h,1,p + 2,n - 2);
+			m_bInFu = true;
+		}
+		else if(m_bInFu)
+			m_FrameBufs[m_nCur].insert(m_FrameBufs[m_nCur].end(),p + 2,p + n);
+		else
+			m_Cur.complete = 0;   //没有第一个分片
+		if(E && m_bInFu)
+		{
+			m_bInFu = false;
+			m_Cur.nalus++;
+			if((h & 0x1f) == 5)
+				m_Cur.keyframe = 1;
+		}
+	}
+	else
+	{
+		//STAP-B、MTAP、FU-B只用于交错模式，不支持
+		m_Stats.invalid++;
+	}
+
+	if(marker)
+		FinishFrame();
+}
+
+int CRtpH264Receiver::ReceiveFrame(RtpFrame& frame,int timeout_ms)
+{
+	int64_t end = now_ns() + (int64_t)timeout_ms * 1000000;
+
+	//上一次交给调用者的帧缓冲区可以重用了
+	if(m_nOut >= 0)
+		m_FreeFrames.push_back(m_nOut);
+	m_nOut = -1;
+	ProcessRtcp(now_ns());
+
+	while(m_Ready.empty())
+	{
+		int64_t now = now_ns();
+		Drain(now,false);
+		if(!m_Ready.empty())
+			break;
+		if(now >= end || m_nFd < 0)
+			return 0;
+
+		//等到有包到达、超时、抖动缓冲区中的空缺需要放弃或者该发送RR
+		int64_t wait = end - now;
+		int64_t deadline = NextDeadline();
+		if(deadline >= 0 && deadline - now < wait)
+			wait = deadline > now ? deadline - now : 0;
+		if(m_bHasPeer && m_Rtcp.NextReportTime() - now < wait)
+			wait = m_Rtcp.NextReportTime() > now ? m_Rtcp.NextReportTime() - now : 0;
+		if(m_bNack && m_bHasPeer && m_nNackDue > 0 && m_nNackDue - now < wait)
+			wait = m_nNackDue > now ? m_nNackDue - now : 0;
+		if(m_bTwcc && m_bHasPeer && m_nTwccBase >= 0 && m_nTwccBase <= m_nTwccMax && m_nNextTwcc - now < wait)
+			wait = m_nNextTwcc > now ? m_nNextTwcc - now : 0;
+		struct pollfd pfd[2];
+		pfd[0].fd = m_nFd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = m_Rtcp.Fd();
+		pfd[1].events = POLLIN;
+		if(poll(pfd,pfd[1].fd >= 0 ? 2 : 1,(int)((wait + 999999) / 1000000)) > 0 && (pfd[0].revents & POLLIN))
+		{
+			while(ReadBatch(now_ns()) == RTP_RECV_BATCH)
+				;
+			if(!m_Fec.empty())
+				RecoverPackets(now_ns());
+		}
+		ProcessRtcp(now_ns());
+	}
+
+	frame = m_Ready.front();
+	m_nOut = m_ReadyBufs.front();
+	frame.data = &m_FrameBufs[m_nOut][0];
+	m_Ready.pop_front();
+	m_ReadyBufs.pop_front();
+	return 1;
+}
+
+void CRtpH264Receiver::Flush()
+{
+	if(!m_Fec.empty())
+		RecoverPackets(now_ns());
+	Drain(now_ns(),true);
+	if(m_nCur >= 0)
+		FinishFrame();
+}
+
+void CRtpH264Receiver::GetStats(RtpRecvStats* stats) const
+{
+	*stats = m_Stats;
+	stats->jitter = m_fJitter * 1000;
+	stats->depth = m_fDepth * 1000;
+}
+
+void CRtpH264Receiver::ProcessRtcp(int64_t now)
+{
+	RtcpReport report;
+	struct sockaddr_in from;
+	int ret;
+
+	if(m_Rtcp.Fd() < 0)
+		return;
+	while((ret = m_Rtcp.Read(&report,&from)) != 0)
+	{
+		if(ret < 0 || !report.has_sr)
+			continue;
+		//记下SR的时间戳对应关系和到达时刻(计算DLSR)，RR发回SR的来源地址
+		if(report.ssrc != m_nSrSsrc)
+			m_nSrCount = 0;
+		m_nSrSsrc = report.ssrc;
+		m_nSrCount++;
+		m_nSrNtp = report.ntp;
+		m_nSrRtp = report.rtp;
+		m_nSrOctets = report.octets;
+		m_nSrArrival = report.arrival;
+		m_RtcpPeer = from;
+		m_bHasPeer = true;
+	}
+
+	if(m_bHasPeer && m_Rtcp.ReportDue(now))
+	{
+		RtcpReportBlock block;
+		if(m_bStarted)
+		{
+			BuildReportBlock(&block);
+			m_Rtcp.SendRr(&m_RtcpPeer,&block,1);
+		}
+		else
+			m_Rtcp.SendRr(&m_RtcpPeer,NULL,0);
+	}
+	SendNacks(now_ns());
+	SendTransportFeedback(now_ns());
+}
+
+void CRtpH264Receiver::SendNacks(int64_t now)
+{
+	unsigned short seqs[RTCP_MAX_NACKS];
+	int n = 0;
+	int64_t due = 0;
+
+	if(!m_bNack || !m_bHasPeer || !m_bStarted || m_nNackDue == 0 || now < m_nNackDue)
+		return;
+	//限速：两个NACK包之间至少间隔RTP_NACK_MIN_INTERVAL_MS，期间新发现的空缺下一次一起请求
+	if(now - m_nLastNack < RTP_NACK_MIN_INTERVAL_MS * 1000000LL)
+	{
+		m_nNackDue = m_nLastNack + RTP_NACK_MIN_INTERVAL_MS * 1000000LL;
+		return;
+	}
+	//重复请求的间隔取测到的重传往返时间的2倍(不小于RTP_NACK_WAIT_MS)，还没有测到时用RTP_NACK_RETRY_MS
+	int64_t retry = RTP_NACK_RETRY_MS * 1000000LL;
+	if(m_fRepairRtt > 0)
+	{
+		retry = (int64_t)(2 * m_fRepairRtt * 1e9);
+		if(retry < RTP_NACK_WAIT_MS * 1000000LL)
+			retry = RTP_NACK_WAIT_MS * 1000000LL;
+	}
+
+	for(int64_t q = m_nNextSeq; q <= m_nMaxSeq; q++)
+	{
+		Slot& s = m_Slots[q & (RTP_JB_SLOTS - 1)];
+		if(s.present || s.seq != q || s.nacks >= RTP_NACK_RETRIES)
+			continue;
+		if(s.next_nack > now || n == RTCP_MAX_NACKS)
+		{
+			if(due == 0 || s.next_nack < due)
+				due = s.next_nack;
+			continue;
+		}
+		seqs[n++] = (unsigned short)q;
+		s.nacks++;
+		s.nack_time = now;
+		s.next_nack = now + retry;
+		if(s.nacks < RTP_NACK_RETRIES && (due == 0 || s.next_nack < due))
+			due = s.next_nack;
+	}
+	m_nNackDue = due;
+	if(n > 0)
+	{
+		m_Rtcp.SendNack(&m_RtcpPeer,m_nSsrc,seqs,n);
+		m_nLastNack = now;
+		m_Stats.nacks += n;
+	}
+}
+
+void CRtpH264Receiver::BuildReportBlock(RtcpReportBlock* block)
+{
+	int64_t expected = m_nMaxSeq - m_nBaseSeq + 1;
+	int64_t lost = expected - (int64_t)m_nReceived;
+	//区间丢包率：上一个RR之后应收到的包数中丢失的比例，重复包多于丢包时为0
+	int64_t expected_interval = expected - m_nExpectedPrior;
+	int64_t lost_interval = expected_interval - (int64_t)(m_nReceived - m_nReceivedPrior);
+	m_nExpectedPrior = expected;
+	m_nReceivedPrior = m_nReceived;
+	unsigned int fraction = (expected_interval <= 0 || lost_interval <= 0) ? 0 : (unsigned int)((lost_interval << 8) / expected_interval);
+	m_fFractionLost = fraction / 256.0;
+
+	block->ssrc = m_nSsrc;
+	block->fraction_lost = fraction > 255 ? 255 : fraction;
+	block->lost = lost > 0x7fffff ? 0x7fffff : (lost < -0x800000 ? -0x800000 : (int)lost);
+	block->highest_seq = (unsigned int)m_nMaxSeq;
+	block->jitter = (unsigned int)(m_fJitter * RTCP_CLOCK_RATE);
+	block->lsr = 0;
+	block->dlsr = 0;
+	if(m_nSrCount > 0 && m_nSrSsrc == m_nSsrc)
+	{
+		block->lsr = CRtcp::NtpMiddle(m_nSrNtp);
+		//DLSR从内核收到SR的时刻算起，单位1/65536秒
+		block->dlsr = CRtcp::NtpMiddle(CRtcp::NtpNow() - m_nSrArrival);
+	}
+}
+
+int CRtpH264Receiver::GetRtcpStats(RtcpStats* stats) const
+{
+	memset(stats,0,sizeof(RtcpStats));
+	stats->rtt = -1;
+	if(!m_bStarted)
+		return 0;
+	stats->ssrc = m_nSsrc;
+	stats->packets = m_nReceived;
+	stats->expected = m_nMaxSeq - m_nBaseSeq + 1;
+	stats->lost = stats->expected - (int64_t)m_nReceived;
+	stats->fraction_lost = m_fFractionLost;
+	stats->highest_seq = (unsigned int)m_nMaxSeq;
+	stats->jitter = m_fJitter * 1000;
+	stats->nacks = m_Stats.nacks;
+	stats->repaired = m_Stats.repaired;
+	if(m_nSrCount > 0 && m_nSrSsrc == m_nSsrc)
+	{
+		stats->reports = m_nSrCount;
+		stats->octets = m_nSrOctets;
+		stats->sr_ntp = m_nSrNtp;
+		stats->sr_rtp = m_nSrRtp;
+	}
+	return 1;
+}
+
+int CRtpH264Receiver::RtpToNtp(unsigned int timestamp,uint64_t* ntp) const
+{
+	if(m_nSrCount == 0 || m_nSrSsrc != m_nSsrc)
+		return 0;
+	*ntp = CRtcp::RtpToNtp(m_nSrNtp,m_nSrRtp,timestamp);
+	return 1;
+}
+
@@ -0,0 +1,307 @@
+/*************************************************************************
+    > File Name: CRtpH264Receiver.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 00时42分37秒
+ ************************************************************************/
+
+#ifndef CRTP_H264_RECEIVER_H
+#define CRTP_H264_RECEIVER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <vector>
+#include <deque>
+#include <random>
+#include "CRtcp.h"
+#include "CRtpFec.h"
+
+//抖动缓冲区的槽数(2的幂)，即最多缓存的序列号范围
+#define RTP_JB_SLOTS            1024
+//一次recvmmsg最多接收的包数
+#define RTP_RECV_BATCH          64
+//默认的最大包长，巨帧时用SetMaxPacketSize加大
+#define RTP_RECV_PKT_SIZE       2048
+//套接字接收缓冲区大小
+#define RTP_RECV_SOCK_BUF       (4*1024*1024)
+//预先分配的帧缓冲区个数以及每个的初始大小
+#define RTP_FRAME_BUFS          4
+#define RTP_FRAME_BUF_SIZE      (1024*1024)
+//抖动缓冲区深度(等待乱序包的时间)的范围，单位毫秒
+#define RTP_JB_MIN_DEPTH_MS     20
+#define RTP_JB_MAX_DEPTH_MS     500
+//发现空缺后等待乱序包的时间，之后才发送NACK
+#define RTP_NACK_WAIT_MS        5
+//两个NACK包之间的最小间隔(限速)
+#define RTP_NACK_MIN_INTERVAL_MS 5
+//同一个序列号最多请求的次数，以及没有测到重传往返时间时重复请求的间隔
+#define RTP_NACK_RETRIES        3
+#define RTP_NACK_RETRY_MS       20
+//RTX(RFC 4588)默认的负载类型
+#define RTP_RECV_RTX_PT         97
+//最多缓存的还不能用于恢复的FEC包数
+#define RTP_FEC_PENDING         64
+//拥塞控制：传输序列号头扩展的ID(与发送端的RTP_TWCC_EXT_ID相同)、发送反馈的间隔(毫秒)以及记录到达时刻的序列号范围(2的幂)
+#define RTP_RECV_TWCC_EXT_ID    5
+#define RTP_TWCC_INTERVAL_MS    50
+#define RTP_TWCC_SLOTS          4096
+
+/**
+ * _RtpFrame
+ * 重组出的一个访问单元，Annex-B格式(每个NALU前加00 00 00 01)，数据在下一次调用ReceiveFrame之前有效
+ */
+typedef struct _RtpFrame
+{
+	const unsigned char* data;
+	unsigned int size;
+	unsigned int timestamp;       //RTP时间戳，单位1/90000秒
+	unsigned int nalus;
+	int complete;                 //该帧以及它与上一个输出的帧之间都没有丢包
+	int keyframe;                 //包含IDR片
+}RtpFrame;
+
+/**
+ * _RtpRecvStats
+ * 接收统计
+ */
+typedef struct _RtpRecvStats
+{
+	uint64_t packets;             //收到的RTP包数
+	uint64_t bytes;
+	uint64_t lost;                //等待超过抖动缓冲区深度后放弃的序列号数
+	uint64_t reordered;           //比已收到的最大序列号小的包(填补了空缺)
+	uint64_t late;                //对应的序列号已经输出或放弃之后才到达的包
+	uint64_t duplicates;
+	uint64_t invalid;             //不是RTP包或者负载类型不支持
+	uint64_t nacks;               //用NACK请求重传的序列号数(包括重复请求)
+	uint64_t repaired;            //请求之后收到的包
+	uint64_t rtx;                 //收到的RTX包
+	uint64_t fec;                 //收到的FEC包
+	uint64_t recovered;           //用FEC恢复的包
+	uint64_t dropped;             //模拟丢包丢弃的包
+	uint64_t feedbacks;           //发送的拥塞控制反馈包数
+	uint64_t frames;              //输出的访问单元数
+	uint64_t damaged;             //其中有丢包的访问单元数
+	double jitter;                //RFC 3550到达抖动，单位毫秒
+	double depth;                 //当前的抖动缓冲区深度，单位毫秒
+}RtpRecvStats;
+
+/**
+ * RTP H.264接收，CRtpH264的对应端。用recvmmsg成批接收到预先分配的包缓冲区，
+ * 按序列号放入抖动缓冲区重新排序；空缺的序列号最多等待抖动缓冲区深度的时间，深度按到达抖动和乱序包的等待时间自适应调整。
+ * 按序列号顺序把单NALU包、STAP-A包和FU-A分片重组为Annex-B格式的访问单元(时间戳相同的包，M位结束)
+ */
+class CRtpH264Receiver
+{
+private:
+	typedef struct _Slot
+	{
+		int64_t seq;              //扩展序列号(包括回绕次数)
+		int buf;                  //包缓冲区编号
+		int len;
+		int off;                  //RTX包去掉原始序列号之后，RTP包在包缓冲区中的偏移
+		bool present;
+		bool kept;                //已经输出，包缓冲区保留到槽被重用，用于FEC恢复同一组中后面的包
+		int64_t missing_since;    //发现该序列号空缺的时刻
+		int nacks;                //已经请求重传的次数
+		int64_t next_nack;        //下一次可以请求的时刻
+		int64_t nack_time;        //最近一次请求的时刻
+	}Slot;
+
+	typedef struct _FecEntry
+	{
+		int buf;                  //FEC包所在的包缓冲区
+		int off;                  //FEC头在包中的偏移
+		int len;
+		int64_t base;             //SN base的扩展序列号
+		int L;
+		int D;
+		int64_t last;             //最后一个受保护包的扩展序列号
+	}FecEntry;
+
+	int m_nFd;
+	int m_nPktSize;
+	std::vector<unsigned char> m_Pool;      //包缓冲区
+	std::vector<int> m_FreeBufs;
+	std::vector<Slot> m_Slots;
+	std::vector<struct mmsghdr> m_Msgs;
+	std::vector<struct iovec> m_Iovs;
+	std::vector<int> m_BatchBufs;           //recvmmsg各消息使用的包缓冲区
+	std::vector<char> m_Ctrl;               //recvmmsg各消息的控制信息(内核的到达时间戳)
+
+	bool m_bStarted;
+	unsigned int m_nSsrc;
+	int64_t m_nNextSeq;                     //下一个输出的扩展序列号
+	int64_t m_nMaxSeq;                      //收到的最大扩展序列号
+
+	bool m_bHasTransit;
+	int64_t m_nTransitArrival;              //上一个参与抖动计算的包的到达时刻，纳秒
+	unsigned int m_nTransitTs;              //上一个参与抖动计算的包的RTP时间戳
+	double m_fJitter;                       //单位秒
+	double m_fReorderWait;                  //乱序包等待时间的峰值(慢慢衰减)，单位秒
+	double m_fDepth;                        //单位秒
+
+	std::vector<std::vector<unsigned char> > m_FrameBufs;
+	std::vector<int> m_FreeFrames;
+	std::deque<RtpFrame> m_Ready;
+	std::deque<int> m_ReadyBufs;
+	int m_nOut;                             //已经交给调用者的帧缓冲区
+	int m_nCur;                             //正在重组的帧缓冲区，-1表示没有
+	RtpFrame m_Cur;
+	bool m_bNextDamaged;                    //丢包发生在两帧之间，下一帧标记为不完整
+	bool m_bInFu;
+	size_t m_nFuStart;                      //正在重组的FU-A NALU在帧缓冲区中的起始位置
+
+	RtpRecvStats m_Stats;
+
+	CRtcp m_Rtcp;                           //RTP端口加1，接收SR、发送RR
+	bool m_bHasPeer;                        //收到过SR，知道RR的目的地址
+	struct sockaddr_in m_RtcpPeer;
+	int64_t m_nBaseSeq;                     //当前SSRC的第一个扩展序列号
+	uint64_t m_nReceived;                   //当前SSRC收到的包数(包括重复和迟到的包)
+	int64_t m_nExpectedPrior;               //上一个RR时应收到和实际收到的包数，用于计算区间丢包率
+	uint64_t m_nReceivedPrior;
+	double m_fFractionLost;
+	unsigned int m_nSrSsrc;                 //最近一个SR的发送端，与m_nSsrc相同时下面的值才有效
+	uint64_t m_nSrCount;
+	uint64_t m_nSrNtp;                      //最近一个SR的NTP时间戳、RTP时间戳以及收到它的时刻
+	unsigned int m_nSrRtp;
+	unsigned int m_nSrOctets;
+	uint64_t m_nSrArrival;                  //NTP时间戳
+
+	bool m_bNack;
+	int m_nRtxPt;
+	int64_t m_nNackDue;                     //最早的可以请求重传的时刻，0表示没有空缺需要请求
+	int64_t m_nLastNack;                    //上一个NACK包的发送时刻
+	double m_fRepairRtt;                    //从请求到收到重传包的平滑时间，单位秒
+
+	bool m_bFec;
+	int m_nFecPt;
+	std::vector<FecEntry> m_Fec;            //还不能恢复的FEC包，按到达顺序
+
+	double m_fDropRate;                     //模拟丢包
+	int m_nDropBurst;
+	int m_nDropLeft;                        //当前这次连续丢包还要丢弃的包数
+	std::mt19937 m_Rand;
+
+	bool m_bTwcc;
+	int m_nTwccId;
+	std::vector<int64_t> m_TwccArrival;     //按扩展传输序列号索引的到达时刻，微秒，-1表示没有收到
+	int64_t m_nTwccBase;                    //下一个反馈的第一个扩展传输序列号，-1表示还没有收到带传输序列号的包
+	int64_t m_nTwccMax;                     //收到的最大扩展传输序列号
+	int64_t m_nTwccEpoch;                   //到达时刻的起点(CLOCK_REALTIME纳秒)，反馈中的参考时刻从0开始
+	int64_t m_nNextTwcc;                    //下一次发送反馈的时刻
+	int m_nTwccFbCount;
+
+	unsigned char* Buf(int i) { return &m_Pool[(size_t)i * m_nPktSize]; }
+	int ReadBatch(int64_t now);
+	/**
+	 * 把包放入抖动缓冲区，放入后*buf换成一个空闲的包缓冲区
+	 * @param recovered 由FEC恢复的包，不计入收到的包数和到达抖动
+	 */
+	void Insert(int* buf,int len,int64_t now,bool recovered = false);
+	//缓存FEC包，放入后*buf换成一个空闲的包缓冲区
+	void InsertFec(int* buf,int len);
+	//对只缺一个包的FEC组恢复出该包，恢复的包可能让其他组也只缺一个，直到没有可以恢复的
+	void RecoverPackets(int64_t now);
+	int RecoverPacket(const FecEntry& e,int64_t seq,int64_t now);
+	//槽被重用时释放保留的包缓冲区
+	void ReleaseSlot(Slot& s);
+	bool SimulateLoss();
+	//记录带传输序列号头扩展的包的到达时刻(CLOCK_REALTIME纳秒)
+	void RecordTransportSeq(const unsigned char* p,int len,int64_t arrival);
+	//到了反馈间隔时把记录的到达时刻发回发送端
+	void SendTransportFeedback(int64_t now);
+	void ResetSequence();
+	void UpdateDepth(double wait);
+	void Drain(int64_t now,bool flush);
+	//抖动缓冲区中下一个空缺的序列号放弃的时刻，没有空缺时返回-1
+	int64_t NextDeadline() const;
+
+	void Depacketize(const unsigned char* pkt,int len);
+	void AppendNalu(const unsigned char* hdr,int hdrlen,const unsigned char* data,int len);
+	void BeginFrame(unsigned int timestamp);
+	void FinishFrame();
+	void MarkLoss();
+	//读取所有到达的SR，到了报告间隔时向发送端发送RR
+	void ProcessRtcp(int64_t now);
+	//按RFC 3550附录A.3计算当前SSRC的报告块
+	void BuildReportBlock(RtcpReportBlock* block);
+	//对等待超过RTP_NACK_WAIT_MS的空缺发送NACK，限速并限制每个序列号的请求次数
+	void SendNacks(int64_t now);
+
+public:
+	CRtpH264Receiver();
+	~CRtpH264Receiver();
+
+	/**
+	 * 丢包重传，默认打开：抖动缓冲区中的空缺用RTCP通用NACK(RFC 4585)向发送端请求重传，收到SR之后才能发送。
+	 * 发送端用RTX流(RFC 4588)重传时按负载类型rtx_pt识别，还原为原始包
+	 */
+	void SetNack(bool bNack,int rtx_pt = RTP_RECV_RTX_PT);
+
+	/**
+	 * 前向纠错，默认打开：负载类型为fec_pt的包是CRtpH264::SetFec生成的FEC包，
+	 * 一组受保护的包只丢了一个时在放弃之前恢复它
+	 */
+	void SetFec(bool bFec,int fec_pt = RTP_FEC_PT);
+
+	/**
+	 * 测试用的模拟丢包：收到的包(包括RTX和FEC包)在进入抖动缓冲区之前按loss的比例随机丢弃，
+	 * 每次连续丢弃burst个包，平均丢包率仍为loss。loss为0时关闭
+	 */
+	void SetLossSimulation(double loss,int burst = 1,unsigned int seed = 1);
+
+	/**
+	 * 拥塞控制反馈，默认打开：包中有ID为ext_id的传输序列号头扩展(CRtpH264::SetCongestionControl)时，
+	 * 记录各包的到达时刻(内核的时间戳)，每RTP_TWCC_INTERVAL_MS用传输层拥塞控制反馈发回SR的来源地址
+	 */
+	void SetTransportFeedback(bool bTwcc,int ext_id = RTP_RECV_TWCC_EXT_ID);
+
+	/**
+	 * 巨帧等大包时设置最大包长，Open之前调用
+	 */
+	void SetMaxPacketSize(int size);
+
+	/**
+	 * 绑定UDP端口，同时在端口加1上接收SR、发送RR(RR发送到SR的来源地址，收到SR之前不发送)
+	 * @param port 端口
+	 * @param ip 本地地址，默认所有地址
+	 * @成功则返回 1 , 失败则返回 0
+	 */
+	int Open(int port,const char* ip = "0.0.0.0");
+	void Close();
+
+	/**
+	 * 取得下一个重组好的访问单元
+	 * @param frame 存储访问单元，数据在下一次调用之前有效
+	 * @param timeout_ms 没有数据时最多等待的时间，毫秒
+	 * @取得访问单元则返回 1 , 超时则返回 0
+	 */
+	int ReceiveFrame(RtpFrame& frame,int timeout_ms);
+
+	/**
+	 * 放弃抖动缓冲区中的所有空缺，输出已经收到的包(流结束时调用)
+	 */
+	void Flush();
+
+	void GetStats(RtpRecvStats* stats) const;
+
+	/**
+	 * 当前发送端的传输统计：RFC 3550的累计丢包、区间丢包率、到达抖动，以及最近SR中的NTP/RTP时间戳对应关系
+	 * @收到过RTP包则返回 1 , 否则返回 0
+	 */
+	int GetRtcpStats(RtcpStats* stats) const;
+
+	/**
+	 * 按最近SR中的对应关系把RTP时间戳换算成发送端的NTP时间戳，用于音视频同步
+	 * @成功则返回 1 , 还没有收到SR则返回 0
+	 */
+	int RtpToNtp(unsigned int timestamp,uint64_t* ntp) const;
+};
+
+#endif
+
@@ -0,0 +1,141 @@
+/*************************************************************************
+    > File Name: CRtpPacer.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 23时58分20秒
+ ************************************************************************/
+
+#include <time.h>
+#include <errno.h>
+#include "CRtpPacer.h"
+#include "../common/CAccessUnitAssembler.h"
+
+CRtpPacer::CRtpPacer() : m_fFraction(RTP_PACER_FRACTION),m_nBurst(RTP_PACER_BURST),m_fMaxRate(0)
+{
+	Reset();
+}
+
+CRtpPacer::~CRtpPacer()
+{
+
+}
+
+void CRtpPacer::Reset()
+{
+	m_bStarted = false;
+	m_nBaseNs = 0;
+	m_nBaseDts = 0;
+	m_nFrameStart = 0;
+	m_fRate = 0;
+	m_nPackets = 0;
+	m_fJitter = 0;
+	m_fSumLate = 0;
+	m_nMaxLate = 0;
+	m_nPrevSched = 0;
+	m_nPrevActual = 0;
+}
+
+void CRtpPacer::SetFraction(double fraction)
+{
+	if(fraction > 0 && fraction <= 1)
+		m_fFraction = fraction;
+}
+
+void CRtpPacer::SetBurst(uint64_t bytes)
+{
+	m_nBurst = bytes;
+}
+
+void CRtpPacer::SetMaxRate(double bps)
+{
+	m_fMaxRate = bps > 0 ? bps / 8 / 1e9 : 0;
+}
+
+int64_t CRtpPacer::Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void CRtpPacer::WaitUntil(int64_t ns)
+{
+	struct timespec ts;
+	ts.tv_sec = ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+	while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR)
+		;
+}
+
+void CRtpPacer::Wait(int64_t ns)
+{
+	if(m_Waiter)
+		m_Waiter(ns);
+	else
+		WaitUntil(ns);
+}
+
+void CRtpPacer::BeginFrame(int64_t dts,int64_t duration,uint64_t bytes)
+{
+	int64_t now = Now();
+	int64_t deadline = m_nBaseNs + (dts - m_nBaseDts) * 1000000000LL / AU_TIME_BASE;
+
+	//第一帧、DTS回退(跳转)或者落后太多时以当前时刻重新确定基准
+	if(!m_bStarted || dts < m_nBaseDts || now - deadline > RTP_PACER_RESYNC_NS)
+	{
+		m_bStarted = true;
+		m_nBaseNs = now;
+		m_nBaseDts = dts;
+		deadline = now;
+	}
+	if(deadline > now)
+		Wait(deadline);
+
+	m_nFrameStart = deadline;
+	double interval = m_fFraction * duration * 1e9 / AU_TIME_BASE;
+	m_fRate = (interval > 0 && bytes > m_nBurst) ? (bytes - m_nBurst) / interval : 0;
+	if(m_fMaxRate > 0)
+	{
+		//桶深以内的包仍然立即发送，超过的部分不超过上限；上一帧发送超过了本帧的计划时刻时从当前时刻开始
+		if(m_fRate == 0 || m_fRate > m_fMaxRate)
+			m_fRate = m_fMaxRate;
+		if(now > deadline)
+			m_nFrameStart = now;
+	}
+}
+
+int64_t CRtpPacer::PacketTime(uint64_t offset,unsigned int len) const
+{
+	//令牌桶开始时是满的：前burst字节立即发送，之后按速率积累令牌
+	if(m_fRate <= 0 || offset + len <= m_nBurst)
+		return m_nFrameStart;
+	return m_nFrameStart + (int64_t)((offset + len - m_nBurst) / m_fRate);
+}
+
+void CRtpPacer::Record(int64_t sched,int64_t actual)
+{
+	int64_t late = actual - sched;
+	if(late < 0)
+		late = 0;
+	if(m_nPackets > 0)
+	{
+		//J = J + (|D| - J)/16，D为实际间隔与计划间隔之差
+		double d = (double)(actual - m_nPrevActual) - (double)(sched - m_nPrevSched);
+		m_fJitter += ((d < 0 ? -d : d) - m_fJitter) / 16;
+	}
+	m_fSumLate += late;
+	if(late > m_nMaxLate)
+		m_nMaxLate = late;
+	m_nPrevSched = sched;
+	m_nPrevActual = actual;
+	m_nPackets++;
+}
+
+void CRtpPacer::GetStats(RtpPacerStats* stats) const
+{
+	stats->packets = m_nPackets;
+	stats->jitter = m_fJitter / 1000;
+	stats->mean_late = m_nPackets ? m_fSumLate / m_nPackets / 1000 : 0;
+	stats->max_late = m_nMaxLate / 1000.0;
+}
+
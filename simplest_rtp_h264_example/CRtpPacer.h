@@ -0,0 +1,111 @@
+/*************************************************************************
+    > File Name: CRtpPacer.h
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 23时58分20秒
+ ************************************************************************/
+
+#ifndef CRTP_PACER_H
+#define CRTP_PACER_H
+
+#include <stdint.h>
+#include <functional>
+
+//默认把一帧的包分散在帧间隔的80%内发送
+#define RTP_PACER_FRACTION      0.8
+//令牌桶深度，默认可以连续发送4个满长度的RTP包
+#define RTP_PACER_BURST         (4*1500)
+//落后帧的发送时刻超过1秒(如进程被挂起)时重新确定时间基准，不再追赶
+#define RTP_PACER_RESYNC_NS     1000000000LL
+
+/**
+ * _RtpPacerStats
+ * 发送时刻的统计，单位微秒
+ */
+typedef struct _RtpPacerStats
+{
+	uint64_t packets;
+	double jitter;                //按RFC 3550的到达抖动公式计算的发送抖动：实际发送间隔与计划间隔之差的平滑值
+	double mean_late;             //实际发送时刻比计划时刻晚的平均值
+	double max_late;
+}RtpPacerStats;
+
+/**
+ * RTP发送节奏控制。每帧的计划发送时刻由RTP时间戳(DTS)换算成CLOCK_MONOTONIC上的绝对时刻，
+ * 用clock_nanosleep(TIMER_ABSTIME)等待，误差不会随帧数累积；
+ * 帧内的包用令牌桶分散在帧间隔的一部分(fraction)内，令牌速率为该帧的字节数除以这段时间，
+ * 桶深为burst字节，避免大的IDR帧一次性发出把接收端和交换机的缓冲区撑满
+ */
+class CRtpPacer
+{
+private:
+	double m_fFraction;
+	uint64_t m_nBurst;
+
+	bool m_bStarted;
+	int64_t m_nBaseNs;            //时间基准：DTS为m_nBaseDts的帧的计划时刻
+	int64_t m_nBaseDts;
+	int64_t m_nFrameStart;        //当前帧的计划时刻
+	double m_fRate;               //当前帧的令牌速率，字节/纳秒，0表示不限速
+	double m_fMaxRate;            //令牌速率的上限(拥塞控制的目标码率)，字节/纳秒，0表示不限
+
+	uint64_t m_nPackets;
+	double m_fJitter;             //单位纳秒
+	double m_fSumLate;
+	int64_t m_nMaxLate;
+	int64_t m_nPrevSched;
+	int64_t m_nPrevActual;
+
+	std::function<void(int64_t)> m_Waiter;
+
+public:
+	CRtpPacer();
+	~CRtpPacer();
+
+	void Reset();
+
+	/**
+	 * 设置帧内发送占帧间隔的比例(0~1]以及令牌桶深度(字节)
+	 */
+	void SetFraction(double fraction);
+	void SetBurst(uint64_t bytes);
+	/**
+	 * 令牌速率的上限，单位bps，0表示不限。大的帧按上限发送会超过帧间隔，下一帧从上一帧发送完的时刻开始，不再突发追赶
+	 */
+	void SetMaxRate(double bps);
+
+	//CLOCK_MONOTONIC的当前时刻，单位纳秒
+	static int64_t Now();
+	//等待到绝对时刻ns，被信号打断时继续等待
+	static void WaitUntil(int64_t ns);
+	/**
+	 * 设置等待函数，替代WaitUntil，用于在等待发送时刻的同时处理其他事件(如响应NACK重传)。
+	 * 等待函数必须在绝对时刻ns之后才返回，为空时恢复为WaitUntil
+	 */
+	void SetWaiter(const std::function<void(int64_t)>& waiter) { m_Waiter = waiter; }
+	//用等待函数等待到绝对时刻ns
+	void Wait(int64_t ns);
+
+	/**
+	 * 开始一帧：等待到该帧的计划时刻，并按帧的字节数确定令牌速率
+	 * @param dts 帧的DTS，单位1/AU_TIME_BASE秒
+	 * @param duration 帧的持续时间，单位1/AU_TIME_BASE秒
+	 * @param bytes 该帧所有RTP包的字节数
+	 */
+	void BeginFrame(int64_t dts,int64_t duration,uint64_t bytes);
+
+	/**
+	 * 帧内一个包的计划发送时刻：令牌桶中积累的令牌足够发送该包的时刻
+	 * @param offset 该帧中这个包之前的字节数
+	 * @param len 包长
+	 */
+	int64_t PacketTime(uint64_t offset,unsigned int len) const;
+
+	//记录一个包的计划时刻和实际发送时刻
+	void Record(int64_t sched,int64_t actual);
+
+	void GetStats(RtpPacerStats* stats) const;
+};
+
+#endif
+
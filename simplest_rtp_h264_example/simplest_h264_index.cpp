@@ -0,0 +1,59 @@
+/*************************************************************************
+    > File Name: simplest_h264_index.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 20时41分26秒
+ ************************************************************************/
+
+#include <string.h>
+#include "../common/CNaluIndex.h"
+
+//建立或更新H.264码流文件的索引文件(xxx.h264.idx)，并列出所有关键帧
+//用法: ./h264index [-f] 码流文件...   -f表示即使索引文件未过期也重新建立
+int main(int argc, char* argv[])
+{
+	int force = 0,ret = 0;
+
+	if(argc > 1 && strcmp(argv[1],"-f") == 0)
+	{
+		force = 1;
+		argc--;
+		argv++;
+	}
+	if(argc < 2)
+	{
+		printf("usage: %s [-f] file.h264 ...\n",argv[0]);
+		return 1;
+	}
+
+	for(int i = 1; i < argc; i++)
+	{
+		CNaluIndex index;
+		int fresh = !force && index.Load(argv[i]);
+		if(!fresh)
+		{
+			if(!index.Build(argv[i]))
+			{
+				printf("%s: open failed\n",argv[i]);
+				ret = 1;
+				continue;
+			}
+			if(!index.Save(argv[i]))
+			{
+				printf("%s: write %s failed\n",argv[i],CNaluIndex::SidecarName(argv[i]).c_str());
+				ret = 1;
+			}
+		}
+
+		printf("%s: %s, %u NALUs, %u AUs, %u keyframes\n",argv[i],fresh ? "index up to date" : "index built",
+			index.NaluCount(),index.AuCount(),index.KeyframeCount());
+		printf("  key|     time|   offset|    AU|  NALU|\n");
+		for(uint32_t k = 0; k < index.KeyframeCount(); k++)
+		{
+			const KeyframeEntry& e = index.Keyframe(k);
+			printf("%5u| %8.3f| %8llu| %5u| %5u|\n",k,(double)e.dts / AU_TIME_BASE,(unsigned long long)e.offset,e.au_index,e.nalu_index);
+		}
+	}
+	return ret;
+}
+
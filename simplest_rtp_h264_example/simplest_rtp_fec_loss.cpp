@@ -0,0 +1,135 @@
+/*************************************************************************
+    > File Name: simplest_rtp_fec_loss.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 03时48分05秒
+ ************************************************************************/
+
+#include <map>
+#include <algorithm>
+#include "CRtpH264.h"
+#include "CRtpH264Receiver.h"
+
+//回环测试使用的端口(RTCP用端口加1)
+#define LOSS_TEST_PORT 16030
+
+/**
+ * 在回环上发送整个码流，接收端模拟丢包，统计FEC恢复的包以及完整的帧。
+ * 完整的帧逐字节与原始的访问单元比较，验证恢复出的包是正确的
+ */
+static void run(const char* name,const std::vector<AccessUnit>& aus,double loss,int burst,bool fec,int L,int D)
+{
+	CRtpH264 rtp;
+	CRtpH264Receiver receiver;
+	RtpFrame frame;
+	RtpRecvStats stats;
+	std::map<unsigned int,size_t> index;
+	uint64_t complete = 0,mismatch = 0;
+	double nominal = 0;           //按设置的L、D算出的名义FEC包数
+	uint64_t expected = 0;        //按每帧实际包数(不满的行、列也生成FEC包)算出的FEC包数
+
+	//只测试FEC，关闭重传
+	receiver.SetNack(false);
+	receiver.SetLossSimulation(loss,burst,1);
+	if(!receiver.Open(LOSS_TEST_PORT,"127.0.0.1"))
+		return;
+	rtp.initSocket("127.0.0.1",LOSS_TEST_PORT);
+	rtp.SetNackHistory(0);
+	rtp.SetFec(fec);
+	if(L > 0)
+	{
+		//所有帧使用相同的保护强度
+		rtp.SetFecLevel(RTP_FEC_IDR,L,D);
+		rtp.SetFecLevel(RTP_FEC_REF,L,D);
+		rtp.SetFecLevel(RTP_FEC_NONREF,L,D);
+	}
+	for(size_t i = 0; i < aus.size(); i++)
+		index[(unsigned int)aus[i].pts] = i;
+
+	for(size_t i = 0; i <= aus.size(); i++)
+	{
+		if(i < aus.size())
+		{
+			unsigned int sent = rtp.PacketCount();
+			rtp.SendAccessUnit(aus[i]);
+			const AccessUnit& a = aus[i];
+			int fL,fD;
+			rtp.GetFecLevel(a.idr ? RTP_FEC_IDR : (a.reference || !a.has_picture ? RTP_FEC_REF : RTP_FEC_NONREF),&fL,&fD);
+			int n = (int)(rtp.PacketCount() - sent);
+			if(fec && fL > 0 && n > 0)
+			{
+				nominal += n * (1.0 / fL + (fD >= 2 ? 1.0 / fD : 0));
+				expected += (n + fL - 1) / fL;
+				if(fD >= 2)
+				{
+					//整块每列一个；最后不满的块中有两个以上包的列数为 剩余包数-L(不超过L)
+					int rest = n % (fL * fD);
+					expected += (uint64_t)(n / (fL * fD)) * fL + std::min(std::max(rest - fL,0),fL);
+				}
+			}
+		}
+		else
+			receiver.Flush();
+		//每发送一帧就把已经到达的包取出来，不会超过接收缓冲区
+		while(receiver.ReceiveFrame(frame,i < aus.size() ? 1 : 0))
+		{
+			if(!frame.complete)
+				continue;
+			complete++;
+			std::map<unsigned int,size_t>::iterator it = index.find(frame.timestamp);
+			if(it == index.end())
+			{
+				mismatch++;
+				continue;
+			}
+			//重组出的帧为每个NALU前加4字节起始码
+			const AccessUnit& au = aus[it->second];
+			const unsigned char* p = frame.data;
+			bool same = true;
+			for(size_t k = 0; k < au.nalus.size() && same; k++)
+			{
+				const NaluView& n = au.nalus[k];
+				if(p + 4 + n.len > frame.data + frame.size || p[3] != 1 || memcmp(p + 4,n.data,n.len) != 0)
+					same = false;
+				p += 4 + n.len;
+			}
+			if(!same || p != frame.data + frame.size)
+				mismatch++;
+		}
+	}
+
+	receiver.GetStats(&stats);
+	double packets = rtp.PacketCount() > 0 ? rtp.PacketCount() : 1;
+	printf("%-8s packets: %u, fec: %u (%.1f%%, nominal %.1f%%, expected %llu), dropped: %llu, recovered: %llu, lost: %llu, frames: %llu/%u complete, mismatch: %llu\n",name,
+		rtp.PacketCount(),rtp.FecPacketCount(),rtp.FecPacketCount() * 100.0 / packets,nominal * 100.0 / packets,(unsigned long long)expected,
+		(unsigned long long)stats.dropped,(unsigned long long)stats.recovered,(unsigned long long)stats.lost,
+		(unsigned long long)complete,(unsigned int)aus.size(),(unsigned long long)mismatch);
+}
+
+int main(int argc, char* argv[])
+{
+	//用法: ./rtpfecloss [码流文件] [丢包率] [连续丢包数]
+	const char* file = argc > 1 ? argv[1] : "./res/cuc_ieschool.h264";
+	double loss = argc > 2 ? atof(argv[2]) : 0.05;
+	int burst = argc > 3 ? atoi(argv[3]) : 1;
+	CAnnexbScanner scanner;
+	CAccessUnitAssembler assembler;
+	std::vector<AccessUnit> aus;
+	AccessUnit au;
+
+	if(!scanner.Open(file))
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,file);
+		return -1;
+	}
+	assembler.Attach(&scanner);
+	while(assembler.Next(au))
+		aus.push_back(au);
+
+	printf("%s: %d access units, loss %.1f%%, burst %d\n",file,(int)aus.size(),loss * 100,burst);
+	run("none",aus,loss,burst,false,0,0);
+	run("default",aus,loss,burst,true,0,0);
+	run("row 8",aus,loss,burst,true,8,0);
+	run("2d 4x4",aus,loss,burst,true,4,4);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*************************************************************************
+    > File Name: simplest_rtp_impair.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 05时02分19秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <deque>
+#include <vector>
+
+//发送端的RTP和RTCP都停止超过该时间(秒)后退出
+#define IMPAIR_IDLE_SEC 5
+
+/**
+ * 回环上模拟一条瓶颈链路，用于测试拥塞控制：
+ * RTP包先按丢包率随机丢弃，再进入按带宽发送的队列，排队超过队列长度时丢弃(drop-tail)，
+ * 发出后再经过固定的传播时延到达接收端。RTCP双向转发：发送端的SR转给接收端，
+ * 接收端的RR、NACK和拥塞控制反馈按同样的传播时延转回发送端
+ */
+typedef struct _Packet
+{
+	int64_t due;                  //转发的时刻，纳秒
+	std::vector<unsigned char> data;
+}Packet;
+
+typedef struct _Step
+{
+	double sec;                   //从收到第一个包开始的秒数
+	double bps;
+}Step;
+
+static int64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int open_socket(int port)
+{
+	struct sockaddr_in addr;
+	int fd = socket(AF_INET,SOCK_DGRAM,0);
+	int bufsize = 4 * 1024 * 1024;
+
+	if(fd < 0)
+		return -1;
+	setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&bufsize,sizeof(bufsize));
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if(bind(fd,(struct sockaddr*)&addr,sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int main(int argc,char* argv[])
+{
+	//用法: ./rtpimpair 监听端口 目的IP:端口 [-bw kbps] [-delay ms] [-loss 丢包率] [-queue ms] [-step 秒:kbps ...]
+	//发送端发往监听端口，这里转发到目的地址；RTCP分别使用两个端口加1
+	if(argc < 3)
+	{
+		printf("usage: %s listen_port dest_ip:port [-bw kbps] [-delay ms] [-loss p] [-queue ms] [-step sec:kbps]\n",argv[0]);
+		return 1;
+	}
+	int listen_port = atoi(argv[1]);
+	char ip[64];
+	int dest_port = 0;
+	double bps = 1000000,delay_ms = 20,loss = 0,queue_ms = 300;
+	std::vector<Step> steps;
+
+	if(sscanf(argv[2],"%63[^:]:%d",ip,&dest_port) != 2)
+	{
+		printf("%s: ====haoge====invalid destination %s\n",__FUNCTION__,argv[2]);
+		return 1;
+	}
+	for(int i = 3; i + 1 < argc; i += 2)
+	{
+		if(strcmp(argv[i],"-bw") == 0)
+			bps = atof(argv[i + 1]) * 1000;
+		else if(strcmp(argv[i],"-delay") == 0)
+			delay_ms = atof(argv[i + 1]);
+		else if(strcmp(argv[i],"-loss") == 0)
+			loss = atof(argv[i + 1]);
+		else if(strcmp(argv[i],"-queue") == 0)
+			queue_ms = atof(argv[i + 1]);
+		else if(strcmp(argv[i],"-step") == 0)
+		{
+			Step s;
+			double kbps;
+			if(sscanf(argv[i + 1],"%lf:%lf",&s.sec,&kbps) == 2)
+			{
+				s.bps = kbps * 1000;
+				steps.push_back(s);
+			}
+		}
+	}
+
+	struct sockaddr_in dest,dest_rtcp,sender_rtcp,from;
+	socklen_t fromlen;
+	memset(&dest,0,sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(dest_port);
+	if(inet_pton(AF_INET,ip,&dest.sin_addr) != 1)
+	{
+		printf("%s: ====haoge====invalid address %s\n",__FUNCTION__,ip);
+		return 1;
+	}
+	dest_rtcp = dest;
+	dest_rtcp.sin_port = htons(dest_port + 1);
+	bool has_sender = false;
+
+	//rtp_fd收发送端的RTP并转发；sr_fd收发送端的RTCP，也用来把反馈转回去；fb_fd把SR转给接收端并收它的反馈
+	int rtp_fd = open_socket(listen_port);
+	int sr_fd = open_socket(listen_port + 1);
+	int fb_fd = open_socket(0);
+	if(rtp_fd < 0 || sr_fd < 0 || fb_fd < 0)
+	{
+		printf("%s: ====haoge====bind port %d error\n",__FUNCTION__,listen_port);
+		return 1;
+	}
+	printf("%s: ====haoge====port %d -> %s:%d, bandwidth: %.0fkbps, delay: %.0fms, loss: %.2f%%, queue: %.0fms\n",__FUNCTION__,
+		listen_port,ip,dest_port,bps / 1000,delay_ms,loss * 100,queue_ms);
+
+	std::deque<Packet> media,sr,fb;
+	std::vector<unsigned char> buf(65536);
+	int64_t delay = (int64_t)(delay_ms * 1000000);
+	int64_t link_free = 0,start = 0,last_active = 0,next_print = 0;
+	size_t next_step = 0;
+	uint64_t in_bytes = 0,out_bytes = 0,in_pkts = 0,queue_drops = 0,loss_drops = 0,rtcp_pkts = 0;
+	uint64_t total_in = 0,total_queue_drops = 0,total_loss_drops = 0;
+	srand(1);
+
+	for(;;)
+	{
+		int64_t now = now_ns();
+		if(start > 0 && now - last_active > IMPAIR_IDLE_SEC * 1000000000LL && media.empty())
+			break;
+
+		//到时间的包依次转发，三个队列的到达时刻各自是递增的
+		while(!media.empty() && media.front().due <= now)
+		{
+			sendto(rtp_fd,&media.front().data[0],media.front().data.size(),0,(struct sockaddr*)&dest,sizeof(dest));
+			out_bytes += media.front().data.size();
+			media.pop_front();
+		}
+		while(!sr.empty() && sr.front().due <= now)
+		{
+			sendto(fb_fd,&sr.front().data[0],sr.front().data.size(),0,(struct sockaddr*)&dest_rtcp,sizeof(dest_rtcp));
+			sr.pop_front();
+		}
+		while(!fb.empty() && fb.front().due <= now)
+		{
+			sendto(sr_fd,&fb.front().data[0],fb.front().data.size(),0,(struct sockaddr*)&sender_rtcp,sizeof(sender_rtcp));
+			fb.pop_front();
+		}
+
+		if(start > 0 && now >= next_print)
+		{
+			double queued = link_free > now ? (link_free - now) / 1e6 : 0;
+			printf("%s: ====haoge====%.0fs in: %.0fkbps %llu pkts, out: %.0fkbps, bandwidth: %.0fkbps, queue: %.1fms, queue drops: %llu, loss drops: %llu, rtcp: %llu\n",__FUNCTION__,
+				(now - start) / 1e9,in_bytes * 8 / 1000.0,(unsigned long long)in_pkts,out_bytes * 8 / 1000.0,bps / 1000,queued,
+				(unsigned long long)queue_drops,(unsigned long long)loss_drops,(unsigned long long)rtcp_pkts);
+			in_bytes = out_bytes = in_pkts = queue_drops = loss_drops = rtcp_pkts = 0;
+			next_print += 1000000000LL;
+		}
+		if(start > 0 && next_step < steps.size() && now - start >= (int64_t)(steps[next_step].sec * 1e9))
+		{
+			bps = steps[next_step++].bps;
+			printf("%s: ====haoge====bandwidth changed to %.0fkbps\n",__FUNCTION__,bps / 1000);
+		}
+
+		//等到下一个要转发的包，最多等到下一次打印
+		int64_t wake = now + 100000000LL;
+		if(!media.empty() && media.front().due < wake)
+			wake = media.front().due;
+		if(!sr.empty() && sr.front().due < wake)
+			wake = sr.front().due;
+		if(!fb.empty() && fb.front().due < wake)
+			wake = fb.front().due;
+		struct pollfd pfd[3] = { { rtp_fd,POLLIN,0 },{ sr_fd,POLLIN,0 },{ fb_fd,POLLIN,0 } };
+		int ms = (int)((wake - now + 999999) / 1000000);
+		if(poll(pfd,3,ms > 0 ? ms : 0) <= 0)
+			continue;
+		now = now_ns();
+
+		if(pfd[0].revents & POLLIN)
+		{
+			int n;
+			while((n = recv(rtp_fd,&buf[0],buf.size(),MSG_DONTWAIT)) > 0)
+			{
+				if(start == 0)
+				{
+					start = now;
+					next_print = now + 1000000000LL;
+				}
+				last_active = now;
+				in_bytes += n;
+				in_pkts++;
+				total_in++;
+				if(loss > 0 && rand() < loss * RAND_MAX)
+				{
+					loss_drops++;
+					total_loss_drops++;
+					continue;
+				}
+				//瓶颈队列：排队时间超过队列长度就丢弃，否则按带宽排在前一个包之后发出
+				if(link_free < now)
+					link_free = now;
+				if(link_free - now > (int64_t)(queue_ms * 1000000))
+				{
+					queue_drops++;
+					total_queue_drops++;
+					continue;
+				}
+				link_free += (int64_t)(n * 8 * 1e9 / bps);
+				Packet p;
+				p.due = link_free + delay;
+				p.data.assign(buf.begin(),buf.begin() + n);
+				media.push_back(p);
+			}
+		}
+		if(pfd[1].revents & POLLIN)
+		{
+			int n;
+			fromlen = sizeof(from);
+			while((n = recvfrom(sr_fd,&buf[0],buf.size(),MSG_DONTWAIT,(struct sockaddr*)&from,&fromlen)) > 0)
+			{
+				//记住发送端RTCP的地址，反馈转回这里；发送端丢弃帧时可能一段时间没有RTP包，SR也算它还在发送
+				sender_rtcp = from;
+				if(start > 0)
+					last_active = now;
+				has_sender = true;
+				rtcp_pkts++;
+				Packet p;
+				p.due = now + delay;
+				p.data.assign(buf.begin(),buf.begin() + n);
+				sr.push_back(p);
+				fromlen = sizeof(from);
+			}
+		}
+		if(pfd[2].revents & POLLIN)
+		{
+			int n;
+			while((n = recv(fb_fd,&buf[0],buf.size(),MSG_DONTWAIT)) > 0)
+			{
+				if(!has_sender)
+					continue;
+				rtcp_pkts++;
+				Packet p;
+				p.due = now + delay;
+				p.data.assign(buf.begin(),buf.begin() + n);
+				fb.push_back(p);
+			}
+		}
+	}
+
+	printf("%s: ====haoge====packets: %llu, queue drops: %llu, loss drops: %llu\n",__FUNCTION__,
+		(unsigned long long)total_in,(unsigned long long)total_queue_drops,(unsigned long long)total_loss_drops);
+	close(rtp_fd);
+	close(sr_fd);
+	close(fb_fd);
+	return 0;
+}
@@ -0,0 +1,80 @@
+/*************************************************************************
+    > File Name: simplest_rtp_recv_h264.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 01时15分26秒
+ ************************************************************************/
+
+#include <stdlib.h>
+#include "CRtpH264Receiver.h"
+
+//没有数据超过该时间(毫秒)认为发送结束
+#define RECV_IDLE_MS  3000
+
+int main(int argc, char* argv[])
+{
+	//用法: ./rtprecvh264 [端口] [输出的码流文件] [没有包到达多少毫秒后结束]
+	//发送端打开拥塞控制时可能丢弃到下一个IDR帧之前的所有帧，需要等待更长的时间
+	int port = argc > 1 ? atoi(argv[1]) : 16000;
+	const char* out = argc > 2 ? argv[2] : "recv.h264";
+	int idle = argc > 3 ? atoi(argv[3]) : RECV_IDLE_MS;
+	CRtpH264Receiver receiver;
+	RtpFrame frame;
+	RtpRecvStats stats;
+	bool started = false,waitKey = true;
+	uint64_t skipped = 0;
+
+	if(!receiver.Open(port))
+		return -1;
+	FILE* fp = fopen(out,"wb");
+	if(fp == NULL)
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,out);
+		return -1;
+	}
+	printf("%s: ====haoge====listening on port %d\n",__FUNCTION__,port);
+
+	while(1)
+	{
+		if(!receiver.ReceiveFrame(frame,idle))
+		{
+			if(!started)
+				continue;
+			//发送结束，输出抖动缓冲区中剩下的帧
+			receiver.Flush();
+			if(!receiver.ReceiveFrame(frame,0))
+				break;
+		}
+		started = true;
+		//有丢包的帧不写入，之后等到下一个关键帧再开始写，避免解码器引用不完整的帧
+		if(!frame.complete)
+			waitKey = true;
+		if(waitKey && frame.complete && frame.keyframe)
+			waitKey = false;
+		if(waitKey)
+		{
+			skipped++;
+			continue;
+		}
+		fwrite(frame.data,1,frame.size,fp);
+	}
+	fclose(fp);
+
+	receiver.GetStats(&stats);
+	printf("%s: ====haoge====packets: %llu, bytes: %llu, lost: %llu, reordered: %llu, late: %llu, duplicates: %llu, invalid: %llu\n",__FUNCTION__,
+		(unsigned long long)stats.packets,(unsigned long long)stats.bytes,(unsigned long long)stats.lost,(unsigned long long)stats.reordered,
+		(unsigned long long)stats.late,(unsigned long long)stats.duplicates,(unsigned long long)stats.invalid);
+	printf("%s: ====haoge====frames: %llu, damaged: %llu, skipped: %llu, jitter: %.2fms, depth: %.1fms\n",__FUNCTION__,
+		(unsigned long long)stats.frames,(unsigned long long)stats.damaged,(unsigned long long)skipped,stats.jitter,stats.depth);
+	printf("%s: ====haoge====nack: %llu, repaired: %llu, rtx: %llu, fec: %llu, recovered: %llu, feedbacks: %llu\n",__FUNCTION__,
+		(unsigned long long)stats.nacks,(unsigned long long)stats.repaired,(unsigned long long)stats.rtx,
+		(unsigned long long)stats.fec,(unsigned long long)stats.recovered,(unsigned long long)stats.feedbacks);
+
+	//RTCP统计：按序列号范围计算的丢包(与抖动缓冲区判定的丢包不同，迟到的包算作收到)以及最近SR的时间戳对应关系
+	RtcpStats rtcp;
+	if(receiver.GetRtcpStats(&rtcp))
+		printf("%s: ====haoge====rtcp ssrc %u: received: %llu, expected: %lld, lost: %lld, fraction lost: %.2f%%, jitter: %.2fms, sr: %llu, sr ntp: %.3f, sr rtp: %u\n",__FUNCTION__,
+			rtcp.ssrc,(unsigned long long)rtcp.packets,(long long)rtcp.expected,(long long)rtcp.lost,rtcp.fraction_lost * 100,rtcp.jitter,
+			(unsigned long long)rtcp.reports,rtcp.sr_ntp / 4294967296.0,rtcp.sr_rtp);
+	return 0;
+}
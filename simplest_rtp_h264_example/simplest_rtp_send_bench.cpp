@@ -0,0 +1,94 @@
+/*************************************************************************
+    > File Name: simplest_rtp_send_bench.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 23时36分12秒
+ ************************************************************************/
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "CRtpH264.h"
+
+//每种发送方式重复发送整个文件的次数
+#define BENCH_ROUNDS 50
+//扇出测试的目的地址数
+#define BENCH_FANOUT 16
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_sec()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static void bench(CRtpH264& rtp,const std::vector<AccessUnit>& aus,bool batch,bool gso)
+{
+	unsigned int pkts = rtp.PacketCount();
+	rtp.SetBatchSend(batch);
+	rtp.SetGso(gso);
+	double t0 = now_sec(),c0 = cpu_sec();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(size_t i = 0; i < aus.size(); i++)
+			rtp.SendAccessUnit(aus[i]);
+	double t = now_sec() - t0,c = cpu_sec() - c0;
+	pkts = rtp.PacketCount() - pkts;
+	printf("%-9s packets: %u, time: %.3fs, %.0f pps, cpu: %.3fs, %.0f pps/cpu-s\n",gso ? (rtp.IsGso() ? "gso" : "gso(off)") : (batch ? "sendmmsg" : "sendmsg"),pkts,t,pkts / t,c,c > 0 ? pkts / c : 0);
+}
+
+int main(int argc, char* argv[])
+{
+	//用法: ./rtpsendbench [码流文件]
+	const char* file = argc > 1 ? argv[1] : "./res/cuc_ieschool.h264";
+	CAnnexbScanner scanner;
+	CAccessUnitAssembler assembler;
+	std::vector<AccessUnit> aus;
+	AccessUnit au;
+
+	//接收端只绑定端口不读取，不影响发送端的开销
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int sink = socket(AF_INET,SOCK_DGRAM,0);
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	if(sink < 0 || bind(sink,(struct sockaddr*)&addr,sizeof(addr)) != 0 || getsockname(sink,(struct sockaddr*)&addr,&addrlen) != 0)
+	{
+		printf("%s: ====haoge====bind sink socket error\n",__FUNCTION__);
+		return -1;
+	}
+
+	if(!scanner.Open(file))
+	{
+		printf("%s: ====haoge====open file %s error\n",__FUNCTION__,file);
+		return -1;
+	}
+	//先取出所有访问单元，测试时只包括打包和发送
+	assembler.Attach(&scanner);
+	while(assembler.Next(au))
+		aus.push_back(au);
+
+	CRtpH264 rtp;
+	rtp.initSocket("127.0.0.1",ntohs(addr.sin_port));
+	printf("%s: %d access units x %d rounds\n",file,(int)aus.size(),BENCH_ROUNDS);
+	bench(rtp,aus,false,false);
+	bench(rtp,aus,true,false);
+	bench(rtp,aus,true,true);
+
+	//扇出：同一份包发送到多个目的地址，统计的是所有目的地址的包数
+	for(int i = 1; i < BENCH_FANOUT; i++)
+		rtp.AddDestination("127.0.0.1",ntohs(addr.sin_port));
+	printf("fan-out to %d destinations:\n",rtp.DestinationCount());
+	bench(rtp,aus,true,false);
+	bench(rtp,aus,true,true);
+
+	close(sink);
+	return 0;
+}
@@ -15,7 +15,28 @@ int main(int argc, char* argv[])
 	CRtpH264* pRtpH264 = new CRtpH264;
 	pRtpH264->initSocket(DEST_IP,DEST_PORT);
    
-	pRtpH264->ConstructRtpPacket("./res/test.h264");
+	//用法: ./rtph264 [码流文件] [起始时间(秒)] [IP:端口 ...] [-fec] [-cc]
+	//之后的每个IP:端口都是扇出的目的地址，同一份包同时发送给它们；-fec打开前向纠错，-cc打开拥塞控制
+	const char* file = argc > 1 ? argv[1] : "./res/test.h264";
+	double start_sec = argc > 2 ? atof(argv[2]) : 0;
+	for(int i = 3; i < argc; i++)
+	{
+		char ip[64];
+		int port = 0;
+		if(strcmp(argv[i],"-fec") == 0)
+		{
+			pRtpH264->SetFec(true);
+			continue;
+		}
+		if(strcmp(argv[i],"-cc") == 0)
+		{
+			pRtpH264->SetCongestionControl(true);
+			continue;
+		}
+		if(sscanf(argv[i],"%63[^:]:%d",ip,&port) != 2 || pRtpH264->AddDestination(ip,port) < 0)
+			printf("%s: ====haoge====invalid destination %s\n",__FUNCTION__,argv[i]);
+	}
+	pRtpH264->ConstructRtpPacket(file,start_sec);
 
 	delete pRtpH264;
 
@@ -0,0 +1,117 @@
+/*************************************************************************
+    > File Name: simplest_startcode_bench.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月15日 星期四 11时40分07秒
+ ************************************************************************/
+
+#include <time.h>
+#include "../common/CAnnexbScanner.h"
+
+//每个文件重复扫描的次数，文件只有1~2MB，重复多次以得到稳定的吞吐量
+#define BENCH_ROUNDS 200
+
+static int FindStartCode2(const unsigned char* Buf)
+{
+	if(Buf[0] != 0 || Buf[1] != 0 || Buf[2] != 1)
+		return 0; //判断是否为0x000001,如果是返回 1
+	else
+		return 1;
+}
+
+static int FindStartCode3(const unsigned char* Buf)
+{
+	if(Buf[0] != 0 || Buf[1] != 0 || Buf[2] != 0 || Buf[3] != 1)
+		return 0;//判断是否为0x00000001,如果是返回 1
+	else
+		return 1;
+}
+
+//原来的逐字节查找方式：在每个位置依次判断4字节和3字节起始码
+static int CountByteLoop(const unsigned char* buf,uint64_t size)
+{
+	int count = 0;
+	for(uint64_t i = 0; i + 4 <= size; i++)
+	{
+		if(FindStartCode3(&buf[i]))
+		{
+			count++;
+			i += 3;
+		}
+		else if(FindStartCode2(&buf[i]))
+		{
+			count++;
+			i += 2;
+		}
+	}
+	return count;
+}
+
+static int CountKernel(const unsigned char* buf,uint64_t size)
+{
+	int count = 0;
+	const unsigned char* end = buf + size;
+	const unsigned char* p = CStartCodeFinder::Find(buf,end);
+	while(p != end)
+	{
+		count++;
+		p = CStartCodeFinder::Find(p + 3,end);
+	}
+	return count;
+}
+
+static double NowSec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void BenchFile(const char* fn)
+{
+	CAnnexbScanner scanner;
+	if(!scanner.Open(fn))
+		return;
+
+	const unsigned char* buf = scanner.Base();
+	uint64_t size = scanner.Size();
+	double bytes = (double)size * BENCH_ROUNDS;
+	int count = 0;
+
+	printf("%s: %llu bytes x %d rounds\n",fn,(unsigned long long)size,BENCH_ROUNDS);
+
+	double t = NowSec();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		count = CountByteLoop(buf,size);
+	t = NowSec() - t;
+	printf("  %-10s start codes: %6d  %8.3f GB/s\n","byte-loop",count,bytes / t / 1e9);
+
+	const int kernels[] = {START_CODE_KERNEL_SCALAR,START_CODE_KERNEL_SSE2,START_CODE_KERNEL_AVX2};
+	for(unsigned int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		if(CStartCodeFinder::SetKernel(kernels[k]) != kernels[k])
+			continue;
+		t = NowSec();
+		for(int r = 0; r < BENCH_ROUNDS; r++)
+			count = CountKernel(buf,size);
+		t = NowSec() - t;
+		printf("  %-10s start codes: %6d  %8.3f GB/s\n",CStartCodeFinder::KernelName(),count,bytes / t / 1e9);
+	}
+	CStartCodeFinder::SetKernel(START_CODE_KERNEL_AUTO);
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc > 1)
+	{
+		for(int i = 1; i < argc; i++)
+			BenchFile(argv[i]);
+	}
+	else
+	{
+		BenchFile("./res/cuc_ieschool.h264");
+		BenchFile("../simplest_mediadata/h264/sintel.h264");
+	}
+	return 0;
+}
+
@@ -0,0 +1,157 @@
+/*************************************************************************
+    > File Name: simplest_ts_send.cpp
+    > Author: zhongjihao
+    > Mail: zhongjihao100@163.com
+    > Created Time: 2026年10月16日 星期五 07时31分08秒
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <vector>
+#include "../common/CAccessUnitAssembler.h"
+#include "../common/CTsMuxer.h"
+#include "CRtpPacer.h"
+
+#define DEST_IP                "127.0.0.1"
+#define DEST_PORT              8888
+
+//ADTS头中sampling_frequency_index对应的采样率
+static const int s_AdtsRates[16] = { 96000,88200,64000,48000,44100,32000,24000,22050,16000,12000,11025,8000,7350,0,0,0 };
+
+static int read_file(const char* fn,std::vector<unsigned char>& data)
+{
+	FILE* fp = fopen(fn,"rb");
+	if(!fp)
+		return 0;
+	fseek(fp,0,SEEK_END);
+	long size = ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	data.resize(size > 0 ? size : 0);
+	size_t n = size > 0 ? fread(&data[0],1,size,fp) : 0;
+	fclose(fp);
+	return n == data.size();
+}
+
+int main(int argc,char* argv[])
+{
+	//用法: ./tssend [H.264码流文件] [IP:端口] [-aac AAC文件] [-rtp] [-psi 毫秒] [-fill]
+	//把H.264(以及AAC)封装成MPEG-TS，每个UDP包7个TS包按帧间隔发送，-rtp时加上负载类型33的RTP包头。
+	//每帧结束时发出不满7个TS包的UDP包，-fill时留到下一帧凑满再发(包数少，但每帧最后几个TS包晚一个帧间隔到达)
+	const char* file = argc > 1 ? argv[1] : "./res/test.h264";
+	const char* aac_file = NULL;
+	char ip[64] = DEST_IP;
+	int port = DEST_PORT;
+	bool rtp = false;
+	int psi_ms = TS_MUX_PSI_INTERVAL;
+	bool fill = false;
+
+	for(int i = 2; i < argc; i++)
+	{
+		if(strcmp(argv[i],"-aac") == 0 && i + 1 < argc)
+			aac_file = argv[++i];
+		else if(strcmp(argv[i],"-rtp") == 0)
+			rtp = true;
+		else if(strcmp(argv[i],"-psi") == 0 && i + 1 < argc)
+			psi_ms = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-fill") == 0)
+			fill = true;
+		else if(sscanf(argv[i],"%63[^:]:%d",ip,&port) != 2)
+			printf("%s: ====haoge====invalid argument %s\n",__FUNCTION__,argv[i]);
+	}
+
+	struct sockaddr_in dest;
+	memset(&dest,0,sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(port);
+	if(inet_pton(AF_INET,ip,&dest.sin_addr) != 1)
+	{
+		printf("%s: ====haoge====invalid address %s\n",__FUNCTION__,ip);
+		return 1;
+	}
+	int fd = socket(AF_INET,SOCK_DGRAM,0);
+	if(fd < 0)
+	{
+		perror("socket");
+		return 1;
+	}
+
+	CAnnexbScanner scanner;
+	CAccessUnitAssembler assembler;
+	if(!scanner.Open(file))
+	{
+		printf("%s: ====haoge====open %s error\n",__FUNCTION__,file);
+		close(fd);
+		return 1;
+	}
+	assembler.Attach(&scanner);
+
+	//AAC文件整个读入，按ADTS帧长依次取帧，每帧1024个采样
+	std::vector<unsigned char> aac;
+	if(aac_file && !read_file(aac_file,aac))
+	{
+		printf("%s: ====haoge====open %s error\n",__FUNCTION__,aac_file);
+		aac.clear();
+	}
+	size_t aac_pos = 0;
+	uint64_t aac_frames = 0;
+
+	CTsMuxer muxer;
+	CRtpPacer pacer;
+	srand(time(NULL));
+	muxer.SetPids(1,TS_MUX_PMT_PID,TS_MUX_VIDEO_PID,aac.empty() ? -1 : TS_MUX_AUDIO_PID);
+	muxer.SetPsiInterval(psi_ms);
+	muxer.SetRtp(rtp,(uint32_t)rand());
+	muxer.SetOutput([&](const unsigned char* data,int len) {
+		if(sendto(fd,data,len,0,(struct sockaddr*)&dest,sizeof(dest)) < 0)
+			perror("sendto");
+	});
+	printf("%s: ====haoge====%s -> %s:%d%s%s\n",__FUNCTION__,file,ip,port,aac.empty() ? "" : " with aac",rtp ? " (rtp)" : "");
+
+	AccessUnit au;
+	while(assembler.Next(au))
+	{
+		//等到这一帧的发送时刻
+		pacer.BeginFrame(au.dts,au.duration,0);
+
+		//先发送时间戳不晚于这一帧结束的音频帧
+		while(aac_pos + 7 <= aac.size())
+		{
+			const unsigned char* p = &aac[aac_pos];
+			if(p[0] != 0xff || (p[1] & 0xf0) != 0xf0)
+				break;
+			int rate = s_AdtsRates[(p[2] >> 2) & 0x0f];
+			unsigned int len = ((p[3] & 0x03) << 11) | (p[4] << 3) | (p[5] >> 5);
+			if(rate == 0 || len < 7 || aac_pos + len > aac.size())
+				break;
+			int64_t pts = (int64_t)(aac_frames * 1024 * AU_TIME_BASE / rate);
+			if(pts > au.dts + au.duration)
+				break;
+			muxer.WriteAudio(p,len,pts);
+			aac_pos += len;
+			aac_frames++;
+		}
+
+		if(!au.nalus.empty())
+			muxer.WriteVideo(&au.nalus[0],au.nalus.size(),au.pts,au.dts,au.idr != 0);
+		//这一帧的TS包全部在它的发送时刻发出，否则最后几个TS包要等到下一帧，PCR抖动达到一个帧间隔
+		if(!fill)
+			muxer.Flush();
+	}
+	muxer.Flush();
+
+	TsMuxStats stats;
+	muxer.GetStats(&stats);
+	printf("%s: ====haoge====video: %llu, audio: %llu, ts packets: %llu, datagrams: %llu, psi: %llu, pcr: %llu, stuffing: %llu bytes\n",__FUNCTION__,
+		(unsigned long long)stats.video_units,(unsigned long long)stats.audio_units,(unsigned long long)stats.packets,
+		(unsigned long long)stats.datagrams,(unsigned long long)stats.psi,(unsigned long long)stats.pcrs,(unsigned long long)stats.stuffing);
+
+	scanner.Close();
+	close(fd);
+	return 0;
+}